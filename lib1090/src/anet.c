@@ -202,6 +202,67 @@ int anetTcpNonBlockConnect(char *err, char *addr, char *service)
     return anetTcpGenericConnect(err,addr,service,ANET_CONNECT_NONBLOCK);
 }
 
+/* Create a non-blocking UDP socket connected to addr:service, so plain
+ * write(2) sends datagrams there. If addr is a multicast group, datagrams
+ * are sent with the given TTL (hop limit). */
+int anetUdpConnect(char *err, char *addr, char *service, int ttl)
+{
+    int s;
+    struct addrinfo gai_hints;
+    struct addrinfo *gai_result, *p;
+    int gai_error;
+
+    memset(&gai_hints, 0, sizeof(gai_hints));
+    gai_hints.ai_family = AF_UNSPEC;
+    gai_hints.ai_socktype = SOCK_DGRAM;
+
+    gai_error = getaddrinfo(addr, service, &gai_hints, &gai_result);
+    if (gai_error != 0) {
+        anetSetError(err, "can't resolve %s: %s", addr, gai_strerror(gai_error));
+        return ANET_ERR;
+    }
+
+    for (p = gai_result; p != NULL; p = p->ai_next) {
+        if ((s = socket(p->ai_family, SOCK_DGRAM, 0)) == -1) {
+            anetSetError(err, "creating socket: %s", strerror(errno));
+            continue;
+        }
+
+        if (p->ai_family == AF_INET &&
+            IN_MULTICAST(ntohl(((struct sockaddr_in *) p->ai_addr)->sin_addr.s_addr))) {
+            unsigned char hops = ttl;
+            if (setsockopt(s, IPPROTO_IP, IP_MULTICAST_TTL, (void*)&hops, sizeof(hops)) == -1) {
+                anetSetError(err, "setsockopt IP_MULTICAST_TTL: %s", strerror(errno));
+                close(s);
+                continue;
+            }
+        } else if (p->ai_family == AF_INET6 &&
+                   IN6_IS_ADDR_MULTICAST(&((struct sockaddr_in6 *) p->ai_addr)->sin6_addr)) {
+            if (setsockopt(s, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, (void*)&ttl, sizeof(ttl)) == -1) {
+                anetSetError(err, "setsockopt IPV6_MULTICAST_HOPS: %s", strerror(errno));
+                close(s);
+                continue;
+            }
+        }
+
+        if (anetNonBlock(err, s) != ANET_OK) {
+            close(s);
+            continue;
+        }
+
+        if (connect(s, p->ai_addr, p->ai_addrlen) >= 0) {
+            freeaddrinfo(gai_result);
+            return s;
+        }
+
+        anetSetError(err, "connect: %s", strerror(errno));
+        close(s);
+    }
+
+    freeaddrinfo(gai_result);
+    return ANET_ERR;
+}
+
 /* Like read(2) but make sure 'count' is read before to return
  * (unless error or EOF condition is encountered) */
 int anetRead(int fd, char *buf, int count)
@@ -64,6 +64,7 @@
 
 int anetTcpConnect(char *err, char *addr, char *service);
 int anetTcpNonBlockConnect(char *err, char *addr, char *service);
+int anetUdpConnect(char *err, char *addr, char *service, int ttl);
 int anetRead(int fd, char *buf, int count);
 int anetTcpServer(char *err, char *service, char *bindaddr, int *fds, int nfds);
 int anetTcpAccept(char *err, int serversock);
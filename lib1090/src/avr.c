@@ -0,0 +1,102 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// avr.c: AVR / raw hex input parsing
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "dump1090.h"
+
+// Raw input lines are parsed without strlen(), trimming in place or
+// per-digit range checks: every digit goes through avrHexValue, and the
+// values are OR-ed together so one test at the end catches any bad digit.
+
+const unsigned char avrHexValue[256] = {
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+};
+
+// Convert 2*n hex digits to n bytes. Returns 0 if any of them is not hex.
+static int hexToBytes(const unsigned char *p, int n, unsigned char *out)
+{
+    unsigned bad = 0;
+
+    for (int i = 0; i < n; ++i) {
+        unsigned hi = avrHexValue[p[2*i]];
+        unsigned lo = avrHexValue[p[2*i+1]];
+        bad |= hi | lo;
+        out[i] = (hi << 4) | lo;
+    }
+
+    return !(bad & AVR_NOT_HEX);
+}
+
+int avrDecodeLine(const char *line, const char *end, struct avr_frame *frame)
+{
+    const unsigned char *p = (const unsigned char *) line;
+    const unsigned char *e = (const unsigned char *) end;
+    int skip;
+
+    while (p < e && isspace(*p))
+        ++p;
+    while (e > p && isspace(e[-1]))
+        --e;
+
+    if (e - p < 2 || e[-1] != ';')
+        return 0;  // not complete
+
+    switch (*p) {
+    case '<': skip = 1 + 12 + 2; break;   // timestamp and signal level
+    case '@':
+    case '%': skip = 1 + 12; break;       // timestamp
+    case '*':
+    case ':': skip = 1; break;
+    default:
+        return 0;  // we don't know what this is
+    }
+
+    int digits = (e - p) - skip - 1;
+    switch (digits) {
+    case MODEAC_MSG_BYTES * 2:
+    case MODES_SHORT_MSG_BYTES * 2:
+    case MODES_LONG_MSG_BYTES * 2:
+        break;
+    default:
+        return 0;  // too short or long
+    }
+
+    frame->len = digits / 2;
+    frame->signalLevel = 0;
+    if (*p == '<') {
+        unsigned char level;
+        if (!hexToBytes(p + 13, 1, &level))
+            return 0;
+        frame->signalLevel = (level / 255.0) * (level / 255.0);
+    }
+
+    return hexToBytes(p + skip, frame->len, frame->msg);
+}
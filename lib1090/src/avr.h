@@ -0,0 +1,45 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// avr.h: AVR / raw hex input parsing
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DUMP1090_AVR_H
+#define DUMP1090_AVR_H
+
+// Value of each hex digit character, or AVR_NOT_HEX for anything else
+#define AVR_NOT_HEX 0x10
+extern const unsigned char avrHexValue[256];
+
+// One decoded AVR / raw line
+struct avr_frame {
+    unsigned char msg[MODES_LONG_MSG_BYTES];
+    int           len;          // MODEAC_MSG_BYTES, MODES_SHORT_MSG_BYTES or MODES_LONG_MSG_BYTES
+    double        signalLevel;  // from a '<' line, as a fraction of full-scale power; 0 for the others
+};
+
+// Decode one line from 'line' up to (not including) 'end', ignoring
+// whitespace around it. Understands
+//
+//   *8D4B969699155600E87406F5B69F;                 AVR raw
+//   :8D4B969699155600E87406F5B69F;                 AVR raw
+//   @0123456789AB8D4B969699155600E87406F5B69F;     AVR / Beast, with timestamp
+//   %0123456789AB8D4B969699155600E87406F5B69F;     same, CRC known good
+//   <0123456789ABC88D4B969699155600E87406F5B69F;   Beast, timestamp and signal level
+//
+// The timestamps are skipped. Returns 1 and fills in 'frame' for a
+// well-formed line, 0 otherwise.
+int avrDecodeLine(const char *line, const char *end, struct avr_frame *frame);
+
+#endif
@@ -43,41 +43,152 @@ static CommBDecoderFn comm_b_decoders[] = {
     &decodeBDS60
 };
 
-void decodeCommB(struct modesMessage *mm)
+#define NUM_COMMB_DECODERS (sizeof(comm_b_decoders) / sizeof(comm_b_decoders[0]))
+
+// Per-aircraft memory of recent Comm-B replies, direct-mapped on the address
+// (Modes.commb_cache). The scorers only look at MB, so a reply identical to
+// the previous one decodes the same way; and an aircraft is usually asked
+// for the same few registers over and over, so those are tried first, for
+// as long as they keep turning up (COMMB_HIT_TTL).
+#define COMMB_CACHE_SIZE 1024           // entries, must be a power of two
+#define COMMB_CONFIDENT_SCORE 40        // predicted scores at least this skip the full sweep
+
+#define COMMB_RESULT_NONE -1
+#define COMMB_RESULT_AMBIGUOUS -2
+
+struct commb_cache_entry {
+    uint32_t addr;
+    uint64_t updated;                   // sysTimestampMsg of the last reply
+    unsigned char mb[7];                // content of the last reply
+    int8_t result;                      // decoder index it decoded with, or COMMB_RESULT_*
+    uint64_t hit[NUM_COMMB_DECODERS];   // sysTimestampMsg of the last reply each decoder identified, or 0
+};
+
+static struct commb_cache_entry *commbCacheEntry(uint32_t addr)
 {
-    mm->commb_format = COMMB_UNKNOWN;
+    if (!Modes.commb_cache) {
+        Modes.commb_cache = calloc(COMMB_CACHE_SIZE, sizeof(struct commb_cache_entry));
+        if (!Modes.commb_cache) {
+            fprintf(stderr, "comm_b: out of memory\n");
+            exit(1);
+        }
+    }
 
-    // If DR or UM are set, this message is _probably_ noise
-    // as nothing really seems to use the multisite broadcast stuff?
-    // Also skip anything that had errors corrected
-    if (mm->DR != 0 || mm->UM != 0 || mm->correctedbits > 0) {
-        return;
+    uint32_t h = (addr ^ (addr >> 10) ^ (addr >> 20)) & (COMMB_CACHE_SIZE - 1);
+    return &Modes.commb_cache[h];
+}
+
+void commBFree()
+{
+    free(Modes.commb_cache);
+    Modes.commb_cache = NULL;
+}
+
+// Bitmask of the decoders that identified a reply in the last COMMB_HIT_TTL
+static unsigned commbRecent(const struct commb_cache_entry *e, uint64_t now)
+{
+    unsigned mask = 0;
+    for (unsigned i = 0; i < NUM_COMMB_DECODERS; ++i) {
+        if (e->hit[i] && now <= e->hit[i] + COMMB_HIT_TTL)
+            mask |= 1 << i;
     }
+    return mask;
+}
 
+// Try every decoder; returns the winner's index or COMMB_RESULT_*
+static int commBSweep(struct modesMessage *mm)
+{
     // This is a bit hairy as we don't know what the requested register was
     int bestScore = 0;
-    CommBDecoderFn bestDecoder = NULL;
+    int best = COMMB_RESULT_NONE;
     int ambiguous = 0;
 
-    for (unsigned i = 0; i < (sizeof(comm_b_decoders) / sizeof(comm_b_decoders[0])); ++i) {
+    for (unsigned i = 0; i < NUM_COMMB_DECODERS; ++i) {
         int score = comm_b_decoders[i](mm, false);
         if (score > bestScore) {
             bestScore = score;
-            bestDecoder = comm_b_decoders[i];
+            best = i;
             ambiguous = 0;
         } else if (score == bestScore) {
             ambiguous = 1;
         }
     }
 
-    if (bestDecoder) {
-        if (ambiguous) {
-            mm->commb_format = COMMB_AMBIGUOUS;
-        } else {
-            // decode it
-            bestDecoder(mm, true);
+    if (best >= 0 && ambiguous)
+        return COMMB_RESULT_AMBIGUOUS;
+    return best;
+}
+
+// Try only the decoders in 'mask'; returns the winner's index if it is
+// unique and scores at least COMMB_CONFIDENT_SCORE, else COMMB_RESULT_NONE
+static int commBPredict(struct modesMessage *mm, unsigned mask)
+{
+    int bestScore = 0;
+    int best = COMMB_RESULT_NONE;
+    int ambiguous = 0;
+
+    for (unsigned i = 0; mask; ++i, mask >>= 1) {
+        if (!(mask & 1))
+            continue;
+        int score = comm_b_decoders[i](mm, false);
+        if (score > bestScore) {
+            bestScore = score;
+            best = i;
+            ambiguous = 0;
+        } else if (score == bestScore) {
+            ambiguous = 1;
         }
     }
+
+    if (ambiguous || bestScore < COMMB_CONFIDENT_SCORE)
+        return COMMB_RESULT_NONE;
+    return best;
+}
+
+void decodeCommB(struct modesMessage *mm)
+{
+    mm->commb_format = COMMB_UNKNOWN;
+
+    // If DR or UM are set, this message is _probably_ noise
+    // as nothing really seems to use the multisite broadcast stuff?
+    // Also skip anything that had errors corrected
+    if (mm->DR != 0 || mm->UM != 0 || mm->correctedbits > 0) {
+        return;
+    }
+
+    struct commb_cache_entry *e = commbCacheEntry(mm->addr);
+    if (e->addr != mm->addr || mm->sysTimestampMsg > e->updated + COMMB_CACHE_TTL) {
+        e->addr = mm->addr;
+        e->result = COMMB_RESULT_NONE;
+        memset(e->hit, 0, sizeof(e->hit));
+        memset(e->mb, 0, sizeof(e->mb));
+        e->updated = 0;
+    }
+
+    unsigned recent = commbRecent(e, mm->sysTimestampMsg);
+    int result;
+    if (e->updated && !memcmp(e->mb, mm->MB, sizeof(e->mb))) {
+        // same content as last time
+        result = e->result;
+        Modes.stats_current.commb_repeated++;
+    } else if (recent && (result = commBPredict(mm, recent)) >= 0) {
+        Modes.stats_current.commb_predicted++;
+    } else {
+        result = commBSweep(mm);
+        Modes.stats_current.commb_sweeps++;
+    }
+
+    e->updated = mm->sysTimestampMsg;
+    memcpy(e->mb, mm->MB, sizeof(e->mb));
+    e->result = result;
+
+    if (result == COMMB_RESULT_AMBIGUOUS) {
+        mm->commb_format = COMMB_AMBIGUOUS;
+    } else if (result >= 0) {
+        // decode it
+        e->hit[result] = mm->sysTimestampMsg;
+        comm_b_decoders[result](mm, true);
+    }
 }
 
 static int decodeEmptyResponse(struct modesMessage *mm, bool store)
@@ -381,6 +492,7 @@ static int decodeBDS40(struct modesMessage *mm, bool store)
 
     if (store) {
         mm->commb_format = COMMB_VERTICAL_INTENT;
+        modesUseSections(mm, MODES_SECTION_NAV);
 
         if (mcp_valid) {
             mm->nav.mcp_altitude_valid = 1;
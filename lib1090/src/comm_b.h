@@ -21,6 +21,15 @@
 #ifndef COMM_B_H
 #define COMM_B_H
 
+// Prediction cache timeouts, in ms: an aircraft's entry is forgotten after
+// COMMB_CACHE_TTL without a reply, and a register stops being tried first
+// COMMB_HIT_TTL after the last reply it identified
+#define COMMB_CACHE_TTL 60000
+#define COMMB_HIT_TTL 30000
+
 void decodeCommB(struct modesMessage *mm);
 
+// Release the per-instance Comm-B prediction cache
+void commBFree();
+
 #endif
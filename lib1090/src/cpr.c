@@ -66,72 +66,54 @@ static double cprModDouble(double a, double b) {
     return res;
 }
 
+//
+// floor(a / 2^17 + 0.5), i.e. a CPR zone index rounded to nearest, computed
+// in integers. Gives exactly the same result as the floating point form
+// since a is an integer and 2^17 a power of two.
+//
+static int cprRoundIndex(int a) {
+    a += 65536;
+    return (a >= 0 ? a : a - 131071) / 131072;
+}
+
 //
 //=========================================================================
 //
-// The NL function uses the precomputed table from 1090-WP-9-14
+// The NL function uses the precomputed table from 1090-WP-9-14:
+// latitudes below cprNLTable[0] have NL 59, below cprNLTable[1] NL 58,
+// and so on down to NL 1 at 87 degrees and above.
 //
+static const double cprNLTable[58] = {
+    10.47047130, 14.82817437, 18.18626357, 21.02939493,
+    23.54504487, 25.82924707, 27.93898710, 29.91135686,
+    31.77209708, 33.53993436, 35.22899598, 36.85025108,
+    38.41241892, 39.92256684, 41.38651832, 42.80914012,
+    44.19454951, 45.54626723, 46.86733252, 48.16039128,
+    49.42776439, 50.67150166, 51.89342469, 53.09516153,
+    54.27817472, 55.44378444, 56.59318756, 57.72747354,
+    58.84763776, 59.95459277, 61.04917774, 62.13216659,
+    63.20427479, 64.26616523, 65.31845310, 66.36171008,
+    67.39646774, 68.42322022, 69.44242631, 70.45451075,
+    71.45986473, 72.45884545, 73.45177442, 74.43893416,
+    75.42056257, 76.39684391, 77.36789461, 78.33374083,
+    79.29428225, 80.24923213, 81.19801349, 82.13956981,
+    83.07199445, 83.99173563, 84.89166191, 85.75541621,
+    86.53536998, 87.00000000,
+};
+
 static int cprNLFunction(double lat) {
     if (lat < 0) lat = -lat; // Table is simmetric about the equator
-    if (lat < 10.47047130) return 59;
-    if (lat < 14.82817437) return 58;
-    if (lat < 18.18626357) return 57;
-    if (lat < 21.02939493) return 56;
-    if (lat < 23.54504487) return 55;
-    if (lat < 25.82924707) return 54;
-    if (lat < 27.93898710) return 53;
-    if (lat < 29.91135686) return 52;
-    if (lat < 31.77209708) return 51;
-    if (lat < 33.53993436) return 50;
-    if (lat < 35.22899598) return 49;
-    if (lat < 36.85025108) return 48;
-    if (lat < 38.41241892) return 47;
-    if (lat < 39.92256684) return 46;
-    if (lat < 41.38651832) return 45;
-    if (lat < 42.80914012) return 44;
-    if (lat < 44.19454951) return 43;
-    if (lat < 45.54626723) return 42;
-    if (lat < 46.86733252) return 41;
-    if (lat < 48.16039128) return 40;
-    if (lat < 49.42776439) return 39;
-    if (lat < 50.67150166) return 38;
-    if (lat < 51.89342469) return 37;
-    if (lat < 53.09516153) return 36;
-    if (lat < 54.27817472) return 35;
-    if (lat < 55.44378444) return 34;
-    if (lat < 56.59318756) return 33;
-    if (lat < 57.72747354) return 32;
-    if (lat < 58.84763776) return 31;
-    if (lat < 59.95459277) return 30;
-    if (lat < 61.04917774) return 29;
-    if (lat < 62.13216659) return 28;
-    if (lat < 63.20427479) return 27;
-    if (lat < 64.26616523) return 26;
-    if (lat < 65.31845310) return 25;
-    if (lat < 66.36171008) return 24;
-    if (lat < 67.39646774) return 23;
-    if (lat < 68.42322022) return 22;
-    if (lat < 69.44242631) return 21;
-    if (lat < 70.45451075) return 20;
-    if (lat < 71.45986473) return 19;
-    if (lat < 72.45884545) return 18;
-    if (lat < 73.45177442) return 17;
-    if (lat < 74.43893416) return 16;
-    if (lat < 75.42056257) return 15;
-    if (lat < 76.39684391) return 14;
-    if (lat < 77.36789461) return 13;
-    if (lat < 78.33374083) return 12;
-    if (lat < 79.29428225) return 11;
-    if (lat < 80.24923213) return 10;
-    if (lat < 81.19801349) return 9;
-    if (lat < 82.13956981) return 8;
-    if (lat < 83.07199445) return 7;
-    if (lat < 83.99173563) return 6;
-    if (lat < 84.89166191) return 5;
-    if (lat < 85.75541621) return 4;
-    if (lat < 86.53536998) return 3;
-    if (lat < 87.00000000) return 2;
-    else return 1;
+
+    // Binary search for the first boundary above lat
+    unsigned lo = 0, hi = sizeof(cprNLTable) / sizeof(cprNLTable[0]);
+    while (lo < hi) {
+        unsigned mid = (lo + hi) / 2;
+        if (lat < cprNLTable[mid])
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return 59 - lo;
 }
 //
 //=========================================================================
@@ -171,7 +153,7 @@ int decodeCPRairborne(int even_cprlat, int even_cprlon,
     double rlat, rlon;
 
     // Compute the Latitude Index "j"
-    int    j     = (int) floor(((59*lat0 - 60*lat1) / 131072) + 0.5);
+    int    j     = cprRoundIndex(59*even_cprlat - 60*odd_cprlat);
     double rlat0 = AirDlat0 * (cprModInt(j,60) + lat0 / 131072);
     double rlat1 = AirDlat1 * (cprModInt(j,59) + lat1 / 131072);
 
@@ -183,21 +165,19 @@ int decodeCPRairborne(int even_cprlat, int even_cprlon,
         return (-2); // bad data
 
     // Check that both are in the same latitude zone, or abort.
-    if (cprNLFunction(rlat0) != cprNLFunction(rlat1))
+    int nl = cprNLFunction(rlat0);
+    if (nl != cprNLFunction(rlat1))
         return (-1); // positions crossed a latitude zone, try again later
 
     // Compute ni and the Longitude Index "m"
+    int m = cprRoundIndex(even_cprlon * (nl-1) - odd_cprlon * nl);
     if (fflag) { // Use odd packet.
-        int ni = cprNFunction(rlat1,1);
-        int m = (int) floor((((lon0 * (cprNLFunction(rlat1)-1)) -
-                              (lon1 * cprNLFunction(rlat1))) / 131072.0) + 0.5);
-        rlon = cprDlonFunction(rlat1, 1, 0) * (cprModInt(m, ni)+lon1/131072);
+        int ni = (nl > 1 ? nl - 1 : 1);
+        rlon = (360.0 / ni) * (cprModInt(m, ni)+lon1/131072);
         rlat = rlat1;
     } else {     // Use even packet.
-        int ni = cprNFunction(rlat0,0);
-        int m = (int) floor((((lon0 * (cprNLFunction(rlat0)-1)) -
-                              (lon1 * cprNLFunction(rlat0))) / 131072) + 0.5);
-        rlon = cprDlonFunction(rlat0, 0, 0) * (cprModInt(m, ni)+lon0/131072);
+        int ni = nl;
+        rlon = (360.0 / ni) * (cprModInt(m, ni)+lon0/131072);
         rlat = rlat0;
     }
 
@@ -225,7 +205,7 @@ int decodeCPRsurface(double reflat, double reflon,
     double rlon, rlat;
 
     // Compute the Latitude Index "j"
-    int    j     = (int) floor(((59*lat0 - 60*lat1) / 131072) + 0.5);
+    int    j     = cprRoundIndex(59*even_cprlat - 60*odd_cprlat);
     double rlat0 = AirDlat0 * (cprModInt(j,60) + lat0 / 131072);
     double rlat1 = AirDlat1 * (cprModInt(j,59) + lat1 / 131072);
 
@@ -275,21 +255,19 @@ int decodeCPRsurface(double reflat, double reflon,
         return (-2); // bad data
 
     // Check that both are in the same latitude zone, or abort.
-    if (cprNLFunction(rlat0) != cprNLFunction(rlat1))
+    int nl = cprNLFunction(rlat0);
+    if (nl != cprNLFunction(rlat1))
         return (-1); // positions crossed a latitude zone, try again later
 
     // Compute ni and the Longitude Index "m"
+    int m = cprRoundIndex(even_cprlon * (nl-1) - odd_cprlon * nl);
     if (fflag) { // Use odd packet.
-        int ni = cprNFunction(rlat1,1);
-        int m = (int) floor((((lon0 * (cprNLFunction(rlat1)-1)) -
-                              (lon1 * cprNLFunction(rlat1))) / 131072.0) + 0.5);
-        rlon = cprDlonFunction(rlat1, 1, 1) * (cprModInt(m, ni)+lon1/131072);
+        int ni = (nl > 1 ? nl - 1 : 1);
+        rlon = (90.0 / ni) * (cprModInt(m, ni)+lon1/131072);
         rlat = rlat1;
     } else {     // Use even packet.
-        int ni = cprNFunction(rlat0,0);
-        int m = (int) floor((((lon0 * (cprNLFunction(rlat0)-1)) -
-                              (lon1 * cprNLFunction(rlat0))) / 131072) + 0.5);
-        rlon = cprDlonFunction(rlat0, 0, 1) * (cprModInt(m, ni)+lon0/131072);
+        int ni = nl;
+        rlon = (90.0 / ni) * (cprModInt(m, ni)+lon0/131072);
         rlat = rlat0;
     }
 
@@ -20,6 +20,7 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "cpr.h"
 
@@ -147,6 +148,250 @@ static const struct {
     { 52.00,   -1.05,  29693, 8997, 1, 1, 0, 52.209976, 0.176507 },   // odd, surface
 };
 
+//
+// Reference CPR decoding: the original floating point implementation,
+// used to check that the integer index / table driven code in cpr.c gives
+// bit-for-bit identical results.
+//
+static const double refNLTable[58] = {
+    10.47047130, 14.82817437, 18.18626357, 21.02939493,
+    23.54504487, 25.82924707, 27.93898710, 29.91135686,
+    31.77209708, 33.53993436, 35.22899598, 36.85025108,
+    38.41241892, 39.92256684, 41.38651832, 42.80914012,
+    44.19454951, 45.54626723, 46.86733252, 48.16039128,
+    49.42776439, 50.67150166, 51.89342469, 53.09516153,
+    54.27817472, 55.44378444, 56.59318756, 57.72747354,
+    58.84763776, 59.95459277, 61.04917774, 62.13216659,
+    63.20427479, 64.26616523, 65.31845310, 66.36171008,
+    67.39646774, 68.42322022, 69.44242631, 70.45451075,
+    71.45986473, 72.45884545, 73.45177442, 74.43893416,
+    75.42056257, 76.39684391, 77.36789461, 78.33374083,
+    79.29428225, 80.24923213, 81.19801349, 82.13956981,
+    83.07199445, 83.99173563, 84.89166191, 85.75541621,
+    86.53536998, 87.00000000,
+};
+
+static int refNLFunction(double lat) {
+    if (lat < 0) lat = -lat;
+    for (unsigned i = 0; i < sizeof(refNLTable) / sizeof(refNLTable[0]); ++i) {
+        if (lat < refNLTable[i])
+            return 59 - i;
+    }
+    return 1;
+}
+
+static int refModInt(int a, int b) {
+    int res = a % b;
+    if (res < 0) res += b;
+    return res;
+}
+
+static double refModDouble(double a, double b) {
+    double res = fmod(a, b);
+    if (res < 0) res += b;
+    return res;
+}
+
+static int refNFunction(double lat, int fflag) {
+    int nl = refNLFunction(lat) - (fflag ? 1 : 0);
+    if (nl < 1) nl = 1;
+    return nl;
+}
+static double refDlonFunction(double lat, int fflag, int surface) {
+    return (surface ? 90.0 : 360.0) / refNFunction(lat, fflag);
+}
+static int refDecodeCPRairborne(int even_cprlat, int even_cprlon,
+                             int odd_cprlat, int odd_cprlon,
+                             int fflag,
+                             double *out_lat, double *out_lon)
+{
+    double AirDlat0 = 360.0 / 60.0;
+    double AirDlat1 = 360.0 / 59.0;
+    double lat0 = even_cprlat;
+    double lat1 = odd_cprlat;
+    double lon0 = even_cprlon;
+    double lon1 = odd_cprlon;
+
+    double rlat, rlon;
+
+    // Compute the Latitude Index "j"
+    int    j     = (int) floor(((59*lat0 - 60*lat1) / 131072) + 0.5);
+    double rlat0 = AirDlat0 * (refModInt(j,60) + lat0 / 131072);
+    double rlat1 = AirDlat1 * (refModInt(j,59) + lat1 / 131072);
+
+    if (rlat0 >= 270) rlat0 -= 360;
+    if (rlat1 >= 270) rlat1 -= 360;
+
+    // Check to see that the latitude is in range: -90 .. +90
+    if (rlat0 < -90 || rlat0 > 90 || rlat1 < -90 || rlat1 > 90)
+        return (-2); // bad data
+
+    // Check that both are in the same latitude zone, or abort.
+    if (refNLFunction(rlat0) != refNLFunction(rlat1))
+        return (-1); // positions crossed a latitude zone, try again later
+
+    // Compute ni and the Longitude Index "m"
+    if (fflag) { // Use odd packet.
+        int ni = refNFunction(rlat1,1);
+        int m = (int) floor((((lon0 * (refNLFunction(rlat1)-1)) -
+                              (lon1 * refNLFunction(rlat1))) / 131072.0) + 0.5);
+        rlon = refDlonFunction(rlat1, 1, 0) * (refModInt(m, ni)+lon1/131072);
+        rlat = rlat1;
+    } else {     // Use even packet.
+        int ni = refNFunction(rlat0,0);
+        int m = (int) floor((((lon0 * (refNLFunction(rlat0)-1)) -
+                              (lon1 * refNLFunction(rlat0))) / 131072) + 0.5);
+        rlon = refDlonFunction(rlat0, 0, 0) * (refModInt(m, ni)+lon0/131072);
+        rlat = rlat0;
+    }
+
+    // Renormalize to -180 .. +180
+    rlon -= floor( (rlon + 180) / 360 ) * 360;
+
+    *out_lat = rlat;
+    *out_lon = rlon;
+
+    return 0;
+}
+
+static int refDecodeCPRsurface(double reflat, double reflon,
+                            int even_cprlat, int even_cprlon,
+                            int odd_cprlat, int odd_cprlon,
+                            int fflag,
+                            double *out_lat, double *out_lon)
+{
+    double AirDlat0 = 90.0 / 60.0;
+    double AirDlat1 = 90.0 / 59.0;
+    double lat0 = even_cprlat;
+    double lat1 = odd_cprlat;
+    double lon0 = even_cprlon;
+    double lon1 = odd_cprlon;
+    double rlon, rlat;
+
+    // Compute the Latitude Index "j"
+    int    j     = (int) floor(((59*lat0 - 60*lat1) / 131072) + 0.5);
+    double rlat0 = AirDlat0 * (refModInt(j,60) + lat0 / 131072);
+    double rlat1 = AirDlat1 * (refModInt(j,59) + lat1 / 131072);
+
+    //
+    // If the computed latitude is more than 45 degrees north of
+    // the reference latitude (using the northern hemisphere
+    // solution), then the southern hemisphere solution will be
+    // closer to the refernce latitude.
+    //
+    // e.g. reflat=0, rlat=44, use rlat=44
+    //      reflat=0, rlat=46, use rlat=46-90 = -44
+    //      reflat=40, rlat=84, use rlat=84
+    //      reflat=40, rlat=86, use rlat=86-90 = -4
+    //      reflat=-40, rlat=4, use rlat=4
+    //      reflat=-40, rlat=6, use rlat=6-90 = -84
+
+    // As a special case, -90, 0 and +90 all encode to zero, so
+    // there's a little extra work to do there.
+
+    if (rlat0 == 0) {
+        if (reflat < -45)
+            rlat0 = -90;
+        else if (reflat > 45)
+            rlat0 = 90;
+    } else if ((rlat0 - reflat) > 45) {
+        rlat0 -= 90;
+    }
+
+    if (rlat1 == 0) {
+        if (reflat < -45)
+            rlat1 = -90;
+        else if (reflat > 45)
+            rlat1 = 90;
+    } else if ((rlat1 - reflat) > 45) {
+        rlat1 -= 90;
+    }
+
+    // Check to see that the latitude is in range: -90 .. +90
+    if (rlat0 < -90 || rlat0 > 90 || rlat1 < -90 || rlat1 > 90)
+        return (-2); // bad data
+
+    // Check that both are in the same latitude zone, or abort.
+    if (refNLFunction(rlat0) != refNLFunction(rlat1))
+        return (-1); // positions crossed a latitude zone, try again later
+
+    // Compute ni and the Longitude Index "m"
+    if (fflag) { // Use odd packet.
+        int ni = refNFunction(rlat1,1);
+        int m = (int) floor((((lon0 * (refNLFunction(rlat1)-1)) -
+                              (lon1 * refNLFunction(rlat1))) / 131072.0) + 0.5);
+        rlon = refDlonFunction(rlat1, 1, 1) * (refModInt(m, ni)+lon1/131072);
+        rlat = rlat1;
+    } else {     // Use even packet.
+        int ni = refNFunction(rlat0,0);
+        int m = (int) floor((((lon0 * (refNLFunction(rlat0)-1)) -
+                              (lon1 * refNLFunction(rlat0))) / 131072) + 0.5);
+        rlon = refDlonFunction(rlat0, 0, 1) * (refModInt(m, ni)+lon0/131072);
+        rlat = rlat0;
+    }
+
+    // Pick the quadrant that's closest to the reference location -
+    // this is not necessarily the same quadrant that contains the
+    // reference location. Unlike the latitude case, all four
+    // quadrants are valid.
+
+    // if reflon is more than 45 degrees away, move some multiple of 90 degrees towards it
+    rlon += floor( (reflon - rlon + 45) / 90 ) * 90;  // this might move us outside (-180..+180), we fix this below
+
+    // Renormalize to -180 .. +180
+    rlon -= floor( (rlon + 180) / 360 ) * 360;
+
+    *out_lat = rlat;
+    *out_lon = rlon;
+    return 0;
+}
+
+static int refDecodeCPRrelative(double reflat, double reflon,
+                             int cprlat, int cprlon,
+                             int fflag, int surface,
+                             double *out_lat, double *out_lon)
+{
+    double AirDlat;
+    double AirDlon;
+    double fractional_lat = cprlat / 131072.0;
+    double fractional_lon = cprlon / 131072.0;
+    double rlon, rlat;
+    int j,m;
+
+    AirDlat = (surface ? 90.0 : 360.0) / (fflag ? 59.0 : 60.0);
+
+    // Compute the Latitude Index "j"
+    j = (int) (floor(reflat/AirDlat) +
+               floor(0.5 + refModDouble(reflat, AirDlat)/AirDlat - fractional_lat));
+    rlat = AirDlat * (j + fractional_lat);
+    if (rlat >= 270) rlat -= 360;
+
+    // Check to see that the latitude is in range: -90 .. +90
+    if (rlat < -90 || rlat > 90) {
+        return (-1);                               // Time to give up - Latitude error
+    }
+
+    // Check to see that answer is reasonable - ie no more than 1/2 cell away
+    if (fabs(rlat - reflat) > (AirDlat/2)) {
+        return (-1);                               // Time to give up - Latitude error
+    }
+
+    // Compute the Longitude Index "m"
+    AirDlon = refDlonFunction(rlat, fflag, surface);
+    m = (int) (floor(reflon/AirDlon) +
+               floor(0.5 + refModDouble(reflon, AirDlon)/AirDlon - fractional_lon));
+    rlon = AirDlon * (m + fractional_lon);
+    if (rlon > 180) rlon -= 360;
+
+    // Check to see that answer is reasonable - ie no more than 1/2 cell away
+    if (fabs(rlon - reflon) > (AirDlon/2))
+        return (-1);                               // Time to give up - Longitude error
+
+    *out_lat = rlat;
+    *out_lon = rlon;
+    return (0);
+}
+
 static int testCPRGlobalAirborne() {
     int ok = 1;
     unsigned i;
@@ -300,10 +545,84 @@ static int testCPRRelative() {
     return ok;
 }
 
+// Compare cpr.c against the reference implementation, exactly, over
+// random inputs
+static int testCPRReference() {
+    int ok = 1;
+    unsigned failures = 0;
+    unsigned seed = 1;
+    const unsigned count = 1000000;
+
+    for (unsigned i = 0; i < count && failures < 10; ++i) {
+        int even_cprlat = rand_r(&seed) & 0x1FFFF, even_cprlon = rand_r(&seed) & 0x1FFFF;
+        int odd_cprlat = rand_r(&seed) & 0x1FFFF, odd_cprlon = rand_r(&seed) & 0x1FFFF;
+        int fflag = rand_r(&seed) & 1;
+        double reflat = rand_r(&seed) / (double) RAND_MAX * 180.0 - 90.0;
+        double reflon = rand_r(&seed) / (double) RAND_MAX * 360.0 - 180.0;
+
+        // nearby even/odd pairs, as real aircraft send them, exercise the
+        // successful paths; independent values mostly exercise the failures
+        if (i & 1) {
+            odd_cprlat = (even_cprlat + (rand_r(&seed) % 4001) - 2000) & 0x1FFFF;
+            odd_cprlon = (even_cprlon + (rand_r(&seed) % 4001) - 2000) & 0x1FFFF;
+        }
+
+        double lat1 = 0, lon1 = 0, lat2 = 0, lon2 = 0;
+        int res1, res2;
+
+        res1 = decodeCPRairborne(even_cprlat, even_cprlon, odd_cprlat, odd_cprlon, fflag, &lat1, &lon1);
+        res2 = refDecodeCPRairborne(even_cprlat, even_cprlon, odd_cprlat, odd_cprlon, fflag, &lat2, &lon2);
+        if (res1 != res2 || (res1 == 0 && (lat1 != lat2 || lon1 != lon2))) {
+            ++failures;
+            fprintf(stderr, "testCPRReference: FAIL: decodeCPRairborne(%d,%d,%d,%d,%d): %d %.9f %.9f, reference %d %.9f %.9f\n",
+                    even_cprlat, even_cprlon, odd_cprlat, odd_cprlon, fflag, res1, lat1, lon1, res2, lat2, lon2);
+        }
+
+        res1 = decodeCPRsurface(reflat, reflon, even_cprlat, even_cprlon, odd_cprlat, odd_cprlon, fflag, &lat1, &lon1);
+        res2 = refDecodeCPRsurface(reflat, reflon, even_cprlat, even_cprlon, odd_cprlat, odd_cprlon, fflag, &lat2, &lon2);
+        if (res1 != res2 || (res1 == 0 && (lat1 != lat2 || lon1 != lon2))) {
+            ++failures;
+            fprintf(stderr, "testCPRReference: FAIL: decodeCPRsurface(%.6f,%.6f,%d,%d,%d,%d,%d): %d %.9f %.9f, reference %d %.9f %.9f\n",
+                    reflat, reflon, even_cprlat, even_cprlon, odd_cprlat, odd_cprlon, fflag, res1, lat1, lon1, res2, lat2, lon2);
+        }
+
+        int surface = (i >> 1) & 1;
+        res1 = decodeCPRrelative(reflat, reflon, even_cprlat, even_cprlon, fflag, surface, &lat1, &lon1);
+        res2 = refDecodeCPRrelative(reflat, reflon, even_cprlat, even_cprlon, fflag, surface, &lat2, &lon2);
+        if (res1 != res2 || (res1 == 0 && (lat1 != lat2 || lon1 != lon2))) {
+            ++failures;
+            fprintf(stderr, "testCPRReference: FAIL: decodeCPRrelative(%.6f,%.6f,%d,%d,%d,%d): %d %.9f %.9f, reference %d %.9f %.9f\n",
+                    reflat, reflon, even_cprlat, even_cprlon, fflag, surface, res1, lat1, lon1, res2, lat2, lon2);
+        }
+    }
+
+    // every NL zone boundary, and either side of it
+    for (unsigned i = 0; i < sizeof(refNLTable) / sizeof(refNLTable[0]); ++i) {
+        double lats[3] = { refNLTable[i], nextafter(refNLTable[i], 0), nextafter(refNLTable[i], 90) };
+        for (unsigned k = 0; k < 3; ++k) {
+            double lat1 = 0, lon1 = 0, lat2 = 0, lon2 = 0;
+            int res1 = decodeCPRrelative(lats[k], 0, 0, 0, 0, 0, &lat1, &lon1);
+            int res2 = refDecodeCPRrelative(lats[k], 0, 0, 0, 0, 0, &lat2, &lon2);
+            if (res1 != res2 || lat1 != lat2 || lon1 != lon2) {
+                ++failures;
+                fprintf(stderr, "testCPRReference: FAIL: decodeCPRrelative near NL boundary %.9f\n", lats[k]);
+            }
+        }
+    }
+
+    if (failures) {
+        ok = 0;
+    } else {
+        fprintf(stderr, "testCPRReference: PASS (%u random cases)\n", count);
+    }
+    return ok;
+}
+
 int main(int __attribute__ ((unused)) argc, char __attribute__ ((unused)) **argv) {
     int ok = 1;
     ok = testCPRGlobalAirborne() && ok;
     ok = testCPRGlobalSurface() && ok;
     ok = testCPRRelative() && ok;
+    ok = testCPRReference() && ok;
     return ok ? 0 : 1;
 }
@@ -0,0 +1,116 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// dedup.c: cross-receiver duplicate message suppression
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "dump1090.h"
+
+// hash table size, must be a power of two:
+#define DEDUP_TABLE_SIZE 4096
+
+// how far we probe before evicting the oldest entry
+#define DEDUP_MAX_PROBE 16
+
+// Open-addressed hash table with linear probing, keyed on a
+// 64-bit hash of the (corrected) message bits. Entries are never
+// deleted; once they fall outside the dedup window their slot is
+// simply reused. Each decoder instance has its own table
+// (Modes.dedup_table).
+
+struct dedup_entry {
+    uint64_t hash;       // 0 = empty slot
+    uint64_t seen;       // time (ms) of the first copy, see dedupClock
+    int receiverId;      // where the first copy came from
+};
+
+
+static uint64_t dedupHash(const unsigned char *msg, int bytes)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (int i = 0; i < bytes; ++i) {
+        hash ^= msg[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash ? hash : 1;
+}
+
+void dedupInit()
+{
+    if (!Modes.dedup_table && !(Modes.dedup_table = malloc(DEDUP_TABLE_SIZE * sizeof(struct dedup_entry)))) {
+        fprintf(stderr, "dedup: out of memory\n");
+        exit(1);
+    }
+    memset(Modes.dedup_table, 0, DEDUP_TABLE_SIZE * sizeof(struct dedup_entry));
+}
+
+void dedupFree()
+{
+    free(Modes.dedup_table);
+    Modes.dedup_table = NULL;
+}
+
+// When a message was heard, in ms: its sample time for file replays,
+// otherwise the system time its block was read
+static uint64_t dedupClock(const struct modesMessage *mm)
+{
+    if (Modes.dedup_sample_clock)
+        return mm->timestampMsg / 12000;
+    return mm->sysTimestampMsg;
+}
+
+int dedupCheck(const struct modesMessage *mm)
+{
+    uint64_t hash = dedupHash(mm->msg, mm->msgbits / 8);
+    uint64_t now = dedupClock(mm);
+    struct dedup_entry *reuse = NULL, *oldest = NULL, *e;
+    uint32_t h = (uint32_t) hash & (DEDUP_TABLE_SIZE-1);
+
+    for (int i = 0; i < DEDUP_MAX_PROBE; ++i, h = (h+1) & (DEDUP_TABLE_SIZE-1)) {
+        e = &Modes.dedup_table[h];
+
+        if (!e->hash) {
+            // end of the probe chain, slots are never emptied again
+            if (!reuse)
+                reuse = e;
+            break;
+        }
+
+        int live = (now < e->seen || now - e->seen <= Modes.dedup_window);
+        if (live && e->hash == hash) {
+            if (e->receiverId != mm->receiverId)
+                return 1;
+
+            // A repeat from the same input is a genuine retransmission
+            e->seen = now;
+            return 0;
+        }
+
+        if (!live) {
+            if (!reuse)
+                reuse = e;
+        } else if (!oldest || e->seen < oldest->seen) {
+            oldest = e;
+        }
+    }
+
+    e = reuse ? reuse : oldest;
+    e->hash = hash;
+    e->seen = now;
+    e->receiverId = mm->receiverId;
+    return 0;
+}
@@ -0,0 +1,32 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// dedup.h: cross-receiver duplicate message suppression
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DUMP1090_DEDUP_H
+#define DUMP1090_DEDUP_H
+
+struct modesMessage;
+
+// Call once per decoder instance:
+void dedupInit();
+void dedupFree();
+
+// Returns 1 if an identical message was already seen from a different
+// receiver (or network client) within Modes.dedup_window milliseconds,
+// otherwise remembers this message and returns 0.
+int dedupCheck(const struct modesMessage *mm);
+
+#endif
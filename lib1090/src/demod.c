@@ -0,0 +1,47 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// demod.c: demodulator selection by input sample rate
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "dump1090.h"
+
+static const struct demodulator demodulators[] = {
+    { "2MHz",   2000000.0, demodulate2000, NULL,             NULL },
+    { "2.4MHz", 2400000.0, demodulate2400, demodulate2400AC, demodulate2400Scan },
+    { "6MHz",   6000000.0, demodulate6000, NULL,             NULL },
+    { "8MHz",   8000000.0, demodulate8000, NULL,             NULL },
+};
+
+#define NUM_DEMODULATORS (sizeof(demodulators) / sizeof(demodulators[0]))
+
+const struct demodulator *demodForSampleRate(double sample_rate)
+{
+    for (unsigned i = 0; i < NUM_DEMODULATORS; ++i) {
+        if (demodulators[i].sample_rate == sample_rate)
+            return &demodulators[i];
+    }
+    return NULL;
+}
+
+void demodListRates(FILE *f)
+{
+    for (unsigned i = 0; i < NUM_DEMODULATORS; ++i)
+        fprintf(f, "%s%.0f", i ? ", " : "", demodulators[i].sample_rate);
+}
+
+uint64_t demodSamplesToTicks(double samples)
+{
+    return (uint64_t) (samples * 12e6 / Modes.sample_rate + 0.5);
+}
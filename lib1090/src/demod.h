@@ -0,0 +1,71 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// demod.h: demodulator selection by input sample rate, and shared helpers
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DUMP1090_DEMOD_H
+#define DUMP1090_DEMOD_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+struct mag_buf;
+struct demod_candidates;
+
+#define MODES_DEFAULT_RATE 2400000
+
+// The demodulators for one input sample rate
+struct demodulator {
+    const char *name;
+    double sample_rate;                              // in Hz
+
+    // Mode S; required
+    void (*demodulate)(struct mag_buf *mag);
+
+    // Mode A/C, or NULL if not supported at this rate
+    void (*demodulate_ac)(struct mag_buf *mag);
+
+    // The part of demodulate() that touches no global state, for
+    // --ifile-threads workers, or NULL if there is no such split
+    void (*scan)(uint16_t *m, uint32_t mlen, struct demod_candidates *out);
+};
+
+// Returns the demodulator for the given rate, or NULL if there is none
+const struct demodulator *demodForSampleRate(double sample_rate);
+
+// Print the supported sample rates, separated by ", "
+void demodListRates(FILE *f);
+
+// Convert an offset of 'samples' (possibly fractional) at Modes.sample_rate
+// into ticks of the 12MHz receive clock, rounded to the nearest tick
+uint64_t demodSamplesToTicks(double samples);
+
+// Number of bytes worth slicing for a frame starting with byte0:
+// 1 for an unknown DF, as there is no point going any further
+static inline int demodFrameBytes(uint8_t byte0)
+{
+    switch (byte0 >> 3) {
+    case 0: case 4: case 5: case 11:
+        return MODES_SHORT_MSG_BYTES;
+
+    case 16: case 17: case 18: case 20: case 21: case 24:
+        return MODES_LONG_MSG_BYTES;
+
+    default:
+        return 1;
+    }
+}
+
+#endif
@@ -21,6 +21,12 @@
 
 #include <assert.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #ifdef MODEAC_DEBUG
 #include <gd.h>
 #endif
@@ -59,310 +65,423 @@ static inline int slice_phase4(uint16_t *m) {
 }
 
 //
-// Given 'mlen' magnitude samples in 'm', sampled at 2.4MHz,
-// try to demodulate some Mode S messages.
+// Check for a Mode S preamble starting at preamble[0], i.e. a message whose
+// first data bit starts at around sample 19 with phase offset 3..7.
 //
-void demodulate2400(struct mag_buf *mag)
+static inline int checkPreamble(uint16_t *preamble)
 {
-    static struct modesMessage zeroMessage;
-    struct modesMessage mm;
-    unsigned char msg1[MODES_LONG_MSG_BYTES], msg2[MODES_LONG_MSG_BYTES], *msg;
-    uint32_t j;
+    int high;
+    uint32_t base_signal, base_noise;
+
+    // Ideal sample values for preambles with different phase
+    // Xn is the first data symbol with phase offset N
+    //
+    // sample#: 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0
+    // phase 3: 2/4\0/5\1 0 0 0 0/5\1/3 3\0 0 0 0 0 0 X4
+    // phase 4: 1/5\0/4\2 0 0 0 0/4\2 2/4\0 0 0 0 0 0 0 X0
+    // phase 5: 0/5\1/3 3\0 0 0 0/3 3\1/5\0 0 0 0 0 0 0 X1
+    // phase 6: 0/4\2 2/4\0 0 0 0 2/4\0/5\1 0 0 0 0 0 0 X2
+    // phase 7: 0/3 3\1/5\0 0 0 0 1/5\0/4\2 0 0 0 0 0 0 X3
+    //
+
+    // quick check: we must have a rising edge 0->1 and a falling edge 12->13
+    if (! (preamble[0] < preamble[1] && preamble[12] > preamble[13]) )
+       return 0;
+
+    if (preamble[1] > preamble[2] &&                                       // 1
+        preamble[2] < preamble[3] && preamble[3] > preamble[4] &&          // 3
+        preamble[8] < preamble[9] && preamble[9] > preamble[10] &&         // 9
+        preamble[10] < preamble[11]) {                                     // 11-12
+        // peaks at 1,3,9,11-12: phase 3
+        high = (preamble[1] + preamble[3] + preamble[9] + preamble[11] + preamble[12]) / 4;
+        base_signal = preamble[1] + preamble[3] + preamble[9];
+        base_noise = preamble[5] + preamble[6] + preamble[7];
+    } else if (preamble[1] > preamble[2] &&                                // 1
+               preamble[2] < preamble[3] && preamble[3] > preamble[4] &&   // 3
+               preamble[8] < preamble[9] && preamble[9] > preamble[10] &&  // 9
+               preamble[11] < preamble[12]) {                              // 12
+        // peaks at 1,3,9,12: phase 4
+        high = (preamble[1] + preamble[3] + preamble[9] + preamble[12]) / 4;
+        base_signal = preamble[1] + preamble[3] + preamble[9] + preamble[12];
+        base_noise = preamble[5] + preamble[6] + preamble[7] + preamble[8];
+    } else if (preamble[1] > preamble[2] &&                                // 1
+               preamble[2] < preamble[3] && preamble[4] > preamble[5] &&   // 3-4
+               preamble[8] < preamble[9] && preamble[10] > preamble[11] && // 9-10
+               preamble[11] < preamble[12]) {                              // 12
+        // peaks at 1,3-4,9-10,12: phase 5
+        high = (preamble[1] + preamble[3] + preamble[4] + preamble[9] + preamble[10] + preamble[12]) / 4;
+        base_signal = preamble[1] + preamble[12];
+        base_noise = preamble[6] + preamble[7];
+    } else if (preamble[1] > preamble[2] &&                                 // 1
+               preamble[3] < preamble[4] && preamble[4] > preamble[5] &&    // 4
+               preamble[9] < preamble[10] && preamble[10] > preamble[11] && // 10
+               preamble[11] < preamble[12]) {                               // 12
+        // peaks at 1,4,10,12: phase 6
+        high = (preamble[1] + preamble[4] + preamble[10] + preamble[12]) / 4;
+        base_signal = preamble[1] + preamble[4] + preamble[10] + preamble[12];
+        base_noise = preamble[5] + preamble[6] + preamble[7] + preamble[8];
+    } else if (preamble[2] > preamble[3] &&                                 // 1-2
+               preamble[3] < preamble[4] && preamble[4] > preamble[5] &&    // 4
+               preamble[9] < preamble[10] && preamble[10] > preamble[11] && // 10
+               preamble[11] < preamble[12]) {                               // 12
+        // peaks at 1-2,4,10,12: phase 7
+        high = (preamble[1] + preamble[2] + preamble[4] + preamble[10] + preamble[12]) / 4;
+        base_signal = preamble[4] + preamble[10] + preamble[12];
+        base_noise = preamble[6] + preamble[7] + preamble[8];
+    } else {
+        // no suitable peaks
+        return 0;
+    }
 
-    unsigned char *bestmsg;
-    int bestscore, bestphase;
+    // Check for enough signal
+    if (base_signal * 2 < 3 * base_noise) // about 3.5dB SNR
+        return 0;
+
+    // Check that the "quiet" bits 6,7,15,16,17 are actually quiet
+    if (preamble[5] >= high ||
+        preamble[6] >= high ||
+        preamble[7] >= high ||
+        preamble[8] >= high ||
+        preamble[14] >= high ||
+        preamble[15] >= high ||
+        preamble[16] >= high ||
+        preamble[17] >= high ||
+        preamble[18] >= high) {
+        return 0;
+    }
 
-    uint16_t *m = mag->data;
-    uint32_t mlen = mag->length;
+    return 1;
+}
 
-    uint64_t sum_scaled_signal_power = 0;
+//
+// Slice bytes 'from' .. 'to'-1 of the bits following a preamble (m points at
+// sample 19 of the preamble), assuming the given phase offset 4..8.
+//
+static void slicePhase(uint16_t *m, int try_phase, unsigned char *msg, int from, int to)
+{
+    uint16_t *pPtr;
+    int phase, i;
 
-    msg = msg1;
+    pPtr = m + (try_phase/5);
+    phase = try_phase % 5;
 
-    for (j = 0; j < mlen; j++) {
-        uint16_t *preamble = &m[j];
-        int high;
-        uint32_t base_signal, base_noise;
-        int try_phase;
-        int msglen;
+    // skip over the bytes we already have
+    for (i = 0; i < from; ++i) {
+        pPtr += (phase == 4 ? 20 : 19);
+        phase = (phase + 1) % 5;
+    }
 
-        // Look for a message starting at around sample 0 with phase offset 3..7
+    for (; i < to; ++i) {
+        uint8_t theByte = 0;
+
+        switch (phase) {
+        case 0:
+            theByte =
+                (slice_phase0(pPtr) > 0 ? 0x80 : 0) |
+                (slice_phase2(pPtr+2) > 0 ? 0x40 : 0) |
+                (slice_phase4(pPtr+4) > 0 ? 0x20 : 0) |
+                (slice_phase1(pPtr+7) > 0 ? 0x10 : 0) |
+                (slice_phase3(pPtr+9) > 0 ? 0x08 : 0) |
+                (slice_phase0(pPtr+12) > 0 ? 0x04 : 0) |
+                (slice_phase2(pPtr+14) > 0 ? 0x02 : 0) |
+                (slice_phase4(pPtr+16) > 0 ? 0x01 : 0);
+
+
+            phase = 1;
+            pPtr += 19;
+            break;
+
+        case 1:
+            theByte =
+                (slice_phase1(pPtr) > 0 ? 0x80 : 0) |
+                (slice_phase3(pPtr+2) > 0 ? 0x40 : 0) |
+                (slice_phase0(pPtr+5) > 0 ? 0x20 : 0) |
+                (slice_phase2(pPtr+7) > 0 ? 0x10 : 0) |
+                (slice_phase4(pPtr+9) > 0 ? 0x08 : 0) |
+                (slice_phase1(pPtr+12) > 0 ? 0x04 : 0) |
+                (slice_phase3(pPtr+14) > 0 ? 0x02 : 0) |
+                (slice_phase0(pPtr+17) > 0 ? 0x01 : 0);
+
+            phase = 2;
+            pPtr += 19;
+            break;
+
+        case 2:
+            theByte =
+                (slice_phase2(pPtr) > 0 ? 0x80 : 0) |
+                (slice_phase4(pPtr+2) > 0 ? 0x40 : 0) |
+                (slice_phase1(pPtr+5) > 0 ? 0x20 : 0) |
+                (slice_phase3(pPtr+7) > 0 ? 0x10 : 0) |
+                (slice_phase0(pPtr+10) > 0 ? 0x08 : 0) |
+                (slice_phase2(pPtr+12) > 0 ? 0x04 : 0) |
+                (slice_phase4(pPtr+14) > 0 ? 0x02 : 0) |
+                (slice_phase1(pPtr+17) > 0 ? 0x01 : 0);
+
+            phase = 3;
+            pPtr += 19;
+            break;
+
+        case 3:
+            theByte =
+                (slice_phase3(pPtr) > 0 ? 0x80 : 0) |
+                (slice_phase0(pPtr+3) > 0 ? 0x40 : 0) |
+                (slice_phase2(pPtr+5) > 0 ? 0x20 : 0) |
+                (slice_phase4(pPtr+7) > 0 ? 0x10 : 0) |
+                (slice_phase1(pPtr+10) > 0 ? 0x08 : 0) |
+                (slice_phase3(pPtr+12) > 0 ? 0x04 : 0) |
+                (slice_phase0(pPtr+15) > 0 ? 0x02 : 0) |
+                (slice_phase2(pPtr+17) > 0 ? 0x01 : 0);
+
+            phase = 4;
+            pPtr += 19;
+            break;
+
+        case 4:
+            theByte =
+                (slice_phase4(pPtr) > 0 ? 0x80 : 0) |
+                (slice_phase1(pPtr+3) > 0 ? 0x40 : 0) |
+                (slice_phase3(pPtr+5) > 0 ? 0x20 : 0) |
+                (slice_phase0(pPtr+8) > 0 ? 0x10 : 0) |
+                (slice_phase2(pPtr+10) > 0 ? 0x08 : 0) |
+                (slice_phase4(pPtr+12) > 0 ? 0x04 : 0) |
+                (slice_phase1(pPtr+15) > 0 ? 0x02 : 0) |
+                (slice_phase3(pPtr+17) > 0 ? 0x01 : 0);
+
+            phase = 0;
+            pPtr += 20;
+            break;
+        }
 
-        // Ideal sample values for preambles with different phase
-        // Xn is the first data symbol with phase offset N
-        //
-        // sample#: 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0
-        // phase 3: 2/4\0/5\1 0 0 0 0/5\1/3 3\0 0 0 0 0 0 X4
-        // phase 4: 1/5\0/4\2 0 0 0 0/4\2 2/4\0 0 0 0 0 0 0 X0
-        // phase 5: 0/5\1/3 3\0 0 0 0/3 3\1/5\0 0 0 0 0 0 0 X1
-        // phase 6: 0/4\2 2/4\0 0 0 0 2/4\0/5\1 0 0 0 0 0 0 X2
-        // phase 7: 0/3 3\1/5\0 0 0 0 1/5\0/4\2 0 0 0 0 0 0 X3
-        //
+        msg[i] = theByte;
+    }
+}
 
-        // quick check: we must have a rising edge 0->1 and a falling edge 12->13
-        if (! (preamble[0] < preamble[1] && preamble[12] > preamble[13]) )
-           continue;
-
-        if (preamble[1] > preamble[2] &&                                       // 1
-            preamble[2] < preamble[3] && preamble[3] > preamble[4] &&          // 3
-            preamble[8] < preamble[9] && preamble[9] > preamble[10] &&         // 9
-            preamble[10] < preamble[11]) {                                     // 11-12
-            // peaks at 1,3,9,11-12: phase 3
-            high = (preamble[1] + preamble[3] + preamble[9] + preamble[11] + preamble[12]) / 4;
-            base_signal = preamble[1] + preamble[3] + preamble[9];
-            base_noise = preamble[5] + preamble[6] + preamble[7];
-        } else if (preamble[1] > preamble[2] &&                                // 1
-                   preamble[2] < preamble[3] && preamble[3] > preamble[4] &&   // 3
-                   preamble[8] < preamble[9] && preamble[9] > preamble[10] &&  // 9
-                   preamble[11] < preamble[12]) {                              // 12
-            // peaks at 1,3,9,12: phase 4
-            high = (preamble[1] + preamble[3] + preamble[9] + preamble[12]) / 4;
-            base_signal = preamble[1] + preamble[3] + preamble[9] + preamble[12];
-            base_noise = preamble[5] + preamble[6] + preamble[7] + preamble[8];
-        } else if (preamble[1] > preamble[2] &&                                // 1
-                   preamble[2] < preamble[3] && preamble[4] > preamble[5] &&   // 3-4
-                   preamble[8] < preamble[9] && preamble[10] > preamble[11] && // 9-10
-                   preamble[11] < preamble[12]) {                              // 12
-            // peaks at 1,3-4,9-10,12: phase 5
-            high = (preamble[1] + preamble[3] + preamble[4] + preamble[9] + preamble[10] + preamble[12]) / 4;
-            base_signal = preamble[1] + preamble[12];
-            base_noise = preamble[6] + preamble[7];
-        } else if (preamble[1] > preamble[2] &&                                 // 1
-                   preamble[3] < preamble[4] && preamble[4] > preamble[5] &&    // 4
-                   preamble[9] < preamble[10] && preamble[10] > preamble[11] && // 10
-                   preamble[11] < preamble[12]) {                               // 12
-            // peaks at 1,4,10,12: phase 6
-            high = (preamble[1] + preamble[4] + preamble[10] + preamble[12]) / 4;
-            base_signal = preamble[1] + preamble[4] + preamble[10] + preamble[12];
-            base_noise = preamble[5] + preamble[6] + preamble[7] + preamble[8];
-        } else if (preamble[2] > preamble[3] &&                                 // 1-2
-                   preamble[3] < preamble[4] && preamble[4] > preamble[5] &&    // 4
-                   preamble[9] < preamble[10] && preamble[10] > preamble[11] && // 10
-                   preamble[11] < preamble[12]) {                               // 12
-            // peaks at 1-2,4,10,12: phase 7
-            high = (preamble[1] + preamble[2] + preamble[4] + preamble[10] + preamble[12]) / 4;
-            base_signal = preamble[4] + preamble[10] + preamble[12];
-            base_noise = preamble[6] + preamble[7] + preamble[8];
-        } else {
-            // no suitable peaks
-            continue;
+// Slice byte 0 (the DF) at every phase, and the rest too if 'full' is set
+static void slicePhases(uint16_t *m, unsigned char msgs[DEMOD_PHASES][MODES_LONG_MSG_BYTES],
+                        uint8_t *bytelen, uint8_t *sliced, int full)
+{
+    int p;
+
+    for (p = 0; p < DEMOD_PHASES; ++p) {
+        slicePhase(m, p + 4, msgs[p], 0, 1);
+        bytelen[p] = demodFrameBytes(msgs[p][0]);
+        sliced[p] = 1;
+        if (full && bytelen[p] > 1) {
+            slicePhase(m, p + 4, msgs[p], 1, bytelen[p]);
+            sliced[p] = bytelen[p];
         }
+    }
+}
 
-        // Check for enough signal
-        if (base_signal * 2 < 3 * base_noise) // about 3.5dB SNR
-            continue;
+//
+// Given the bits sliced so far at each phase for the preamble at m[j], pick
+// the best-scoring phase, decode it and pass it to the next layer. Returns
+// the number of samples to skip over (0 if nothing was decoded).
+//
+// Phases are tried in order of the best score their DF allows, and a phase
+// whose DF can't beat the best score so far is dropped without slicing the
+// rest of it or checking its CRC. Ties go to the lowest phase, as they would
+// scoring every phase in order, so the choice is the same.
+//
+static uint32_t demodulateCandidate(struct mag_buf *mag, uint32_t j,
+                                    unsigned char msgs[DEMOD_PHASES][MODES_LONG_MSG_BYTES],
+                                    const uint8_t *bytelen, const uint8_t *sliced,
+                                    uint64_t *sum_scaled_signal_power)
+{
+    struct modesMessage mm;
+    unsigned char *bestmsg;
+    int bestscore, bestphase;
+    int bound[DEMOD_PHASES], order[DEMOD_PHASES];
+    int i, p, msglen;
+    uint16_t *m = mag->data;
+
+    Modes.stats_current.demod_preambles++;
+
+    // order the phases by their DF's best possible score (stable, so
+    // phases with equal bounds stay in phase order)
+    for (i = 0; i < DEMOD_PHASES; ++i) {
+        int k;
+        bound[i] = (bytelen[i] > 1 ? scoreModesMessageBound(msgs[i][0] >> 3) : -2);
+        for (k = i; k > 0 && bound[order[k-1]] < bound[i]; --k)
+            order[k] = order[k-1];
+        order[k] = i;
+    }
 
-        // Check that the "quiet" bits 6,7,15,16,17 are actually quiet
-        if (preamble[5] >= high ||
-            preamble[6] >= high ||
-            preamble[7] >= high ||
-            preamble[8] >= high ||
-            preamble[14] >= high ||
-            preamble[15] >= high ||
-            preamble[16] >= high ||
-            preamble[17] >= high ||
-            preamble[18] >= high) {
+    bestmsg = NULL; bestscore = -2; bestphase = -1;
+    for (i = 0; i < DEMOD_PHASES; ++i) {
+        int score;
+
+        p = order[i];
+        if (bound[p] < bestscore || (bound[p] == bestscore && p + 4 > bestphase)) {
+            Modes.stats_current.demod_phases_abandoned++;
             continue;
         }
 
-        // try all phases
-        Modes.stats_current.demod_preambles++;
-        bestmsg = NULL; bestscore = -2; bestphase = -1;
-        for (try_phase = 4; try_phase <= 8; ++try_phase) {
-            uint16_t *pPtr;
-            int phase, i, score, bytelen;
-
-            // Decode all the next 112 bits, regardless of the actual message
-            // size. We'll check the actual message type later
-
-            pPtr = &m[j+19] + (try_phase/5);
-            phase = try_phase % 5;
-
-            bytelen = MODES_LONG_MSG_BYTES;
-            for (i = 0; i < bytelen; ++i) {
-                uint8_t theByte = 0;
-
-                switch (phase) {
-                case 0:
-                    theByte =
-                        (slice_phase0(pPtr) > 0 ? 0x80 : 0) |
-                        (slice_phase2(pPtr+2) > 0 ? 0x40 : 0) |
-                        (slice_phase4(pPtr+4) > 0 ? 0x20 : 0) |
-                        (slice_phase1(pPtr+7) > 0 ? 0x10 : 0) |
-                        (slice_phase3(pPtr+9) > 0 ? 0x08 : 0) |
-                        (slice_phase0(pPtr+12) > 0 ? 0x04 : 0) |
-                        (slice_phase2(pPtr+14) > 0 ? 0x02 : 0) |
-                        (slice_phase4(pPtr+16) > 0 ? 0x01 : 0);
-
-
-                    phase = 1;
-                    pPtr += 19;
-                    break;
-
-                case 1:
-                    theByte =
-                        (slice_phase1(pPtr) > 0 ? 0x80 : 0) |
-                        (slice_phase3(pPtr+2) > 0 ? 0x40 : 0) |
-                        (slice_phase0(pPtr+5) > 0 ? 0x20 : 0) |
-                        (slice_phase2(pPtr+7) > 0 ? 0x10 : 0) |
-                        (slice_phase4(pPtr+9) > 0 ? 0x08 : 0) |
-                        (slice_phase1(pPtr+12) > 0 ? 0x04 : 0) |
-                        (slice_phase3(pPtr+14) > 0 ? 0x02 : 0) |
-                        (slice_phase0(pPtr+17) > 0 ? 0x01 : 0);
-
-                    phase = 2;
-                    pPtr += 19;
-                    break;
-
-                case 2:
-                    theByte =
-                        (slice_phase2(pPtr) > 0 ? 0x80 : 0) |
-                        (slice_phase4(pPtr+2) > 0 ? 0x40 : 0) |
-                        (slice_phase1(pPtr+5) > 0 ? 0x20 : 0) |
-                        (slice_phase3(pPtr+7) > 0 ? 0x10 : 0) |
-                        (slice_phase0(pPtr+10) > 0 ? 0x08 : 0) |
-                        (slice_phase2(pPtr+12) > 0 ? 0x04 : 0) |
-                        (slice_phase4(pPtr+14) > 0 ? 0x02 : 0) |
-                        (slice_phase1(pPtr+17) > 0 ? 0x01 : 0);
-
-                    phase = 3;
-                    pPtr += 19;
-                    break;
-
-                case 3:
-                    theByte =
-                        (slice_phase3(pPtr) > 0 ? 0x80 : 0) |
-                        (slice_phase0(pPtr+3) > 0 ? 0x40 : 0) |
-                        (slice_phase2(pPtr+5) > 0 ? 0x20 : 0) |
-                        (slice_phase4(pPtr+7) > 0 ? 0x10 : 0) |
-                        (slice_phase1(pPtr+10) > 0 ? 0x08 : 0) |
-                        (slice_phase3(pPtr+12) > 0 ? 0x04 : 0) |
-                        (slice_phase0(pPtr+15) > 0 ? 0x02 : 0) |
-                        (slice_phase2(pPtr+17) > 0 ? 0x01 : 0);
-
-                    phase = 4;
-                    pPtr += 19;
-                    break;
-
-                case 4:
-                    theByte =
-                        (slice_phase4(pPtr) > 0 ? 0x80 : 0) |
-                        (slice_phase1(pPtr+3) > 0 ? 0x40 : 0) |
-                        (slice_phase3(pPtr+5) > 0 ? 0x20 : 0) |
-                        (slice_phase0(pPtr+8) > 0 ? 0x10 : 0) |
-                        (slice_phase2(pPtr+10) > 0 ? 0x08 : 0) |
-                        (slice_phase4(pPtr+12) > 0 ? 0x04 : 0) |
-                        (slice_phase1(pPtr+15) > 0 ? 0x02 : 0) |
-                        (slice_phase3(pPtr+17) > 0 ? 0x01 : 0);
-
-                    phase = 0;
-                    pPtr += 20;
-                    break;
-                }
-
-                msg[i] = theByte;
-                if (i == 0) {
-                    switch (msg[0] >> 3) {
-                    case 0: case 4: case 5: case 11:
-                        bytelen = MODES_SHORT_MSG_BYTES; break;
-
-                    case 16: case 17: case 18: case 20: case 21: case 24:
-                        break;
-
-                    default:
-                        bytelen = 1; // unknown DF, give up immediately
-                        break;
-                    }
-                }
-            }
-
-            // Score the mode S message and see if it's any good.
-            score = scoreModesMessage(msg, i*8);
-            if (score > bestscore) {
-                // new high score!
-                bestmsg = msg;
-                bestscore = score;
-                bestphase = try_phase;
-
-                // swap to using the other buffer so we don't clobber our demodulated data
-                // (if we find a better result then we'll swap back, but that's OK because
-                // we no longer need this copy if we found a better one)
-                msg = (msg == msg1) ? msg2 : msg1;
-            }
+        Modes.stats_current.demod_phases_scored++;
+        if (sliced[p] < bytelen[p])
+            slicePhase(&m[j+19], p + 4, msgs[p], sliced[p], bytelen[p]);
+
+        // Score the mode S message and see if it's any good.
+        score = scoreModesMessage(msgs[p], bytelen[p]*8);
+        if (score > bestscore || (score == bestscore && p + 4 < bestphase)) {
+            // new high score!
+            bestmsg = msgs[p];
+            bestscore = score;
+            bestphase = p + 4;
         }
+    }
+
+    // Do we have a candidate?
+    if (bestscore < 0) {
+        if (bestscore == -1)
+            Modes.stats_current.demod_rejected_unknown_icao++;
+        else
+            Modes.stats_current.demod_rejected_bad++;
+        return 0; // nope.
+    }
+
+    msglen = modesMessageLenByType(bestmsg[0] >> 3);
+
+    // Set initial mm structure details
+    modesInitMessage(&mm);
+
+    // For consistency with how the Beast / Radarcape does it,
+    // we report the timestamp at the end of bit 56 (even if
+    // the frame is a 112-bit frame)
+    mm.timestampMsg = mag->sampleTimestamp + j*5 + (8 + 56) * 12 + bestphase;
 
-        // Do we have a candidate?
-        if (bestscore < 0) {
-            if (bestscore == -1)
+    // compute message receive time as block-start-time + difference in the 12MHz clock
+    mm.sysTimestampMsg = mag->sysTimestamp + receiveclock_ms_elapsed(mag->sampleTimestamp, mm.timestampMsg);
+    mm.receiverId = mag->receiverId;
+
+    mm.score = bestscore;
+
+    // Decode the received message
+    {
+        int result = decodeModesHeader(&mm, bestmsg);
+        if (result < 0) {
+            if (result == -1)
                 Modes.stats_current.demod_rejected_unknown_icao++;
             else
                 Modes.stats_current.demod_rejected_bad++;
-            continue; // nope.
+            return 0;
+        } else {
+            Modes.stats_current.demod_accepted[mm.correctedbits]++;
+        }
+    }
+
+    // measure signal power
+    {
+        double signal_power;
+        uint64_t scaled_signal_power = 0;
+        int signal_len = msglen*12/5;
+        int k;
+
+        for (k = 0; k < signal_len; ++k) {
+            uint32_t mag = m[j+19+k];
+            scaled_signal_power += mag * mag;
         }
 
-        msglen = modesMessageLenByType(bestmsg[0] >> 3);
+        signal_power = scaled_signal_power / 65535.0 / 65535.0;
+        mm.signalLevel = signal_power / signal_len;
+        Modes.stats_current.signal_power_sum += signal_power;
+        Modes.stats_current.signal_power_count += signal_len;
+        *sum_scaled_signal_power += scaled_signal_power;
 
-        // Set initial mm structure details
-        mm = zeroMessage;
+        if (mm.signalLevel > Modes.stats_current.peak_signal_power)
+            Modes.stats_current.peak_signal_power = mm.signalLevel;
+        if (mm.signalLevel > 0.50119)
+            Modes.stats_current.strong_signal_count++; // signal power above -3dBFS
+    }
 
-        // For consistency with how the Beast / Radarcape does it,
-        // we report the timestamp at the end of bit 56 (even if
-        // the frame is a 112-bit frame)
-        mm.timestampMsg = mag->sampleTimestamp + j*5 + (8 + 56) * 12 + bestphase;
+    // Pass data to the next layer
+    useModesMessage(&mm);
 
-        // compute message receive time as block-start-time + difference in the 12MHz clock
-        mm.sysTimestampMsg = mag->sysTimestamp + receiveclock_ms_elapsed(mag->sampleTimestamp, mm.timestampMsg);
+    // Skip over the message:
+    // (we actually skip to 8 bits before the end of the message,
+    //  because we can often decode two messages that *almost* collide,
+    //  where the preamble of the second message clobbered the last
+    //  few bits of the first message, but the message bits didn't
+    //  overlap)
+    return msglen*12/5;
+}
 
-        mm.score = bestscore;
+//
+// Find every Mode S preamble in 'mlen' samples of 'm' and slice the bits that
+// follow it at each phase, without scoring or decoding anything. This does
+// not touch any global state, so offline decoding can run it on worker
+// threads; demodulate2400 then finishes the job in order.
+//
+void demodulate2400Scan(uint16_t *m, uint32_t mlen, struct demod_candidates *out)
+{
+    uint8_t sliced[DEMOD_PHASES];
+    uint32_t j;
 
-        // Decode the received message
-        {
-            int result = decodeModesMessage(&mm, bestmsg);
-            if (result < 0) {
-                if (result == -1)
-                    Modes.stats_current.demod_rejected_unknown_icao++;
-                else
-                    Modes.stats_current.demod_rejected_bad++;
-                continue;
-            } else {
-                Modes.stats_current.demod_accepted[mm.correctedbits]++;
+    out->count = 0;
+    for (j = 0; j < mlen; j++) {
+        struct demod_candidate *c;
+
+        if (!checkPreamble(&m[j]))
+            continue;
+
+        if (out->count == out->alloc) {
+            unsigned alloc = out->alloc ? out->alloc * 2 : 256;
+            struct demod_candidate *list = realloc(out->list, alloc * sizeof(*list));
+            if (!list) {
+                fprintf(stderr, "demod: out of memory\n");
+                exit(1);
             }
+            out->list = list;
+            out->alloc = alloc;
         }
 
-        // measure signal power
-        {
-            double signal_power;
-            uint64_t scaled_signal_power = 0;
-            int signal_len = msglen*12/5;
-            int k;
+        c = &out->list[out->count++];
+        c->j = j;
+        slicePhases(&m[j+19], c->msg, c->bytelen, sliced, 1);
+    }
+}
 
-            for (k = 0; k < signal_len; ++k) {
-                uint32_t mag = m[j+19+k];
-                scaled_signal_power += mag * mag;
-            }
+//
+// Given 'mlen' magnitude samples in 'm', sampled at 2.4MHz,
+// try to demodulate some Mode S messages.
+//
+// If the buffer already carries the results of demodulate2400Scan, only the
+// filter-dependent half of the work (scoring, decoding) is done here. The
+// candidates are consumed in the same order and with the same skip-over rule
+// as a direct scan, so the results are identical.
+//
+void demodulate2400(struct mag_buf *mag)
+{
+    uint16_t *m = mag->data;
+    uint32_t mlen = mag->length;
+    uint64_t sum_scaled_signal_power = 0;
 
-            signal_power = scaled_signal_power / 65535.0 / 65535.0;
-            mm.signalLevel = signal_power / signal_len;
-            Modes.stats_current.signal_power_sum += signal_power;
-            Modes.stats_current.signal_power_count += signal_len;
-            sum_scaled_signal_power += scaled_signal_power;
+    if (mag->candidates) {
+        struct demod_candidates *cands = mag->candidates;
+        uint32_t next_j = 0;
+        unsigned c;
 
-            if (mm.signalLevel > Modes.stats_current.peak_signal_power)
-                Modes.stats_current.peak_signal_power = mm.signalLevel;
-            if (mm.signalLevel > 0.50119)
-                Modes.stats_current.strong_signal_count++; // signal power above -3dBFS
+        for (c = 0; c < cands->count; ++c) {
+            struct demod_candidate *cand = &cands->list[c];
+            if (cand->j < next_j)
+                continue; // inside a message we already decoded
+            next_j = cand->j + 1 + demodulateCandidate(mag, cand->j, cand->msg, cand->bytelen, cand->bytelen, &sum_scaled_signal_power);
         }
+    } else {
+        unsigned char msgs[DEMOD_PHASES][MODES_LONG_MSG_BYTES];
+        uint8_t bytelen[DEMOD_PHASES], sliced[DEMOD_PHASES];
+        uint32_t j;
 
-        // Skip over the message:
-        // (we actually skip to 8 bits before the end of the message,
-        //  because we can often decode two messages that *almost* collide,
-        //  where the preamble of the second message clobbered the last
-        //  few bits of the first message, but the message bits didn't
-        //  overlap)
-        j += msglen*12/5;
+        for (j = 0; j < mlen; j++) {
+            if (!checkPreamble(&m[j]))
+                continue;
 
-        // Pass data to the next layer
-        useModesMessage(&mm);
+            // just the DFs for now; demodulateCandidate slices the rest
+            // of the phases it doesn't rule out
+            slicePhases(&m[j+19], msgs, bytelen, sliced, 0);
+
+            j += demodulateCandidate(mag, j, msgs, bytelen, sliced, &sum_scaled_signal_power);
+        }
     }
 
     /* update noise power */
@@ -466,6 +585,86 @@ static void draw_modeac(uint16_t *m, unsigned modeac, unsigned f1_clock, unsigne
 //            1.00us = 60 cycles } one bit period = 1.45us = 87 cycles
 //
 // one 2.4MHz sample = 25 cycles
+//
+// F2 is 14 bit periods = 1218 cycles after F1. F1 starts 0..25 cycles into
+// its sample, so F2 always lands 48 or 49 samples after F1's sample.
+
+// Number of F1 offsets checked at once by modeACCandidates
+#define MODEAC_BLOCK 8
+
+#if defined(__SSE2__)
+
+// Lanes of p[0..7] that pass the framing pulse tests in demodulate2400AC:
+// a rising edge, a third sample no louder than the first two, and a level
+// of at least 'threshold'. _mm_avg_epu16 rounds up where the scalar code
+// rounds down, so this can only let extra lanes through, never drop one.
+static inline __m128i pulseLanes(const uint16_t *p, __m128i threshold)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i prev = _mm_loadu_si128((const __m128i *) (p - 1));
+    __m128i s0 = _mm_loadu_si128((const __m128i *) (p + 0));
+    __m128i s1 = _mm_loadu_si128((const __m128i *) (p + 1));
+    __m128i s2 = _mm_loadu_si128((const __m128i *) (p + 2));
+
+    // unsigned a <= b is (a -sat b) == 0
+    __m128i flat = _mm_cmpeq_epi16(_mm_subs_epu16(s0, prev), zero);
+    __m128i quiet = _mm_and_si128(_mm_cmpeq_epi16(_mm_subs_epu16(s2, s0), zero),
+                                  _mm_cmpeq_epi16(_mm_subs_epu16(s2, s1), zero));
+    __m128i loud = _mm_cmpeq_epi16(_mm_subs_epu16(threshold, _mm_avg_epu16(s0, s1)), zero);
+    return _mm_andnot_si128(flat, _mm_and_si128(quiet, loud));
+}
+
+// Could a F1/F2 pair start at any of m[f1_sample .. f1_sample+7]?
+static inline int modeACCandidates(const uint16_t *m, unsigned f1_sample, uint16_t threshold)
+{
+    __m128i t = _mm_set1_epi16((short) threshold);
+    __m128i f1 = pulseLanes(m + f1_sample, t);
+    __m128i f2 = _mm_or_si128(pulseLanes(m + f1_sample + 48, t),
+                              pulseLanes(m + f1_sample + 49, t));
+    return _mm_movemask_epi8(_mm_and_si128(f1, f2)) != 0;
+}
+
+#elif defined(__ARM_NEON)
+
+// As the SSE2 version; vhaddq_u16 rounds down exactly like the scalar code
+static inline uint16x8_t pulseLanes(const uint16_t *p, uint16x8_t threshold)
+{
+    uint16x8_t prev = vld1q_u16(p - 1);
+    uint16x8_t s0 = vld1q_u16(p + 0);
+    uint16x8_t s1 = vld1q_u16(p + 1);
+    uint16x8_t s2 = vld1q_u16(p + 2);
+
+    uint16x8_t rising = vcltq_u16(prev, s0);
+    uint16x8_t quiet = vandq_u16(vcleq_u16(s2, s0), vcleq_u16(s2, s1));
+    uint16x8_t loud = vcgeq_u16(vhaddq_u16(s0, s1), threshold);
+    return vandq_u16(rising, vandq_u16(quiet, loud));
+}
+
+static inline int modeACCandidates(const uint16_t *m, unsigned f1_sample, uint16_t threshold)
+{
+    uint16x8_t t = vdupq_n_u16(threshold);
+    uint16x8_t f1 = pulseLanes(m + f1_sample, t);
+    uint16x8_t f2 = vorrq_u16(pulseLanes(m + f1_sample + 48, t),
+                              pulseLanes(m + f1_sample + 49, t));
+    uint16x8_t both = vandq_u16(f1, f2);
+    uint16x4_t any = vorr_u16(vget_low_u16(both), vget_high_u16(both));
+    any = vpmax_u16(any, any);
+    any = vpmax_u16(any, any);
+    return vget_lane_u16(any, 0) != 0;
+}
+
+#else
+
+// No vector unit: let the scalar tests in demodulate2400AC do all the work
+static inline int modeACCandidates(const uint16_t *m, unsigned f1_sample, uint16_t threshold)
+{
+    MODES_NOTUSED(m);
+    MODES_NOTUSED(f1_sample);
+    MODES_NOTUSED(threshold);
+    return 1;
+}
+
+#endif
 
 void demodulate2400AC(struct mag_buf *mag)
 {
@@ -474,12 +673,28 @@ void demodulate2400AC(struct mag_buf *mag)
     uint32_t mlen = mag->length;
     unsigned f1_sample;
 
-    memset(&mm, 0, sizeof(mm));
+    modesInitMessage(&mm);
 
     double noise_stddev = sqrt(mag->mean_power - mag->mean_level * mag->mean_level); // Var(X) = E[(X-E[X])^2] = E[X^2] - (E[X])^2
     unsigned noise_level = (unsigned) ((mag->mean_power + noise_stddev) * 65535 + 0.5);
 
+    // no 16-bit sample can be 6dB above this much noise
+    if (noise_level * 2 > 65535)
+        return;
+
+    unsigned next_block = 1;
     for (f1_sample = 1; f1_sample < mlen; ++f1_sample) {
+        // Skip blocks of offsets where the pulse filter rules out
+        // any F1/F2 pair; offsets in a block that might hold one fall
+        // through to the full per-sample tests below.
+        if (f1_sample >= next_block) {
+            while (f1_sample + MODEAC_BLOCK <= mlen && !modeACCandidates(m, f1_sample, noise_level * 2))
+                f1_sample += MODEAC_BLOCK;
+            if (f1_sample >= mlen)
+                break;
+            next_block = f1_sample + MODEAC_BLOCK;
+        }
+
         // Mode A/C messages should match this bit sequence:
 
         // bit #     value
@@ -645,6 +860,7 @@ void demodulate2400AC(struct mag_buf *mag)
 
         // compute message receive time as block-start-time + difference in the 12MHz clock
         mm.sysTimestampMsg = mag->sysTimestamp + receiveclock_ms_elapsed(mag->sampleTimestamp, mm.timestampMsg);
+        mm.receiverId = mag->receiverId;
 
         decodeModeAMessage(&mm, modeac);
 
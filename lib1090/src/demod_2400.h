@@ -24,7 +24,26 @@
 
 struct mag_buf;
 
+// Number of phase offsets tried for each preamble
+#define DEMOD_PHASES 5
+
+// A Mode S preamble found by demodulate2400Scan, with the following bits
+// sliced at each phase offset. Choosing between the phases depends on the
+// ICAO filter, so that is left to demodulate2400.
+struct demod_candidate {
+    uint32_t j;                                              // sample offset of the preamble
+    uint8_t bytelen[DEMOD_PHASES];                           // bytes sliced for each phase
+    unsigned char msg[DEMOD_PHASES][MODES_LONG_MSG_BYTES];   // sliced bits for each phase
+};
+
+struct demod_candidates {
+    struct demod_candidate *list;
+    unsigned count;
+    unsigned alloc;
+};
+
 void demodulate2400(struct mag_buf *mag);
+void demodulate2400Scan(uint16_t *m, uint32_t mlen, struct demod_candidates *out);
 void demodulate2400AC(struct mag_buf *mag);
 
 #endif
@@ -0,0 +1,325 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// demod_8000.c: 8MHz Mode S demodulator, and the 2MHz and 6MHz ones built
+// from the same code.
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "dump1090.h"
+
+// 8MHz sampling rate version
+//
+// At 8MHz each 0.5us Mode S chip is exactly 4 samples, so there is no
+// phase juggling as in the 2.4MHz demodulator: a bit is 8 samples and
+// the 8us preamble is 64 samples.
+//
+//  sample#: 0   4   8   12              28  32  36  40      48          64
+//           |-P-|   |-P-|                |-P-|   |-P-|                   | bit 0
+//
+// Instead of matching the shape of individual samples, we correlate the
+// magnitude against the preamble: +2 over the pulses (P), -1 over the quiet
+// windows 4-7, 12-27, 32-35 and 40-47. The weights sum to zero, so as with
+// the 2.4MHz correlation functions, any DC offset cancels out. The window
+// sums slide along one sample at a time, so the search costs a handful of
+// additions per sample.
+//
+// The correlation peaks where the template lines up with the frame. Fitting
+// a parabola through the peak and its neighbours gives the frame start to a
+// fraction of a sample, which goes straight into the 12MHz timestamp.
+//
+// Nothing above depends on there being 4 samples per chip, only on it being
+// a whole number, so the same code runs at 6MHz (3 samples per chip) and at
+// 2MHz (1 sample per chip, the rate of the original dump1090 and of
+// testfiles/modes1.bin). Everything is written in terms of 'n', the samples
+// per chip, and each rate gets its own copy with n a constant.
+
+#define PREAMBLE_CHIPS (MODES_PREAMBLE_US * 2)
+
+// Correlation windows, in chips: the first four are the pulses, the rest are quiet
+#define NUM_PULSES 4
+#define NUM_WINDOWS 8
+static const uint8_t window_start[NUM_WINDOWS] = { 0, 2, 7, 9,   1, 3, 8, 10 };
+static const uint8_t window_len[NUM_WINDOWS]   = { 1, 1, 1, 1,   1, 4, 1,  2 };
+
+static inline void windowSums(const uint16_t *m, uint32_t *w, const int n)
+{
+    for (int k = 0; k < NUM_WINDOWS; ++k) {
+        w[k] = 0;
+        for (int i = 0; i < window_len[k] * n; ++i)
+            w[k] += m[window_start[k] * n + i];
+    }
+}
+
+// Move the windows from m[0] to m[1]. This is the inner loop of the search,
+// and is written out by hand because the compiler won't unroll it once
+// the offsets are scaled by n.
+#define SLIDE_WINDOW(k) (w[k] += m[(window_start[k] + window_len[k]) * n] - m[window_start[k] * n])
+static inline void slideWindows(const uint16_t *m, uint32_t *w, const int n)
+{
+    SLIDE_WINDOW(0); SLIDE_WINDOW(1); SLIDE_WINDOW(2); SLIDE_WINDOW(3);
+    SLIDE_WINDOW(4); SLIDE_WINDOW(5); SLIDE_WINDOW(6); SLIDE_WINDOW(7);
+}
+#undef SLIDE_WINDOW
+
+static inline int32_t correlate(const uint32_t *w)
+{
+    int32_t signal = w[0] + w[1] + w[2] + w[3];
+    int32_t quiet = w[4] + w[5] + w[6] + w[7];
+    return 2 * signal - quiet;
+}
+
+// Could the windows hold a preamble at all?
+static inline int plausiblePreamble(const uint32_t *w)
+{
+    uint32_t signal = w[0] + w[1] + w[2] + w[3];
+    uint32_t quiet = w[4] + w[5] + w[6] + w[7];
+
+    // pulses (4 chips) must average at least twice the quiet windows
+    // (8 chips), i.e. 6dB
+    if (signal <= quiet)
+        return 0;
+
+    // and each pulse must be there on its own, at least 1.5x the quiet level
+    for (int k = 0; k < NUM_PULSES; ++k) {
+        if (16 * w[k] < 3 * quiet)
+            return 0;
+    }
+
+    return 1;
+}
+
+//
+// Slice bytes 'from' .. 'to'-1 of a frame whose first data bit starts at m[0]
+//
+static inline void sliceBits(const uint16_t *m, unsigned char *msg, int from, int to, const int n)
+{
+    m += from * 16 * n;
+    for (int i = from; i < to; ++i) {
+        uint8_t theByte = 0;
+
+        for (int b = 0; b < 8; ++b, m += 2 * n) {
+            unsigned first = 0, second = 0;
+            for (int k = 0; k < n; ++k) {
+                first += m[k];
+                second += m[n + k];
+            }
+            theByte = (theByte << 1) | (first > second ? 1 : 0);
+        }
+
+        msg[i] = theByte;
+    }
+}
+
+// Slicing offsets tried around the correlation peak
+#define NUM_SHIFTS 3
+static const int slice_shift[NUM_SHIFTS] = { 0, -1, 1 };
+
+//
+// Try to demodulate a frame whose preamble correlation peaks at m[j], with
+// correlation values corr[0..2] at j-1, j, j+1. Returns the number of samples
+// to skip over (0 if nothing was decoded).
+//
+// As in the 2.4MHz demodulator, each offset's DF is sliced first and offsets
+// whose DF can't beat the best score so far are dropped unscored.
+//
+static uint32_t demodulateFrame(struct mag_buf *mag, uint32_t j, const int32_t *corr,
+                                uint64_t *sum_scaled_signal_power, const int n)
+{
+    const int preamble_samples = PREAMBLE_CHIPS * n;
+    struct modesMessage mm;
+    unsigned char msgs[NUM_SHIFTS][MODES_LONG_MSG_BYTES];
+    unsigned char *bestmsg;
+    int bestscore, bestshift;
+    int s, msglen;
+    uint16_t *m = mag->data;
+    double peak;
+
+    int bytelen[NUM_SHIFTS], bound[NUM_SHIFTS], order[NUM_SHIFTS];
+    int i, best;
+
+    Modes.stats_current.demod_preambles++;
+
+    // slice the DFs and order the offsets by their best possible score
+    for (i = 0; i < NUM_SHIFTS; ++i) {
+        int k;
+        sliceBits(&m[j + slice_shift[i] + preamble_samples], msgs[i], 0, 1, n);
+        bytelen[i] = demodFrameBytes(msgs[i][0]);
+        bound[i] = (bytelen[i] > 1 ? scoreModesMessageBound(msgs[i][0] >> 3) : -2);
+        for (k = i; k > 0 && bound[order[k-1]] < bound[i]; --k)
+            order[k] = order[k-1];
+        order[k] = i;
+    }
+
+    bestmsg = NULL; bestscore = -2; bestshift = 0; best = NUM_SHIFTS;
+    for (i = 0; i < NUM_SHIFTS; ++i) {
+        int score;
+
+        s = order[i];
+        if (bound[s] < bestscore || (bound[s] == bestscore && s > best)) {
+            Modes.stats_current.demod_phases_abandoned++;
+            continue;
+        }
+
+        Modes.stats_current.demod_phases_scored++;
+        sliceBits(&m[j + slice_shift[s] + preamble_samples], msgs[s], 1, bytelen[s], n);
+        score = scoreModesMessage(msgs[s], bytelen[s]*8);
+        if (score > bestscore || (score == bestscore && s < best)) {
+            bestmsg = msgs[s];
+            bestscore = score;
+            bestshift = slice_shift[s];
+            best = s;
+        }
+    }
+
+    if (bestscore < 0) {
+        if (bestscore == -1)
+            Modes.stats_current.demod_rejected_unknown_icao++;
+        else
+            Modes.stats_current.demod_rejected_bad++;
+        return 0;
+    }
+
+    msglen = modesMessageLenByType(bestmsg[0] >> 3);
+
+    // Sub-sample position of the correlation peak
+    {
+        int32_t curve = corr[0] - 2 * corr[1] + corr[2];
+        double offset = (curve < 0 ? 0.5 * (corr[0] - corr[2]) / curve : 0);
+        if (offset < -0.5)
+            offset = -0.5;
+        if (offset > 0.5)
+            offset = 0.5;
+        peak = j + offset;
+    }
+
+    modesInitMessage(&mm);
+
+    // As the 2.4MHz demodulator does, report the timestamp at the end
+    // of bit 56
+    mm.timestampMsg = mag->sampleTimestamp + demodSamplesToTicks(peak + preamble_samples + 56 * 2 * n);
+
+    // compute message receive time as block-start-time + difference in the 12MHz clock
+    mm.sysTimestampMsg = mag->sysTimestamp + receiveclock_ms_elapsed(mag->sampleTimestamp, mm.timestampMsg);
+    mm.receiverId = mag->receiverId;
+
+    mm.score = bestscore;
+
+    {
+        int result = decodeModesHeader(&mm, bestmsg);
+        if (result < 0) {
+            if (result == -1)
+                Modes.stats_current.demod_rejected_unknown_icao++;
+            else
+                Modes.stats_current.demod_rejected_bad++;
+            return 0;
+        } else {
+            Modes.stats_current.demod_accepted[mm.correctedbits]++;
+        }
+    }
+
+    // measure signal power
+    {
+        double signal_power;
+        uint64_t scaled_signal_power = 0;
+        int signal_len = msglen * 2 * n;
+        int k;
+
+        for (k = 0; k < signal_len; ++k) {
+            uint32_t mag = m[j + bestshift + preamble_samples + k];
+            scaled_signal_power += mag * mag;
+        }
+
+        signal_power = scaled_signal_power / 65535.0 / 65535.0;
+        mm.signalLevel = signal_power / signal_len;
+        Modes.stats_current.signal_power_sum += signal_power;
+        Modes.stats_current.signal_power_count += signal_len;
+        *sum_scaled_signal_power += scaled_signal_power;
+
+        if (mm.signalLevel > Modes.stats_current.peak_signal_power)
+            Modes.stats_current.peak_signal_power = mm.signalLevel;
+        if (mm.signalLevel > 0.50119)
+            Modes.stats_current.strong_signal_count++; // signal power above -3dBFS
+    }
+
+    // Pass data to the next layer
+    useModesMessage(&mm);
+
+    // Skip over the message, resuming 8us before its end as the 2.4MHz
+    // demodulator does, so that a following preamble can still be found
+    return msglen * 2 * n;
+}
+
+//
+// Given 'mlen' magnitude samples in 'm', sampled at 'n' samples per chip,
+// try to demodulate some Mode S messages.
+//
+static inline __attribute__((always_inline)) void demodulateChips(struct mag_buf *mag, const int n)
+{
+    uint16_t *m = mag->data;
+    uint32_t mlen = mag->length;
+    uint64_t sum_scaled_signal_power = 0;
+    uint32_t w[NUM_WINDOWS];
+    int32_t corr[3];          // correlation at j-1, j, j+1
+    uint32_t j;
+
+    windowSums(m, w, n);
+    corr[0] = correlate(w);   // nothing before sample 0; treat it as flat
+    for (j = 0; j < mlen; ) {
+        corr[1] = correlate(w);
+
+        if (corr[1] >= corr[0] && plausiblePreamble(w)) {
+            uint32_t next[NUM_WINDOWS];
+            memcpy(next, w, sizeof(next));
+            slideWindows(&m[j], next, n);
+            corr[2] = correlate(next);
+
+            if (corr[1] > corr[2]) {
+                uint32_t skip = demodulateFrame(mag, j, corr, &sum_scaled_signal_power, n);
+                if (skip) {
+                    j += skip;
+                    windowSums(&m[j - 1], w, n);
+                    corr[0] = correlate(w);
+                    slideWindows(&m[j - 1], w, n);
+                    continue;
+                }
+            }
+        }
+
+        corr[0] = corr[1];
+        slideWindows(&m[j], w, n);
+        ++j;
+    }
+
+    /* update noise power */
+    {
+        double sum_signal_power = sum_scaled_signal_power / 65535.0 / 65535.0;
+        Modes.stats_current.noise_power_sum += (mag->mean_power * mag->length - sum_signal_power);
+        Modes.stats_current.noise_power_count += mag->length;
+    }
+}
+
+void demodulate2000(struct mag_buf *mag)
+{
+    demodulateChips(mag, 1);
+}
+
+void demodulate6000(struct mag_buf *mag)
+{
+    demodulateChips(mag, 3);
+}
+
+void demodulate8000(struct mag_buf *mag)
+{
+    demodulateChips(mag, 4);
+}
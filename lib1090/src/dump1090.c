@@ -60,10 +60,69 @@
 // ============================= Utility functions ==========================
 //
 
-struct modes_t Modes;
+struct modes_t modesDefault;
+_Thread_local struct modes_t *modesCurrent = &modesDefault;
 
 static bool reset_signal_handlers = true;
 
+// The CRC and Mode A/C lookup tables are shared by all decoder instances
+static pthread_mutex_t tables_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int tables_nfix_crc = -1;
+
+// Make 'modes' the decoder instance this thread works on; returns the previous one
+struct modes_t *modesSetCurrent(struct modes_t *modes)
+{
+    struct modes_t *previous = modesCurrent;
+    modesCurrent = modes;
+    return previous;
+}
+
+// Allocate an additional, zeroed decoder instance. Bind it with
+// modesSetCurrent() before calling modesInitConfig() and modesInit() on it.
+struct modes_t *modesNewInstance(void)
+{
+    struct modes_t *modes = calloc(1, sizeof(*modes));
+    if (!modes) {
+        fprintf(stderr, "Out of memory allocating decoder instance.\n");
+        exit(1);
+    }
+    return modes;
+}
+
+// Release an instance from modesNewInstance() and everything modesInit()
+// allocated for it. No thread may be using it any more.
+void modesFreeInstance(struct modes_t *modes)
+{
+    struct modes_t *previous = modesSetCurrent(modes);
+
+    while (Modes.aircrafts) {
+        struct aircraft *next = Modes.aircrafts->next;
+        free(Modes.aircrafts);
+        Modes.aircrafts = next;
+    }
+
+    for (int r = 0; r < Modes.num_receivers; ++r) {
+        struct receiver *rx = &Modes.receivers[r];
+        for (int i = 0; i < MODES_MAG_BUFFERS; ++i)
+            free(rx->mag_buffers[i].data);
+        free(rx->dev_name);
+    }
+
+    free(Modes.sink_batch);
+    free(Modes.sink_batch_aircraft);
+    icaoFilterFree();
+    dedupFree();
+    commBFree();
+    if (Modes.trace_dir)
+        traceClose();
+    free(Modes.log10lut);
+    pthread_cond_destroy(&Modes.data_cond);
+    pthread_mutex_destroy(&Modes.data_mutex);
+
+    modesSetCurrent(previous == modes ? &modesDefault : previous);
+    free(modes);
+}
+
 static void sigintHandler(int dummy) {
     MODES_NOTUSED(dummy);
     if (reset_signal_handlers) {
@@ -133,6 +192,7 @@ void modesInitConfig(void) {
     // Now initialise things that should not be 0/NULL to their defaults
     Modes.gain                    = MODES_MAX_GAIN;
     Modes.freq                    = MODES_DEFAULT_FREQ;
+    Modes.sample_rate             = MODES_DEFAULT_RATE;
     Modes.check_crc               = 1;
     Modes.nfix_crc                = 1;
     Modes.net_heartbeat_interval  = MODES_NET_HEARTBEAT_INTERVAL;
@@ -141,11 +201,15 @@ void modesInitConfig(void) {
     Modes.net_output_sbs_ports    = strdup("30003");
     Modes.net_input_beast_ports   = strdup("30004,30104");
     Modes.net_output_beast_ports  = strdup("30005");
+    Modes.net_udp_ttl             = 1;
     Modes.interactive_display_ttl = MODES_INTERACTIVE_DISPLAY_TTL;
     Modes.json_interval           = 1000;
+    Modes.state_interval          = 60000;
+    Modes.trace_fd                = -1;
     Modes.json_location_accuracy  = 1;
     Modes.maxRange                = 1852 * 300; // 300NM default max range
     Modes.mode_ac_auto            = 1;
+    Modes.dedup_window_auto       = 1;
 
     sdrInitConfig();
 }
@@ -176,31 +240,64 @@ void modesInit(void) {
     pthread_mutex_init(&Modes.data_mutex,NULL);
     pthread_cond_init(&Modes.data_cond,NULL);
 
-    // oops, demodulator doesn't support any other sample rate
-    //if (Modes.sample_rate < 2400000.0) {
-        Modes.sample_rate = 2400000.0;
-    //}
+    if (Modes.sample_rate == 0)
+        Modes.sample_rate = MODES_DEFAULT_RATE;
+    if (!(Modes.demod = demodForSampleRate(Modes.sample_rate))) {
+        fprintf(stderr, "No demodulator for a sample rate of %.0f; supported rates are: ", Modes.sample_rate);
+        demodListRates(stderr);
+        fprintf(stderr, "\n");
+        exit(1);
+    }
+    if (Modes.mode_ac && !Modes.demod->demodulate_ac)
+        fprintf(stderr, "Mode A/C decoding is not supported at %s, ignoring --modeac\n", Modes.demod->name);
 
     // Allocate the various buffers used by Modes
     Modes.trailing_samples = (MODES_PREAMBLE_US + MODES_LONG_MSG_BITS + 16) * 1e-6 * Modes.sample_rate;
 
-    if ( ((Modes.log10lut   = (uint16_t *) malloc(sizeof(uint16_t) * 256 * 256)                                 ) == NULL) )
+    if ( !Modes.frames_only &&
+         ((Modes.log10lut   = (uint16_t *) malloc(sizeof(uint16_t) * 256 * 256)                                 ) == NULL) )
     {
         fprintf(stderr, "Out of memory allocating data buffer.\n");
         exit(1);
     }
 
-    for (i = 0; i < MODES_MAG_BUFFERS; ++i) {
-        if ( (Modes.mag_buffers[i].data = calloc(MODES_MAG_BUF_SAMPLES+Modes.trailing_samples, sizeof(uint16_t))) == NULL ) {
-            fprintf(stderr, "Out of memory allocating magnitude buffer.\n");
-            exit(1);
+    // Without any --device / --ifile arguments, use a single default receiver,
+    // unless this instance is only ever given whole frames
+    if (Modes.num_receivers == 0 && !Modes.frames_only)
+        sdrAddReceiver(NULL);
+
+    for (int r = 0; r < Modes.num_receivers; ++r) {
+        struct receiver *rx = &Modes.receivers[r];
+
+        for (i = 0; i < MODES_MAG_BUFFERS; ++i) {
+            if ( (rx->mag_buffers[i].data = calloc(MODES_MAG_BUF_SAMPLES+Modes.trailing_samples, sizeof(uint16_t))) == NULL ) {
+                fprintf(stderr, "Out of memory allocating magnitude buffer.\n");
+                exit(1);
+            }
+
+            rx->mag_buffers[i].length = 0;
+            rx->mag_buffers[i].dropped = 0;
+            rx->mag_buffers[i].sampleTimestamp = 0;
+            rx->mag_buffers[i].receiverId = r;
         }
 
-        Modes.mag_buffers[i].length = 0;
-        Modes.mag_buffers[i].dropped = 0;
-        Modes.mag_buffers[i].sampleTimestamp = 0;
+        rx->first_free_buffer = rx->first_filled_buffer = 0;
     }
 
+    // Several receivers will usually hear the same transmissions
+    if (Modes.num_receivers > 1 && Modes.dedup_window_auto)
+        Modes.dedup_window = MODES_DEDUP_DEFAULT_WINDOW;
+
+    // Files are read as fast as they can be, so when they were read says
+    // nothing about when their messages were heard; their sample clocks
+    // line up as long as the recordings started together. Network input
+    // only carries the sender's clock, so with --net stay on system time.
+    Modes.dedup_sample_clock = (Modes.sdr_type == SDR_IFILE && !Modes.net);
+
+    // ... and each has its own sample clock, so outputs can't carry timestamps
+    if (Modes.num_receivers > 1)
+        log_with_timestamp("Decoding %d receivers: Beast and raw output will carry no timestamps (not usable for mlat)", Modes.num_receivers);
+
     // Validate the users Lat/Lon home location inputs
     if ( (Modes.fUserLat >   90.0)  // Latitude must be -90 to +90
       || (Modes.fUserLat <  -90.0)  // and
@@ -229,20 +326,42 @@ void modesInit(void) {
       {Modes.net_sndbuf_size = MODES_NET_SNDBUF_MAX;}
 
     // Prepare the log10 lookup table: 100log10(x)
-    Modes.log10lut[0] = 0; // poorly defined..
-    for (i = 1; i <= 65535; i++) {
-        Modes.log10lut[i] = (uint16_t) round(100.0 * log10(i));
+    if (Modes.log10lut) {
+        Modes.log10lut[0] = 0; // poorly defined..
+        for (i = 1; i <= 65535; i++) {
+            Modes.log10lut[i] = (uint16_t) round(100.0 * log10(i));
+        }
+    }
+
+    // Prepare error correction tables (once per process; the most
+    // recently initialized instance's --fix setting applies to all)
+    pthread_mutex_lock(&tables_mutex);
+    if (tables_nfix_crc < 0)
+        modeACInit();
+    if (tables_nfix_crc != Modes.nfix_crc) {
+        modesChecksumInit(Modes.nfix_crc);
+        tables_nfix_crc = Modes.nfix_crc;
     }
+    pthread_mutex_unlock(&tables_mutex);
 
-    // Prepare error correction tables
-    modesChecksumInit(Modes.nfix_crc);
     icaoFilterInit();
-    modeACInit();
+    dedupInit();
+
+    // Pick up where the last run left off
+    if (Modes.state_path)
+        stateRead(Modes.state_path);
 
     if (Modes.show_only)
         icaoFilterAdd(Modes.show_only);
 }
 
+// modesInit for an instance that is only ever handed whole frames (lib1090):
+// it gets no receivers, magnitude buffers or log10 table
+void modesInitFramesOnly(void) {
+    Modes.frames_only = 1;
+    modesInit();
+}
+
 //
 //=========================================================================
 //
@@ -264,14 +383,21 @@ void modesInit(void) {
 
 void *readerThreadEntryPoint(void *arg)
 {
-    MODES_NOTUSED(arg);
+    struct receiver *rx = (struct receiver *) arg;
 
-    sdrRun();
+    modesSetCurrent(rx->modes);
+    sdrRun(rx);
 
-    // Wake the main thread (if it's still waiting)
+    // Wake the main thread (if it's still waiting); once the last
+    // reader has finished there is nothing left to demodulate
     pthread_mutex_lock(&Modes.data_mutex);
-    Modes.exit = 1; // just in case
-    pthread_cond_signal(&Modes.data_cond);
+    rx->running = 0;
+    int still_running = 0;
+    for (int r = 0; r < Modes.num_receivers; ++r)
+        still_running += Modes.receivers[r].running;
+    if (!still_running)
+        Modes.exit = 1; // just in case
+    pthread_cond_broadcast(&Modes.data_cond);
     pthread_mutex_unlock(&Modes.data_mutex);
 
 #ifndef _WIN32
@@ -326,17 +452,38 @@ void mainLoopNetOnly(void) {
     }
 }
 
+// Returns the receiver with the oldest pending buffer, or NULL if all rings are empty.
+// Must be called with Modes.data_mutex held.
+static struct receiver *nextFilledReceiver(void)
+{
+    struct receiver *best = NULL;
+
+    for (int r = 0; r < Modes.num_receivers; ++r) {
+        struct receiver *rx = &Modes.receivers[r];
+        if (rx->first_free_buffer == rx->first_filled_buffer)
+            continue;
+        if (!best || rx->mag_buffers[rx->first_filled_buffer].sysTimestamp < best->mag_buffers[best->first_filled_buffer].sysTimestamp)
+            best = rx;
+    }
+
+    return best;
+}
+
 void mainLoopSdr(void) {
     int watchdogCounter = 10; // about 1 second
 
-    // Create the thread that will read the data from the device.
+    // Create the threads that will read the data from the devices.
     pthread_mutex_lock(&Modes.data_mutex);
-    pthread_create(&Modes.reader_thread, NULL, readerThreadEntryPoint, NULL);
+    for (int r = 0; r < Modes.num_receivers; ++r) {
+        Modes.receivers[r].running = 1;
+        pthread_create(&Modes.receivers[r].reader_thread, NULL, readerThreadEntryPoint, &Modes.receivers[r]);
+    }
 
     while (!Modes.exit) {
         struct timespec start_time;
+        struct receiver *rx;
 
-        if (Modes.first_free_buffer == Modes.first_filled_buffer) {
+        if (!(rx = nextFilledReceiver())) {
             /* wait for more data.
             * we should be getting data every 50-60ms. wait for max 100ms before we give up and do some background work.
             * this is fairly aggressive as all our network I/O runs out of the background work!
@@ -348,6 +495,7 @@ void mainLoopSdr(void) {
             normalize_timespec(&ts);
 
             pthread_cond_timedwait(&Modes.data_cond, &Modes.data_mutex, &ts); // This unlocks Modes.data_mutex, and waits for Modes.data_cond
+            rx = nextFilledReceiver();
         }
 
         // Modes.data_mutex is locked, and possibly we have data.
@@ -357,23 +505,24 @@ void mainLoopSdr(void) {
         Modes.reader_cpu_accumulator.tv_sec = 0;
         Modes.reader_cpu_accumulator.tv_nsec = 0;
 
-        if (Modes.first_free_buffer != Modes.first_filled_buffer) {
+        if (rx) {
             // FIFO is not empty, process one buffer.
 
             struct mag_buf *buf;
 
             start_cpu_timing(&start_time);
-            buf = &Modes.mag_buffers[Modes.first_filled_buffer];
+            buf = &rx->mag_buffers[rx->first_filled_buffer];
 
             // Process data after releasing the lock, so that the capturing
             // thread can read data while we perform computationally expensive
             // stuff at the same time.
             pthread_mutex_unlock(&Modes.data_mutex);
 
-            demodulate2400(buf);
-            if (Modes.mode_ac) {
-                demodulate2400AC(buf);
+            Modes.demod->demodulate(buf);
+            if (Modes.mode_ac && Modes.demod->demodulate_ac) {
+                Modes.demod->demodulate_ac(buf);
             }
+            modesFlushSink();
 
             Modes.stats_current.samples_processed += buf->length;
             Modes.stats_current.samples_dropped += buf->dropped;
@@ -381,8 +530,8 @@ void mainLoopSdr(void) {
 
             // Mark the buffer we just processed as completed.
             pthread_mutex_lock(&Modes.data_mutex);
-            Modes.first_filled_buffer = (Modes.first_filled_buffer + 1) % MODES_MAG_BUFFERS;
-            pthread_cond_signal(&Modes.data_cond);
+            rx->first_filled_buffer = (rx->first_filled_buffer + 1) % MODES_MAG_BUFFERS;
+            pthread_cond_broadcast(&Modes.data_cond);
             pthread_mutex_unlock(&Modes.data_mutex);
             watchdogCounter = 10;
         } else {
@@ -401,11 +550,14 @@ void mainLoopSdr(void) {
         pthread_mutex_lock(&Modes.data_mutex);
     }
 
+    // Wake any reader still waiting for buffer space so it can see Modes.exit
+    pthread_cond_broadcast(&Modes.data_cond);
     pthread_mutex_unlock(&Modes.data_mutex);
 
     log_with_timestamp("Waiting for receive thread termination");
-    pthread_join(Modes.reader_thread,NULL);     // Wait on reader thread exit
-    pthread_cond_destroy(&Modes.data_cond);     // Thread cleanup - only after the reader thread is dead!
+    for (int r = 0; r < Modes.num_receivers; ++r)
+        pthread_join(Modes.receivers[r].reader_thread, NULL); // Wait on reader thread exit
+    pthread_cond_destroy(&Modes.data_cond);     // Thread cleanup - only after the reader threads are dead!
     pthread_mutex_destroy(&Modes.data_mutex);
 }
 
@@ -414,12 +566,11 @@ void mainLoopSdr(void) {
 // from the net, refreshing the screen in interactive mode, and so forth
 //
 void backgroundTasks(void) {
-    static uint64_t next_stats_display;
-    static uint64_t next_stats_update;
-    static uint64_t next_json, next_history;
-
     uint64_t now = mstime();
 
+    // Deliver batched messages while their aircraft are certain to exist
+    modesFlushSink();
+
     icaoFilterExpire();
     trackPeriodicUpdate();
 
@@ -436,11 +587,11 @@ void backgroundTasks(void) {
     // always update end time so it is current when requests arrive
     Modes.stats_current.end = mstime();
 
-    if (now >= next_stats_update) {
+    if (now >= Modes.next_stats_update) {
         int i;
 
-        if (next_stats_update == 0) {
-            next_stats_update = now + 60000;
+        if (Modes.next_stats_update == 0) {
+            Modes.next_stats_update = now + 60000;
         } else {
             Modes.stats_latest_1min = (Modes.stats_latest_1min + 1) % 15;
             Modes.stats_1min[Modes.stats_latest_1min] = Modes.stats_current;
@@ -462,32 +613,42 @@ void backgroundTasks(void) {
             if (Modes.json_dir)
                 writeJsonToFile("stats.json", generateStatsJson);
 
-            next_stats_update += 60000;
+            Modes.next_stats_update += 60000;
         }
     }
 
-    if (Modes.stats && now >= next_stats_display) {
-        if (next_stats_display == 0) {
-            next_stats_display = now + Modes.stats;
+    if (Modes.stats && now >= Modes.next_stats_display) {
+        if (Modes.next_stats_display == 0) {
+            Modes.next_stats_display = now + Modes.stats;
         } else {
             add_stats(&Modes.stats_periodic, &Modes.stats_current, &Modes.stats_periodic);
             display_stats(&Modes.stats_periodic);
             reset_stats(&Modes.stats_periodic);
 
-            next_stats_display += Modes.stats;
-            if (next_stats_display <= now) {
+            Modes.next_stats_display += Modes.stats;
+            if (Modes.next_stats_display <= now) {
                 /* something has gone wrong, perhaps the system clock jumped */
-                next_stats_display = now + Modes.stats;
+                Modes.next_stats_display = now + Modes.stats;
             }
         }
     }
 
-    if (Modes.json_dir && now >= next_json) {
+    if (Modes.json_dir && now >= Modes.next_json) {
         writeJsonToFile("aircraft.json", generateAircraftJson);
-        next_json = now + Modes.json_interval;
+        Modes.next_json = now + Modes.json_interval;
+    }
+
+    if (Modes.state_path && now >= Modes.next_state) {
+        if (Modes.next_state)
+            stateWrite(Modes.state_path);
+        Modes.next_state = now + Modes.state_interval;
     }
 
-    if (now >= next_history) {
+    if (Modes.trace_dir) {
+        traceFlush(now);
+    }
+
+    if (now >= Modes.next_history) {
         int rewrite_receiver_json = (Modes.json_dir && Modes.json_aircraft_history[HISTORY_SIZE-1].content == NULL);
 
         free(Modes.json_aircraft_history[Modes.json_aircraft_history_next].content); // might be NULL, that's OK.
@@ -505,7 +666,7 @@ void backgroundTasks(void) {
         if (rewrite_receiver_json)
             writeJsonToFile("receiver.json", generateReceiverJson); // number of history entries changed
 
-        next_history = now + HISTORY_INTERVAL;
+        Modes.next_history = now + HISTORY_INTERVAL;
     }
 }
 
@@ -547,6 +708,8 @@ static void showHelp(void) {
 "\n"
 "--gain <db>              Set gain (default: max gain. Use -10 for auto-gain)\n"
 "--freq <hz>              Set frequency (default: 1090 Mhz)\n"
+"--sample-rate <hz>       Set sample rate: 2000000, 2400000, 6000000 or 8000000 (default: 2400000)\n"
+"                         Mode A/C is only decoded at 2400000; elsewhere --modeac just warns\n"
 "--interactive            Interactive mode refreshing data on screen. Implies --throttle\n"
 "--interactive-rows <num> Max number of rows in interactive mode (default: 22)\n"
 "--interactive-ttl <sec>  Remove from list if idle for <sec> (default: 60)\n"
@@ -561,12 +724,19 @@ static void showHelp(void) {
 "--net-sbs-port <ports>   TCP BaseStation output listen ports (default: 30003)\n"
 "--net-bi-port <ports>    TCP Beast input listen ports  (default: 30004,30104)\n"
 "--net-bo-port <ports>    TCP Beast output listen ports (default: 30005)\n"
+"--net-udp-beast <dest>   Also send Beast output as UDP datagrams to host:port (unicast or multicast)\n"
+"--net-udp-raw <dest>     Also send raw output as UDP datagrams to host:port (unicast or multicast)\n"
+"--net-udp-ttl <hops>     TTL for multicast UDP output (default: 1)\n"
 "--net-ro-size <size>     TCP output minimum size (default: 0)\n"
 "--net-ro-interval <rate> TCP output memory flush rate in seconds (default: 0)\n"
 "--net-heartbeat <rate>   TCP heartbeat rate in seconds (default: 60 sec; 0 to disable)\n"
 "--net-buffer <n>         TCP buffer size 64Kb * (2^n) (default: n=0, 64Kb)\n"
 "--net-verbatim           Do not apply CRC corrections to messages we forward; send unchanged\n"
 "--forward-mlat           Allow forwarding of received mlat results to output ports\n"
+"--dedup-window <ms>      Drop identical messages heard by another input within <ms> (default: 100 with several receivers; 0 to disable)\n"
+"                         With only file inputs (no --net) this uses the sample clock, so the recordings\n"
+"                         must have started together; otherwise it uses the time messages were read\n"
+"--record <path>          Record raw samples to a compressed file that --ifile can replay\n"
 "--lat <latitude>         Reference/receiver latitude for surface posn (opt)\n"
 "--lon <longitude>        Reference/receiver longitude for surface posn (opt)\n"
 "--max-range <distance>   Absolute maximum range for position decoding (in nm, default: 300)\n"
@@ -592,6 +762,9 @@ static void showHelp(void) {
 "--write-json <dir>       Periodically write json output to <dir> (for serving by a separate webserver)\n"
 "--write-json-every <t>   Write json output every t seconds (default 1)\n"
 "--json-location-accuracy <n>  Accuracy of receiver location in json metadata: 0=no location, 1=approximate, 2=exact\n"
+"--write-state <file>     Save tracker state to <file> periodically and on exit, and restore it on startup\n"
+"--write-state-every <t>  Save tracker state every t seconds (default 60)\n"
+"--write-trace <dir>      Append full-resolution aircraft traces to daily files in <dir> (read them with trace1090)\n"
 "--dcfilter               Apply a 1Hz DC filter to input data (requires more CPU)\n"
 "--help                   Show this help\n"
 "\n"
@@ -611,8 +784,14 @@ static void dump1090ParseArgs(int argc, char **argv) {
 
         if (!strcmp(argv[j],"--freq") && more) {
             Modes.freq = (int) strtoll(argv[++j],NULL,10);
+        } else if (!strcmp(argv[j],"--sample-rate") && more) {
+            Modes.sample_rate = strtod(argv[++j], NULL);
         } else if ( (!strcmp(argv[j], "--device") || !strcmp(argv[j], "--device-index")) && more) {
-            Modes.dev_name = strdup(argv[++j]);
+            // may be repeated to decode several devices in one process
+            if (!Modes.dev_name)
+                Modes.dev_name = strdup(argv[j+1]);
+            if (!sdrAddReceiver(argv[++j]))
+                exit(1);
         } else if (!strcmp(argv[j],"--gain") && more) {
             Modes.gain = (int) (atof(argv[++j])*10); // Gain is in tens of DBs
         } else if (!strcmp(argv[j],"--dcfilter")) {
@@ -675,6 +854,19 @@ static void dump1090ParseArgs(int argc, char **argv) {
             Modes.net_sndbuf_size = atoi(argv[++j]);
         } else if (!strcmp(argv[j],"--net-verbatim")) {
             Modes.net_verbatim = 1;
+        } else if (!strcmp(argv[j],"--net-udp-beast") && more) {
+            free(Modes.net_udp_beast);
+            Modes.net_udp_beast = strdup(argv[++j]);
+        } else if (!strcmp(argv[j],"--net-udp-raw") && more) {
+            free(Modes.net_udp_raw);
+            Modes.net_udp_raw = strdup(argv[++j]);
+        } else if (!strcmp(argv[j],"--net-udp-ttl") && more) {
+            Modes.net_udp_ttl = atoi(argv[++j]);
+        } else if (!strcmp(argv[j],"--dedup-window") && more) {
+            Modes.dedup_window = (uint64_t) atoi(argv[++j]);
+            Modes.dedup_window_auto = 0;
+        } else if (!strcmp(argv[j],"--record") && more) {
+            Modes.record_path = strdup(argv[++j]);
         } else if (!strcmp(argv[j],"--forward-mlat")) {
             Modes.forward_mlat = 1;
         } else if (!strcmp(argv[j],"--onlyaddr")) {
@@ -749,6 +941,14 @@ static void dump1090ParseArgs(int argc, char **argv) {
                 Modes.json_interval = 100;
         } else if (!strcmp(argv[j], "--json-location-accuracy") && more) {
             Modes.json_location_accuracy = atoi(argv[++j]);
+        } else if (!strcmp(argv[j], "--write-state") && more) {
+            Modes.state_path = strdup(argv[++j]);
+        } else if (!strcmp(argv[j], "--write-state-every") && more) {
+            Modes.state_interval = (uint64_t)(1000 * atof(argv[++j]));
+            if (Modes.state_interval < 1000) // 1s
+                Modes.state_interval = 1000;
+        } else if (!strcmp(argv[j], "--write-trace") && more) {
+            Modes.trace_dir = strdup(argv[++j]);
 #endif
         } else if (sdrHandleOption(argc, argv, &j)) {
             /* handled */
@@ -808,19 +1008,39 @@ int dump1090main(int argc, char **argv) {
 
     // If the user specifies --net-only, just run in order to serve network
     // clients without reading data from the RTL device
+    struct timespec bench_start, bench_end;
+    clock_gettime(CLOCK_MONOTONIC, &bench_start);
+
     if (Modes.sdr_type == SDR_NONE) {
         mainLoopNetOnly();
     } else {
         mainLoopSdr();
     }
 
+    clock_gettime(CLOCK_MONOTONIC, &bench_end);
+
     interactiveCleanup();
 
+    if (Modes.state_path) {
+        stateWrite(Modes.state_path);
+    }
+
+    if (Modes.trace_dir) {
+        traceClose();
+    }
+
     // If --stats were given, print statistics
     if (Modes.stats) {
         display_total_stats();
     }
 
+    // With --bench, report throughput over the whole input
+    if (Modes.bench) {
+        struct stats added;
+        add_stats(&Modes.stats_alltime, &Modes.stats_current, &added);
+        display_bench_stats(&added, (bench_end.tv_sec - bench_start.tv_sec) + (bench_end.tv_nsec - bench_start.tv_nsec) / 1e9);
+    }
+
     log_with_timestamp("Normal exit.");
 
     sdrClose();
@@ -65,6 +65,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <pthread.h>
 #include <stdint.h>
@@ -85,6 +86,9 @@
 
 #include "compat/compat.h"
 
+// The decoded message, shared with the public lib1090.h
+#include "message.h"
+
 // ============================= #defines ===============================
 
 #define MODES_DEFAULT_FREQ         1090000000
@@ -94,6 +98,9 @@
 #define MODES_RTL_BUF_SIZE         (16*16384)                 // 256k
 #define MODES_MAG_BUF_SAMPLES      (MODES_RTL_BUF_SIZE / 2)   // Each sample is 2 bytes
 #define MODES_MAG_BUFFERS          12                         // Number of magnitude buffers (should be smaller than RTL_BUFFERS for flowcontrol to work)
+#define MODES_MAX_RECEIVERS        4                          // Maximum number of SDRs / input files decoded by one process
+#define MODES_DEDUP_DEFAULT_WINDOW 100                        // Cross-receiver duplicate window (ms) used when several receivers are configured
+#define MODES_SINK_DEFAULT_BATCH   1024                       // Messages held for a batch message sink before it is called early
 #define MODES_AUTO_GAIN            -100                       // Use automatic gain
 #define MODES_MAX_GAIN             999999                     // Use max available gain
 #define MODES_MSG_SQUELCH_DB       4.0                        // Minimum SNR, in dB
@@ -106,8 +113,6 @@
 #define MODES_PREAMBLE_US        8              // microseconds = bits
 #define MODES_PREAMBLE_SAMPLES  (MODES_PREAMBLE_US       * 2)
 #define MODES_PREAMBLE_SIZE     (MODES_PREAMBLE_SAMPLES  * sizeof(uint16_t))
-#define MODES_LONG_MSG_BYTES     14
-#define MODES_SHORT_MSG_BYTES    7
 #define MODES_LONG_MSG_BITS     (MODES_LONG_MSG_BYTES    * 8)
 #define MODES_SHORT_MSG_BITS    (MODES_SHORT_MSG_BYTES   * 8)
 #define MODES_LONG_MSG_SAMPLES  (MODES_LONG_MSG_BITS     * 2)
@@ -123,6 +128,7 @@
 #define MODES_OS_SHORT_MSG_SIZE    (MODES_SHORT_MSG_SAMPLES * sizeof(uint16_t))
 
 #define MODES_OUT_BUF_SIZE         (1500)
+#define MODES_UDP_PAYLOAD_SIZE     (1500 - 40 - 8 - 4)        // one Ethernet frame, after IPv6 + UDP headers and our sequence number
 #define MODES_OUT_FLUSH_SIZE       (MODES_OUT_BUF_SIZE - 256)
 #define MODES_OUT_FLUSH_INTERVAL   (60000)
 
@@ -130,109 +136,6 @@
 
 #define INVALID_ALTITUDE (-9999)
 
-/* Where did a bit of data arrive from? In order of increasing priority */
-typedef enum {
-    SOURCE_INVALID,        /* data is not valid */
-    SOURCE_MODE_AC,        /* A/C message */
-    SOURCE_MLAT,           /* derived from mlat */
-    SOURCE_MODE_S,         /* data from a Mode S message, no full CRC */
-    SOURCE_MODE_S_CHECKED, /* data from a Mode S message with full CRC */
-    SOURCE_TISB,           /* data from a TIS-B extended squitter message */
-    SOURCE_ADSR,           /* data from a ADS-R extended squitter message */
-    SOURCE_ADSB,           /* data from a ADS-B extended squitter message */
-} datasource_t;
-
-/* What sort of address is this and who sent it?
- * (Earlier values are higher priority)
- */
-typedef enum {
-    ADDR_ADSB_ICAO,       /* Mode S or ADS-B, ICAO address, transponder sourced */
-    ADDR_ADSB_ICAO_NT,    /* ADS-B, ICAO address, non-transponder */
-    ADDR_ADSR_ICAO,       /* ADS-R, ICAO address */
-    ADDR_TISB_ICAO,       /* TIS-B, ICAO address */
-
-    ADDR_ADSB_OTHER,      /* ADS-B, other address format */
-    ADDR_ADSR_OTHER,      /* ADS-R, other address format */
-    ADDR_TISB_TRACKFILE,  /* TIS-B, Mode A code + track file number */
-    ADDR_TISB_OTHER,      /* TIS-B, other address format */
-
-    ADDR_MODE_A,          /* Mode A */
-
-    ADDR_UNKNOWN          /* unknown address format */
-} addrtype_t;
-
-typedef enum {
-    UNIT_FEET,
-    UNIT_METERS
-} altitude_unit_t;
-
-typedef enum {
-    ALTITUDE_BARO,
-    ALTITUDE_GEOM
-} altitude_source_t;
-
-typedef enum {
-    AG_INVALID,
-    AG_GROUND,
-    AG_AIRBORNE,
-    AG_UNCERTAIN
-} airground_t;
-
-typedef enum {
-    SIL_INVALID, SIL_UNKNOWN, SIL_PER_SAMPLE, SIL_PER_HOUR
-} sil_type_t;
-
-typedef enum {
-    CPR_SURFACE, CPR_AIRBORNE, CPR_COARSE
-} cpr_type_t;
-
-typedef enum {
-    HEADING_INVALID,          // Not set
-    HEADING_GROUND_TRACK,     // Direction of track over ground, degrees clockwise from true north
-    HEADING_TRUE,             // Heading, degrees clockwise from true north
-    HEADING_MAGNETIC,         // Heading, degrees clockwise from magnetic north
-    HEADING_MAGNETIC_OR_TRUE, // HEADING_MAGNETIC or HEADING_TRUE depending on the HRD bit in opstatus
-    HEADING_TRACK_OR_HEADING  // GROUND_TRACK / MAGNETIC / TRUE depending on the TAH bit in opstatus
-} heading_type_t;
-
-typedef enum {
-    COMMB_UNKNOWN,
-    COMMB_AMBIGUOUS,
-    COMMB_EMPTY_RESPONSE,
-    COMMB_DATALINK_CAPS,
-    COMMB_GICB_CAPS,
-    COMMB_AIRCRAFT_IDENT,
-    COMMB_ACAS_RA,
-    COMMB_VERTICAL_INTENT,
-    COMMB_TRACK_TURN,
-    COMMB_HEADING_SPEED
-} commb_format_t;
-
-typedef enum {
-    NAV_MODE_AUTOPILOT = 1,
-    NAV_MODE_VNAV = 2,
-    NAV_MODE_ALT_HOLD = 4,
-    NAV_MODE_APPROACH = 8,
-    NAV_MODE_LNAV = 16,
-    NAV_MODE_TCAS = 32
-} nav_modes_t;
-
-// Matches encoding of the ES type 28/1 emergency/priority status subfield
-typedef enum {
-    EMERGENCY_NONE = 0,
-    EMERGENCY_GENERAL = 1,
-    EMERGENCY_LIFEGUARD = 2,
-    EMERGENCY_MINFUEL = 3,
-    EMERGENCY_NORDO = 4,
-    EMERGENCY_UNLAWFUL = 5,
-    EMERGENCY_DOWNED = 6,
-    EMERGENCY_RESERVED = 7
-} emergency_t;
-
-typedef enum {
-    NAV_ALT_INVALID, NAV_ALT_UNKNOWN, NAV_ALT_AIRCRAFT, NAV_ALT_MCP, NAV_ALT_FMS
-} nav_altitude_source_t;
-
 #define MODES_NON_ICAO_ADDRESS       (1<<24) // Set on addresses to indicate they are not ICAO addresses
 
 #define MODES_DEBUG_DEMOD (1<<0)
@@ -270,12 +173,21 @@ typedef enum {
 #include "anet.h"
 #include "net_io.h"
 #include "crc.h"
+#include "demod.h"
 #include "demod_2400.h"
+#include "demod_8000.h"
 #include "stats.h"
 #include "cpr.h"
 #include "icao_filter.h"
 #include "convert.h"
 #include "sdr.h"
+#include "recorder.h"
+#include "dedup.h"
+#include "sbs.h"
+#include "netfilter.h"
+#include "avr.h"
+#include "state.h"
+#include "trace.h"
 
 //======================== structure declarations =========================
 
@@ -292,22 +204,40 @@ struct mag_buf {
     uint32_t        dropped;         // Number of dropped samples preceding this buffer
     double          mean_level;      // Mean of normalized (0..1) signal level
     double          mean_power;      // Mean of normalized (0..1) power level
+    int             receiverId;      // Index of the receiver that produced this buffer
+    struct demod_candidates *candidates; // Preambles already found by demodulate2400Scan, or NULL to scan data
 };
 
-// Program global state
-struct modes_t {                             // Internal state
+// One sample source (SDR or input file), with its own reader thread and buffer ring
+struct receiver {
+    int             id;                                   // Index into Modes.receivers
+    char           *dev_name;                             // Device index/serial, or filename for ifile; NULL for the default
+    void           *sdr_state;                            // Per-receiver state owned by the SDR handler
     pthread_t       reader_thread;
-
-    pthread_mutex_t data_mutex;      // Mutex to synchronize buffer access
-    pthread_cond_t  data_cond;       // Conditional variable associated
+    int             running;                              // Reader thread has not yet returned
+    struct modes_t *modes;                                // Decoder instance this receiver feeds
+    input_format_t  sample_format;                        // Raw sample format delivered by the SDR handler
+    struct recorder *recorder;                            // --record tap, or NULL
 
     struct mag_buf  mag_buffers[MODES_MAG_BUFFERS];       // Converted magnitude buffers from RTL or file input
     unsigned        first_free_buffer;                    // Entry in mag_buffers that will next be filled with input.
     unsigned        first_filled_buffer;                  // Entry in mag_buffers that has valid data and will be demodulated next. If equal to next_free_buffer, there is no unprocessed data.
-    struct timespec reader_cpu_accumulator;               // CPU time used by the reader thread, copied out and reset by the main thread under the mutex
+};
+
+// Program global state
+struct modes_t {                             // Internal state
+    pthread_mutex_t data_mutex;      // Mutex to synchronize buffer access (all receivers)
+    pthread_cond_t  data_cond;       // Conditional variable associated; always broadcast, as several readers may wait on it
+
+    struct receiver receivers[MODES_MAX_RECEIVERS];       // Configured sample sources
+    int             num_receivers;                        // Number of entries used in receivers
+    int             frames_only;                          // no sample input at all: set up no receivers or magnitude buffers
+    pthread_t       lib1090_thread;                       // lib1090.c: thread running lib1090RunThread's main loop, or 0
+    struct timespec reader_cpu_accumulator;               // CPU time used by the reader threads, copied out and reset by the main thread under the mutex
 
     unsigned        trailing_samples;                     // extra trailing samples in magnitude buffers
     double          sample_rate;                          // actual sample rate in use (in hz)
+    const struct demodulator *demod;                      // demodulators for sample_rate
 
     uint16_t       *log10lut;        // Magnitude -> log10 lookup table
     int             exit;            // Exit from the main loop when true (2 = unclean exit)
@@ -324,6 +254,7 @@ struct modes_t {                             // Internal state
     char           aneterr[ANET_ERR_LEN];
     struct net_service *services;    // Active services
     struct client *clients;          // Our clients
+    int   clients_created;           // network clients so far, for their receiverIds
 
     struct net_service *beast_verbatim_service;  // Beast-format output service, verbatim mode
     struct net_service *beast_cooked_service;    // Beast-format output service, "cooked" mode
@@ -333,6 +264,11 @@ struct modes_t {                             // Internal state
     struct net_writer beast_cooked_out;          // Beast-format output, "cooked" mode
     struct net_writer sbs_out;                   // SBS-format output
     struct net_writer fatsv_out;                 // FATSV-format output
+    uint8_t net_output_dispatch[NET_OUTPUT_FORMATS]; // formats with clients, see modesQueueOutput
+    int   net_output_dispatch_count;
+    int   net_output_wants_fields;               // does any of them use decoded fields?
+    struct modesMessage *net_output_mm;          // message being output, for client filters
+    struct aircraft *net_output_aircraft;
 
 #ifdef _WIN32
     WSADATA        wsaData;          // Windows socket initialisation
@@ -357,15 +293,23 @@ struct modes_t {                             // Internal state
     char *net_input_beast_ports;     // List of Beast input TCP ports
     char *net_output_beast_ports;    // List of Beast output TCP ports
     char *net_bind_address;          // Bind address
+    char *net_udp_beast;             // host:port to send Beast output datagrams to, or NULL
+    char *net_udp_raw;               // host:port to send raw output datagrams to, or NULL
+    int   net_udp_ttl;               // TTL of multicast datagrams
     int   net_sndbuf_size;           // TCP output buffer size (64Kb * 2^n)
     int   net_verbatim;              // if true, Beast output connections default to verbatim mode
     int   forward_mlat;              // allow forwarding of mlat messages to output ports
+    uint64_t dedup_window;           // Drop identical messages from different inputs within this many ms (0 = off)
+    int   dedup_window_auto;         // --dedup-window not given: use the default window with several receivers
+    int   dedup_sample_clock;        // dedup.c: compare sample timestamps rather than system time (file replay)
     int   quiet;                     // Suppress stdout
     uint32_t show_only;              // Only show messages from this ICAO
     int   interactive;               // Interactive mode
     uint64_t interactive_display_ttl;// Interactive mode: TTL display
     uint64_t stats;                  // Interval (millis) between stats dumps,
     int   stats_range_histo;         // Collect/show a range histogram?
+    int   bench;                     // Report throughput and per-stage CPU when the input ends
+    char *record_path;               // Record raw samples to this file (--record)
     int   onlyaddr;                  // Print only ICAO addresses
     int   metric;                    // Use metric units
     int   use_gnss;                  // Use GNSS altitudes with H suffix ("HAE", though it isn't always) when available
@@ -373,6 +317,9 @@ struct modes_t {                             // Internal state
     char *json_dir;                  // Path to json base directory, or NULL not to write json.
     uint64_t json_interval;          // Interval between rewriting the json aircraft file, in milliseconds; also the advertised map refresh interval
     int   json_location_accuracy;    // Accuracy of location metadata: 0=none, 1=approx, 2=exact
+    char *state_path;                // Snapshot tracker state to this file and restore it on startup, or NULL
+    uint64_t state_interval;         // Interval between tracker state snapshots, in milliseconds
+    char *trace_dir;                 // Append aircraft traces to daily files in this directory, or NULL
 
     int   json_aircraft_history_next;
     struct {
@@ -388,6 +335,7 @@ struct modes_t {                             // Internal state
 
     // State tracking
     struct aircraft *aircrafts;
+    struct aircraft *fatsv_dirty;   // aircraft updated since writeFATSV() last dealt with them
 
     // Statistics
     struct stats stats_current;
@@ -397,209 +345,68 @@ struct modes_t {                             // Internal state
     int stats_latest_1min;
     struct stats stats_5min;
     struct stats stats_15min;
-};
 
-extern struct modes_t Modes;
-
-// The struct we use to store information about a decoded message.
-struct modesMessage {
-    // Generic fields
-    unsigned char msg[MODES_LONG_MSG_BYTES];      // Binary message.
-    unsigned char verbatim[MODES_LONG_MSG_BYTES]; // Binary message, as originally received before correction
-    int           msgbits;                        // Number of bits in message
-    int           msgtype;                        // Downlink format #
-    uint32_t      crc;                            // Message CRC
-    int           correctedbits;                  // No. of bits corrected
-    uint32_t      addr;                           // Address Announced
-    addrtype_t    addrtype;                       // address format / source
-    uint64_t      timestampMsg;                   // Timestamp of the message (12MHz clock)
-    uint64_t      sysTimestampMsg;                // Timestamp of the message (system time)
-    int           remote;                         // If set this message is from a remote station
-    double        signalLevel;                    // RSSI, in the range [0..1], as a fraction of full-scale power
-    int           score;                          // Scoring from scoreModesMessage, if used
-    int           reliable;                       // is this a "reliable" message (uncorrected DF11/DF17/DF18)?
-
-    datasource_t  source;                         // Characterizes the overall message source
-
-    // Raw data, just extracted directly from the message
-    // The names reflect the field names in Annex 4
-    unsigned IID; // extracted from CRC of DF11s
-    unsigned AA;
-    unsigned AC;
-    unsigned CA;
-    unsigned CC;
-    unsigned CF;
-    unsigned DR;
-    unsigned FS;
-    unsigned ID;
-    unsigned KE;
-    unsigned ND;
-    unsigned RI;
-    unsigned SL;
-    unsigned UM;
-    unsigned VS;
-    unsigned char MB[7];
-    unsigned char MD[10];
-    unsigned char ME[7];
-    unsigned char MV[7];
-
-    // Decoded data
-    unsigned altitude_baro_valid : 1;
-    unsigned altitude_geom_valid : 1;
-    unsigned track_valid : 1;
-    unsigned track_rate_valid : 1;
-    unsigned heading_valid : 1;
-    unsigned roll_valid : 1;
-    unsigned gs_valid : 1;
-    unsigned ias_valid : 1;
-    unsigned tas_valid : 1;
-    unsigned mach_valid : 1;
-    unsigned baro_rate_valid : 1;
-    unsigned geom_rate_valid : 1;
-    unsigned squawk_valid : 1;
-    unsigned callsign_valid : 1;
-    unsigned cpr_valid : 1;
-    unsigned cpr_odd : 1;
-    unsigned cpr_decoded : 1;
-    unsigned cpr_relative : 1;
-    unsigned category_valid : 1;
-    unsigned geom_delta_valid : 1;
-    unsigned from_mlat : 1;
-    unsigned from_tisb : 1;
-    unsigned spi_valid : 1;
-    unsigned spi : 1;
-    unsigned alert_valid : 1;
-    unsigned alert : 1;
-    unsigned emergency_valid : 1;
-
-    unsigned metype; // DF17/18 ME type
-    unsigned mesub;  // DF17/18 ME subtype
-
-    commb_format_t commb_format; // Inferred format of a comm-b message
-
-    // valid if altitude_baro_valid:
-    int               altitude_baro;       // Altitude in either feet or meters
-    altitude_unit_t   altitude_baro_unit;  // the unit used for altitude
-
-    // valid if altitude_geom_valid:
-    int               altitude_geom;       // Altitude in either feet or meters
-    altitude_unit_t   altitude_geom_unit;  // the unit used for altitude
-
-    // following fields are valid if the corresponding _valid field is set:
-    int      geom_delta;        // Difference between geometric and baro alt
-    float    heading;           // ground track or heading, degrees (0-359). Reported directly or computed from from EW and NS velocity
-    heading_type_t heading_type;// how to interpret 'track_or_heading'
-    float    track_rate;        // Rate of change of track, degrees/second
-    float    roll;              // Roll, degrees, negative is left roll
-    struct {
-        // Groundspeed, kts, reported directly or computed from from EW and NS velocity
-        // For surface movement, this has different interpretations for v0 and v2; both
-        // fields are populated. The tracking layer will update "gs.selected".
-        float v0;
-        float v2;
-        float selected;
-    } gs;
-    unsigned ias;               // Indicated airspeed, kts
-    unsigned tas;               // True airspeed, kts
-    double   mach;              // Mach number
-    int      baro_rate;         // Rate of change of barometric altitude, feet/minute
-    int      geom_rate;         // Rate of change of geometric (GNSS / INS) altitude, feet/minute
-    unsigned squawk;            // 13 bits identity (Squawk), encoded as 4 hex digits
-    char     callsign[9];       // 8 chars flight number, NUL-terminated
-    unsigned category;          // A0 - D7 encoded as a single hex byte
-    emergency_t emergency;      // emergency/priority status
-
-    // valid if cpr_valid
-    cpr_type_t cpr_type;       // The encoding type used (surface, airborne, coarse TIS-B)
-    unsigned   cpr_lat;        // Non decoded latitude.
-    unsigned   cpr_lon;        // Non decoded longitude.
-    unsigned   cpr_nucp;       // NUCp/NIC value implied by message type
-
-    airground_t airground;     // air/ground state
-
-    // valid if cpr_decoded:
-    double decoded_lat;
-    double decoded_lon;
-    unsigned decoded_nic;
-    unsigned decoded_rc;
-
-    // various integrity/accuracy things
-    struct {
-        unsigned nic_a_valid : 1;
-        unsigned nic_b_valid : 1;
-        unsigned nic_c_valid : 1;
-        unsigned nic_baro_valid : 1;
-        unsigned nac_p_valid : 1;
-        unsigned nac_v_valid : 1;
-        unsigned gva_valid : 1;
-        unsigned sda_valid : 1;
-
-        unsigned nic_a : 1;        // if nic_a_valid
-        unsigned nic_b : 1;        // if nic_b_valid
-        unsigned nic_c : 1;        // if nic_c_valid
-        unsigned nic_baro : 1;     // if nic_baro_valid
-
-        unsigned nac_p : 4;        // if nac_p_valid
-        unsigned nac_v : 3;        // if nac_v_valid
-
-        unsigned sil : 2;          // if sil_type != SIL_INVALID
-        sil_type_t sil_type;
-
-        unsigned gva : 2;          // if gva_valid
-
-        unsigned sda : 2;          // if sda_valid
-    } accuracy;
-
-    // Operational Status
-    struct {
-        unsigned valid : 1;
-        unsigned version : 3;
-
-        unsigned om_acas_ra : 1;
-        unsigned om_ident : 1;
-        unsigned om_atc : 1;
-        unsigned om_saf : 1;
-
-        unsigned cc_acas : 1;
-        unsigned cc_cdti : 1;
-        unsigned cc_1090_in : 1;
-        unsigned cc_arv : 1;
-        unsigned cc_ts : 1;
-        unsigned cc_tc : 2;
-        unsigned cc_uat_in : 1;
-        unsigned cc_poa : 1;
-        unsigned cc_b2_low : 1;
-        unsigned cc_lw_valid : 1;
-
-        heading_type_t tah;
-        heading_type_t hrd;
-
-        unsigned cc_lw;
-        unsigned cc_antenna_offset;
-    } opstatus;
-
-    // combined:
-    //   Target State & Status (ADS-B V2 only)
-    //   Comm-B BDS4,0 Vertical Intent
-    struct {
-        unsigned heading_valid : 1;
-        unsigned fms_altitude_valid : 1;
-        unsigned mcp_altitude_valid : 1;
-        unsigned qnh_valid : 1;
-        unsigned modes_valid : 1;
-
-        float    heading;       // heading, degrees (0-359) (could be magnetic or true heading; magnetic recommended)
-        heading_type_t heading_type;
-        unsigned fms_altitude;  // FMS selected altitude
-        unsigned mcp_altitude;  // MCP/FCU selected altitude
-        float    qnh;           // altimeter setting (QFE or QNH/QNE), millibars
-
-        nav_altitude_source_t altitude_source;
-
-        nav_modes_t modes;
-    } nav;
+    // Per-instance state of the decoding modules
+    struct icao_filter_table icao_filter_exact;   // icao_filter.c: recently seen addresses
+    struct icao_filter_table icao_filter_partial; // the same, keyed on the low 16 bits
+    uint32_t        icao_filter_epoch;   // current icao_filter.c epoch (seconds)
+    struct dedup_entry *dedup_table;     // dedup.c: recently seen messages
+    struct commb_cache_entry *commb_cache; // comm_b.c: recent Comm-B replies per aircraft
+    uint32_t        modeAC_count[4096];  // track.c: Mode A/C replies seen per code
+    uint32_t        modeAC_lastcount[4096];
+    uint32_t        modeAC_match[4096];
+    uint32_t        modeAC_age[4096];
+    uint64_t        message_now;         // Time of the message being processed, see messageNow()
+
+    // Decoded message sink
+    modesMessageSinkFn message_sink;
+    modesBatchSinkFn batch_sink;
+    void           *sink_udata;
+    struct modesMessage *sink_batch;     // batch mode: messages held until the end of the block
+    struct aircraft **sink_batch_aircraft;
+    size_t          sink_batch_count;
+    size_t          sink_batch_size;
+
+    // Periodic work timers
+    uint64_t        next_icao_filter_sweep;
+    uint64_t        next_track_update;
+    uint64_t        next_stats_display;
+    uint64_t        next_stats_update;
+    uint64_t        next_json;
+    uint64_t        next_history;
+    uint64_t        next_state;
+    uint64_t        next_trace_flush;
+    uint64_t        next_trace_retry;    // when to try again after the trace file could not be opened or written
+
+    // trace.c: the open --write-trace file
+    int             trace_fd;
+    uint64_t        trace_day;           // UTC day (days since the epoch) of the open file
+    uint64_t        trace_base;          // base time of the current segment
+    uint8_t        *trace_buf;
+    size_t          trace_buf_used;
+
+    // net_io.c: FATSV output
+    uint64_t        next_fatsv_update;
+    float           fatsv_last_lat, fatsv_last_lon, fatsv_last_alt;  // receiver location last sent
 };
 
+// The decoder instance the calling thread works on. Every thread starts out
+// on modesDefault, the instance the dump1090 program uses; lib1090 contexts
+// rebind it with modesSetCurrent() so that independent decoders can run on
+// separate threads of one process.
+extern struct modes_t modesDefault;
+extern _Thread_local struct modes_t *modesCurrent;
+#define Modes (*modesCurrent)
+
+struct modes_t *modesSetCurrent(struct modes_t *modes);
+struct modes_t *modesNewInstance(void);
+void modesFreeInstance(struct modes_t *modes);
+
+/* Returns the time for the current message we're dealing with */
+static inline uint64_t messageNow() {
+    return Modes.message_now;
+}
+
 // This one needs modesMessage:
 #include "track.h"
 #include "mode_s.h"
@@ -643,6 +450,7 @@ void view1090Init(void);
 
 void modesInitConfig(void);
 void modesInit(void);
+void modesInitFramesOnly(void);
 void modesInitStats(void);
 void *readerThreadEntryPoint(void *arg);
 void snipMode(int level);
@@ -652,6 +460,7 @@ void backgroundTasks(void);
 int dump1090main(int argc, char **argv);
 int faup1090main(int argc, char **argv);
 int view1090main(int argc, char **argv);
+int trace1090main(int argc, char **argv);
 
 #ifdef __cplusplus
 }
@@ -116,6 +116,7 @@ static void showHelp(void) {
             "-----------------------------------------------------------------------------\n"
             "--net-bo-ipaddr <addr>   IP address to connect to for Beast data (default: 127.0.0.1)\n"
             "--net-bo-port <port>     Port to connect for Beast data (default: 30005)\n"
+            "--net-bo-compress        Ask for the Beast data to be compressed\n"
             "--lat <latitude>         Reference/receiver latitude for surface posn (opt)\n"
             "--lon <longitude>        Reference/receiver longitude for surface posn (opt)\n"
             "--stdout                 REQUIRED. Write results to stdout.\n"
@@ -146,6 +147,7 @@ int faup1090main(int argc, char **argv) {
     int stdout_option = 0;
     char *bo_connect_ipaddr = "127.0.0.1";
     int bo_connect_port = 30005;
+    int bo_compress = 0;
     struct client *c;
     struct net_service *beast_input, *fatsv_output;
 
@@ -160,6 +162,8 @@ int faup1090main(int argc, char **argv) {
             bo_connect_port = atoi(argv[++j]);
         } else if (!strcmp(argv[j],"--net-bo-ipaddr") && more) {
             bo_connect_ipaddr = argv[++j];
+        } else if (!strcmp(argv[j],"--net-bo-compress")) {
+            bo_compress = 1;
         } else if (!strcmp(argv[j],"--lat") && more) {
             Modes.fUserLat = atof(argv[++j]);
         } else if (!strcmp(argv[j],"--lon") && more) {
@@ -200,6 +204,8 @@ int faup1090main(int argc, char **argv) {
     }
 
     sendBeastSettings(c, "CdfjV"); // Beast binary, no filters, CRC checks on, no mode A/C, verbatim mode on
+    if (bo_compress)
+        requestBeastCompression(c);
 
     // Set up output connection on stdout
     fatsv_output = makeFatsvOutputService();
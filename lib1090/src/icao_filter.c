@@ -19,21 +19,23 @@
 
 #include "dump1090.h"
 
-// hash table size, must be a power of two:
-#define ICAO_FILTER_SIZE 4096
+// Millis between sweeps that drop expired entries (and shrink the tables):
+#define MODES_ICAO_FILTER_SWEEP 60000
 
-// Millis between filter expiry flips:
-#define MODES_ICAO_FILTER_TTL 60000
-
-// Open-addressed hash table with linear probing.
-// We store each address twice to handle Data/Parity
-// which need to match on a partial address (top 16 bits only).
-
-// Maintain two tables and switch between them to age out entries.
-
-static uint32_t icao_filter_a[ICAO_FILTER_SIZE];
-static uint32_t icao_filter_b[ICAO_FILTER_SIZE];
-static uint32_t *icao_filter_active;
+// Open-addressed hash tables probed a group of slots at a time.
+// Each address is stored twice: once keyed on the whole address and once
+// keyed on the low 16 bits only, to handle Data/Parity which need to match
+// on a partial address.
+//
+// Every slot records the epoch (in seconds) the address was last seen, so
+// entries expire individually. Expired slots are reused by later inserts and
+// dropped by the periodic sweep; tables grow when they fill up.
+// The tables belong to the current decoder instance (Modes.icao_filter_*).
+//
+// The partial table holds one address per low 16 bits: adding an address
+// replaces any other with the same low 16 bits, so icaoFilterTestFuzzy
+// returns the most recently added one. (The old table kept the first one
+// added instead, plus possibly another in its second generation.)
 
 static uint32_t icaoHash(uint32_t a)
 {
@@ -56,108 +58,209 @@ static uint32_t icaoHash(uint32_t a)
     hash ^= (hash >> 11);
     hash += (hash << 15);
 
-    return hash & (ICAO_FILTER_SIZE-1);
+    return hash;
 }
 
-void icaoFilterInit()
+static void tableAlloc(struct icao_filter_table *t, uint32_t size)
 {
-    memset(icao_filter_a, 0, sizeof(icao_filter_a));
-    memset(icao_filter_b, 0, sizeof(icao_filter_b));
-    icao_filter_active = icao_filter_a;
+    t->addr = calloc(size, sizeof(uint32_t));
+    t->seen = malloc(size * sizeof(uint32_t));
+    if (!t->addr || !t->seen) {
+        fprintf(stderr, "icao_filter: out of memory\n");
+        exit(1);
+    }
+    t->size = size;
+    t->used = 0;
 }
 
-void icaoFilterAdd(uint32_t addr)
+static void tableFree(struct icao_filter_table *t)
 {
-    uint32_t h, h0;
-    h0 = h = icaoHash(addr);
-    while (icao_filter_active[h] && icao_filter_active[h] != addr) {
-        h = (h+1) & (ICAO_FILTER_SIZE-1);
-        if (h == h0) {
-            fprintf(stderr, "ICAO hash table full, increase ICAO_FILTER_SIZE\n");
-            return;
-        }
-    }
-    if (!icao_filter_active[h])
-        icao_filter_active[h] = addr;
-
-    // also add with a zeroed top byte, for handling DF20/21 with Data Parity
-    h0 = h = icaoHash(addr & 0x00ffff);
-    while (icao_filter_active[h] && (icao_filter_active[h] & 0x00ffff) != (addr & 0x00ffff)) {
-        h = (h+1) & (ICAO_FILTER_SIZE-1);
-        if (h == h0) {
-            fprintf(stderr, "ICAO hash table full, increase ICAO_FILTER_SIZE\n");
-            return;
+    free(t->addr);
+    free(t->seen);
+    t->addr = t->seen = NULL;
+    t->size = t->used = 0;
+}
+
+static void tableRebuild(struct icao_filter_table *t, uint32_t mask, uint32_t min_seen);
+
+// Oldest epoch that is still live
+static inline uint32_t minSeen()
+{
+    return Modes.icao_filter_epoch - MODES_ICAO_FILTER_TTL / 1000;
+}
+
+// Returns the live address matching 'key' under 'mask', or 0
+static uint32_t tableLookup(const struct icao_filter_table *t, uint32_t key, uint32_t mask, uint32_t min_seen)
+{
+    uint32_t g = icaoHash(key) & (t->size - 1) & ~(ICAO_FILTER_GROUP - 1);
+
+    for (uint32_t n = 0; n < t->size; n += ICAO_FILTER_GROUP) {
+        unsigned empty;
+        unsigned match = icaoGroupMatch(&t->addr[g], key, mask, &empty);
+        while (match) {
+            unsigned i = __builtin_ctz(match);
+            if ((int32_t) (t->seen[g + i] - min_seen) >= 0)
+                return t->addr[g + i];
+            match &= match - 1;
         }
+        if (empty)
+            return 0;
+        g = (g + ICAO_FILTER_GROUP) & (t->size - 1);
     }
-    if (!icao_filter_active[h])
-        icao_filter_active[h] = addr;
+    return 0;
 }
 
-int icaoFilterTest(uint32_t addr)
+// Insert 'addr' keyed on (addr & mask), or refresh the existing entry
+static void tableInsert(struct icao_filter_table *t, uint32_t addr, uint32_t mask, uint32_t epoch, uint32_t min_seen)
 {
-    uint32_t h, h0;
+    uint32_t key = addr & mask;
+    uint32_t g = icaoHash(key) & (t->size - 1) & ~(ICAO_FILTER_GROUP - 1);
+    uint32_t *slot = NULL;
+    uint32_t slot_index = 0;
 
-    h0 = h = icaoHash(addr);
-    while (icao_filter_a[h] && icao_filter_a[h] != addr) {
-        h = (h+1) & (ICAO_FILTER_SIZE-1);
-        if (h == h0)
+    for (uint32_t n = 0; n < t->size; n += ICAO_FILTER_GROUP) {
+        unsigned empty;
+        unsigned match = icaoGroupMatch(&t->addr[g], key, mask, &empty);
+        if (match) {
+            unsigned i = __builtin_ctz(match);
+            t->addr[g + i] = addr;
+            t->seen[g + i] = epoch;
+            return;
+        }
+
+        if (!slot) {
+            // reuse the first expired slot on the probe sequence
+            for (unsigned i = 0; i < ICAO_FILTER_GROUP; ++i) {
+                if (t->addr[g + i] && (int32_t) (t->seen[g + i] - min_seen) < 0) {
+                    slot = &t->addr[g + i];
+                    slot_index = g + i;
+                    break;
+                }
+            }
+        }
+
+        if (empty) {
+            if (!slot) {
+                slot_index = g + __builtin_ctz(empty);
+                slot = &t->addr[slot_index];
+                ++t->used;
+            }
             break;
+        }
+        g = (g + ICAO_FILTER_GROUP) & (t->size - 1);
     }
-    if (icao_filter_a[h] == addr)
-        return 1;
 
-    h = h0;
-    while (icao_filter_b[h] && icao_filter_b[h] != addr) {
-        h = (h+1) & (ICAO_FILTER_SIZE-1);
-        if (h == h0)
-            break;
+    if (!slot) {
+        // every slot is live; grow and try again
+        tableRebuild(t, mask, min_seen);
+        tableInsert(t, addr, mask, epoch, min_seen);
+        return;
     }
-    if (icao_filter_b[h] == addr)
-        return 1;
 
-    return 0;
+    *slot = addr;
+    t->seen[slot_index] = epoch;
+
+    // keep at least a quarter of the slots empty so probe sequences stay short
+    if (t->used > t->size / 4 * 3)
+        tableRebuild(t, mask, min_seen);
 }
 
-uint32_t icaoFilterTestFuzzy(uint32_t partial)
+// Rehash the live entries into a table sized for them, dropping expired ones
+static void tableRebuild(struct icao_filter_table *t, uint32_t mask, uint32_t min_seen)
 {
-    uint32_t h, h0;
+    uint32_t live = 0;
+    for (uint32_t i = 0; i < t->size; ++i) {
+        if (t->addr[i] && (int32_t) (t->seen[i] - min_seen) >= 0)
+            ++live;
+    }
 
-    partial &= 0x00ffff;
-    h0 = h = icaoHash(partial);
-    while (icao_filter_a[h] && (icao_filter_a[h] & 0x00ffff) != partial) {
-        h = (h+1) & (ICAO_FILTER_SIZE-1);
-        if (h == h0)
-            break;
+    uint32_t size = ICAO_FILTER_MIN_SIZE;
+    while (live > size / 2)
+        size *= 2;
+
+    struct icao_filter_table old = *t;
+    tableAlloc(t, size);
+    for (uint32_t i = 0; i < old.size; ++i) {
+        if (old.addr[i] && (int32_t) (old.seen[i] - min_seen) >= 0)
+            tableInsert(t, old.addr[i], mask, old.seen[i], min_seen);
     }
-    if ((icao_filter_a[h] & 0x00ffff) == partial)
-        return icao_filter_a[h];
+    tableFree(&old);
+}
 
-    h = h0;
-    while (icao_filter_b[h] && (icao_filter_b[h] & 0x00ffff) != partial) {
-        h = (h+1) & (ICAO_FILTER_SIZE-1);
-        if (h == h0)
-            break;
+void icaoFilterInit()
+{
+    tableFree(&Modes.icao_filter_exact);
+    tableFree(&Modes.icao_filter_partial);
+    tableAlloc(&Modes.icao_filter_exact, ICAO_FILTER_MIN_SIZE);
+    tableAlloc(&Modes.icao_filter_partial, ICAO_FILTER_MIN_SIZE);
+
+    uint64_t now = mstime();
+    Modes.icao_filter_epoch = (uint32_t) (now / 1000);
+    Modes.next_icao_filter_sweep = now + MODES_ICAO_FILTER_SWEEP;
+}
+
+void icaoFilterFree()
+{
+    tableFree(&Modes.icao_filter_exact);
+    tableFree(&Modes.icao_filter_partial);
+}
+
+void icaoFilterAdd(uint32_t addr)
+{
+    if (!addr)
+        return;
+
+    uint32_t min_seen = minSeen();
+    tableInsert(&Modes.icao_filter_exact, addr, 0xffffffff, Modes.icao_filter_epoch, min_seen);
+
+    // also add keyed on the low 16 bits, for handling DF20/21 with Data Parity
+    tableInsert(&Modes.icao_filter_partial, addr, 0x00ffff, Modes.icao_filter_epoch, min_seen);
+}
+
+void icaoFilterAddSeen(uint32_t addr, uint32_t seen)
+{
+    uint32_t min_seen = minSeen();
+    if (!addr || (int32_t) (seen - min_seen) < 0)
+        return;
+
+    tableInsert(&Modes.icao_filter_exact, addr, 0xffffffff, seen, min_seen);
+    tableInsert(&Modes.icao_filter_partial, addr, 0x00ffff, seen, min_seen);
+}
+
+void icaoFilterForEach(void (*visit)(uint32_t addr, uint32_t seen, void *udata), void *udata)
+{
+    const struct icao_filter_table *t = &Modes.icao_filter_exact;
+    uint32_t min_seen = minSeen();
+
+    for (uint32_t i = 0; i < t->size; ++i) {
+        if (t->addr[i] && (int32_t) (t->seen[i] - min_seen) >= 0)
+            visit(t->addr[i], t->seen[i], udata);
     }
-    if ((icao_filter_b[h] & 0x00ffff) == partial)
-        return icao_filter_b[h];
+}
 
-    return 0;
+int icaoFilterTest(uint32_t addr)
+{
+    if (!addr)
+        return 0;
+    return tableLookup(&Modes.icao_filter_exact, addr, 0xffffffff, minSeen()) != 0;
+}
+
+uint32_t icaoFilterTestFuzzy(uint32_t partial)
+{
+    return tableLookup(&Modes.icao_filter_partial, partial & 0x00ffff, 0x00ffff, minSeen());
 }
 
 // call this periodically:
 void icaoFilterExpire()
 {
-    static uint64_t next_flip = 0;
     uint64_t now = mstime();
 
-    if (now >= next_flip) {
-        if (icao_filter_active == icao_filter_a) {
-            memset(icao_filter_b, 0, sizeof(icao_filter_b));
-            icao_filter_active = icao_filter_b;
-        } else {
-            memset(icao_filter_a, 0, sizeof(icao_filter_a));
-            icao_filter_active = icao_filter_a;
-        }
-        next_flip = now + MODES_ICAO_FILTER_TTL;
+    Modes.icao_filter_epoch = (uint32_t) (now / 1000);
+
+    if (now >= Modes.next_icao_filter_sweep) {
+        uint32_t min_seen = minSeen();
+        tableRebuild(&Modes.icao_filter_exact, 0xffffffff, min_seen);
+        tableRebuild(&Modes.icao_filter_partial, 0x00ffff, min_seen);
+        Modes.next_icao_filter_sweep = now + MODES_ICAO_FILTER_SWEEP;
     }
 }
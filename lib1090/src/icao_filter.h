@@ -20,8 +20,72 @@
 #ifndef DUMP1090_ICAO_FILTER_H
 #define DUMP1090_ICAO_FILTER_H
 
-// Call once:
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Initial (and minimum) table size, must be a power of two
+// and a multiple of ICAO_FILTER_GROUP:
+#define ICAO_FILTER_MIN_SIZE 4096
+
+// Slots compared at once while probing
+#define ICAO_FILTER_GROUP 4
+
+// Millis an address stays in the filter after it was last seen:
+#define MODES_ICAO_FILTER_TTL 60000
+
+// One hash table of recently seen addresses (see icao_filter.c)
+struct icao_filter_table {
+    uint32_t *addr;     // address in each slot, 0 if unused
+    uint32_t *seen;     // epoch (seconds) each address was last seen
+    uint32_t size;      // number of slots, a power of two
+    uint32_t used;      // slots in use, including expired ones
+};
+
+// Compare the ICAO_FILTER_GROUP slots at 'slots' against 'key' under 'mask'.
+// Returns a bitmask of matching slots; *empty gets a bitmask of unused slots.
+// The scalar version is what the vector ones must agree with.
+static inline unsigned icaoGroupMatchScalar(const uint32_t *slots, uint32_t key, uint32_t mask, unsigned *empty)
+{
+    unsigned match = 0;
+    *empty = 0;
+    for (unsigned i = 0; i < ICAO_FILTER_GROUP; ++i) {
+        if (!slots[i])
+            *empty |= 1 << i;
+        else if ((slots[i] & mask) == key)
+            match |= 1 << i;
+    }
+    return match;
+}
+
+static inline unsigned icaoGroupMatch(const uint32_t *slots, uint32_t key, uint32_t mask, unsigned *empty)
+{
+#if defined(__SSE2__)
+    __m128i v = _mm_loadu_si128((const __m128i *) slots);
+    __m128i eq = _mm_cmpeq_epi32(_mm_and_si128(v, _mm_set1_epi32(mask)), _mm_set1_epi32(key));
+    __m128i zero = _mm_cmpeq_epi32(v, _mm_setzero_si128());
+    *empty = _mm_movemask_ps(_mm_castsi128_ps(zero));
+    return _mm_movemask_ps(_mm_castsi128_ps(eq)) & ~*empty;
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    static const uint32_t bits[4] = { 1, 2, 4, 8 };
+    uint32x4_t v = vld1q_u32(slots);
+    uint32x4_t b = vld1q_u32(bits);
+    uint32x4_t eq = vceqq_u32(vandq_u32(v, vdupq_n_u32(mask)), vdupq_n_u32(key));
+    uint32x4_t zero = vceqzq_u32(v);
+    *empty = vaddvq_u32(vandq_u32(zero, b));
+    return vaddvq_u32(vandq_u32(eq, b)) & ~*empty;
+#else
+    return icaoGroupMatchScalar(slots, key, mask, empty);
+#endif
+}
+
+// Call once per decoder instance:
 void icaoFilterInit();
+void icaoFilterFree();
 
 // Add an address to the filter
 void icaoFilterAdd(uint32_t addr);
@@ -29,8 +93,8 @@ void icaoFilterAdd(uint32_t addr);
 // Test if the given address matches the filter
 int icaoFilterTest(uint32_t addr);
 
-// Test if the top 16 bits match any previously added address.
-// If they do, returns an arbitrary one of the matched
+// Test if the low 16 bits match any previously added address.
+// If they do, returns the most recently added of the matched
 // addresses. Returns 0 on failure.
 uint32_t icaoFilterTestFuzzy(uint32_t partial);
 
@@ -38,4 +102,9 @@ uint32_t icaoFilterTestFuzzy(uint32_t partial);
 // old entries.
 void icaoFilterExpire();
 
+// Snapshot support (state.c): visit every live address with the epoch it
+// was last seen, and put such an address back (ignored if already expired)
+void icaoFilterForEach(void (*visit)(uint32_t addr, uint32_t seen, void *udata), void *udata);
+void icaoFilterAddSeen(uint32_t addr, uint32_t seen);
+
 #endif
@@ -191,7 +191,7 @@ void interactiveShowData(void) {
 
     if (Modes.mode_ac) {
         for (unsigned i = 1; i < 4096 && row < rows; ++i) {
-            if (modeAC_match[i] || modeAC_count[i] < 50 || modeAC_age[i] > 5)
+            if (Modes.modeAC_match[i] || Modes.modeAC_count[i] < 50 || Modes.modeAC_age[i] > 5)
                 continue;
 
             char strMode[5] = "  A ";
@@ -215,8 +215,8 @@ void interactiveShowData(void) {
                      "",    /* lat */
                      "",    /* lon */
                      "",    /* signal */
-                     modeAC_count[i], /* messages */
-                     modeAC_age[i]);  /* age */
+                     Modes.modeAC_count[i], /* messages */
+                     Modes.modeAC_age[i]);  /* age */
             ++row;
         }
     }
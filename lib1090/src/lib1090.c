@@ -52,17 +52,33 @@
 //   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 //   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
-#include "ais_charset.h"
+#include "dump1090.h"
 #include "lib1090.h"
 #include <pthread.h>
 #include <math.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 
-static struct lib1090Config_t lib1090Config = {
-    NULL, NULL, NULL, { 0, 0 }, NULL, 0, 0, 4000000, NULL
+// Beast messages gathered into one writev() by lib1090HandleFrames
+#define LIB1090_BATCH_IOV 256
+
+static struct lib1090Config_t lib1090DefaultConfig = {
+    NULL, NULL, NULL, { 0, 0 }, NULL, -1, 0, 4000000, NULL, 0
 };
 
+// Configuration of the context bound to this thread, see lib1090BindContext
+static _Thread_local struct lib1090Config_t *lib1090CurrentConfig = &lib1090DefaultConfig;
+#define lib1090Config (*lib1090CurrentConfig)
+
+struct lib1090Context {
+    struct modes_t *modes;
+    struct lib1090Config_t config;
+};
+
+// Context bound to this thread, or NULL for the process-wide default
+static _Thread_local struct lib1090Context *lib1090CurrentContext;
+
 void lib1090GetConfig(struct lib1090Config_t **configOut) {
     if (configOut != NULL) {
         *configOut = &lib1090Config;
@@ -80,10 +96,11 @@ static void signalHandler(int dummy) {
     lib1090Uninit();
 }
 
-static int __lib1090InitThread() {
+// Configure and initialize the currently bound decoder instance
+static int __lib1090InitInstance(bool net) {
     modesInitConfig();
 
-    Modes.net = 1;
+    Modes.net = net;
     Modes.sdr_type = SDR_NONE;
     if (lib1090Config.userLat != NULL) {
         Modes.fUserLat = atof(lib1090Config.userLat);
@@ -91,10 +108,7 @@ static int __lib1090InitThread() {
     if (lib1090Config.userLon != NULL) {
         Modes.fUserLon = atof(lib1090Config.userLon);
     }
-    if (lib1090Config.userAltMeters != NULL) {
-        Modes.fUserAltM = atof(lib1090Config.userAltMeters);
-    }
-    Modes.json_dir = "/tmp/piaware";
+    Modes.json_dir = (char *) lib1090Config.jsonDir;
     Modes.mode_ac = 1;
     Modes.mode_ac_auto = 0;
     Modes.dc_filter = 1;
@@ -108,8 +122,10 @@ static int __lib1090InitThread() {
     Modes.net_verbatim = 0;
     //Modes.sample_rate = 4000000.0;
 
-    modesInit();
-    modesInitNet();
+    modesInitFramesOnly();  // lib1090 is handed frames, never samples
+    if (net) {
+        modesInitNet();
+    }
     modesInitStats();
 
     if (lib1090Config.beastOutPipeName != NULL) {
@@ -123,6 +139,13 @@ static int __lib1090InitThread() {
     return 0;
 }
 
+static int __lib1090InitThread() {
+    if (lib1090Config.jsonDir == NULL) {
+        lib1090Config.jsonDir = "/tmp/piaware";
+    }
+    return __lib1090InitInstance(true);
+}
+
 int lib1090Init() {
     return 0;
 }
@@ -165,6 +188,7 @@ static void __lib1090MainLoop() {
 }
 
 static void* __lib1090RunThread(void* pparam) {
+    modesSetCurrent((struct modes_t *) pparam);
     __lib1090MainLoop();
     return NULL;
 }
@@ -172,24 +196,23 @@ static void* __lib1090RunThread(void* pparam) {
 // will return -EBUSY if the thread is already running
 // ( <0 indicating it was an error returned by ME and not the pthread library)
 int lib1090RunThread(void *udata) {
-    if (Modes.reader_thread != 0) {
+    MODES_NOTUSED(udata);
+    if (Modes.lib1090_thread != 0) {
         return -EBUSY;
     }
     int err = __lib1090InitThread();
     if (err != 0) {
         return err;
     }
-    if (udata == NULL) {
-        udata = __builtin_return_address(0);
-    }
     signal(SIGINT, signalHandler);
     signal(SIGTERM, signalHandler);
-    return pthread_create(&Modes.reader_thread, NULL, __lib1090RunThread, udata);
+    // the loop runs on the instance bound here
+    return pthread_create(&Modes.lib1090_thread, NULL, __lib1090RunThread, &Modes);
 }
 
 int lib1090JoinThread(void **retptr) {
     // thread already joined or never created
-    if (Modes.reader_thread == 0) {
+    if (Modes.lib1090_thread == 0) {
         return 0;
     }
     void *dummy;
@@ -200,15 +223,17 @@ int lib1090JoinThread(void **retptr) {
     Modes.exit = 1;
     pthread_cond_signal(&Modes.data_cond);
     pthread_mutex_unlock(&Modes.data_mutex);
-    int status = pthread_join(Modes.reader_thread, retptr);
+    int status = pthread_join(Modes.lib1090_thread, retptr);
     if (status != 0) {
         return status;
     }
-    Modes.reader_thread = 0;
+    Modes.lib1090_thread = 0;
     pthread_cond_destroy(&Modes.data_cond);
     pthread_mutex_destroy(&Modes.data_mutex);
-    close(lib1090Config.pipefd);
-    lib1090Config.pipefd = 0;
+    if (lib1090Config.pipefd >= 0) {
+        close(lib1090Config.pipefd);
+    }
+    lib1090Config.pipefd = -1;
     return status;
 }
 
@@ -250,19 +275,11 @@ int lib1090FixupFrame(uint8_t *frameIn, uint8_t *frameOut) { // check crc, fix i
 
 ssize_t lib1090DecodeFrame(struct modesMessage *mm, uint8_t *frame, uint64_t timestamp, double signalLevel) {
     // Decode the received message
-    memset(mm, '\0', sizeof(struct modesMessage));
+    modesInitMessage(mm);
 
     // For consistency with how the Beast / Radarcape does it,
     // we report the timestamp at the end of bit 56 (even if
     // the frame is a 112-bit frame)
-    struct timespec tp;
-    clock_gettime(CLOCK_REALTIME, &tp);
-    /*mm->timestampMsg = tp.tv_nsec + receiveclock_ns_elapsed(0, 56); // + j*5 + (8 + 56) * 12 + bestphase; /// these magic numbers//// 12 because of 12MHz... i dunno wtf
-
-     // compute message receive time as block-start-time + difference in the 12MHz clock
-     mm->sysTimestampMsg = mm->timestampMsg + receiveclock_ms_elapsed(timestamp, mm->timestampMsg); // idk
-     */
-
     mm->timestampMsg = timestamp + 56*12; //j*5 + (8 + 56) * 12 + bestphase;
 
     // compute message receive time as block-start-time + difference in the 12MHz clock
@@ -309,8 +326,11 @@ ssize_t lib1090DecodeFrame(struct modesMessage *mm, uint8_t *frame, uint64_t tim
         // log something?
     }
 
-    displayModesMessage(mm);
+    if (!lib1090Config.quiet) {
+        displayModesMessage(mm);
+    }
     modesQueueOutput(mm, a);
+    modesSinkMessage(mm, a);
 
     return 0;
 }
@@ -330,6 +350,223 @@ ssize_t lib1090FormatBeast(struct modesMessage *mm, uint8_t *beastBufferOut, siz
     return msgLen;
 }
 
+static ssize_t writeBeastBatch(struct iovec *iov, int iovcnt, size_t total) {
+    const ssize_t written = writev(lib1090Config.pipefd, iov, iovcnt);
+    if (written < 0 || (size_t) written != total) {
+        fprintf(stderr, "writev returned error %d while writing beast messages to pipe\n", errno);
+        return -1;
+    }
+    return written;
+}
+
+// Fix up, decode and track 'count' frames. With writeToPipe, the Beast output
+// for all of them goes to the pipe with one writev() per LIB1090_BATCH_IOV
+// messages; without it, no Beast output is formatted at all.
+// mms must have room for 'count' messages; if status is not NULL, status[i]
+// receives the lib1090DecodeFrame result for frame i (or -2 if its CRC could
+// not be repaired). Returns the number of messages accepted (with writeToPipe,
+// written), or -1 if there is no pipe or writing to it failed; with no pipe,
+// nothing is decoded.
+ssize_t lib1090HandleFrames(struct modesMessage *mms, const struct lib1090Frame *frames, size_t count, int *status, bool writeToPipe) {
+    uint8_t beast[LIB1090_BATCH_IOV][MAX_BEAST_MSG_LEN];
+    struct iovec iov[LIB1090_BATCH_IOV];
+    int iovcnt = 0;
+    size_t pending = 0;
+    ssize_t produced = 0;
+
+    if (writeToPipe && lib1090Config.pipefd < 0) {
+        fprintf(stderr, "lib1090HandleFrames: no Beast output pipe (see beastOutPipeName)\n");
+        errno = EBADF;
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t frameOut[MAX_BEAST_MSG_LEN];
+        ssize_t res = lib1090FixupFrame(frames[i].frame, frameOut);
+        if (res != -1) {
+            res = lib1090DecodeFrame(&mms[i], frameOut, frames[i].timestamp, frames[i].signalLevel > 0 ? frames[i].signalLevel : _3dBFS);
+        } else {
+            res = -2;
+        }
+        if (status != NULL) {
+            status[i] = res;
+        }
+        if (res == -2) {
+            continue;
+        }
+        if (!writeToPipe) {
+            ++produced;
+            continue;
+        }
+
+        const ssize_t msgLen = formatBeastMessage(&mms[i], beast[iovcnt], MAX_BEAST_MSG_LEN);
+        if (msgLen <= 0) {
+            fprintf(stderr, "formatBeastMessage returned error %zd\n", msgLen);
+            continue;
+        }
+        ++produced;
+
+        iov[iovcnt].iov_base = beast[iovcnt];
+        iov[iovcnt].iov_len = msgLen;
+        pending += msgLen;
+        if (++iovcnt == LIB1090_BATCH_IOV) {
+            if (writeBeastBatch(iov, iovcnt, pending) < 0) {
+                return -1;
+            }
+            iovcnt = 0;
+            pending = 0;
+        }
+    }
+
+    modesFlushSink();
+    if (iovcnt > 0 && writeBeastBatch(iov, iovcnt, pending) < 0) {
+        return -1;
+    }
+    return produced;
+}
+
+// Create an independent decoder instance. 'config' (may be NULL) is copied;
+// jsonDir defaults to NULL here, so contexts do not write JSON unless asked.
+struct lib1090Context *lib1090CreateContext(const struct lib1090Config_t *config) {
+    struct lib1090Context *ctx = calloc(1, sizeof(*ctx));
+    if (ctx == NULL) {
+        return NULL;
+    }
+    if (config != NULL) {
+        ctx->config = *config;
+    }
+    ctx->config.pipefd = -1;
+    ctx->modes = modesNewInstance();
+
+    struct lib1090Context *previous = lib1090BindContext(ctx);
+    int err = __lib1090InitInstance(false);
+    lib1090BindContext(previous);
+    if (err != 0) {
+        lib1090FreeContext(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+void lib1090FreeContext(struct lib1090Context *ctx) {
+    if (ctx == NULL) {
+        return;
+    }
+    if (lib1090CurrentContext == ctx) {
+        lib1090BindContext(NULL);
+    }
+    if (ctx->config.pipefd >= 0) {
+        close(ctx->config.pipefd);
+    }
+    modesFreeInstance(ctx->modes);
+    free(ctx);
+}
+
+// Make the calling thread use 'ctx' (NULL: the process-wide default) for all
+// following lib1090 calls. Returns the previously bound context.
+struct lib1090Context *lib1090BindContext(struct lib1090Context *ctx) {
+    struct lib1090Context *previous = lib1090CurrentContext;
+    lib1090CurrentContext = ctx;
+    if (ctx != NULL) {
+        modesSetCurrent(ctx->modes);
+        lib1090CurrentConfig = &ctx->config;
+    } else {
+        modesSetCurrent(&modesDefault);
+        lib1090CurrentConfig = &lib1090DefaultConfig;
+    }
+    return previous;
+}
+
+// Expire aircraft and filter entries and roll the statistics over; call a few
+// times a second, as the lib1090RunThread main loop does for the default instance.
+void lib1090CtxPeriodicWork(struct lib1090Context *ctx) {
+    struct lib1090Context *previous = lib1090BindContext(ctx);
+    backgroundTasks();
+    lib1090BindContext(previous);
+}
+
+ssize_t lib1090CtxHandleFrame(struct lib1090Context *ctx, struct modesMessage *mm, uint8_t *frm, uint64_t timestamp) {
+    struct lib1090Context *previous = lib1090BindContext(ctx);
+    ssize_t res = lib1090HandleFrame(mm, frm, timestamp);
+    lib1090BindContext(previous);
+    return res;
+}
+
+ssize_t lib1090CtxDecodeFrame(struct lib1090Context *ctx, struct modesMessage *mm, uint8_t *frame, uint64_t timestamp, double signalLevel) {
+    struct lib1090Context *previous = lib1090BindContext(ctx);
+    ssize_t res = lib1090DecodeFrame(mm, frame, timestamp, signalLevel);
+    lib1090BindContext(previous);
+    return res;
+}
+
+ssize_t lib1090CtxHandleFrames(struct lib1090Context *ctx, struct modesMessage *mms, const struct lib1090Frame *frames, size_t count, int *status, bool writeToPipe) {
+    struct lib1090Context *previous = lib1090BindContext(ctx);
+    ssize_t res = lib1090HandleFrames(mms, frames, count, status, writeToPipe);
+    lib1090BindContext(previous);
+    return res;
+}
+
+void lib1090SetMessageCallback(struct lib1090Context *ctx, modesMessageSinkFn fn, void *udata) {
+    struct lib1090Context *previous = lib1090BindContext(ctx);
+    modesSetMessageSink(fn, udata);
+    lib1090BindContext(previous);
+}
+
+void lib1090SetBatchCallback(struct lib1090Context *ctx, modesBatchSinkFn fn, void *udata, size_t max_batch) {
+    struct lib1090Context *previous = lib1090BindContext(ctx);
+    modesSetBatchSink(fn, udata, max_batch);
+    lib1090BindContext(previous);
+}
+
+void lib1090AircraftInfo(const struct aircraft *a, struct lib1090Aircraft *out) {
+    memset(out, 0, sizeof(*out));
+    out->addr = a->addr;
+    out->seen = a->seen;
+    out->messages = a->messages;
+    if ((out->callsign_valid = trackDataValid(&a->callsign_valid)))
+        memcpy(out->callsign, a->callsign, sizeof(out->callsign));
+    if ((out->squawk_valid = trackDataValid(&a->squawk_valid)))
+        out->squawk = a->squawk;
+    if ((out->altitude_baro_valid = trackDataValid(&a->altitude_baro_valid)))
+        out->altitude_baro = a->altitude_baro;
+    if ((out->position_valid = trackDataValid(&a->position_valid))) {
+        out->lat = a->lat;
+        out->lon = a->lon;
+    }
+    if ((out->gs_valid = trackDataValid(&a->gs_valid)))
+        out->gs = a->gs;
+    if ((out->track_valid = trackDataValid(&a->track_valid)))
+        out->track = a->track;
+}
+
+bool lib1090GetAircraft(struct lib1090Context *ctx, uint32_t addr, struct lib1090Aircraft *out) {
+    struct lib1090Context *previous = lib1090BindContext(ctx);
+    struct aircraft *a = trackFindAircraft(addr);
+    if (a != NULL) {
+        lib1090AircraftInfo(a, out);
+    }
+    lib1090BindContext(previous);
+    return a != NULL;
+}
+
+void lib1090GetStats(struct lib1090Context *ctx, struct lib1090Stats *out) {
+    struct lib1090Context *previous = lib1090BindContext(ctx);
+    struct stats st;
+    add_stats(&Modes.stats_alltime, &Modes.stats_current, &st);
+
+    memset(out, 0, sizeof(*out));
+    out->messages = st.messages_total;
+    for (int i = 0; i <= MODES_MAX_BITERRORS; ++i) {
+        out->accepted += st.demod_accepted[i];
+    }
+    out->rejected_bad = st.demod_rejected_bad;
+    out->rejected_unknown_icao = st.demod_rejected_unknown_icao;
+    for (struct aircraft *a = Modes.aircrafts; a != NULL; a = a->next) {
+        ++out->aircraft;
+    }
+    lib1090BindContext(previous);
+}
+
 int lib1090InitDump1090(struct dump1090Fork_t **forkInfoOut) {
     struct dump1090Fork_t *forkInfo = malloc(sizeof(struct dump1090Fork_t));
     memset(forkInfo, '\0', sizeof(struct dump1090Fork_t));
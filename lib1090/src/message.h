@@ -0,0 +1,391 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// message.h: the decoded message structure
+//
+// Copyright (c) 2014-2016 Oliver Jowett <oliver@mutability.co.uk>
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Everything here is part of the lib1090 API as well, so it must stand on
+// its own (no Modes, no other dump1090 headers) and compile as C++.
+
+#ifndef DUMP1090_MESSAGE_H
+#define DUMP1090_MESSAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MODES_LONG_MSG_BYTES     14
+#define MODES_SHORT_MSG_BYTES    7
+
+/* Where did a bit of data arrive from? In order of increasing priority */
+typedef enum {
+    SOURCE_INVALID,        /* data is not valid */
+    SOURCE_MODE_AC,        /* A/C message */
+    SOURCE_MLAT,           /* derived from mlat */
+    SOURCE_MODE_S,         /* data from a Mode S message, no full CRC */
+    SOURCE_MODE_S_CHECKED, /* data from a Mode S message with full CRC */
+    SOURCE_TISB,           /* data from a TIS-B extended squitter message */
+    SOURCE_ADSR,           /* data from a ADS-R extended squitter message */
+    SOURCE_ADSB,           /* data from a ADS-B extended squitter message */
+} datasource_t;
+
+/* What sort of address is this and who sent it?
+ * (Earlier values are higher priority)
+ */
+typedef enum {
+    ADDR_ADSB_ICAO,       /* Mode S or ADS-B, ICAO address, transponder sourced */
+    ADDR_ADSB_ICAO_NT,    /* ADS-B, ICAO address, non-transponder */
+    ADDR_ADSR_ICAO,       /* ADS-R, ICAO address */
+    ADDR_TISB_ICAO,       /* TIS-B, ICAO address */
+
+    ADDR_ADSB_OTHER,      /* ADS-B, other address format */
+    ADDR_ADSR_OTHER,      /* ADS-R, other address format */
+    ADDR_TISB_TRACKFILE,  /* TIS-B, Mode A code + track file number */
+    ADDR_TISB_OTHER,      /* TIS-B, other address format */
+
+    ADDR_MODE_A,          /* Mode A */
+
+    ADDR_UNKNOWN          /* unknown address format */
+} addrtype_t;
+
+typedef enum {
+    UNIT_FEET,
+    UNIT_METERS
+} altitude_unit_t;
+
+typedef enum {
+    ALTITUDE_BARO,
+    ALTITUDE_GEOM
+} altitude_source_t;
+
+typedef enum {
+    AG_INVALID,
+    AG_GROUND,
+    AG_AIRBORNE,
+    AG_UNCERTAIN
+} airground_t;
+
+typedef enum {
+    SIL_INVALID, SIL_UNKNOWN, SIL_PER_SAMPLE, SIL_PER_HOUR
+} sil_type_t;
+
+typedef enum {
+    CPR_SURFACE, CPR_AIRBORNE, CPR_COARSE
+} cpr_type_t;
+
+typedef enum {
+    HEADING_INVALID,          // Not set
+    HEADING_GROUND_TRACK,     // Direction of track over ground, degrees clockwise from true north
+    HEADING_TRUE,             // Heading, degrees clockwise from true north
+    HEADING_MAGNETIC,         // Heading, degrees clockwise from magnetic north
+    HEADING_MAGNETIC_OR_TRUE, // HEADING_MAGNETIC or HEADING_TRUE depending on the HRD bit in opstatus
+    HEADING_TRACK_OR_HEADING  // GROUND_TRACK / MAGNETIC / TRUE depending on the TAH bit in opstatus
+} heading_type_t;
+
+typedef enum {
+    COMMB_UNKNOWN,
+    COMMB_AMBIGUOUS,
+    COMMB_EMPTY_RESPONSE,
+    COMMB_DATALINK_CAPS,
+    COMMB_GICB_CAPS,
+    COMMB_AIRCRAFT_IDENT,
+    COMMB_ACAS_RA,
+    COMMB_VERTICAL_INTENT,
+    COMMB_TRACK_TURN,
+    COMMB_HEADING_SPEED
+} commb_format_t;
+
+typedef enum {
+    NAV_MODE_AUTOPILOT = 1,
+    NAV_MODE_VNAV = 2,
+    NAV_MODE_ALT_HOLD = 4,
+    NAV_MODE_APPROACH = 8,
+    NAV_MODE_LNAV = 16,
+    NAV_MODE_TCAS = 32
+} nav_modes_t;
+
+// Matches encoding of the ES type 28/1 emergency/priority status subfield
+typedef enum {
+    EMERGENCY_NONE = 0,
+    EMERGENCY_GENERAL = 1,
+    EMERGENCY_LIFEGUARD = 2,
+    EMERGENCY_MINFUEL = 3,
+    EMERGENCY_NORDO = 4,
+    EMERGENCY_UNLAWFUL = 5,
+    EMERGENCY_DOWNED = 6,
+    EMERGENCY_RESERVED = 7
+} emergency_t;
+
+typedef enum {
+    NAV_ALT_INVALID, NAV_ALT_UNKNOWN, NAV_ALT_AIRCRAFT, NAV_ALT_MCP, NAV_ALT_FMS
+} nav_altitude_source_t;
+
+// Optional sections at the end of the decoded fields of a modesMessage.
+// Each holds data only if its flag is set in 'sections'.
+#define MODES_SECTION_ACCURACY (1U << 0)    // accuracy
+#define MODES_SECTION_OPSTATUS (1U << 1)    // opstatus
+#define MODES_SECTION_NAV      (1U << 2)    // nav
+
+// The struct we use to store information about a decoded message.
+//
+// Only the header (up to and including 'source') is initialized for every
+// message, by modesInitMessage and decodeModesHeader. The decoded fields
+// that follow are only valid once 'fields_decoded' is set; decodeModesFields
+// clears them before filling them in, except for the optional sections
+// (accuracy, opstatus, nav), which are only cleared by the decoders that
+// fill them in, via modesUseSections. Test 'sections' before reading them.
+struct modesMessage {
+    // Generic fields
+    unsigned char msg[MODES_LONG_MSG_BYTES];      // Binary message.
+    unsigned char verbatim[MODES_LONG_MSG_BYTES]; // Binary message, as originally received before correction
+    int           msgbits;                        // Number of bits in message
+    int           msgtype;                        // Downlink format #
+    uint32_t      crc;                            // Message CRC
+    int           correctedbits;                  // No. of bits corrected
+    uint32_t      addr;                           // Address Announced
+    addrtype_t    addrtype;                       // address format / source
+    uint64_t      timestampMsg;                   // Timestamp of the message (12MHz clock)
+    uint64_t      sysTimestampMsg;                // Timestamp of the message (system time)
+    int           remote;                         // If set this message is from a remote station
+    int           receiverId;                     // Local receiver index, or the receiving client's id (>= MODES_MAX_RECEIVERS) for network input
+    double        signalLevel;                    // RSSI, in the range [0..1], as a fraction of full-scale power
+    int           score;                          // Scoring from scoreModesMessage, if used
+    int           reliable;                       // is this a "reliable" message (uncorrected DF11/DF17/DF18)?
+    int           fields_decoded;                 // set once decodeModesFields has run
+    unsigned      sections;                       // MODES_SECTION_* holding data, valid if fields_decoded
+    unsigned      IID;                            // extracted from CRC of DF11s
+    unsigned      AA;                             // Address announced (DF11/17/18)
+
+    datasource_t  source;                         // Characterizes the overall message source
+
+    // Decoded fields, valid if fields_decoded is set
+
+    // Raw data, just extracted directly from the message
+    // The names reflect the field names in Annex 4
+    unsigned AC;
+    unsigned CA;
+    unsigned CC;
+    unsigned CF;
+    unsigned DR;
+    unsigned FS;
+    unsigned ID;
+    unsigned KE;
+    unsigned ND;
+    unsigned RI;
+    unsigned SL;
+    unsigned UM;
+    unsigned VS;
+    unsigned char MB[7];
+    unsigned char MD[10];
+    unsigned char ME[7];
+    unsigned char MV[7];
+
+    // Decoded data
+    unsigned altitude_baro_valid : 1;
+    unsigned altitude_geom_valid : 1;
+    unsigned track_valid : 1;
+    unsigned track_rate_valid : 1;
+    unsigned heading_valid : 1;
+    unsigned roll_valid : 1;
+    unsigned gs_valid : 1;
+    unsigned ias_valid : 1;
+    unsigned tas_valid : 1;
+    unsigned mach_valid : 1;
+    unsigned baro_rate_valid : 1;
+    unsigned geom_rate_valid : 1;
+    unsigned squawk_valid : 1;
+    unsigned callsign_valid : 1;
+    unsigned cpr_valid : 1;
+    unsigned cpr_odd : 1;
+    unsigned cpr_decoded : 1;
+    unsigned cpr_relative : 1;
+    unsigned category_valid : 1;
+    unsigned geom_delta_valid : 1;
+    unsigned from_mlat : 1;
+    unsigned from_tisb : 1;
+    unsigned spi_valid : 1;
+    unsigned spi : 1;
+    unsigned alert_valid : 1;
+    unsigned alert : 1;
+    unsigned emergency_valid : 1;
+
+    unsigned metype; // DF17/18 ME type
+    unsigned mesub;  // DF17/18 ME subtype
+
+    commb_format_t commb_format; // Inferred format of a comm-b message
+
+    // valid if altitude_baro_valid:
+    int               altitude_baro;       // Altitude in either feet or meters
+    altitude_unit_t   altitude_baro_unit;  // the unit used for altitude
+
+    // valid if altitude_geom_valid:
+    int               altitude_geom;       // Altitude in either feet or meters
+    altitude_unit_t   altitude_geom_unit;  // the unit used for altitude
+
+    // following fields are valid if the corresponding _valid field is set:
+    int      geom_delta;        // Difference between geometric and baro alt
+    float    heading;           // ground track or heading, degrees (0-359). Reported directly or computed from from EW and NS velocity
+    heading_type_t heading_type;// how to interpret 'track_or_heading'
+    float    track_rate;        // Rate of change of track, degrees/second
+    float    roll;              // Roll, degrees, negative is left roll
+    struct {
+        // Groundspeed, kts, reported directly or computed from from EW and NS velocity
+        // For surface movement, this has different interpretations for v0 and v2; both
+        // fields are populated. The tracking layer will update "gs.selected".
+        float v0;
+        float v2;
+        float selected;
+    } gs;
+    unsigned ias;               // Indicated airspeed, kts
+    unsigned tas;               // True airspeed, kts
+    double   mach;              // Mach number
+    int      baro_rate;         // Rate of change of barometric altitude, feet/minute
+    int      geom_rate;         // Rate of change of geometric (GNSS / INS) altitude, feet/minute
+    unsigned squawk;            // 13 bits identity (Squawk), encoded as 4 hex digits
+    char     callsign[9];       // 8 chars flight number, NUL-terminated
+    unsigned category;          // A0 - D7 encoded as a single hex byte
+    emergency_t emergency;      // emergency/priority status
+
+    // valid if cpr_valid
+    cpr_type_t cpr_type;       // The encoding type used (surface, airborne, coarse TIS-B)
+    unsigned   cpr_lat;        // Non decoded latitude.
+    unsigned   cpr_lon;        // Non decoded longitude.
+    unsigned   cpr_nucp;       // NUCp/NIC value implied by message type
+
+    airground_t airground;     // air/ground state
+
+    // valid if cpr_decoded:
+    double decoded_lat;
+    double decoded_lon;
+    unsigned decoded_nic;
+    unsigned decoded_rc;
+
+    // Optional sections, see MODES_SECTION_*; these must stay last
+
+    // various integrity/accuracy things
+    struct {
+        unsigned nic_a_valid : 1;
+        unsigned nic_b_valid : 1;
+        unsigned nic_c_valid : 1;
+        unsigned nic_baro_valid : 1;
+        unsigned nac_p_valid : 1;
+        unsigned nac_v_valid : 1;
+        unsigned gva_valid : 1;
+        unsigned sda_valid : 1;
+
+        unsigned nic_a : 1;        // if nic_a_valid
+        unsigned nic_b : 1;        // if nic_b_valid
+        unsigned nic_c : 1;        // if nic_c_valid
+        unsigned nic_baro : 1;     // if nic_baro_valid
+
+        unsigned nac_p : 4;        // if nac_p_valid
+        unsigned nac_v : 3;        // if nac_v_valid
+
+        unsigned sil : 2;          // if sil_type != SIL_INVALID
+        sil_type_t sil_type;
+
+        unsigned gva : 2;          // if gva_valid
+
+        unsigned sda : 2;          // if sda_valid
+    } accuracy;
+
+    // Operational Status
+    struct {
+        unsigned valid : 1;
+        unsigned version : 3;
+
+        unsigned om_acas_ra : 1;
+        unsigned om_ident : 1;
+        unsigned om_atc : 1;
+        unsigned om_saf : 1;
+
+        unsigned cc_acas : 1;
+        unsigned cc_cdti : 1;
+        unsigned cc_1090_in : 1;
+        unsigned cc_arv : 1;
+        unsigned cc_ts : 1;
+        unsigned cc_tc : 2;
+        unsigned cc_uat_in : 1;
+        unsigned cc_poa : 1;
+        unsigned cc_b2_low : 1;
+        unsigned cc_lw_valid : 1;
+
+        heading_type_t tah;
+        heading_type_t hrd;
+
+        unsigned cc_lw;
+        unsigned cc_antenna_offset;
+    } opstatus;
+
+    // combined:
+    //   Target State & Status (ADS-B V2 only)
+    //   Comm-B BDS4,0 Vertical Intent
+    struct {
+        unsigned heading_valid : 1;
+        unsigned fms_altitude_valid : 1;
+        unsigned mcp_altitude_valid : 1;
+        unsigned qnh_valid : 1;
+        unsigned modes_valid : 1;
+
+        float    heading;       // heading, degrees (0-359) (could be magnetic or true heading; magnetic recommended)
+        heading_type_t heading_type;
+        unsigned fms_altitude;  // FMS selected altitude
+        unsigned mcp_altitude;  // MCP/FCU selected altitude
+        float    qnh;           // altimeter setting (QFE or QNH/QNE), millibars
+
+        nav_altitude_source_t altitude_source;
+
+        nav_modes_t modes;
+    } nav;
+};
+
+// Reset the header fields of a message (everything before the decoded fields)
+static inline void modesInitMessage(struct modesMessage *mm)
+{
+    memset(&mm->msgbits, 0, offsetof(struct modesMessage, AC) - offsetof(struct modesMessage, msgbits));
+}
+
+// Clear the decoded fields of a message, up to the optional sections
+static inline void modesClearFields(struct modesMessage *mm)
+{
+    memset(&mm->AC, 0, offsetof(struct modesMessage, accuracy) - offsetof(struct modesMessage, AC));
+    mm->sections = 0;
+}
+
+// Called by decoders before they fill in optional sections: clears those
+// that don't hold data yet, and marks them as present
+static inline void modesUseSections(struct modesMessage *mm, unsigned sections)
+{
+    unsigned fresh = sections & ~mm->sections;
+
+    if (fresh & MODES_SECTION_ACCURACY)
+        memset(&mm->accuracy, 0, sizeof(mm->accuracy));
+    if (fresh & MODES_SECTION_OPSTATUS)
+        memset(&mm->opstatus, 0, sizeof(mm->opstatus));
+    if (fresh & MODES_SECTION_NAV)
+        memset(&mm->nav, 0, sizeof(mm->nav));
+    mm->sections |= sections;
+}
+
+struct aircraft;
+
+// Callbacks that receive decoded messages directly (see modesSetMessageSink, and
+// lib1090SetMessageCallback in lib1090.h).
+// 'a' is the aircraft the message updated, or NULL.
+typedef void (*modesMessageSinkFn)(struct modesMessage *mm, struct aircraft *a, void *udata);
+typedef void (*modesBatchSinkFn)(struct modesMessage *mms, struct aircraft **aircraft, size_t count, void *udata);
+
+#endif
@@ -126,6 +126,8 @@ void decodeModeAMessage(struct modesMessage *mm, int ModeA)
     mm->addrtype = ADDR_MODE_A;
     mm->msgtype = 32; // Valid Mode S DF's are DF-00 to DF-31.
     // so use 32 to indicate Mode A/C
+    modesClearFields(mm);
+    mm->fields_decoded = 1;
 
     mm->msgbits = 16; // Fudge up a Mode S style data stream
     mm->msg[0] = mm->verbatim[0] = (ModeA >> 8);
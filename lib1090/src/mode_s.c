@@ -380,6 +380,28 @@ int scoreModesMessage(unsigned char *msg, int validbits)
     }
 }
 
+// The best score scoreModesMessage can give a message of this type,
+// whatever the rest of its bits are. Demodulators use this to avoid
+// slicing and scoring phases that could not beat one already found.
+int scoreModesMessageBound(int msgtype)
+{
+    switch (msgtype) {
+        case 0: case 4: case 5: case 16:
+        case 20: case 21:
+        case 24: case 25: case 26: case 27: case 28: case 29: case 30: case 31:
+            return 1000;
+
+        case 11:
+            return 1600;
+
+        case 17: case 18:
+            return 1800;
+
+        default:
+            return -2;
+    }
+}
+
 //
 //=========================================================================
 //
@@ -393,7 +415,25 @@ static void decodeExtendedSquitter(struct modesMessage *mm);
 //   -1: message might be valid, but we couldn't validate the CRC against a known ICAO
 //   -2: bad message or unrepairable CRC error
 
+// Decode a message in full; see decodeModesHeader for the return value
 int decodeModesMessage(struct modesMessage *mm, unsigned char *msg)
+{
+    int result = decodeModesHeader(mm, msg);
+    if (result < 0)
+        return result;
+
+    decodeModesFields(mm);
+    return 0;
+}
+
+// First decoding stage: the downlink format, CRC checks and the address.
+// This is everything needed to accept or reject the message and to forward
+// it verbatim; decodeModesFields does the rest.
+//
+// return 0 if all OK
+//   -1: message might be valid, but we couldn't validate the CRC against a known ICAO
+//   -2: bad message or unrepairable CRC error
+int decodeModesHeader(struct modesMessage *mm, unsigned char *msg)
 {
     // Preserve the original uncorrected copy for later forwarding
     memcpy(mm->verbatim, msg, MODES_LONG_MSG_BYTES);
@@ -411,6 +451,11 @@ int decodeModesMessage(struct modesMessage *mm, unsigned char *msg)
     mm->crc             = modesChecksum(msg, mm->msgbits);
     mm->correctedbits   = 0;
     mm->addr            = 0;
+    mm->addrtype        = ADDR_ADSB_ICAO;
+    mm->reliable        = 0;
+    mm->fields_decoded  = 0;
+    mm->IID             = 0;
+    mm->AA              = 0;
 
     // Do checksum work and set fields that depend on the CRC
     switch (mm->msgtype) {
@@ -530,13 +575,41 @@ int decodeModesMessage(struct modesMessage *mm, unsigned char *msg)
             return -2;
     }
 
-    // decode the bulk of the message
-
     // AA (Address announced)
     if (mm->msgtype == 11 || mm->msgtype == 17 || mm->msgtype == 18) {
         mm->AA = mm->addr = getbits(msg, 9, 32);
     }
 
+    if (!mm->correctedbits && (mm->msgtype == 17 || (mm->msgtype == 11 && mm->IID == 0))) {
+        // No CRC errors seen, and either it was an DF17 extended squitter
+        // or a DF11 acquisition squitter with II = 0. We probably have the right address.
+
+        // Don't do this for DF18, as a DF18 transmitter doesn't necessarily have a
+        // Mode S transponder.
+
+        // NB this is the only place that adds addresses!
+        icaoFilterAdd(mm->addr);
+    }
+
+    // MLAT overrides all other sources
+    if (mm->remote && mm->timestampMsg == MAGIC_MLAT_TIMESTAMP)
+        mm->source = SOURCE_MLAT;
+
+    return 0;
+}
+
+// Second decoding stage: all the remaining fields of a message accepted by
+// decodeModesHeader, including the extended squitter and Comm-B contents.
+// Does nothing if the message was already decoded.
+void decodeModesFields(struct modesMessage *mm)
+{
+    unsigned char *msg = mm->msg;
+
+    if (mm->fields_decoded)
+        return;
+    modesClearFields(mm);
+    mm->fields_decoded = 1;
+
     // AC (Altitude Code)
     if (mm->msgtype == 0 || mm->msgtype == 4 || mm->msgtype == 16 || mm->msgtype == 20) {
         mm->AC = getbits(msg, 20, 32);
@@ -690,23 +763,9 @@ int decodeModesMessage(struct modesMessage *mm, unsigned char *msg)
             mm->airground = AG_UNCERTAIN;
     }
 
-    if (!mm->correctedbits && (mm->msgtype == 17 || (mm->msgtype == 11 && mm->IID == 0))) {
-        // No CRC errors seen, and either it was an DF17 extended squitter
-        // or a DF11 acquisition squitter with II = 0. We probably have the right address.
-
-        // Don't do this for DF18, as a DF18 transmitter doesn't necessarily have a
-        // Mode S transponder.
-
-        // NB this is the only place that adds addresses!
-        icaoFilterAdd(mm->addr);
-    }
-
-    // MLAT overrides all other sources
+    // MLAT overrides all other sources, including TIS-B set above
     if (mm->remote && mm->timestampMsg == MAGIC_MLAT_TIMESTAMP)
         mm->source = SOURCE_MLAT;
-
-    // all done
-    return 0;
 }
 
 static void decodeESIdentAndCategory(struct modesMessage *mm)
@@ -786,6 +845,7 @@ static void decodeESAirborneVelocity(struct modesMessage *mm, int check_imf)
     // 10: reserved
 
     // 11-13: NACv (NUCr in v0, maps directly to NACv in v2)
+    modesUseSections(mm, MODES_SECTION_ACCURACY);
     mm->accuracy.nac_v_valid = 1;
     mm->accuracy.nac_v = getbits(me, 11, 13);
 
@@ -947,6 +1007,7 @@ static void decodeESAirbornePosition(struct modesMessage *mm, int check_imf)
             setIMF(mm);
     } else {
         // NIC-B (v2) or SAF (v0/v1)
+        modesUseSections(mm, MODES_SECTION_ACCURACY);
         mm->accuracy.nic_b_valid = 1;
         mm->accuracy.nic_b = getbit(me, 8);
     }
@@ -1046,6 +1107,8 @@ static void decodeESTargetStatus(struct modesMessage *mm, int check_imf)
     if (check_imf && getbit(me, 51))
         setIMF(mm);
 
+    modesUseSections(mm, MODES_SECTION_NAV | MODES_SECTION_ACCURACY);
+
     if (mm->mesub == 0 && getbit(me, 11) == 0) { // Target state and status, V1
         // 8-9: vertical source
         switch (getbits(me, 8, 9)) {
@@ -1243,6 +1306,7 @@ static void decodeESOperationalStatus(struct modesMessage *mm, int check_imf)
         setIMF(mm);
 
     if (mm->mesub == 0 || mm->mesub == 1) {
+        modesUseSections(mm, MODES_SECTION_OPSTATUS | MODES_SECTION_ACCURACY);
         mm->opstatus.valid = 1;
         mm->opstatus.version = getbits(me, 41, 43);
 
@@ -2015,53 +2079,55 @@ void displayModesMessage(struct modesMessage *mm) {
         }
     }
 
-    if (mm->accuracy.nic_a_valid) {
-        printf("  NIC-A:         %d\n", mm->accuracy.nic_a);
-    }
-    if (mm->accuracy.nic_b_valid) {
-        printf("  NIC-B:         %d\n", mm->accuracy.nic_b);
-    }
-    if (mm->accuracy.nic_c_valid) {
-        printf("  NIC-C:         %d\n", mm->accuracy.nic_c);
-    }
-    if (mm->accuracy.nic_baro_valid) {
-        printf("  NIC-baro:      %d\n", mm->accuracy.nic_baro);
-    }
-    if (mm->accuracy.nac_p_valid) {
-        printf("  NACp:          %d\n", mm->accuracy.nac_p);
-    }
-    if (mm->accuracy.nac_v_valid) {
-        printf("  NACv:          %d\n", mm->accuracy.nac_v);
-    }
-    if (mm->accuracy.gva_valid) {
-        printf("  GVA:           %d\n", mm->accuracy.gva);
-    }
-    if (mm->accuracy.sil_type != SIL_INVALID) {
-        const char *sil_description;
-        switch (mm->accuracy.sil) {
-            case 1:
-                sil_description = "p <= 0.1%";
-                break;
-            case 2:
-                sil_description = "p <= 0.001%";
-                break;
-            case 3:
-                sil_description = "p <= 0.00001%";
-                break;
-            default:
-                sil_description = "p > 0.1%";
-                break;
+    if (mm->sections & MODES_SECTION_ACCURACY) {
+        if (mm->accuracy.nic_a_valid) {
+            printf("  NIC-A:         %d\n", mm->accuracy.nic_a);
+        }
+        if (mm->accuracy.nic_b_valid) {
+            printf("  NIC-B:         %d\n", mm->accuracy.nic_b);
+        }
+        if (mm->accuracy.nic_c_valid) {
+            printf("  NIC-C:         %d\n", mm->accuracy.nic_c);
+        }
+        if (mm->accuracy.nic_baro_valid) {
+            printf("  NIC-baro:      %d\n", mm->accuracy.nic_baro);
+        }
+        if (mm->accuracy.nac_p_valid) {
+            printf("  NACp:          %d\n", mm->accuracy.nac_p);
+        }
+        if (mm->accuracy.nac_v_valid) {
+            printf("  NACv:          %d\n", mm->accuracy.nac_v);
+        }
+        if (mm->accuracy.gva_valid) {
+            printf("  GVA:           %d\n", mm->accuracy.gva);
+        }
+        if (mm->accuracy.sil_type != SIL_INVALID) {
+            const char *sil_description;
+            switch (mm->accuracy.sil) {
+                case 1:
+                    sil_description = "p <= 0.1%";
+                    break;
+                case 2:
+                    sil_description = "p <= 0.001%";
+                    break;
+                case 3:
+                    sil_description = "p <= 0.00001%";
+                    break;
+                default:
+                    sil_description = "p > 0.1%";
+                    break;
+            }
+            printf("  SIL:           %d (%s, %s)\n",
+                   mm->accuracy.sil,
+                   sil_description,
+                   sil_type_to_string(mm->accuracy.sil_type));
+        }
+        if (mm->accuracy.sda_valid) {
+            printf("  SDA:           %d\n", mm->accuracy.sda);
         }
-        printf("  SIL:           %d (%s, %s)\n",
-               mm->accuracy.sil,
-               sil_description,
-               sil_type_to_string(mm->accuracy.sil_type));
-    }
-    if (mm->accuracy.sda_valid) {
-        printf("  SDA:           %d\n", mm->accuracy.sda);
     }
 
-    if (mm->opstatus.valid) {
+    if ((mm->sections & MODES_SECTION_OPSTATUS) && mm->opstatus.valid) {
         printf("  Aircraft Operational Status:\n");
         printf("    Version:            %d\n", mm->opstatus.version);
 
@@ -2091,33 +2157,35 @@ void displayModesMessage(struct modesMessage *mm) {
         printf("    Heading ref dir:    %s\n", heading_type_to_string(mm->opstatus.hrd));
     }
 
-    if (mm->nav.heading_valid)
-        printf("  Selected heading:        %.1f\n", mm->nav.heading);
-    if (mm->nav.fms_altitude_valid)
-        printf("  FMS selected altitude:   %u ft\n", mm->nav.fms_altitude);
-    if (mm->nav.mcp_altitude_valid)
-        printf("  MCP selected altitude:   %u ft\n", mm->nav.mcp_altitude);
-    if (mm->nav.qnh_valid)
-        printf("  QNH:                     %.1f millibars\n", mm->nav.qnh);
-    if (mm->nav.altitude_source != NAV_ALT_INVALID) {
-        printf("  Target altitude source:  ");
-        switch (mm->nav.altitude_source) {
-            case NAV_ALT_AIRCRAFT:
-                printf("aircraft altitude\n");
-                break;
-            case NAV_ALT_MCP:
-                printf("MCP selected altitude\n");
-                break;
-            case NAV_ALT_FMS:
-                printf("FMS selected altitude\n");
-                break;
-            default:
-                printf("unknown\n");
+    if (mm->sections & MODES_SECTION_NAV) {
+        if (mm->nav.heading_valid)
+            printf("  Selected heading:        %.1f\n", mm->nav.heading);
+        if (mm->nav.fms_altitude_valid)
+            printf("  FMS selected altitude:   %u ft\n", mm->nav.fms_altitude);
+        if (mm->nav.mcp_altitude_valid)
+            printf("  MCP selected altitude:   %u ft\n", mm->nav.mcp_altitude);
+        if (mm->nav.qnh_valid)
+            printf("  QNH:                     %.1f millibars\n", mm->nav.qnh);
+        if (mm->nav.altitude_source != NAV_ALT_INVALID) {
+            printf("  Target altitude source:  ");
+            switch (mm->nav.altitude_source) {
+                case NAV_ALT_AIRCRAFT:
+                    printf("aircraft altitude\n");
+                    break;
+                case NAV_ALT_MCP:
+                    printf("MCP selected altitude\n");
+                    break;
+                case NAV_ALT_FMS:
+                    printf("FMS selected altitude\n");
+                    break;
+                default:
+                    printf("unknown\n");
+            }
         }
-    }
 
-    if (mm->nav.modes_valid) {
-        printf("  Nav modes:               %s\n", nav_modes_to_string(mm->nav.modes));
+        if (mm->nav.modes_valid) {
+            printf("  Nav modes:               %s\n", nav_modes_to_string(mm->nav.modes));
+        }
     }
 
     if (mm->emergency_valid) {
@@ -2138,11 +2206,43 @@ void displayModesMessage(struct modesMessage *mm) {
 // Basically this function passes a raw message to the upper layers for further
 // processing and visualization
 //
+// Does anything consume more of a message than decodeModesHeader provides?
+// Tracking is only needed for the display, JSON, stats, traces, state
+// snapshots, message sinks and network outputs other than Beast verbatim.
+static int modesWantsDecodedFields(void)
+{
+    if (!Modes.quiet || Modes.interactive || Modes.json_dir || Modes.stats)
+        return 1;
+    if (Modes.trace_dir || Modes.state_path)
+        return 1;
+    if (Modes.message_sink || Modes.batch_sink)
+        return 1;
+    return Modes.net && modesNetWantsDecodedFields();
+}
+
 void useModesMessage(struct modesMessage *mm) {
     struct aircraft *a;
 
+    // Drop copies of a message that another receiver or input already delivered
+    if (Modes.dedup_window && mm->msgtype != 32 && dedupCheck(mm)) {
+        ++Modes.stats_current.dedup_dropped;
+        return;
+    }
+
     ++Modes.stats_current.messages_total;
 
+    // Messages from decodeModesHeader only get their remaining fields decoded
+    // if something will look at them; otherwise only verbatim output is fed.
+    if (!mm->fields_decoded) {
+        if (!modesWantsDecodedFields()) {
+            if (Modes.net) {
+                modesQueueOutput(mm, NULL);
+            }
+            return;
+        }
+        decodeModesFields(mm);
+    }
+
     // Track aircraft state
     a = trackUpdateFromMessage(mm);
 
@@ -2155,6 +2255,68 @@ void useModesMessage(struct modesMessage *mm) {
     if (Modes.net) {
         modesQueueOutput(mm, a);
     }
+
+    modesSinkMessage(mm, a);
+}
+
+//
+// ========================= Message sink callbacks =========================
+//
+
+// Deliver every message to fn as it is decoded (NULL to stop)
+void modesSetMessageSink(modesMessageSinkFn fn, void *udata)
+{
+    modesFlushSink();
+    Modes.message_sink = fn;
+    Modes.batch_sink = NULL;
+    Modes.sink_udata = udata;
+}
+
+// Collect messages and deliver them to fn in one call per demodulated block
+// (or whenever max_batch messages are waiting). The aircraft pointers are
+// valid until the callback returns.
+void modesSetBatchSink(modesBatchSinkFn fn, void *udata, size_t max_batch)
+{
+    modesFlushSink();
+    Modes.message_sink = NULL;
+    Modes.batch_sink = fn;
+    Modes.sink_udata = udata;
+
+    if (max_batch == 0)
+        max_batch = MODES_SINK_DEFAULT_BATCH;
+    if (max_batch != Modes.sink_batch_size) {
+        free(Modes.sink_batch);
+        free(Modes.sink_batch_aircraft);
+        Modes.sink_batch = malloc(max_batch * sizeof(*Modes.sink_batch));
+        Modes.sink_batch_aircraft = malloc(max_batch * sizeof(*Modes.sink_batch_aircraft));
+        if (!Modes.sink_batch || !Modes.sink_batch_aircraft) {
+            fprintf(stderr, "Out of memory allocating message batch.\n");
+            exit(1);
+        }
+        Modes.sink_batch_size = max_batch;
+    }
+}
+
+void modesSinkMessage(struct modesMessage *mm, struct aircraft *a)
+{
+    if (Modes.message_sink) {
+        Modes.message_sink(mm, a, Modes.sink_udata);
+    } else if (Modes.batch_sink) {
+        Modes.sink_batch[Modes.sink_batch_count] = *mm;
+        Modes.sink_batch_aircraft[Modes.sink_batch_count] = a;
+        if (++Modes.sink_batch_count == Modes.sink_batch_size)
+            modesFlushSink();
+    }
+}
+
+// Hand any batched messages to the batch sink. Called at the end of each
+// demodulated block, and before aircraft can expire.
+void modesFlushSink(void)
+{
+    if (Modes.batch_sink && Modes.sink_batch_count) {
+        Modes.batch_sink(Modes.sink_batch, Modes.sink_batch_aircraft, Modes.sink_batch_count, Modes.sink_udata);
+    }
+    Modes.sink_batch_count = 0;
 }
 
 //
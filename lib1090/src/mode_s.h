@@ -28,10 +28,20 @@
 //
 int modesMessageLenByType(int type);
 int scoreModesMessage(unsigned char *msg, int validbits);
+int scoreModesMessageBound(int msgtype);
 int decodeModesMessage (struct modesMessage *mm, unsigned char *msg);
+int decodeModesHeader  (struct modesMessage *mm, unsigned char *msg);
+void decodeModesFields (struct modesMessage *mm);
 void displayModesMessage(struct modesMessage *mm);
 void useModesMessage    (struct modesMessage *mm);
 
+// Deliver decoded messages to a callback, one at a time or (batch sink)
+// once per demodulated block, instead of or as well as the usual outputs
+void modesSetMessageSink(modesMessageSinkFn fn, void *udata);
+void modesSetBatchSink(modesBatchSinkFn fn, void *udata, size_t max_batch);
+void modesSinkMessage(struct modesMessage *mm, struct aircraft *a);
+void modesFlushSink(void);
+
 // datafield extraction helpers
 
 // The first bit (MSB of the first byte) is numbered 1, for consistency
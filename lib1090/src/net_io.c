@@ -55,6 +55,8 @@
 #include <assert.h>
 #include <stdarg.h>
 
+#include <zlib.h>
+
 //
 // ============================= Networking =============================
 //
@@ -69,6 +71,7 @@
 //    they have something new to share with us when reading is needed.
 
 static int handleBeastCommand(struct client *c, char *p);
+static int handleOutputCommand(struct client *c, char *p);
 static int decodeBinMessage(struct client *c, char *p);
 static int decodeHexMessage(struct client *c, char *hex);
 
@@ -81,6 +84,7 @@ static void send_sbs_heartbeat(struct net_service *service);
 static void writeBeastMessage(struct net_writer *writer, uint64_t timestamp, double signalLevel, unsigned char *msg, int msgLen);
 
 static void writeFATSVEvent(struct modesMessage *mm, struct aircraft *a);
+static void updateOutputDispatch(void);
 static void writeFATSVPositionUpdate(float lat, float lon, float alt);
 
 static void autoset_modeac();
@@ -150,8 +154,21 @@ struct client *createGenericClient(struct net_service *service, int fd)
     c->service    = NULL;
     c->next       = Modes.clients;
     c->fd         = fd;
+    c->receiverId = MODES_MAX_RECEIVERS + Modes.clients_created++;
     c->buflen     = 0;
     c->modeac_requested = 0;
+    c->filter     = NULL;
+    c->queue      = NULL;
+    c->queue_used = 0;
+    c->queue_size = 0;
+    c->queue_since = 0;
+    c->udp        = 0;
+    c->udp_seq    = 0;
+    c->zout       = NULL;
+    c->zout_sync  = 0;
+    c->zout_pending = 0;
+    c->zin        = NULL;
+    c->zin_buf    = NULL;
     Modes.clients = c;
 
     moveNetClient(c, service);
@@ -175,6 +192,51 @@ struct client *serviceConnect(struct net_service *service, char *addr, int port)
     return createSocketClient(service, s);
 }
 
+// Send the given (output) service's data as UDP datagrams to target,
+// "host:port" or "[ipv6-address]:port", which may be a multicast group.
+// Each datagram is a 32-bit sequence number followed by whole messages,
+// so the cost is the same however many consumers are listening.
+// _exits_ on failure!
+struct client *serviceSendUdp(struct net_service *service, const char *target)
+{
+    char host[256];
+    const char *port;
+    struct client *c;
+    int s;
+
+    const char *colon = strrchr(target, ':');
+    if (!colon || colon == target || !colon[1] || (size_t) (colon - target) >= sizeof(host)) {
+        fprintf(stderr, "Bad UDP destination %s for %s, expected host:port\n", target, service->descr);
+        exit(1);
+    }
+
+    if (target[0] == '[' && colon[-1] == ']') {
+        memcpy(host, target + 1, colon - target - 2);
+        host[colon - target - 2] = 0;
+    } else {
+        memcpy(host, target, colon - target);
+        host[colon - target] = 0;
+    }
+    port = colon + 1;
+
+    s = anetUdpConnect(Modes.aneterr, host, (char *) port, Modes.net_udp_ttl);
+    if (s == ANET_ERR) {
+        fprintf(stderr, "Error setting up UDP output to %s for %s: %s\n", target, service->descr, Modes.aneterr);
+        exit(1);
+    }
+
+    c = createGenericClient(service, s);
+    if (!(c->queue = malloc(MODES_UDP_PAYLOAD_SIZE))) {
+        fprintf(stderr, "Out of memory allocating a UDP output buffer for %s\n", service->descr);
+        exit(1);
+    }
+    c->queue_size = MODES_UDP_PAYLOAD_SIZE;
+    c->udp = 1;
+    ++service->queued_clients;
+
+    return c;
+}
+
 // Set up the given service to listen on an address/port.
 // _exits_ on failure!
 void serviceListen(struct net_service *service, char *bind_addr, char *bind_ports)
@@ -252,8 +314,10 @@ void modesInitNet(void) {
     Modes.services = NULL;
 
     // set up listeners
-    s = serviceInit("Raw TCP output", &Modes.raw_out, send_raw_heartbeat, READ_MODE_IGNORE, NULL, NULL);
+    s = serviceInit("Raw TCP output", &Modes.raw_out, send_raw_heartbeat, READ_MODE_ASCII, "\n", handleOutputCommand);
     serviceListen(s, Modes.net_bind_address, Modes.net_output_raw_ports);
+    if (Modes.net_udp_raw)
+        serviceSendUdp(s, Modes.net_udp_raw);
 
     // we maintain two output services, one producing a stream of verbatim messages, one producing a stream of cooked messages
     // and switch clients between them if they request a change in mode
@@ -264,11 +328,13 @@ void modesInitNet(void) {
         serviceListen(Modes.beast_verbatim_service, Modes.net_bind_address, Modes.net_output_beast_ports);
     else
         serviceListen(Modes.beast_cooked_service, Modes.net_bind_address, Modes.net_output_beast_ports);
+    if (Modes.net_udp_beast)
+        serviceSendUdp(Modes.net_verbatim ? Modes.beast_verbatim_service : Modes.beast_cooked_service, Modes.net_udp_beast);
 
-    s = serviceInit("Basestation TCP output", &Modes.sbs_out, send_sbs_heartbeat, READ_MODE_IGNORE, NULL, NULL);
+    s = serviceInit("Basestation TCP output", &Modes.sbs_out, send_sbs_heartbeat, READ_MODE_ASCII, "\n", handleOutputCommand);
     serviceListen(s, Modes.net_bind_address, Modes.net_output_sbs_ports);
 
-    s = serviceInit("Raw TCP input", NULL, NULL, READ_MODE_ASCII, "\n", decodeHexMessage);
+    s = serviceInit("Raw TCP input", NULL, NULL, READ_MODE_AVR, "\n", decodeHexMessage);
     serviceListen(s, Modes.net_bind_address, Modes.net_input_raw_ports);
 
     s = makeBeastInputService();
@@ -295,6 +361,13 @@ static struct client * modesAcceptClients(void) {
 
     return Modes.clients;
 }
+
+// Does this client get its own copy of the output (filtered or UDP)
+// rather than sharing the writer's buffer?
+static inline int clientQueued(const struct client *c) {
+    return c->filter || c->udp;
+}
+
 //
 //=========================================================================
 //
@@ -313,6 +386,26 @@ static void modesCloseClient(struct client *c) {
 
     close(c->fd);
     c->service->connections--;
+    if (clientQueued(c))
+        c->service->queued_clients--;
+    netFilterFree(c->filter);
+    c->filter = NULL;
+    free(c->queue);
+    c->queue = NULL;
+    if (c->zout) {
+        deflateEnd(c->zout);
+        free(c->zout);
+        c->zout = NULL;
+    }
+    if (c->zin) {
+        inflateEnd(c->zin);
+        free(c->zin);
+        c->zin = NULL;
+    }
+    free(c->zin_buf);
+    c->zin_buf = NULL;
+    if (c->service->writer)
+        updateOutputDispatch();
 
     // mark it as inactive and ready to be freed
     c->fd = -1;
@@ -324,28 +417,158 @@ static void modesCloseClient(struct client *c) {
 //
 //=========================================================================
 //
-// Send the write buffer for the specified writer to all connected clients
+// Send some bytes to one client's socket, closing it if that fails.
+// Returns 0 if the client was closed.
+//
+static int writeSocket(struct client *c, const void *data, int len) {
+#ifndef _WIN32
+    int nwritten = write(c->fd, data, len);
+#else
+    int nwritten = send(c->fd, data, len, 0 );
+#endif
+    if (nwritten != len) {
+        modesCloseClient(c);
+        return 0;
+    }
+    return 1;
+}
+
+// Run some output through a compressed client's deflate stream, sending
+// whatever deflate produces. With Z_SYNC_FLUSH everything given so far
+// goes out; with Z_NO_FLUSH deflate keeps collecting until it has a
+// block worth sending, which is where most of the compression comes from.
+static void deflateClient(struct client *c, const char *data, int len, int flush) {
+    unsigned char out[MODES_OUT_BUF_SIZE];
+    z_stream *z = c->zout;
+
+    z->next_in = (unsigned char *) data;
+    z->avail_in = len;
+
+    do {
+        z->next_out = out;
+        z->avail_out = sizeof(out);
+        deflate(z, flush);  // can't fail: the stream is valid and there is room to write
+
+        int n = sizeof(out) - z->avail_out;
+        Modes.stats_current.net_compress_out += n;
+        if (n && !writeSocket(c, out, n))
+            return;
+    } while (z->avail_out == 0);
+
+    Modes.stats_current.net_compress_in += len;
+    if (flush == Z_SYNC_FLUSH) {
+        c->zout_pending = 0;
+        c->zout_sync = mstime();
+    } else {
+        c->zout_pending = 1;
+    }
+}
+
+// Send some output to one client, closing it if that fails
+//
+static void writeClient(struct client *c, const char *data, int len) {
+    if (c->zout) {
+        // flush the deflate stream through to the socket no more often
+        // than the output flush interval, so the latency stays the same
+        // as for an uncompressed client
+        int due = (c->zout_sync + Modes.net_output_flush_interval <= mstime());
+        deflateClient(c, data, len, due ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+    } else {
+        writeSocket(c, data, len);
+    }
+}
+
+// Send a UDP client's queue as one datagram, after a 32-bit big-endian
+// sequence number so consumers can spot lost datagrams. Errors are not
+// fatal: the datagram is simply lost, as it could be on the network.
+static void sendDatagram(struct client *c) {
+    unsigned char datagram[4 + MODES_OUT_BUF_SIZE];
+    uint32_t seq = c->udp_seq++;
+
+    datagram[0] = seq >> 24;
+    datagram[1] = seq >> 16;
+    datagram[2] = seq >> 8;
+    datagram[3] = seq;
+    memcpy(datagram + 4, c->queue, c->queue_used);
+
+#ifndef _WIN32
+    int nwritten = write(c->fd, datagram, 4 + c->queue_used);
+#else
+    int nwritten = send(c->fd, datagram, 4 + c->queue_used, 0 );
+#endif
+    if (nwritten != 4 + c->queue_used)
+        Modes.stats_current.net_udp_dropped++;
+    else
+        Modes.stats_current.net_udp_sent++;
+}
+
+// Send the output queued for one client
+static void flushClientQueue(struct client *c) {
+    if (c->queue_used) {
+        if (c->udp) {
+            sendDatagram(c);
+            c->queue_used = 0;
+        } else {
+            int len = c->queue_used;
+            c->queue_used = 0;
+            writeClient(c, c->queue, len);
+        }
+    }
+}
+
+// Send the write buffer for the specified writer to all connected clients.
+// Filtered and UDP clients get their own queue instead. UDP queues are
+// only sent early if their data has waited for the flush interval, so
+// datagrams fill up to the MTU where the flush interval allows.
 //
 static void flushWrites(struct net_writer *writer) {
     struct client *c;
+    uint64_t now = mstime();
 
     for (c = Modes.clients; c; c = c->next) {
         if (!c->service)
             continue;
         if (c->service == writer->service) {
-#ifndef _WIN32
-            int nwritten = write(c->fd, writer->data, writer->dataUsed);
-#else
-            int nwritten = send(c->fd, writer->data, writer->dataUsed, 0 );
-#endif
-            if (nwritten != writer->dataUsed) {
-                modesCloseClient(c);
-            }
+            if (!clientQueued(c))
+                writeClient(c, writer->data, writer->dataUsed);
+            else if (!c->udp || c->queue_since + Modes.net_output_flush_interval <= now)
+                flushClientQueue(c);
         }
     }
 
     writer->dataUsed = 0;
-    writer->lastWrite = mstime();
+    writer->lastWrite = now;
+}
+
+// Copy one completed write to the queue of each filtered or UDP client
+// of the writer's service that wants it. The other clients share the
+// writer's buffer as before, so they cost nothing extra. Writes made
+// outside modesQueueOutput (heartbeats, FATSV) pass every filter.
+// Each write is one whole message, so a full queue (one datagram, for
+// UDP) always ends on a message boundary.
+static void queueClientWrite(struct net_writer *writer, const char *data, int len) {
+    struct modesMessage *mm = Modes.net_output_mm;
+    struct client *c;
+
+    for (c = Modes.clients; c; c = c->next) {
+        if (c->service != writer->service || !clientQueued(c))
+            continue;
+        if (c->filter && mm && !netFilterMatch(c->filter, mm, Modes.net_output_aircraft))
+            continue;
+        if (len > c->queue_size)
+            continue;
+
+        if (c->queue_used + len > c->queue_size) {
+            flushClientQueue(c);
+            if (!c->service)
+                continue;
+        }
+
+        if (!c->queue_used)
+            c->queue_since = mstime();
+        memcpy(c->queue + c->queue_used, data, len);
+        c->queue_used += len;
+    }
 }
 
 // Prepare to write up to 'len' bytes to the given net_writer.
@@ -372,6 +595,11 @@ static void *prepareWrite(struct net_writer *writer, int len) {
 // endptr should point one byte past the last byte written
 // to the buffer returned from prepareWrite.
 static void completeWrite(struct net_writer *writer, void *endptr) {
+    if (writer->service->queued_clients) {
+        char *start = writer->data + writer->dataUsed;
+        queueClientWrite(writer, start, (char *) endptr - start);
+    }
+
     writer->dataUsed = endptr - writer->data;
 
     if (writer->dataUsed >= Modes.net_output_flush_size) {
@@ -379,6 +607,17 @@ static void completeWrite(struct net_writer *writer, void *endptr) {
     }
 }
 
+// Each local receiver counts its own 12MHz clock, and with several of them
+// the clocks are unrelated. One output stream can't carry timestamps from
+// several clocks without confusing mlat, so they are left out (0, "no
+// timestamp") for locally received messages in that case.
+static uint64_t outputTimestamp(const struct modesMessage *mm)
+{
+    if (Modes.num_receivers > 1 && !mm->remote)
+        return 0;
+    return mm->timestampMsg;
+}
+
 //
 //=========================================================================
 //
@@ -390,7 +629,7 @@ static void modesSendBeastVerbatimOutput(struct modesMessage *mm, struct aircraf
         return;
 
     // Do verbatim output for all messages
-    writeBeastMessage(&Modes.beast_verbatim_out, mm->timestampMsg, mm->signalLevel, mm->verbatim, mm->msgbits / 8);
+    writeBeastMessage(&Modes.beast_verbatim_out, outputTimestamp(mm), mm->signalLevel, mm->verbatim, mm->msgbits / 8);
 }
 
 static void modesSendBeastCookedOutput(struct modesMessage *mm, struct aircraft *a) {
@@ -407,7 +646,7 @@ static void modesSendBeastCookedOutput(struct modesMessage *mm, struct aircraft
     if ((a && !a->reliable) && !mm->reliable)
         return;
 
-    writeBeastMessage(&Modes.beast_cooked_out, mm->timestampMsg, mm->signalLevel, mm->msg, mm->msgbits / 8);
+    writeBeastMessage(&Modes.beast_cooked_out, outputTimestamp(mm), mm->signalLevel, mm->msg, mm->msgbits / 8);
 }
 
 static void writeBeastMessage(struct net_writer *writer, uint64_t timestamp, double signalLevel, unsigned char *msg, int msgLen) {
@@ -499,10 +738,11 @@ static void modesSendRawOutput(struct modesMessage *mm, struct aircraft *a) {
     if (!p)
         return;
 
-    if (Modes.mlat && mm->timestampMsg) {
+    uint64_t timestamp = outputTimestamp(mm);
+    if (Modes.mlat && timestamp) {
         /* timestamp, big-endian */
         sprintf(p, "@%012" PRIX64,
-                mm->timestampMsg);
+                timestamp);
         p += 13;
     } else
         *p++ = '*';
@@ -544,218 +784,19 @@ static void send_raw_heartbeat(struct net_service *service)
 static void modesSendSBSOutput(struct modesMessage *mm, struct aircraft *a) {
     char *p;
     struct timespec now;
-    struct tm    stTime_receive, stTime_now;
-    int          msgType;
-
-    // We require a tracked aircraft for SBS output
-    if (!a)
-        return;
-
-    // Don't ever forward 2-bit-corrected messages via SBS output.
-    if (mm->correctedbits >= 2)
-        return;
-
-    // Don't ever forward mlat messages via SBS output.
-    if (mm->source == SOURCE_MLAT)
-        return;
-
-    // Don't ever send unreliable messages via SBS output
-    if (!mm->reliable && !a->reliable)
-        return;
+    int msgType;
 
-    // For now, suppress non-ICAO addresses
-    if (mm->addr & MODES_NON_ICAO_ADDRESS)
+    if (!(msgType = sbsMessageType(mm, a)))
         return;
 
-    p = prepareWrite(&Modes.sbs_out, 200);
+    p = prepareWrite(&Modes.sbs_out, SBS_MAX_LINE);
     if (!p)
         return;
 
-    //
-    // SBS BS style output checked against the following reference
-    // http://www.homepages.mcb.net/bones/SBS/Article/Barebones42_Socket_Data.htm - seems comprehensive
-    //
-
-    // Decide on the basic SBS Message Type
-    switch (mm->msgtype) {
-        case 4:
-        case 20:
-            msgType = 5;
-            break;
-            break;
-
-        case 5:
-        case 21:
-            msgType = 6;
-            break;
-
-        case 0:
-        case 16:
-            msgType = 7;
-            break;
-
-        case 11:
-            msgType = 8;
-            break;
-
-        case 17:
-        case 18:
-            if (mm->metype >= 1 && mm->metype <= 4) {
-                msgType = 1;
-            } else if (mm->metype >= 5 && mm->metype <=  8) {
-                msgType = 2;
-            } else if (mm->metype >= 9 && mm->metype <= 18) {
-                msgType = 3;
-            } else if (mm->metype == 19) {
-                msgType = 4;
-            } else {
-                return;
-            }
-            break;
-
-        default:
-            return;
-    }
-
-    // Fields 1 to 6 : SBS message type and ICAO address of the aircraft and some other stuff
-    p += sprintf(p, "MSG,%d,1,1,%06X,1,", msgType, mm->addr);
-
     // Find current system time
     clock_gettime(CLOCK_REALTIME, &now);
-    localtime_r(&now.tv_sec, &stTime_now);
-
-    // Find message reception time
-    time_t received = (time_t) (mm->sysTimestampMsg / 1000);
-    localtime_r(&received, &stTime_receive);
-
-    // Fields 7 & 8 are the message reception time and date
-    p += sprintf(p, "%04d/%02d/%02d,", (stTime_receive.tm_year+1900),(stTime_receive.tm_mon+1), stTime_receive.tm_mday);
-    p += sprintf(p, "%02d:%02d:%02d.%03u,", stTime_receive.tm_hour, stTime_receive.tm_min, stTime_receive.tm_sec, (unsigned) (mm->sysTimestampMsg % 1000));
-
-    // Fields 9 & 10 are the current time and date
-    p += sprintf(p, "%04d/%02d/%02d,", (stTime_now.tm_year+1900),(stTime_now.tm_mon+1), stTime_now.tm_mday);
-    p += sprintf(p, "%02d:%02d:%02d.%03u", stTime_now.tm_hour, stTime_now.tm_min, stTime_now.tm_sec, (unsigned) (now.tv_nsec / 1000000U));
-
-    // Field 11 is the callsign (if we have it)
-    if (mm->callsign_valid) {p += sprintf(p, ",%s", mm->callsign);}
-    else                    {p += sprintf(p, ",");}
-
-    // Field 12 is the altitude (if we have it)
-    if (Modes.use_gnss) {
-        if (mm->altitude_geom_valid) {
-            p += sprintf(p, ",%dH", mm->altitude_geom);
-        } else if (mm->altitude_baro_valid && trackDataValid(&a->geom_delta_valid)) {
-            p += sprintf(p, ",%dH", mm->altitude_baro + a->geom_delta);
-        } else if (mm->altitude_baro_valid) {
-            p += sprintf(p, ",%d", mm->altitude_baro);
-        } else {
-            p += sprintf(p, ",");
-        }
-    } else {
-        if (mm->altitude_baro_valid) {
-            p += sprintf(p, ",%d", mm->altitude_baro);
-        } else if (mm->altitude_geom_valid && trackDataValid(&a->geom_delta_valid)) {
-            p += sprintf(p, ",%d", mm->altitude_geom - a->geom_delta);
-        } else {
-            p += sprintf(p, ",");
-        }
-    }
-
-    // Field 13 is the ground Speed (if we have it)
-    if (mm->gs_valid) {
-        p += sprintf(p, ",%.0f", mm->gs.selected);
-    } else {
-        p += sprintf(p, ",");
-    }
-
-    // Field 14 is the ground Heading (if we have it)
-    if (mm->heading_valid && mm->heading_type == HEADING_GROUND_TRACK) {
-        p += sprintf(p, ",%.0f", mm->heading);
-    } else {
-        p += sprintf(p, ",");
-    }
-
-    // Fields 15 and 16 are the Lat/Lon (if we have it)
-    if (mm->cpr_decoded) {
-        p += sprintf(p, ",%1.5f,%1.5f", mm->decoded_lat, mm->decoded_lon);
-    } else {
-        p += sprintf(p, ",,");
-    }
-
-    // Field 17 is the VerticalRate (if we have it)
-    if (Modes.use_gnss) {
-        if (mm->geom_rate_valid) {
-            p += sprintf(p, ",%dH", mm->geom_rate);
-        } else if (mm->baro_rate_valid) {
-            p += sprintf(p, ",%d", mm->baro_rate);
-        } else {
-            p += sprintf(p, ",");
-        }
-    } else {
-        if (mm->baro_rate_valid) {
-            p += sprintf(p, ",%d", mm->baro_rate);
-        } else if (mm->geom_rate_valid) {
-            p += sprintf(p, ",%d", mm->geom_rate);
-        } else {
-            p += sprintf(p, ",");
-        }
-    }
-
-    // Field 18 is  the Squawk (if we have it)
-    if (mm->squawk_valid) {
-        p += sprintf(p, ",%04x", mm->squawk);
-    } else {
-        p += sprintf(p, ",");
-    }
-
-    // Field 19 is the Squawk Changing Alert flag (if we have it)
-    if (mm->alert_valid) {
-        if (mm->alert) {
-            p += sprintf(p, ",-1");
-        } else {
-            p += sprintf(p, ",0");
-        }
-    } else {
-        p += sprintf(p, ",");
-    }
-
-    // Field 20 is the Squawk Emergency flag (if we have it)
-    if (mm->squawk_valid) {
-        if ((mm->squawk == 0x7500) || (mm->squawk == 0x7600) || (mm->squawk == 0x7700)) {
-            p += sprintf(p, ",-1");
-        } else {
-            p += sprintf(p, ",0");
-        }
-    } else {
-        p += sprintf(p, ",");
-    }
-
-    // Field 21 is the Squawk Ident flag (if we have it)
-    if (mm->spi_valid) {
-        if (mm->spi) {
-            p += sprintf(p, ",-1");
-        } else {
-            p += sprintf(p, ",0");
-        }
-    } else {
-        p += sprintf(p, ",");
-    }
-
-    // Field 22 is the OnTheGround flag (if we have it)
-    switch (mm->airground) {
-        case AG_GROUND:
-            p += sprintf(p, ",-1");
-            break;
-        case AG_AIRBORNE:
-            p += sprintf(p, ",0");
-            break;
-        default:
-            p += sprintf(p, ",");
-            break;
-    }
-
-    p += sprintf(p, "\r\n");
 
+    p = sbsFormatMessage(p, msgType, mm, a, &now);
     completeWrite(&Modes.sbs_out, p);
 }
 
@@ -806,7 +847,7 @@ ssize_t formatBeastMessage(struct modesMessage *mm, uint8_t *beastMsgOut, size_t
         uint64_t mlatTimestamp;
         uint8_t bytes[8];
     } ts;
-    ts.mlatTimestamp = htobe64(mm->timestampMsg & 0x0000FFFFFFFFFFFF);
+    ts.mlatTimestamp = htobe64(outputTimestamp(mm) & 0x0000FFFFFFFFFFFF);
     for (uint8_t *from = ts.bytes; from < ts.bytes+6; ++from) {
         *beastMsgOut++ = *from;
         if (*from == BEAST_MSG_DELIMITER) { // escape delimiter
@@ -842,14 +883,86 @@ ssize_t formatBeastMessage(struct modesMessage *mm, uint8_t *beastMsgOut, size_t
 //
 //=========================================================================
 //
+// Per-message output formats. modesQueueOutput only calls the ones in
+// Modes.net_output_dispatch, which updateOutputDispatch keeps in step with
+// the connected clients.
+//
+static const struct {
+    const char *name;
+    void (*send)(struct modesMessage *mm, struct aircraft *a);
+    int wants_fields;    // uses decoded fields or the aircraft
+} net_output_formats[NET_OUTPUT_FORMATS] = {
+    [NET_OUTPUT_SBS]            = { "sbs",            modesSendSBSOutput,           1 },
+    [NET_OUTPUT_RAW]            = { "raw",            modesSendRawOutput,           1 },
+    [NET_OUTPUT_BEAST_VERBATIM] = { "beast_verbatim", modesSendBeastVerbatimOutput, 0 },
+    [NET_OUTPUT_BEAST_COOKED]   = { "beast_cooked",   modesSendBeastCookedOutput,   1 },
+    [NET_OUTPUT_FATSV]          = { "fatsv",          writeFATSVEvent,              1 },
+};
+
+static struct net_writer *outputWriter(enum net_output_format f)
+{
+    switch (f) {
+    case NET_OUTPUT_SBS:            return &Modes.sbs_out;
+    case NET_OUTPUT_RAW:            return &Modes.raw_out;
+    case NET_OUTPUT_BEAST_VERBATIM: return &Modes.beast_verbatim_out;
+    case NET_OUTPUT_BEAST_COOKED:   return &Modes.beast_cooked_out;
+    case NET_OUTPUT_FATSV:          return &Modes.fatsv_out;
+    default:                        return NULL;
+    }
+}
+
+const char *netOutputFormatName(enum net_output_format f)
+{
+    return net_output_formats[f].name;
+}
+
+// Rebuild the dispatch list after a client came or went
+static void updateOutputDispatch(void)
+{
+    int n = 0, wants_fields = 0;
+    struct client *c;
+
+    for (int f = 0; f < NET_OUTPUT_FORMATS; ++f) {
+        struct net_writer *writer = outputWriter(f);
+        if (writer->service && writer->service->connections) {
+            Modes.net_output_dispatch[n++] = f;
+            wants_fields |= net_output_formats[f].wants_fields;
+        }
+    }
+
+    // a position filter needs positions decoded even for Beast verbatim
+    for (c = Modes.clients; c && !wants_fields; c = c->next) {
+        if (c->service && c->filter && netFilterNeedsFields(c->filter))
+            wants_fields = 1;
+    }
+
+    Modes.net_output_dispatch_count = n;
+    Modes.net_output_wants_fields = wants_fields;
+}
+
+// Are there clients for any output that needs decoded messages and the
+// aircraft they update, i.e. anything but Beast verbatim?
+int modesNetWantsDecodedFields(void)
+{
+    return Modes.net_output_wants_fields;
+}
+
 void modesQueueOutput(struct modesMessage *mm, struct aircraft *a) {
 
-    // Delegate to the format-specific outputs, each of which makes its own decision about filtering messages
-    modesSendSBSOutput(mm, a);
-    modesSendRawOutput(mm, a);
-    modesSendBeastVerbatimOutput(mm, a);
-    modesSendBeastCookedOutput(mm, a);
-    writeFATSVEvent(mm, a);
+    // Delegate to the format-specific outputs that have clients, each of
+    // which makes its own decision about filtering messages
+    // (and completeWrite applies the per-client filters)
+    Modes.net_output_mm = mm;
+    Modes.net_output_aircraft = a;
+
+    for (int i = 0; i < Modes.net_output_dispatch_count; ++i) {
+        enum net_output_format f = Modes.net_output_dispatch[i];
+        net_output_formats[f].send(mm, a);
+        Modes.stats_current.net_output_calls[f]++;
+    }
+
+    Modes.net_output_mm = NULL;
+    Modes.net_output_aircraft = NULL;
 }
 
 // Decode a little-endian IEEE754 float (binary32)
@@ -947,6 +1060,8 @@ static void moveNetClient(struct client *c, struct net_service *new_service)
         if (c->service->writer)
             flushWrites(c->service->writer);
         --c->service->connections;
+        if (clientQueued(c))
+            --c->service->queued_clients;
     }
 
     if (new_service) {
@@ -954,17 +1069,177 @@ static void moveNetClient(struct client *c, struct net_service *new_service)
         if (new_service->writer)
             flushWrites(new_service->writer);
         ++new_service->connections;
+        if (clientQueued(c))
+            ++new_service->queued_clients;
     }
 
     c->service = new_service;
+    updateOutputDispatch();
+}
+
+// Replace the filter on an output client (NULL to send it everything)
+static void setClientFilter(struct client *c, struct net_filter *filter)
+{
+    // Flush so the switch between the shared buffer and the client's
+    // own queue happens on a message boundary
+    if (c->service->writer)
+        flushWrites(c->service->writer);
+    if (!c->service) {
+        // write failed and closed the client
+        netFilterFree(filter);
+        return;
+    }
+
+    int was_queued = clientQueued(c);
+    netFilterFree(c->filter);
+    c->filter = filter;
+    c->service->queued_clients += clientQueued(c) - was_queued;
+
+    if (filter && !c->queue) {
+        if (!(c->queue = malloc(MODES_OUT_BUF_SIZE))) {
+            fprintf(stderr, "Out of memory allocating output buffer for a filtered %s client\n", c->service->descr);
+            exit(1);
+        }
+        c->queue_size = MODES_OUT_BUF_SIZE;
+    }
+
+    updateOutputDispatch();
+}
+
+// Parse a filter spec sent by an output client (see netfilter.h).
+// A malformed spec leaves the current filter alone.
+static void handleFilterSpec(struct client *c, const char *spec)
+{
+    int error;
+    struct net_filter *filter = netFilterParse(spec, &error);
+
+    if (!error)
+        setClientFilter(c, filter);
+}
+
+//
+// Handle a line sent to a SBS or raw output port. The only thing
+// these clients can ask for is a filter:
+//
+//   FILTER icao=4840D6,40621D df=17
+//
+// and "FILTER" alone clears it. Anything else is ignored.
+//
+static int handleOutputCommand(struct client *c, char *p) {
+    size_t len = strlen(p);
+    if (len && p[len - 1] == '\r')
+        p[len - 1] = 0;
+
+    if (!strncmp(p, "FILTER", 6) && (p[6] == 0 || p[6] == ' '))
+        handleFilterSpec(c, p + 6);
+
+    return 0;
+}
+
+// Switch a Beast output client to a compressed stream: <esc> "Z", then a
+// zlib stream carrying the Beast data that would otherwise have been sent
+static void startCompression(struct client *c)
+{
+    if (c->zout || !c->service)
+        return;
+
+    // Flush so the stream switches over on a message boundary; either
+    // flush may close this client
+    if (c->service->writer) {
+        flushWrites(c->service->writer);
+        if (!c->service)
+            return;
+    }
+    if (c->filter) {
+        flushClientQueue(c);
+        if (!c->service)
+            return;
+    }
+    if (!writeSocket(c, "\x1a" "Z", 2))
+        return;
+
+    if (!(c->zout = calloc(1, sizeof(*c->zout)))) {
+        fprintf(stderr, "Out of memory allocating a deflate stream for a %s client\n", c->service->descr);
+        exit(1);
+    }
+
+    if (deflateInit(c->zout, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        fprintf(stderr, "Failed to set up a deflate stream for a %s client\n", c->service->descr);
+        free(c->zout);
+        c->zout = NULL;
+        modesCloseClient(c);
+        return;
+    }
+
+    c->zout_sync = mstime();
+    c->zout_pending = 0;
+}
+
+// Flush the deflate streams of compressed clients, and the queues of UDP
+// clients, that have been holding data back for longer than the output
+// flush interval
+static void flushHeldClients(uint64_t now)
+{
+    struct client *c;
+
+    for (c = Modes.clients; c; c = c->next) {
+        if (c->service && c->zout && c->zout_pending &&
+            c->zout_sync + Modes.net_output_flush_interval <= now) {
+            deflateClient(c, NULL, 0, Z_SYNC_FLUSH);
+        }
+        if (c->service && c->udp && c->queue_used &&
+            c->queue_since + Modes.net_output_flush_interval <= now) {
+            flushClientQueue(c);
+        }
+    }
+}
+
+// Ask the Beast output at the other end of this input connection to
+// compress the rest of the stream. It answers with <esc> "Z" when it
+// switches over, which modesReadFromClient watches for.
+void requestBeastCompression(struct client *c)
+{
+    if (!c->zin_buf && !(c->zin_buf = malloc(MODES_CLIENT_BUF_SIZE))) {
+        fprintf(stderr, "Out of memory allocating an inflate buffer for a %s client\n", c->service->descr);
+        exit(1);
+    }
+
+    sendBeastSettings(c, "Z");
+}
+
+// The Beast input has switched to a compressed stream; 'data' is
+// whatever we had already read of it
+static void startDecompression(struct client *c, const char *data, int len)
+{
+    if (!(c->zin = calloc(1, sizeof(*c->zin)))) {
+        fprintf(stderr, "Out of memory allocating an inflate stream for a %s client\n", c->service->descr);
+        exit(1);
+    }
+
+    if (inflateInit(c->zin) != Z_OK) {
+        fprintf(stderr, "Failed to set up an inflate stream for a %s client\n", c->service->descr);
+        modesCloseClient(c);
+        return;
+    }
+
+    memcpy(c->zin_buf, data, len);
+    c->zin->next_in = c->zin_buf;
+    c->zin->avail_in = len;
+    Modes.stats_current.net_decompress_in += len;
 }
 
 //
 // Handle a Beast command message.
-// Currently, we just look for the Mode A/C command message
+// We look for the Mode A/C and verbatim/cooked command messages, and
+// filter requests (<esc> "F" filter-spec "\n", see handleOutputCommand),
 // and ignore everything else.
 //
 static int handleBeastCommand(struct client *c, char *p) {
+    if (p[0] == 'F') {
+        handleFilterSpec(c, p + 1);
+        return 0;
+    }
+
     if (p[0] != '1') {
         // huh?
         return 0;
@@ -985,6 +1260,9 @@ static int handleBeastCommand(struct client *c, char *p) {
         case 'V':
             moveNetClient(c, Modes.beast_verbatim_service);
             break;
+        case 'Z':
+            startCompression(c);
+            break;
     }
 
     return 0;
@@ -1008,10 +1286,7 @@ static int decodeBinMessage(struct client *c, char *p) {
     int  j;
     char ch;
     unsigned char msg[MODES_LONG_MSG_BYTES + 7];
-    static struct modesMessage zeroMessage;
     struct modesMessage mm;
-    MODES_NOTUSED(c);
-    memset(&mm, 0, sizeof(mm));
 
     ch = *p++; /// Get the message type
 
@@ -1041,11 +1316,12 @@ static int decodeBinMessage(struct client *c, char *p) {
     }
 
     if (msgLen) {
-        mm = zeroMessage;
+        modesInitMessage(&mm);
 
         // Mark messages received over the internet as remote so that we don't try to
         // pass them off as being received by this instance when forwarding them
         mm.remote      =    1;
+        mm.receiverId  =    c->receiverId;
 
         // Grab the timestamp (big endian format)
         mm.timestampMsg = 0;
@@ -1075,7 +1351,7 @@ static int decodeBinMessage(struct client *c, char *p) {
             int result;
 
             Modes.stats_current.remote_received_modes++;
-            result = decodeModesMessage(&mm, msg);
+            result = decodeModesHeader(&mm, msg);
             if (result < 0) {
                 if (result == -1)
                     Modes.stats_current.remote_rejected_unknown_icao++;
@@ -1094,118 +1370,68 @@ static int decodeBinMessage(struct client *c, char *p) {
 //
 //=========================================================================
 //
-// Turn an hex digit into its 4 bit decimal value.
-// Returns -1 if the digit is not in the 0-F range.
-//
-static int hexDigitVal(int c) {
-    c = tolower(c);
-    if (c >= '0' && c <= '9') return c-'0';
-    else if (c >= 'a' && c <= 'f') return c-'a'+10;
-    else return -1;
-}
-//
-//=========================================================================
-//
-// This function decodes a string representing message in raw hex format
-// like: *8D4B969699155600E87406F5B69F; The string is null-terminated.
+// This function decodes a line representing a message in raw hex format
+// like: *8D4B969699155600E87406F5B69F; (see avrDecodeLine for the other
+// forms we understand). The line runs from 'line' up to 'end'.
 //
 // The message is passed to the higher level layers, so it feeds
 // the selected screen output, the network output and so forth.
 //
 // If the message looks invalid it is silently discarded.
 //
-// The function always returns 0 (success) to the caller as there is no
-// case where we want broken messages here to close the client connection.
-//
-static int decodeHexMessage(struct client *c, char *hex) {
-    int l = strlen(hex), j;
-    unsigned char msg[MODES_LONG_MSG_BYTES];
+static void decodeAvrLine(struct client *c, const char *line, const char *end) {
+    struct avr_frame frame;
     struct modesMessage mm;
-    static struct modesMessage zeroMessage;
 
-    MODES_NOTUSED(c);
-    mm = zeroMessage;
+    if (!avrDecodeLine(line, end, &frame))
+        return;
+
+    if (0 == Modes.mode_ac && frame.len == MODEAC_MSG_BYTES)
+        return; // Right length for ModeA/C, but not enabled
+
+    modesInitMessage(&mm);
 
     // Mark messages received over the internet as remote so that we don't try to
     // pass them off as being received by this instance when forwarding them
     mm.remote      =    1;
-    mm.signalLevel =    0;
-
-    // Remove spaces on the left and on the right
-    while(l && isspace(hex[l-1])) {
-        hex[l-1] = '\0'; l--;
-    }
-    while(isspace(*hex)) {
-        hex++; l--;
-    }
-
-    // Turn the message into binary.
-    // Accept *-AVR raw @-AVR/BEAST timeS+raw %-AVR timeS+raw (CRC good) <-BEAST timeS+sigL+raw
-    // and some AVR records that we can understand
-    if (hex[l-1] != ';') {return (0);} // not complete - abort
-
-    switch(hex[0]) {
-        case '<': {
-            mm.signalLevel = ((hexDigitVal(hex[13])<<4) | hexDigitVal(hex[14])) / 255.0;
-            mm.signalLevel = mm.signalLevel * mm.signalLevel;
-            hex += 15; l -= 16; // Skip <, timestamp and siglevel, and ;
-            break;}
-
-        case '@':     // No CRC check
-        case '%': {   // CRC is OK
-            hex += 13; l -= 14; // Skip @,%, and timestamp, and ;
-            break;}
-
-        case '*':
-        case ':': {
-            hex++; l-=2; // Skip * and ;
-            break;}
-
-        default: {
-            return (0); // We don't know what this is, so abort
-            break;}
-    }
-
-    if ( (l != (MODEAC_MSG_BYTES      * 2))
-         && (l != (MODES_SHORT_MSG_BYTES * 2))
-         && (l != (MODES_LONG_MSG_BYTES  * 2)) )
-    {return (0);} // Too short or long message... broken
-
-    if ( (0 == Modes.mode_ac)
-         && (l == (MODEAC_MSG_BYTES * 2)) )
-    {return (0);} // Right length for ModeA/C, but not enabled
-
-    for (j = 0; j < l; j += 2) {
-        int high = hexDigitVal(hex[j]);
-        int low  = hexDigitVal(hex[j+1]);
-
-        if (high == -1 || low == -1) return 0;
-        msg[j/2] = (high << 4) | low;
-    }
+    mm.receiverId  =    c->receiverId;
+    mm.signalLevel =    frame.signalLevel;
 
     // record reception time as the time we read it.
     mm.sysTimestampMsg = mstime();
 
-    if (l == (MODEAC_MSG_BYTES * 2)) {  // ModeA or ModeC
+    if (frame.len == MODEAC_MSG_BYTES) {  // ModeA or ModeC
         Modes.stats_current.remote_received_modeac++;
-        decodeModeAMessage(&mm, ((msg[0] << 8) | msg[1]));
+        decodeModeAMessage(&mm, ((frame.msg[0] << 8) | frame.msg[1]));
     } else {       // Assume ModeS
         int result;
 
         Modes.stats_current.remote_received_modes++;
-        result = decodeModesMessage(&mm, msg);
+        result = decodeModesHeader(&mm, frame.msg);
         if (result < 0) {
             if (result == -1)
                 Modes.stats_current.remote_rejected_unknown_icao++;
             else
                 Modes.stats_current.remote_rejected_bad++;
-            return 0;
+            return;
         } else {
             Modes.stats_current.remote_accepted[mm.correctedbits]++;
         }
     }
 
     useModesMessage(&mm);
+}
+
+//
+// Read handler for raw input. The read loop (READ_MODE_AVR) normally
+// hands whole buffers to decodeAvrLine directly; this takes one
+// NUL-terminated line.
+//
+// The function always returns 0 (success) to the caller as there is no
+// case where we want broken messages here to close the client connection.
+//
+static int decodeHexMessage(struct client *c, char *hex) {
+    decodeAvrLine(c, hex, hex + strlen(hex));
     return (0);
 }
 
@@ -1427,7 +1653,7 @@ char *generateAircraftJson(const char *url_path, int *len) {
 
     MODES_NOTUSED(url_path);
 
-    _messageNow = now;
+    Modes.message_now = now;
 
     p = safe_snprintf(p, end,
                       "{ \"now\" : %.1f,\n"
@@ -1582,13 +1808,17 @@ static char * appendStatsJson(char *p,
                           ",\"modeac\":%u"
                           ",\"modes\":%u"
                           ",\"bad\":%u"
-                          ",\"unknown_icao\":%u",
+                          ",\"unknown_icao\":%u"
+                          ",\"phases_scored\":%u"
+                          ",\"phases_abandoned\":%u",
                           (unsigned long long)st->samples_processed,
                           (unsigned long long)st->samples_dropped,
                           st->demod_modeac,
                           st->demod_preambles,
                           st->demod_rejected_bad,
-                          st->demod_rejected_unknown_icao);
+                          st->demod_rejected_unknown_icao,
+                          st->demod_phases_scored,
+                          st->demod_phases_abandoned);
 
         for (i=0; i <= Modes.nfix_crc; ++i) {
             if (i == 0) p = safe_snprintf(p, end, ",\"accepted\":[%u", st->demod_accepted[i]);
@@ -1626,6 +1856,32 @@ static char * appendStatsJson(char *p,
         p = safe_snprintf(p, end, "]}");
     }
 
+    if (Modes.dedup_window)
+        p = safe_snprintf(p, end, ",\"dedup_dropped\":%u", st->dedup_dropped);
+
+    p = safe_snprintf(p, end,
+                      ",\"commb\":{\"repeated\":%u,\"predicted\":%u,\"sweeps\":%u}",
+                      st->commb_repeated,
+                      st->commb_predicted,
+                      st->commb_sweeps);
+
+    for (int f = 0; f < NET_OUTPUT_FORMATS; ++f) {
+        p = safe_snprintf(p, end, "%s\"%s\":%u",
+                          f == 0 ? ",\"output\":{" : ",",
+                          netOutputFormatName(f), st->net_output_calls[f]);
+    }
+    p = safe_snprintf(p, end, "}");
+
+    p = safe_snprintf(p, end,
+                      ",\"udp\":{\"sent\":%u,\"dropped\":%u}",
+                      st->net_udp_sent, st->net_udp_dropped);
+
+    p = safe_snprintf(p, end,
+                      ",\"compression\":{\"output_raw\":%" PRIu64 ",\"output_compressed\":%" PRIu64
+                      ",\"input_compressed\":%" PRIu64 ",\"input_raw\":%" PRIu64 "}",
+                      st->net_compress_in, st->net_compress_out,
+                      st->net_decompress_in, st->net_decompress_out);
+
     {
         uint64_t demod_cpu_millis = (uint64_t)st->demod_cpu.tv_sec*1000UL + st->demod_cpu.tv_nsec/1000000UL;
         uint64_t reader_cpu_millis = (uint64_t)st->reader_cpu.tv_sec*1000UL + st->reader_cpu.tv_nsec/1000000UL;
@@ -1832,6 +2088,50 @@ void writeJsonToFile(const char *file, char * (*generator) (const char *,int*))
 // The handler returns 0 on success, or 1 to signal this function we should
 // close the connection with the client in case of non-recoverable errors.
 //
+static int readSocket(struct client *c, void *buf, int len) {
+#ifndef _WIN32
+    return read(c->fd, buf, len);
+#else
+    int nread = recv(c->fd, buf, len, 0);
+    if (nread < 0) {errno = WSAGetLastError();}
+    return nread;
+#endif
+}
+
+// Read up to 'len' bytes of Beast data from a compressed input, with the
+// same results as read(): 0 at the end of the stream, -1 with errno set
+// on errors or when there is nothing to read just now.
+static int readCompressed(struct client *c, char *buf, int len) {
+    z_stream *z = c->zin;
+
+    z->next_out = (unsigned char *) buf;
+    z->avail_out = len;
+
+    while (z->avail_out) {
+        if (!z->avail_in) {
+            int nread = readSocket(c, c->zin_buf, MODES_CLIENT_BUF_SIZE);
+            if (nread <= 0) {
+                if (z->avail_out != (unsigned) len)
+                    break;  // return what we have, see the rest next time
+                return nread;
+            }
+            Modes.stats_current.net_decompress_in += nread;
+            z->next_in = c->zin_buf;
+            z->avail_in = nread;
+        }
+
+        int ret = inflate(z, Z_SYNC_FLUSH);
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            // corrupt, or the sender ended the stream
+            errno = EIO;
+            return -1;
+        }
+    }
+
+    Modes.stats_current.net_decompress_out += len - z->avail_out;
+    return len - z->avail_out;
+}
+
 static void modesReadFromClient(struct client *c) {
     int left;
     int nread;
@@ -1846,12 +2146,10 @@ static void modesReadFromClient(struct client *c) {
             left = MODES_CLIENT_BUF_SIZE;
             // If there is garbage, read more to discard it ASAP
         }
-#ifndef _WIN32
-        nread = read(c->fd, c->buf+c->buflen, left);
-#else
-        nread = recv(c->fd, c->buf+c->buflen, left, 0);
-        if (nread < 0) {errno = WSAGetLastError();}
-#endif
+        if (c->zin)
+            nread = readCompressed(c, c->buf+c->buflen, left);
+        else
+            nread = readSocket(c, c->buf+c->buflen, left);
 
         // If we didn't get all the data we asked for, then return once we've processed what we did get.
         if (nread != left) {
@@ -1914,6 +2212,15 @@ static void modesReadFromClient(struct client *c) {
                         eom = p + MODES_LONG_MSG_BYTES  + 8;
                     } else if (*p == '5') {
                         eom = p + MODES_LONG_MSG_BYTES  + 8;
+                    } else if (*p == 'Z' && c->zin_buf && !c->zin) {
+                        // We asked for compression and the rest of the
+                        // stream, starting with what is left in the
+                        // buffer, is compressed
+                        startDecompression(c, p + 1, eod - (p + 1));
+                        if (!c->service)
+                            return;
+                        som = eod = p + 1;
+                        break;
                     } else {
                         // Not a valid beast message, skip 0x1a and try again
                         ++som;
@@ -1957,6 +2264,23 @@ static void modesReadFromClient(struct client *c) {
 
                     if (*p == '1') {
                         eom = p + 2;
+                    } else if (*p == 'F') {
+                        // filter request, runs to the end of the line
+                        char *nl = memchr(p, '\n', eod - p);
+                        if (!nl) {
+                            // Incomplete message in buffer, retry later
+                            break;
+                        }
+                        *nl = '\0';
+                        if (nl > p && nl[-1] == '\r')
+                            nl[-1] = '\0';
+                        eom = nl + 1;
+                        if (c->service->read_handler(c, p)) {
+                            modesCloseClient(c);
+                            return;
+                        }
+                        som = eom;
+                        continue;
                     } else {
                         // Not a valid beast command, skip 0x1a and try again
                         ++som;
@@ -1986,6 +2310,15 @@ static void modesReadFromClient(struct client *c) {
                 }
                 break;
 
+            case READ_MODE_AVR:
+                // Raw / AVR input: decode every complete line in the
+                // buffer where it is, without copying or NUL-terminating
+                while (som < eod && (p = memchr(som, '\n', eod - som)) != NULL) {
+                    decodeAvrLine(c, som, p);
+                    som = p + 1;
+                }
+                break;
+
             case READ_MODE_ASCII:
                 //
                 // This is the ASCII scanning case, AVR RAW or HTTP at present
@@ -2035,14 +2368,12 @@ __attribute__ ((format (printf,4,5))) static char *appendFATSV(char *p, char *en
 
 static void writeFATSVPositionUpdate(float lat, float lon, float alt)
 {
-    static float last_lat, last_lon, last_alt;
-
-    if (lat == last_lat && lon == last_lon && alt == last_alt)
+    if (lat == Modes.fatsv_last_lat && lon == Modes.fatsv_last_lon && alt == Modes.fatsv_last_alt)
         return;
 
-    last_lat = lat;
-    last_lon = lon;
-    last_alt = alt;
+    Modes.fatsv_last_lat = lat;
+    Modes.fatsv_last_lon = lon;
+    Modes.fatsv_last_alt = alt;
 
     char *p = prepareWrite(&Modes.fatsv_out, TSV_MAX_PACKET_SIZE);
     if (!p)
@@ -2160,8 +2491,13 @@ static inline float heading_difference(float h1, float h2)
     return (d < 180) ? d : (360 - d);
 }
 
-__attribute__ ((format (printf,6,7))) static char *appendFATSVMeta(char *p, char *end, const char *field, struct aircraft *a, const data_validity *source, const char *format, ...)
+__attribute__ ((format (printf,7,8))) static char *appendFATSVMeta(char *p, char *end, const char *field, struct aircraft *a, const data_validity *source, uint64_t changed, const char *format, ...)
 {
+    if (!(a->fatsv_changed & changed)) {
+        // not written since last time
+        return p;
+    }
+
     const char *sourcetype;
     switch (source->source) {
         case SOURCE_MODE_S:
@@ -2230,32 +2566,34 @@ static const char *airground_enum_string(airground_t ag)
 
 static void writeFATSV()
 {
-    struct aircraft *a;
-    static uint64_t next_update;
+    struct aircraft *a, *next;
 
     if (!Modes.fatsv_out.service || !Modes.fatsv_out.service->connections) {
         return; // not enabled or no active connections
     }
 
     uint64_t now = mstime();
-    if (now < next_update) {
+    if (now < Modes.next_fatsv_update) {
         return;
     }
 
     // scan once a second at most
-    next_update = now + 1000;
+    Modes.next_fatsv_update = now + 1000;
 
-    for (a = Modes.aircrafts; a; a = a->next) {
-        if (!a->reliable)
-            continue;
+    // Only aircraft that have been updated since we last emitted them
+    // are on the dirty list; they stay there until they are emitted.
+    for (a = Modes.fatsv_dirty; a; a = next) {
+        next = a->fatsv_dirty_next;
 
-        // don't emit if it hasn't updated since last time
-        if (a->seen < a->fatsv_last_emitted) {
+        // don't emit if it hasn't updated since last time; a new message
+        // puts it back on the list
+        if (!a->reliable || a->seen < a->fatsv_last_emitted) {
+            trackClearDirty(a);
             continue;
         }
 
         // Pretend we are "processing a message" so the validity checks work as expected
-        _messageNow = a->seen;
+        Modes.message_now = a->seen;
 
         // some special cases:
         int altValid = trackDataValid(&a->altitude_baro_valid);
@@ -2273,34 +2611,38 @@ static void writeFATSV()
             altValid = 0;
 
         // if it hasn't changed altitude, heading, or speed much,
-        // don't update so often
+        // don't update so often. Fields that haven't been written since the
+        // last emission still hold the emitted value, so skip comparing them.
+#define FATSV_CHANGED(_f) (a->fatsv_changed & CHANGED_##_f)
         int changed =
-                (altValid && abs(a->altitude_baro - a->fatsv_emitted_altitude_baro) >= 50) ||
-                (trackDataValid(&a->altitude_geom_valid) && abs(a->altitude_geom - a->fatsv_emitted_altitude_geom) >= 50) ||
-                (trackDataValid(&a->baro_rate_valid) && abs(a->baro_rate - a->fatsv_emitted_baro_rate) > 500) ||
-                (trackDataValid(&a->geom_rate_valid) && abs(a->geom_rate - a->fatsv_emitted_geom_rate) > 500) ||
-                (trackDataValid(&a->track_valid) && heading_difference(a->track, a->fatsv_emitted_track) >= 2) ||
-                (trackDataValid(&a->track_rate_valid) && fabs(a->track_rate - a->fatsv_emitted_track_rate) >= 0.5) ||
-                (trackDataValid(&a->roll_valid) && fabs(a->roll - a->fatsv_emitted_roll) >= 5.0) ||
-                (trackDataValid(&a->mag_heading_valid) && heading_difference(a->mag_heading, a->fatsv_emitted_mag_heading) >= 2) ||
-                (trackDataValid(&a->true_heading_valid) && heading_difference(a->true_heading, a->fatsv_emitted_true_heading) >= 2) ||
-                (gsValid && fabs(a->gs - a->fatsv_emitted_gs) >= 25) ||
-                (trackDataValid(&a->ias_valid) && unsigned_difference(a->ias, a->fatsv_emitted_ias) >= 25) ||
-                (trackDataValid(&a->tas_valid) && unsigned_difference(a->tas, a->fatsv_emitted_tas) >= 25) ||
-                (trackDataValid(&a->mach_valid) && fabs(a->mach - a->fatsv_emitted_mach) >= 0.02);
+                (FATSV_CHANGED(ALTITUDE_BARO) && altValid && abs(a->altitude_baro - a->fatsv_emitted_altitude_baro) >= 50) ||
+                (FATSV_CHANGED(ALTITUDE_GEOM) && trackDataValid(&a->altitude_geom_valid) && abs(a->altitude_geom - a->fatsv_emitted_altitude_geom) >= 50) ||
+                (FATSV_CHANGED(BARO_RATE) && trackDataValid(&a->baro_rate_valid) && abs(a->baro_rate - a->fatsv_emitted_baro_rate) > 500) ||
+                (FATSV_CHANGED(GEOM_RATE) && trackDataValid(&a->geom_rate_valid) && abs(a->geom_rate - a->fatsv_emitted_geom_rate) > 500) ||
+                (FATSV_CHANGED(TRACK) && trackDataValid(&a->track_valid) && heading_difference(a->track, a->fatsv_emitted_track) >= 2) ||
+                (FATSV_CHANGED(TRACK_RATE) && trackDataValid(&a->track_rate_valid) && fabs(a->track_rate - a->fatsv_emitted_track_rate) >= 0.5) ||
+                (FATSV_CHANGED(ROLL) && trackDataValid(&a->roll_valid) && fabs(a->roll - a->fatsv_emitted_roll) >= 5.0) ||
+                (FATSV_CHANGED(MAG_HEADING) && trackDataValid(&a->mag_heading_valid) && heading_difference(a->mag_heading, a->fatsv_emitted_mag_heading) >= 2) ||
+                (FATSV_CHANGED(TRUE_HEADING) && trackDataValid(&a->true_heading_valid) && heading_difference(a->true_heading, a->fatsv_emitted_true_heading) >= 2) ||
+                (FATSV_CHANGED(GS) && gsValid && fabs(a->gs - a->fatsv_emitted_gs) >= 25) ||
+                (FATSV_CHANGED(IAS) && trackDataValid(&a->ias_valid) && unsigned_difference(a->ias, a->fatsv_emitted_ias) >= 25) ||
+                (FATSV_CHANGED(TAS) && trackDataValid(&a->tas_valid) && unsigned_difference(a->tas, a->fatsv_emitted_tas) >= 25) ||
+                (FATSV_CHANGED(MACH) && trackDataValid(&a->mach_valid) && fabs(a->mach - a->fatsv_emitted_mach) >= 0.02);
 
         int immediate =
-                (trackDataValid(&a->nav_altitude_mcp_valid) && unsigned_difference(a->nav_altitude_mcp, a->fatsv_emitted_nav_altitude_mcp) > 50) ||
-                (trackDataValid(&a->nav_altitude_fms_valid) && unsigned_difference(a->nav_altitude_fms, a->fatsv_emitted_nav_altitude_fms) > 50) ||
-                (trackDataValid(&a->nav_altitude_src_valid) && a->nav_altitude_src != a->fatsv_emitted_nav_altitude_src) ||
-                (trackDataValid(&a->nav_heading_valid) && heading_difference(a->nav_heading, a->fatsv_emitted_nav_heading) > 2) ||
-                (trackDataValid(&a->nav_modes_valid) && a->nav_modes != a->fatsv_emitted_nav_modes) ||
-                (trackDataValid(&a->nav_qnh_valid) && fabs(a->nav_qnh - a->fatsv_emitted_nav_qnh) > 0.8) || // 0.8 is the ES message resolution
-                (callsignValid && strcmp(a->callsign, a->fatsv_emitted_callsign) != 0) ||
-                (airgroundValid && a->airground == AG_AIRBORNE && a->fatsv_emitted_airground == AG_GROUND) ||
-                (airgroundValid && a->airground == AG_GROUND && a->fatsv_emitted_airground == AG_AIRBORNE) ||
-                (squawkValid && a->squawk != a->fatsv_emitted_squawk) ||
-                (trackDataValid(&a->emergency_valid) && a->emergency != a->fatsv_emitted_emergency);
+                (FATSV_CHANGED(NAV_ALTITUDE_MCP) && trackDataValid(&a->nav_altitude_mcp_valid) && unsigned_difference(a->nav_altitude_mcp, a->fatsv_emitted_nav_altitude_mcp) > 50) ||
+                (FATSV_CHANGED(NAV_ALTITUDE_FMS) && trackDataValid(&a->nav_altitude_fms_valid) && unsigned_difference(a->nav_altitude_fms, a->fatsv_emitted_nav_altitude_fms) > 50) ||
+                (FATSV_CHANGED(NAV_ALTITUDE_SRC) && trackDataValid(&a->nav_altitude_src_valid) && a->nav_altitude_src != a->fatsv_emitted_nav_altitude_src) ||
+                (FATSV_CHANGED(NAV_HEADING) && trackDataValid(&a->nav_heading_valid) && heading_difference(a->nav_heading, a->fatsv_emitted_nav_heading) > 2) ||
+                (FATSV_CHANGED(NAV_MODES) && trackDataValid(&a->nav_modes_valid) && a->nav_modes != a->fatsv_emitted_nav_modes) ||
+                (FATSV_CHANGED(NAV_QNH) && trackDataValid(&a->nav_qnh_valid) && fabs(a->nav_qnh - a->fatsv_emitted_nav_qnh) > 0.8) || // 0.8 is the ES message resolution
+                (FATSV_CHANGED(CALLSIGN) && callsignValid && strcmp(a->callsign, a->fatsv_emitted_callsign) != 0) ||
+                (FATSV_CHANGED(AIRGROUND) && airgroundValid && a->airground == AG_AIRBORNE && a->fatsv_emitted_airground == AG_GROUND) ||
+                (FATSV_CHANGED(AIRGROUND) && airgroundValid && a->airground == AG_GROUND && a->fatsv_emitted_airground == AG_AIRBORNE) ||
+                (FATSV_CHANGED(SQUAWK) && squawkValid && a->squawk != a->fatsv_emitted_squawk) ||
+                (FATSV_CHANGED(EMERGENCY) && trackDataValid(&a->emergency_valid) && a->emergency != a->fatsv_emitted_emergency);
+
+#undef FATSV_CHANGED
 
         uint64_t minAge;
         if (immediate) {
@@ -2349,19 +2691,19 @@ static void writeFATSV()
             p = appendFATSV(p, end, "category", "%02X", a->category);
         }
         if (trackDataValid(&a->nac_p_valid) && (forceEmit || a->nac_p != a->fatsv_emitted_nac_p)) {
-            p = appendFATSVMeta(p, end, "nac_p",       a, &a->nac_p_valid,         "%u",       a->nac_p);
+            p = appendFATSVMeta(p, end, "nac_p",    a, &a->nac_p_valid,    CHANGED_NAC_P,    "%u", a->nac_p);
         }
         if (trackDataValid(&a->nac_v_valid) && (forceEmit || a->nac_v != a->fatsv_emitted_nac_v)) {
-            p = appendFATSVMeta(p, end, "nac_v",       a, &a->nac_v_valid,         "%u",       a->nac_v);
+            p = appendFATSVMeta(p, end, "nac_v",    a, &a->nac_v_valid,    CHANGED_NAC_V,    "%u", a->nac_v);
         }
         if (trackDataValid(&a->sil_valid) && (forceEmit || a->sil != a->fatsv_emitted_sil)) {
-            p = appendFATSVMeta(p, end, "sil",         a, &a->sil_valid,           "%u",       a->sil);
+            p = appendFATSVMeta(p, end, "sil",      a, &a->sil_valid,      CHANGED_SIL,      "%u", a->sil);
         }
         if (trackDataValid(&a->sil_valid) && (forceEmit || a->sil_type != a->fatsv_emitted_sil_type)) {
-            p = appendFATSVMeta(p, end, "sil_type",    a, &a->sil_valid,           "%s",       sil_type_enum_string(a->sil_type));
+            p = appendFATSVMeta(p, end, "sil_type", a, &a->sil_valid,      CHANGED_SIL,      "%s", sil_type_enum_string(a->sil_type));
         }
         if (trackDataValid(&a->nic_baro_valid) && (forceEmit || a->nic_baro != a->fatsv_emitted_nic_baro)) {
-            p = appendFATSVMeta(p, end, "nic_baro",    a, &a->nic_baro_valid,      "%u",       a->nic_baro);
+            p = appendFATSVMeta(p, end, "nic_baro", a, &a->nic_baro_valid, CHANGED_NIC_BARO, "%u", a->nic_baro);
         }
 
         // only emit alt, speed, latlon, track etc if they have been received since the last time
@@ -2371,36 +2713,36 @@ static void writeFATSV()
 
         // special cases
         if (airgroundValid)
-            p = appendFATSVMeta(p, end, "airGround", a, &a->airground_valid,      "%s",   airground_enum_string(a->airground));
+            p = appendFATSVMeta(p, end, "airGround",        a, &a->airground_valid,        CHANGED_AIRGROUND,        "%s",                airground_enum_string(a->airground));
         if (squawkValid)
-            p = appendFATSVMeta(p, end, "squawk", a, &a->squawk_valid,        "%04x", a->squawk);
+            p = appendFATSVMeta(p, end, "squawk",           a, &a->squawk_valid,           CHANGED_SQUAWK,           "%04x",              a->squawk);
         if (callsignValid)
-            p = appendFATSVMeta(p, end, "ident", a, &a->callsign_valid,       "{%s}", a->callsign);
+            p = appendFATSVMeta(p, end, "ident",            a, &a->callsign_valid,         CHANGED_CALLSIGN,         "{%s}",              a->callsign);
         if (altValid)
-            p = appendFATSVMeta(p, end, "alt",   a, &a->altitude_baro_valid,  "%d",   a->altitude_baro);
+            p = appendFATSVMeta(p, end, "alt",              a, &a->altitude_baro_valid,    CHANGED_ALTITUDE_BARO,    "%d",                a->altitude_baro);
         if (positionValid) {
-            p = appendFATSVMeta(p, end, "position", a, &a->position_valid,  "{%.5f %.5f %u %u}", a->lat, a->lon, a->pos_nic, a->pos_rc);
+            p = appendFATSVMeta(p, end, "position",         a, &a->position_valid,         CHANGED_POSITION,         "{%.5f %.5f %u %u}", a->lat, a->lon, a->pos_nic, a->pos_rc);
         }
 
-        p = appendFATSVMeta(p, end, "alt_gnss",    a, &a->altitude_geom_valid,  "%d",   a->altitude_geom);
-        p = appendFATSVMeta(p, end, "vrate",       a, &a->baro_rate_valid,      "%d",   a->baro_rate);
-        p = appendFATSVMeta(p, end, "vrate_geom",  a, &a->geom_rate_valid,      "%d",   a->geom_rate);
-        p = appendFATSVMeta(p, end, "speed",       a, &a->gs_valid,             "%.1f", a->gs);
-        p = appendFATSVMeta(p, end, "speed_ias",   a, &a->ias_valid,            "%u",   a->ias);
-        p = appendFATSVMeta(p, end, "speed_tas",   a, &a->tas_valid,            "%u",   a->tas);
-        p = appendFATSVMeta(p, end, "mach",        a, &a->mach_valid,           "%.3f", a->mach);
-        p = appendFATSVMeta(p, end, "track",       a, &a->track_valid,          "%.1f", a->track);
-        p = appendFATSVMeta(p, end, "track_rate",  a, &a->track_rate_valid,     "%.2f", a->track_rate);
-        p = appendFATSVMeta(p, end, "roll",        a, &a->roll_valid,           "%.1f", a->roll);
-        p = appendFATSVMeta(p, end, "heading_magnetic", a, &a->mag_heading_valid, "%.1f", a->mag_heading);
-        p = appendFATSVMeta(p, end, "heading_true", a, &a->true_heading_valid,    "%.1f", a->true_heading);
-        p = appendFATSVMeta(p, end, "nav_alt_mcp", a, &a->nav_altitude_mcp_valid, "%u",   a->nav_altitude_mcp);
-        p = appendFATSVMeta(p, end, "nav_alt_fms", a, &a->nav_altitude_fms_valid, "%u",   a->nav_altitude_fms);
-        p = appendFATSVMeta(p, end, "nav_alt_src", a, &a->nav_altitude_src_valid, "%s", nav_altitude_source_enum_string(a->nav_altitude_src));
-        p = appendFATSVMeta(p, end, "nav_heading", a, &a->nav_heading_valid,   "%.1f", a->nav_heading);
-        p = appendFATSVMeta(p, end, "nav_modes",   a, &a->nav_modes_valid,     "{%s}", nav_modes_flags_string(a->nav_modes));
-        p = appendFATSVMeta(p, end, "nav_qnh",     a, &a->nav_qnh_valid,       "%.1f", a->nav_qnh);
-        p = appendFATSVMeta(p, end, "emergency",   a, &a->emergency_valid,     "%s",   emergency_enum_string(a->emergency));
+        p = appendFATSVMeta(p, end, "alt_gnss",         a, &a->altitude_geom_valid,    CHANGED_ALTITUDE_GEOM,    "%d",                a->altitude_geom);
+        p = appendFATSVMeta(p, end, "vrate",            a, &a->baro_rate_valid,        CHANGED_BARO_RATE,        "%d",                a->baro_rate);
+        p = appendFATSVMeta(p, end, "vrate_geom",       a, &a->geom_rate_valid,        CHANGED_GEOM_RATE,        "%d",                a->geom_rate);
+        p = appendFATSVMeta(p, end, "speed",            a, &a->gs_valid,               CHANGED_GS,               "%.1f",              a->gs);
+        p = appendFATSVMeta(p, end, "speed_ias",        a, &a->ias_valid,              CHANGED_IAS,              "%u",                a->ias);
+        p = appendFATSVMeta(p, end, "speed_tas",        a, &a->tas_valid,              CHANGED_TAS,              "%u",                a->tas);
+        p = appendFATSVMeta(p, end, "mach",             a, &a->mach_valid,             CHANGED_MACH,             "%.3f",              a->mach);
+        p = appendFATSVMeta(p, end, "track",            a, &a->track_valid,            CHANGED_TRACK,            "%.1f",              a->track);
+        p = appendFATSVMeta(p, end, "track_rate",       a, &a->track_rate_valid,       CHANGED_TRACK_RATE,       "%.2f",              a->track_rate);
+        p = appendFATSVMeta(p, end, "roll",             a, &a->roll_valid,             CHANGED_ROLL,             "%.1f",              a->roll);
+        p = appendFATSVMeta(p, end, "heading_magnetic", a, &a->mag_heading_valid,      CHANGED_MAG_HEADING,      "%.1f",              a->mag_heading);
+        p = appendFATSVMeta(p, end, "heading_true",     a, &a->true_heading_valid,     CHANGED_TRUE_HEADING,     "%.1f",              a->true_heading);
+        p = appendFATSVMeta(p, end, "nav_alt_mcp",      a, &a->nav_altitude_mcp_valid, CHANGED_NAV_ALTITUDE_MCP, "%u",                a->nav_altitude_mcp);
+        p = appendFATSVMeta(p, end, "nav_alt_fms",      a, &a->nav_altitude_fms_valid, CHANGED_NAV_ALTITUDE_FMS, "%u",                a->nav_altitude_fms);
+        p = appendFATSVMeta(p, end, "nav_alt_src",      a, &a->nav_altitude_src_valid, CHANGED_NAV_ALTITUDE_SRC, "%s",                nav_altitude_source_enum_string(a->nav_altitude_src));
+        p = appendFATSVMeta(p, end, "nav_heading",      a, &a->nav_heading_valid,      CHANGED_NAV_HEADING,      "%.1f",              a->nav_heading);
+        p = appendFATSVMeta(p, end, "nav_modes",        a, &a->nav_modes_valid,        CHANGED_NAV_MODES,        "{%s}",              nav_modes_flags_string(a->nav_modes));
+        p = appendFATSVMeta(p, end, "nav_qnh",          a, &a->nav_qnh_valid,          CHANGED_NAV_QNH,          "%.1f",              a->nav_qnh);
+        p = appendFATSVMeta(p, end, "emergency",        a, &a->emergency_valid,        CHANGED_EMERGENCY,        "%s",                emergency_enum_string(a->emergency));
 
         // if we didn't get anything interesting, bail out.
         // We don't need to do anything special to unwind prepareWrite().
@@ -2451,6 +2793,13 @@ static void writeFATSV()
         if (forceEmit) {
             a->fatsv_last_force_emit = now;
         }
+
+        // Anything written in this same millisecond counts as updated
+        // again next time, so keep those aircraft queued.
+        if (a->seen < now) {
+            a->fatsv_changed = 0;
+            trackClearDirty(a);
+        }
     }
 }
 
@@ -2470,7 +2819,7 @@ void modesNetPeriodicWork(void) {
     for (c = Modes.clients; c; c = c->next) {
         if (!c->service)
             continue;
-        if (c->service->read_handler)
+        if (c->service->read_handler && !c->udp)
             modesReadFromClient(c);
     }
 
@@ -2499,6 +2848,7 @@ void modesNetPeriodicWork(void) {
             flushWrites(s->writer);
         }
     }
+    flushHeldClients(now);
 
     // Unlink and free closed clients
     for (prev = &Modes.clients, c = *prev; c; c = *prev) {
@@ -42,6 +42,7 @@ typedef enum {
     READ_MODE_IGNORE,
     READ_MODE_BEAST,
     READ_MODE_BEAST_COMMAND,
+    READ_MODE_AVR,
     READ_MODE_ASCII
 } read_mode_t;
 
@@ -53,6 +54,7 @@ struct net_service {
     int *listener_fds;   // listening FDs
 
     int connections;     // number of active clients
+    int queued_clients;  // how many of them have their own output queue
 
     struct net_writer *writer; // shared writer state
 
@@ -65,10 +67,33 @@ struct net_service {
 struct client {
     struct client*  next;                // Pointer to next client
     int    fd;                           // File descriptor
+    int    receiverId;                   // identifies this client's messages to dedupCheck; never reused, unlike fd
     struct net_service *service;         // Service this client is part of
     int    buflen;                       // Amount of data on buffer
     char   buf[MODES_CLIENT_BUF_SIZE+1]; // Read buffer
     int    modeac_requested;             // 1 if this Beast output connection has asked for A/C
+    struct net_filter *filter;           // what this output connection asked for, or NULL for everything
+    char  *queue;                        // if filtered or UDP, the output queued for this client alone
+    int    queue_used;                   // amount of data in queue
+    int    queue_size;                   // how much the queue holds before it must be sent
+    uint64_t queue_since;                // when the oldest data in the queue was queued
+    int    udp;                          // 1 if this is a UDP output, sending datagrams of up to queue_size
+    uint32_t udp_seq;                    // sequence number of the next datagram
+    struct z_stream_s *zout;             // if this Beast output client asked for compression, its deflate stream
+    uint64_t zout_sync;                  // when zout was last flushed through to the socket
+    int    zout_pending;                 // is there data in zout that has not been flushed?
+    struct z_stream_s *zin;              // if this Beast input is compressed, its inflate stream
+    unsigned char *zin_buf;              // if we asked for a compressed Beast input, the data read from the socket
+};
+
+// The per-message output formats, in the order modesQueueOutput feeds them
+enum net_output_format {
+    NET_OUTPUT_SBS,
+    NET_OUTPUT_RAW,
+    NET_OUTPUT_BEAST_VERBATIM,
+    NET_OUTPUT_BEAST_COOKED,
+    NET_OUTPUT_FATSV,
+    NET_OUTPUT_FORMATS
 };
 
 // Common writer state for all output sockets of one type
@@ -83,6 +108,7 @@ struct net_writer {
 struct net_service *serviceInit(const char *descr, struct net_writer *writer, heartbeat_fn hb_handler, read_mode_t mode, const char *sep, read_fn read_handler);
 struct client *serviceConnect(struct net_service *service, char *addr, int port);
 void serviceListen(struct net_service *service, char *bind_addr, char *bind_ports);
+struct client *serviceSendUdp(struct net_service *service, const char *target);
 struct client *createSocketClient(struct net_service *service, int fd);
 struct client *createGenericClient(struct net_service *service, int fd);
 
@@ -91,8 +117,11 @@ struct net_service *makeBeastInputService(void);
 struct net_service *makeFatsvOutputService(void);
 
 void sendBeastSettings(struct client *c, const char *settings);
+void requestBeastCompression(struct client *c);
 
 void modesInitNet(void);
+int modesNetWantsDecodedFields(void);
+const char *netOutputFormatName(enum net_output_format f);
 void modesQueueOutput(struct modesMessage *mm, struct aircraft *a);
 void modesNetPeriodicWork(void);
 
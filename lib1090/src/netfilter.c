@@ -0,0 +1,223 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// netfilter.c: per-connection output filters
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "dump1090.h"
+
+// Filters are parsed once, when a client sends one, and then checked
+// against every message that client's output format produces, so the
+// match side is kept cheap: a bit test for the DF, a binary search of
+// the sorted address list, and a couple of comparisons.
+
+static int compareAddr(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+// Parse the next number of a comma-separated list that ends at 'end',
+// advancing *p past it and its comma. Returns 0 if it is malformed.
+static int nextNumber(const char **p, const char *end, int base, double *out)
+{
+    char *next;
+    double v = (base == 16 ? (double) strtoul(*p, &next, 16) : strtod(*p, &next));
+
+    if (next == *p || next > end || !isfinite(v))
+        return 0;
+    if (next < end) {
+        if (*next != ',' || next + 1 == end)
+            return 0;
+        ++next;
+    }
+
+    *p = next;
+    *out = v;
+    return 1;
+}
+
+// Parse a list of up to 'max' numbers, returning the count or -1
+static int parseList(const char *p, const char *end, double *out, int max)
+{
+    int n = 0;
+
+    while (p < end) {
+        if (n == max || !nextNumber(&p, end, 10, &out[n]))
+            return -1;
+        ++n;
+    }
+
+    return n;
+}
+
+static int parseAddrs(struct net_filter *filter, const char *p, const char *end)
+{
+    unsigned n = 0, size = 0;
+
+    while (p < end) {
+        double v;
+        if (!nextNumber(&p, end, 16, &v) || v > 0xFFFFFF)
+            return -1;
+
+        if (n == size) {
+            size = (size ? size * 2 : 16);
+            if (!(filter->addrs = realloc(filter->addrs, size * sizeof(*filter->addrs)))) {
+                fprintf(stderr, "Out of memory allocating a net filter\n");
+                exit(1);
+            }
+        }
+        filter->addrs[n++] = (uint32_t) v;
+    }
+
+    qsort(filter->addrs, n, sizeof(*filter->addrs), compareAddr);
+    filter->addr_count = n;
+    return 0;
+}
+
+static int parseTerm(struct net_filter *filter, const char *term, const char *end)
+{
+    const char *eq = memchr(term, '=', end - term);
+    double v[4];
+
+    if (!eq || eq + 1 == end)
+        return -1;
+
+    size_t keylen = eq - term;
+    const char *value = eq + 1;
+
+#define KEY(k) (keylen == sizeof(k) - 1 && !strncmp(term, k, keylen))
+
+    if (KEY("icao")) {
+        return parseAddrs(filter, value, end);
+    } else if (KEY("df")) {
+        for (const char *p = value; p < end; ) {
+            if (!nextNumber(&p, end, 10, &v[0]) || v[0] < 0 || v[0] > 31 || v[0] != (int) v[0])
+                return -1;
+            filter->df_mask |= 1U << (int) v[0];
+        }
+        return 0;
+    } else if (KEY("bbox")) {
+        if (parseList(value, end, v, 4) != 4)
+            return -1;
+        if (fabs(v[0]) > 90 || fabs(v[2]) > 90 || fabs(v[1]) > 180 || fabs(v[3]) > 180)
+            return -1;
+        filter->have_bbox = 1;
+        filter->lat_min = (v[0] < v[2] ? v[0] : v[2]);
+        filter->lat_max = (v[0] < v[2] ? v[2] : v[0]);
+        filter->lon_min = v[1];
+        filter->lon_max = v[3];
+        return 0;
+    } else if (KEY("signal")) {
+        if (parseList(value, end, v, 1) != 1 || v[0] > 0)
+            return -1;
+        filter->have_signal = 1;
+        filter->min_signal = pow(10, v[0] / 10);
+        return 0;
+    }
+
+#undef KEY
+
+    return -1;
+}
+
+struct net_filter *netFilterParse(const char *spec, int *error)
+{
+    struct net_filter *filter;
+
+    if (!(filter = calloc(1, sizeof(*filter)))) {
+        fprintf(stderr, "Out of memory allocating a net filter\n");
+        exit(1);
+    }
+
+    *error = 0;
+    for (const char *p = spec; *p; ) {
+        if (isspace((unsigned char) *p)) {
+            ++p;
+            continue;
+        }
+
+        const char *end = p;
+        while (*end && !isspace((unsigned char) *end))
+            ++end;
+
+        if (parseTerm(filter, p, end) < 0) {
+            *error = 1;
+            netFilterFree(filter);
+            return NULL;
+        }
+
+        p = end;
+    }
+
+    if (!filter->addr_count && !filter->df_mask && !filter->have_bbox && !filter->have_signal) {
+        // matches everything
+        netFilterFree(filter);
+        return NULL;
+    }
+
+    return filter;
+}
+
+void netFilterFree(struct net_filter *filter)
+{
+    if (!filter)
+        return;
+    free(filter->addrs);
+    free(filter);
+}
+
+int netFilterNeedsFields(const struct net_filter *filter)
+{
+    return filter->have_bbox;
+}
+
+int netFilterMatch(const struct net_filter *filter, const struct modesMessage *mm, const struct aircraft *a)
+{
+    if (filter->df_mask && (mm->msgtype > 31 || !(filter->df_mask & (1U << mm->msgtype))))
+        return 0;
+
+    if (filter->have_signal && mm->signalLevel < filter->min_signal)
+        return 0;
+
+    if (filter->addr_count && !bsearch(&mm->addr, filter->addrs, filter->addr_count, sizeof(*filter->addrs), compareAddr))
+        return 0;
+
+    if (filter->have_bbox) {
+        double lat, lon;
+
+        if (mm->cpr_decoded) {
+            lat = mm->decoded_lat;
+            lon = mm->decoded_lon;
+        } else if (a && trackDataValid(&a->position_valid)) {
+            lat = a->lat;
+            lon = a->lon;
+        } else {
+            return 0;
+        }
+
+        if (lat < filter->lat_min || lat > filter->lat_max)
+            return 0;
+        if (filter->lon_min <= filter->lon_max) {
+            if (lon < filter->lon_min || lon > filter->lon_max)
+                return 0;
+        } else {
+            // box crosses the antimeridian
+            if (lon < filter->lon_min && lon > filter->lon_max)
+                return 0;
+        }
+    }
+
+    return 1;
+}
@@ -0,0 +1,61 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// netfilter.h: per-connection output filters
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DUMP1090_NETFILTER_H
+#define DUMP1090_NETFILTER_H
+
+#include <stdint.h>
+
+struct modesMessage;
+struct aircraft;
+
+// What an output client asked to be sent. Every criterion that is
+// given must match; a filter with none matches everything.
+struct net_filter {
+    uint32_t *addrs;        // sorted ICAO addresses, or NULL for any
+    unsigned  addr_count;
+    uint32_t  df_mask;      // bit N set = DF N wanted, 0 for any
+    int       have_bbox;    // position must lie in the box below
+    double    lat_min, lat_max;
+    double    lon_min, lon_max;   // lon_min > lon_max crosses 180
+    int       have_signal;  // signal must be at least min_signal
+    double    min_signal;   // as a fraction of full-scale power
+};
+
+// Parse a filter spec: space-separated terms of
+//
+//   icao=HEX[,HEX...]         only these aircraft
+//   df=N[,N...]               only these downlink formats
+//   bbox=LAT1,LON1,LAT2,LON2  only positions in this box, from west
+//                             edge LON1 east to LON2 (so LON1 > LON2
+//                             is a box that crosses 180)
+//   signal=DBFS               only messages at least this strong
+//
+// Returns a new filter, or NULL if the spec is malformed or matches
+// everything (an empty spec clears the client's filter).
+// *error is set to 1 in the malformed case, 0 otherwise.
+struct net_filter *netFilterParse(const char *spec, int *error);
+void netFilterFree(struct net_filter *filter);
+
+// Does this message (and the aircraft it updated, which may be NULL)
+// pass the filter?
+int netFilterMatch(const struct net_filter *filter, const struct modesMessage *mm, const struct aircraft *a);
+
+// Does the filter look at decoded positions / aircraft state?
+int netFilterNeedsFields(const struct net_filter *filter);
+
+#endif
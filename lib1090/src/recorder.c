@@ -0,0 +1,282 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// recorder.c: compressed raw IQ recording (--record)
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "dump1090.h"
+
+#include <inttypes.h>
+#include <zlib.h>
+
+// Blocks that may be waiting for the writer thread (must be a power of two)
+#define RECORDER_QUEUE_BLOCKS 32
+
+// Raw IQ is mostly noise, so there is little to gain from a slower level
+#define RECORDER_ZLIB_LEVEL Z_BEST_SPEED
+
+struct recorder_block {
+    uint8_t *data;
+    size_t len;
+    size_t alloc;
+    uint64_t first_sample;
+};
+
+struct recorder {
+    char *path;
+    FILE *out;
+    unsigned bytes_per_sample;
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool stop;
+
+    // Filled by the reader thread at 'head', drained by the writer at 'tail'
+    struct recorder_block queue[RECORDER_QUEUE_BLOCKS];
+    unsigned head;
+    unsigned tail;
+
+    uint64_t next_sample;        // reader thread only
+
+    // counters, reported on close
+    uint64_t frames;
+    uint64_t dropped;
+    uint64_t raw_bytes;
+    uint64_t compressed_bytes;
+    bool failed;
+};
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = v; p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    put_le16(p, v); put_le16(p + 2, v >> 16);
+}
+
+static void put_le64(uint8_t *p, uint64_t v)
+{
+    put_le32(p, v); put_le32(p + 4, v >> 32);
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint64_t get_le64(const uint8_t *p)
+{
+    return get_le32(p) | ((uint64_t) get_le32(p + 4) << 32);
+}
+
+//
+// Writer thread: compress each queued block into its own frame
+//
+static void *recorderThread(void *arg)
+{
+    struct recorder *rec = arg;
+    uint8_t *zbuf = NULL;
+    uLong zbuf_size = 0;
+
+    pthread_mutex_lock(&rec->mutex);
+    for (;;) {
+        struct recorder_block *block;
+        uint8_t header[RECORDER_FRAME_HEADER_SIZE];
+        uLongf zlen;
+
+        if (rec->tail == rec->head) {
+            if (rec->stop)
+                break;
+            pthread_cond_wait(&rec->cond, &rec->mutex);
+            continue;
+        }
+
+        block = &rec->queue[rec->tail % RECORDER_QUEUE_BLOCKS];
+        pthread_mutex_unlock(&rec->mutex);
+
+        if (compressBound(block->len) > zbuf_size) {
+            zbuf_size = compressBound(block->len);
+            if (!(zbuf = realloc(zbuf, zbuf_size))) {
+                fprintf(stderr, "record: out of memory\n");
+                exit(1);
+            }
+        }
+
+        zlen = zbuf_size;
+        if (!rec->failed && compress2(zbuf, &zlen, block->data, block->len, RECORDER_ZLIB_LEVEL) == Z_OK) {
+            memcpy(header, RECORDER_FRAME_MAGIC, 4);
+            put_le32(header + 4, zlen);
+            put_le32(header + 8, block->len);
+            put_le64(header + 12, block->first_sample);
+
+            if (fwrite(header, sizeof(header), 1, rec->out) != 1 || fwrite(zbuf, zlen, 1, rec->out) != 1) {
+                fprintf(stderr, "record: error writing %s: %s\n", rec->path, strerror(errno));
+                rec->failed = true;
+            } else {
+                rec->frames++;
+                rec->raw_bytes += block->len;
+                rec->compressed_bytes += sizeof(header) + zlen;
+            }
+        }
+
+        pthread_mutex_lock(&rec->mutex);
+        rec->tail++;
+    }
+    pthread_mutex_unlock(&rec->mutex);
+
+    free(zbuf);
+    return NULL;
+}
+
+bool recorderOpen(struct receiver *rx, const char *path, input_format_t format, double sample_rate)
+{
+    struct recorder *rec;
+    uint8_t header[RECORDER_HEADER_SIZE];
+
+    if (!(rec = calloc(1, sizeof(*rec))) || !(rec->path = strdup(path))) {
+        fprintf(stderr, "record: out of memory\n");
+        exit(1);
+    }
+
+    rec->bytes_per_sample = (format == INPUT_UC8 ? 2 : 4);
+    if (!(rec->out = fopen(path, "wb"))) {
+        fprintf(stderr, "record: could not open %s: %s\n", path, strerror(errno));
+        free(rec->path);
+        free(rec);
+        return false;
+    }
+
+    memcpy(header, RECORDER_MAGIC, 8);
+    header[8] = RECORDER_VERSION;
+    header[9] = format;
+    put_le16(header + 10, 0);
+    put_le32(header + 12, (uint32_t) sample_rate);
+    if (fwrite(header, sizeof(header), 1, rec->out) != 1) {
+        fprintf(stderr, "record: error writing %s: %s\n", path, strerror(errno));
+        fclose(rec->out);
+        free(rec->path);
+        free(rec);
+        return false;
+    }
+
+    pthread_mutex_init(&rec->mutex, NULL);
+    pthread_cond_init(&rec->cond, NULL);
+    if (pthread_create(&rec->thread, NULL, recorderThread, rec)) {
+        fprintf(stderr, "record: failed to start writer thread\n");
+        exit(1);
+    }
+
+    rx->recorder = rec;
+    return true;
+}
+
+void recorderWrite(struct recorder *rec, const void *data, size_t bytes)
+{
+    struct recorder_block *block;
+    uint64_t first_sample = rec->next_sample;
+
+    rec->next_sample += bytes / rec->bytes_per_sample;
+
+    pthread_mutex_lock(&rec->mutex);
+    if (rec->head - rec->tail >= RECORDER_QUEUE_BLOCKS) {
+        // writer has fallen behind; never stall the sample path
+        rec->dropped++;
+        pthread_mutex_unlock(&rec->mutex);
+        return;
+    }
+    block = &rec->queue[rec->head % RECORDER_QUEUE_BLOCKS];
+    pthread_mutex_unlock(&rec->mutex);
+
+    // The writer never touches slots between tail and head, so this is safe unlocked.
+    // Buffers only grow, so after the first pass round the queue there are no allocations.
+    if (bytes > block->alloc) {
+        if (!(block->data = realloc(block->data, bytes))) {
+            fprintf(stderr, "record: out of memory\n");
+            exit(1);
+        }
+        block->alloc = bytes;
+    }
+    memcpy(block->data, data, bytes);
+    block->len = bytes;
+    block->first_sample = first_sample;
+
+    pthread_mutex_lock(&rec->mutex);
+    rec->head++;
+    pthread_cond_signal(&rec->cond);
+    pthread_mutex_unlock(&rec->mutex);
+}
+
+void recorderClose(struct receiver *rx)
+{
+    struct recorder *rec = rx->recorder;
+
+    if (!rec)
+        return;
+
+    pthread_mutex_lock(&rec->mutex);
+    rec->stop = true;
+    pthread_cond_signal(&rec->cond);
+    pthread_mutex_unlock(&rec->mutex);
+    pthread_join(rec->thread, NULL);
+
+    if (fclose(rec->out) != 0 && !rec->failed)
+        fprintf(stderr, "record: error writing %s: %s\n", rec->path, strerror(errno));
+
+    log_with_timestamp("Recorded %" PRIu64 " frames to %s: %.1f MB raw, %.1f MB written (%.2f:1), %" PRIu64 " blocks dropped",
+                       rec->frames, rec->path,
+                       rec->raw_bytes / 1e6, rec->compressed_bytes / 1e6,
+                       rec->compressed_bytes ? (double) rec->raw_bytes / rec->compressed_bytes : 0.0,
+                       rec->dropped);
+
+    for (unsigned i = 0; i < RECORDER_QUEUE_BLOCKS; ++i)
+        free(rec->queue[i].data);
+    pthread_mutex_destroy(&rec->mutex);
+    pthread_cond_destroy(&rec->cond);
+    free(rec->path);
+    free(rec);
+    rx->recorder = NULL;
+}
+
+bool recorderParseHeader(const uint8_t *buf, input_format_t *format, double *sample_rate)
+{
+    if (memcmp(buf, RECORDER_MAGIC, 8) || buf[8] != RECORDER_VERSION)
+        return false;
+
+    switch (buf[9]) {
+    case INPUT_UC8:
+    case INPUT_SC16:
+    case INPUT_SC16Q11:
+        *format = buf[9];
+        break;
+    default:
+        return false;
+    }
+
+    *sample_rate = get_le32(buf + 12);
+    return true;
+}
+
+bool recorderParseFrameHeader(const uint8_t *buf, struct recorder_frame *frame)
+{
+    if (memcmp(buf, RECORDER_FRAME_MAGIC, 4))
+        return false;
+
+    frame->compressed_len = get_le32(buf + 4);
+    frame->raw_len = get_le32(buf + 8);
+    frame->first_sample = get_le64(buf + 12);
+    return true;
+}
@@ -0,0 +1,59 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// recorder.h: compressed raw IQ recording (--record) and its file format
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DUMP1090_RECORDER_H
+#define DUMP1090_RECORDER_H
+
+// File layout (all integers little-endian):
+//
+//   header:  "D1090IQZ" u8 version, u8 input format, u16 reserved, u32 sample rate (Hz)
+//   frames:  "IQZF" u32 compressed length, u32 raw length, u64 first sample,
+//            followed by one complete zlib stream
+//
+// Every frame is compressed on its own, so a reader can seek to any frame
+// by walking the frame headers without decompressing anything.
+
+#define RECORDER_MAGIC "D1090IQZ"
+#define RECORDER_VERSION 1
+#define RECORDER_HEADER_SIZE 16
+#define RECORDER_FRAME_MAGIC "IQZF"
+#define RECORDER_FRAME_HEADER_SIZE 20
+
+struct recorder;
+struct receiver;
+
+struct recorder_frame {
+    uint32_t compressed_len;
+    uint32_t raw_len;
+    uint64_t first_sample;
+};
+
+// Start recording the raw samples of 'rx' to 'path', if --record was given
+bool recorderOpen(struct receiver *rx, const char *path, input_format_t format, double sample_rate);
+
+// Queue raw samples for the writer thread; called from the reader thread.
+// Never blocks: if the writer has fallen behind, the block is dropped and counted.
+void recorderWrite(struct recorder *rec, const void *data, size_t bytes);
+
+// Flush pending blocks, stop the writer thread and report what was written
+void recorderClose(struct receiver *rx);
+
+// Replay helpers for sdr_ifile
+bool recorderParseHeader(const uint8_t *buf, input_format_t *format, double *sample_rate);
+bool recorderParseFrameHeader(const uint8_t *buf, struct recorder_frame *frame);
+
+#endif
@@ -0,0 +1,336 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// sbs.c: BaseStation (port 30003) output formatting
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "dump1090.h"
+
+//
+// SBS BS style output checked against the following reference
+// http://www.homepages.mcb.net/bones/SBS/Article/Barebones42_Socket_Data.htm - seems comprehensive
+//
+// Every line is one message, so this runs at the full message rate. The
+// output is byte-for-byte what the printf formats in the comments below
+// would give, but built with the small formatters here: the date and time
+// only change once a second, so they are cached, and the numbers are all
+// integers or fixed point with a known number of decimals.
+//
+
+int sbsMessageType(const struct modesMessage *mm, const struct aircraft *a)
+{
+    // We require a tracked aircraft for SBS output
+    if (!a)
+        return 0;
+
+    // Don't ever forward 2-bit-corrected messages via SBS output.
+    if (mm->correctedbits >= 2)
+        return 0;
+
+    // Don't ever forward mlat messages via SBS output.
+    if (mm->source == SOURCE_MLAT)
+        return 0;
+
+    // Don't ever send unreliable messages via SBS output
+    if (!mm->reliable && !a->reliable)
+        return 0;
+
+    // For now, suppress non-ICAO addresses
+    if (mm->addr & MODES_NON_ICAO_ADDRESS)
+        return 0;
+
+    // Decide on the basic SBS Message Type
+    switch (mm->msgtype) {
+        case 4:
+        case 20:
+            return 5;
+
+        case 5:
+        case 21:
+            return 6;
+
+        case 0:
+        case 16:
+            return 7;
+
+        case 11:
+            return 8;
+
+        case 17:
+        case 18:
+            if (mm->metype >= 1 && mm->metype <= 4) {
+                return 1;
+            } else if (mm->metype >= 5 && mm->metype <=  8) {
+                return 2;
+            } else if (mm->metype >= 9 && mm->metype <= 18) {
+                return 3;
+            } else if (mm->metype == 19) {
+                return 4;
+            } else {
+                return 0;
+            }
+
+        default:
+            return 0;
+    }
+}
+
+// "%0<width>u"
+static inline char *putUnsigned(char *p, unsigned long long v, int width)
+{
+    char digits[20];
+    int n = 0;
+
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+
+    while (width-- > n)
+        *p++ = '0';
+    while (n)
+        *p++ = digits[--n];
+    return p;
+}
+
+// "%d"
+static inline char *putInt(char *p, int v)
+{
+    if (v < 0) {
+        *p++ = '-';
+        return putUnsigned(p, -(long long) v, 1);
+    }
+    return putUnsigned(p, v, 1);
+}
+
+// "%0<width>X" or "%0<width>x"
+static inline char *putHex(char *p, unsigned v, int width, const char *digits)
+{
+    char buf[8];
+    int n = 0;
+
+    do {
+        buf[n++] = digits[v & 15];
+        v >>= 4;
+    } while (v);
+
+    while (width-- > n)
+        *p++ = '0';
+    while (n)
+        *p++ = buf[--n];
+    return p;
+}
+
+// "%.<decimals>f", for 0..6 decimals. printf rounds the exact binary value
+// to nearest, ties to even. Scaling by 10^decimals can itself round, which
+// only matters when the scaled value lands (almost) exactly on a tie, so in
+// that case, and for anything too big for an integer, use printf itself.
+static char *putFixed(char *p, double v, int decimals)
+{
+    static const double scales[] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+    double scaled = v * scales[decimals];
+    double rounded, frac;
+    unsigned long long n;
+
+    if (!(fabs(scaled) < 1e15))
+        return p + sprintf(p, "%.*f", decimals, v);
+
+    frac = fabs(scaled - trunc(scaled));
+    if (decimals > 0 && fabs(frac - 0.5) < 1e-6)
+        return p + sprintf(p, "%.*f", decimals, v);
+
+    rounded = nearbyint(scaled);
+    if (signbit(rounded))
+        *p++ = '-';
+    n = (unsigned long long) fabs(rounded);
+
+    if (decimals == 0)
+        return putUnsigned(p, n, 1);
+
+    p = putUnsigned(p, n / (unsigned long long) scales[decimals], 1);
+    *p++ = '.';
+    return putUnsigned(p, n % (unsigned long long) scales[decimals], decimals);
+}
+
+// "%04d/%02d/%02d,%02d:%02d:%02d" of the local time, for the last second
+// asked for
+struct sbs_time_cache {
+    time_t when;
+    int valid;
+    char text[32];
+    int len;
+};
+
+static _Thread_local struct sbs_time_cache receive_cache, now_cache;
+
+static char *putDateTime(char *p, struct sbs_time_cache *cache, time_t when)
+{
+    if (!cache->valid || cache->when != when) {
+        struct tm tm;
+        char *q = cache->text;
+
+        localtime_r(&when, &tm);
+        q = putUnsigned(q, tm.tm_year + 1900, 4);
+        *q++ = '/';
+        q = putUnsigned(q, tm.tm_mon + 1, 2);
+        *q++ = '/';
+        q = putUnsigned(q, tm.tm_mday, 2);
+        *q++ = ',';
+        q = putUnsigned(q, tm.tm_hour, 2);
+        *q++ = ':';
+        q = putUnsigned(q, tm.tm_min, 2);
+        *q++ = ':';
+        q = putUnsigned(q, tm.tm_sec, 2);
+
+        cache->len = q - cache->text;
+        cache->when = when;
+        cache->valid = 1;
+    }
+
+    memcpy(p, cache->text, cache->len);
+    return p + cache->len;
+}
+
+static inline char *putString(char *p, const char *s)
+{
+    while (*s)
+        *p++ = *s++;
+    return p;
+}
+
+char *sbsFormatMessage(char *p, int msgType, const struct modesMessage *mm,
+                       const struct aircraft *a, const struct timespec *now)
+{
+    static const char upper[] = "0123456789ABCDEF";
+    static const char lower[] = "0123456789abcdef";
+
+    // Fields 1 to 6 : SBS message type and ICAO address of the aircraft and some other stuff
+    // "MSG,%d,1,1,%06X,1,"
+    p = putString(p, "MSG,");
+    p = putInt(p, msgType);
+    p = putString(p, ",1,1,");
+    p = putHex(p, mm->addr, 6, upper);
+    p = putString(p, ",1,");
+
+    // Fields 7 & 8 are the message reception time and date
+    // "%04d/%02d/%02d,%02d:%02d:%02d.%03u,"
+    p = putDateTime(p, &receive_cache, (time_t) (mm->sysTimestampMsg / 1000));
+    *p++ = '.';
+    p = putUnsigned(p, mm->sysTimestampMsg % 1000, 3);
+    *p++ = ',';
+
+    // Fields 9 & 10 are the current time and date
+    p = putDateTime(p, &now_cache, now->tv_sec);
+    *p++ = '.';
+    p = putUnsigned(p, now->tv_nsec / 1000000U, 3);
+
+    // Field 11 is the callsign (if we have it)
+    *p++ = ',';
+    if (mm->callsign_valid)
+        p = putString(p, mm->callsign);
+
+    // Field 12 is the altitude (if we have it)
+    *p++ = ',';
+    if (Modes.use_gnss) {
+        if (mm->altitude_geom_valid) {
+            p = putInt(p, mm->altitude_geom);
+            *p++ = 'H';
+        } else if (mm->altitude_baro_valid && trackDataValid(&a->geom_delta_valid)) {
+            p = putInt(p, mm->altitude_baro + a->geom_delta);
+            *p++ = 'H';
+        } else if (mm->altitude_baro_valid) {
+            p = putInt(p, mm->altitude_baro);
+        }
+    } else {
+        if (mm->altitude_baro_valid) {
+            p = putInt(p, mm->altitude_baro);
+        } else if (mm->altitude_geom_valid && trackDataValid(&a->geom_delta_valid)) {
+            p = putInt(p, mm->altitude_geom - a->geom_delta);
+        }
+    }
+
+    // Field 13 is the ground Speed (if we have it)
+    *p++ = ',';
+    if (mm->gs_valid)
+        p = putFixed(p, mm->gs.selected, 0);
+
+    // Field 14 is the ground Heading (if we have it)
+    *p++ = ',';
+    if (mm->heading_valid && mm->heading_type == HEADING_GROUND_TRACK)
+        p = putFixed(p, mm->heading, 0);
+
+    // Fields 15 and 16 are the Lat/Lon (if we have it)
+    *p++ = ',';
+    if (mm->cpr_decoded)
+        p = putFixed(p, mm->decoded_lat, 5);
+    *p++ = ',';
+    if (mm->cpr_decoded)
+        p = putFixed(p, mm->decoded_lon, 5);
+
+    // Field 17 is the VerticalRate (if we have it)
+    *p++ = ',';
+    if (Modes.use_gnss) {
+        if (mm->geom_rate_valid) {
+            p = putInt(p, mm->geom_rate);
+            *p++ = 'H';
+        } else if (mm->baro_rate_valid) {
+            p = putInt(p, mm->baro_rate);
+        }
+    } else {
+        if (mm->baro_rate_valid) {
+            p = putInt(p, mm->baro_rate);
+        } else if (mm->geom_rate_valid) {
+            p = putInt(p, mm->geom_rate);
+        }
+    }
+
+    // Field 18 is  the Squawk (if we have it)
+    *p++ = ',';
+    if (mm->squawk_valid)
+        p = putHex(p, mm->squawk, 4, lower);
+
+    // Field 19 is the Squawk Changing Alert flag (if we have it)
+    *p++ = ',';
+    if (mm->alert_valid)
+        p = putString(p, mm->alert ? "-1" : "0");
+
+    // Field 20 is the Squawk Emergency flag (if we have it)
+    *p++ = ',';
+    if (mm->squawk_valid) {
+        if ((mm->squawk == 0x7500) || (mm->squawk == 0x7600) || (mm->squawk == 0x7700))
+            p = putString(p, "-1");
+        else
+            p = putString(p, "0");
+    }
+
+    // Field 21 is the Squawk Ident flag (if we have it)
+    *p++ = ',';
+    if (mm->spi_valid)
+        p = putString(p, mm->spi ? "-1" : "0");
+
+    // Field 22 is the OnTheGround flag (if we have it)
+    *p++ = ',';
+    switch (mm->airground) {
+        case AG_GROUND:
+            p = putString(p, "-1");
+            break;
+        case AG_AIRBORNE:
+            p = putString(p, "0");
+            break;
+        default:
+            break;
+    }
+
+    return putString(p, "\r\n");
+}
@@ -0,0 +1,39 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// sbs.h: BaseStation (port 30003) output formatting
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DUMP1090_SBS_H
+#define DUMP1090_SBS_H
+
+#include <time.h>
+
+struct modesMessage;
+struct aircraft;
+
+// Room needed for one line from sbsFormatMessage
+#define SBS_MAX_LINE 200
+
+// The SBS message type (1..8) to send for this message, or 0 if it
+// should not go out as SBS at all
+int sbsMessageType(const struct modesMessage *mm, const struct aircraft *a);
+
+// Write the SBS line for mm, of the type given by sbsMessageType, to p
+// (which must have room for SBS_MAX_LINE bytes) with 'now' as the time
+// it was generated. Returns the end of the line.
+char *sbsFormatMessage(char *p, int msgType, const struct modesMessage *mm,
+                       const struct aircraft *a, const struct timespec *now);
+
+#endif
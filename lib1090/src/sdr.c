@@ -46,9 +46,10 @@ typedef struct {
     void (*initConfig)();
     void (*showHelp)();
     bool (*handleOption)(int, char**, int*);
-    bool (*open)();
-    void (*run)();
-    void (*close)();
+    bool (*open)(struct receiver *);
+    void (*run)(struct receiver *);
+    void (*close)(struct receiver *);
+    bool multi_receiver;             // can this handler drive more than one receiver at once?
 } sdr_handler;
 
 static void noInitConfig()
@@ -68,48 +69,52 @@ static bool noHandleOption(int argc, char **argv, int *jptr)
     return false;
 }
 
-static bool noOpen()
+static bool noOpen(struct receiver *rx)
 {
+    MODES_NOTUSED(rx);
     fprintf(stderr, "Net-only mode, no SDR device or file open.\n");
     return true;
 }
 
-static void noRun()
+static void noRun(struct receiver *rx)
 {
+    MODES_NOTUSED(rx);
 }
 
-static void noClose()
+static void noClose(struct receiver *rx)
 {
+    MODES_NOTUSED(rx);
 }
 
-static bool unsupportedOpen()
+static bool unsupportedOpen(struct receiver *rx)
 {
+    MODES_NOTUSED(rx);
     fprintf(stderr, "Support for this SDR type was not enabled in this build.\n");
     return false;
 }
 
 static sdr_handler sdr_handlers[] = {
 #ifdef ENABLE_SOAPYSDR
-    { "soapysdr", SDR_SOAPYSDR, SOAPYSDRInitConfig, SOAPYSDRShowHelp, SOAPYSDRHandleOption, SOAPYSDROpen, SOAPYSDRRun, SOAPYSDRClose },
+    { "soapysdr", SDR_SOAPYSDR, SOAPYSDRInitConfig, SOAPYSDRShowHelp, SOAPYSDRHandleOption, SOAPYSDROpen, SOAPYSDRRun, SOAPYSDRClose, false },
 #endif
 #ifdef ENABLE_LIMESDR
-    { "limesdr", SDR_LIMESDR, limesdrInitConfig, limesdrShowHelp, limesdrHandleOption, limesdrOpen, limesdrRun, limesdrClose },
+    { "limesdr", SDR_LIMESDR, limesdrInitConfig, limesdrShowHelp, limesdrHandleOption, limesdrOpen, limesdrRun, limesdrClose, false },
 #endif
 #ifdef ENABLE_HACKRFSDR
-    { "hackrf", SDR_HACKRF, hackRFInitConfig, hackRFShowHelp, hackRFHandleOption, hackRFOpen, hackRFRun, hackRFClose },
+    { "hackrf", SDR_HACKRF, hackRFInitConfig, hackRFShowHelp, hackRFHandleOption, hackRFOpen, hackRFRun, hackRFClose, false },
 #endif
 #ifdef ENABLE_RTLSDR
-    { "rtlsdr", SDR_RTLSDR, rtlsdrInitConfig, rtlsdrShowHelp, rtlsdrHandleOption, rtlsdrOpen, rtlsdrRun, rtlsdrClose },
+    { "rtlsdr", SDR_RTLSDR, rtlsdrInitConfig, rtlsdrShowHelp, rtlsdrHandleOption, rtlsdrOpen, rtlsdrRun, rtlsdrClose, true },
 #endif
 
 #ifdef ENABLE_BLADERF
-    { "bladerf", SDR_BLADERF, bladeRFInitConfig, bladeRFShowHelp, bladeRFHandleOption, bladeRFOpen, bladeRFRun, bladeRFClose },
+    { "bladerf", SDR_BLADERF, bladeRFInitConfig, bladeRFShowHelp, bladeRFHandleOption, bladeRFOpen, bladeRFRun, bladeRFClose, false },
 #endif
 
-    { "ifile", SDR_IFILE, ifileInitConfig, ifileShowHelp, ifileHandleOption, ifileOpen, ifileRun, ifileClose },
-    { "none", SDR_NONE, noInitConfig, noShowHelp, noHandleOption, noOpen, noRun, noClose },
+    { "ifile", SDR_IFILE, ifileInitConfig, ifileShowHelp, ifileHandleOption, ifileOpen, ifileRun, ifileClose, true },
+    { "none", SDR_NONE, noInitConfig, noShowHelp, noHandleOption, noOpen, noRun, noClose, false },
 
-    { NULL, SDR_NONE, NULL, NULL, NULL, NULL, NULL, NULL } /* must come last */
+    { NULL, SDR_NONE, NULL, NULL, NULL, NULL, NULL, NULL, false } /* must come last */
 };
 
 void sdrInitConfig()
@@ -163,7 +168,7 @@ bool sdrHandleOption(int argc, char **argv, int *jptr)
 
 static sdr_handler *current_handler()
 {
-    static sdr_handler unsupported_handler = { "unsupported", SDR_NONE, noInitConfig, noShowHelp, noHandleOption, unsupportedOpen, noRun, noClose };
+    static sdr_handler unsupported_handler = { "unsupported", SDR_NONE, noInitConfig, noShowHelp, noHandleOption, unsupportedOpen, noRun, noClose, false };
 
     for (int i = 0; sdr_handlers[i].name; ++i) {
         if (Modes.sdr_type == sdr_handlers[i].sdr_type) {
@@ -174,17 +179,71 @@ static sdr_handler *current_handler()
     return &unsupported_handler;
 }
 
+bool sdrAddReceiver(const char *dev_name)
+{
+    if (Modes.num_receivers >= MODES_MAX_RECEIVERS) {
+        fprintf(stderr, "Too many receivers configured (at most %d are supported)\n", MODES_MAX_RECEIVERS);
+        return false;
+    }
+
+    struct receiver *rx = &Modes.receivers[Modes.num_receivers];
+    rx->id = Modes.num_receivers++;
+    rx->modes = &Modes;
+    rx->dev_name = dev_name ? strdup(dev_name) : NULL;
+    rx->sdr_state = NULL;
+    rx->running = 0;
+    return true;
+}
+
 bool sdrOpen()
 {
-    return current_handler()->open();
+    sdr_handler *handler = current_handler();
+
+    if (Modes.num_receivers > 1 && !handler->multi_receiver) {
+        fprintf(stderr, "SDR type '%s' does not support multiple receivers in one process\n", handler->name);
+        return false;
+    }
+
+    for (int i = 0; i < Modes.num_receivers; ++i) {
+        if (!handler->open(&Modes.receivers[i])) {
+            while (--i >= 0)
+                handler->close(&Modes.receivers[i]);
+            return false;
+        }
+    }
+
+    if (Modes.record_path) {
+        for (int i = 0; i < Modes.num_receivers; ++i) {
+            struct receiver *rx = &Modes.receivers[i];
+            char path[PATH_MAX];
+
+            // the first receiver records to the path as given, any others get a suffix
+            if (i == 0)
+                snprintf(path, sizeof(path), "%s", Modes.record_path);
+            else
+                snprintf(path, sizeof(path), "%s.%d", Modes.record_path, i);
+
+            if (!recorderOpen(rx, path, rx->sample_format, Modes.sample_rate)) {
+                sdrClose();
+                return false;
+            }
+        }
+    }
+
+    return true;
 }
 
-void sdrRun()
+void sdrRun(struct receiver *rx)
 {
-    return current_handler()->run();
+    current_handler()->run(rx);
 }
 
 void sdrClose()
 {
-    current_handler()->close();
+    sdr_handler *handler = current_handler();
+
+    for (int i = 0; i < Modes.num_receivers; ++i) {
+        handler->close(&Modes.receivers[i]);
+        recorderClose(&Modes.receivers[i]);
+    }
 }
@@ -23,11 +23,21 @@
 
 // Common interface to different SDR inputs.
 
+struct receiver;
+
 void sdrInitConfig();
 void sdrShowHelp();
 bool sdrHandleOption(int argc, char **argv, int *jptr);
+
+// Configure an additional receiver reading from the given device
+// (or file, for ifile). Returns false if too many are configured.
+bool sdrAddReceiver(const char *dev_name);
+
+// Open / close every configured receiver
 bool sdrOpen();
-void sdrRun();
 void sdrClose();
 
+// Run the reader loop for one receiver; called on that receiver's thread
+void sdrRun(struct receiver *rx);
+
 #endif
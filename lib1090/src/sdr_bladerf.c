@@ -170,7 +170,7 @@ static void show_config()
 
 }
 
-bool bladeRFOpen()
+bool bladeRFOpen(struct receiver *rx)
 {
     if (BladeRF.device) {
         return true;
@@ -281,6 +281,7 @@ bool bladeRFOpen()
 
     show_config();
 
+    rx->sample_format = INPUT_SC16Q11;
     BladeRF.converter = init_converter(INPUT_SC16Q11,
                                        Modes.sample_rate,
                                        Modes.dc_filter,
@@ -310,13 +311,13 @@ static void *handle_bladerf_samples(struct bladerf *dev,
                                     size_t num_samples,
                                     void *user_data)
 {
+    struct receiver *rx = user_data;
     static uint64_t nextTimestamp = 0;
     static bool dropping = false;
 
     MODES_NOTUSED(dev);
     MODES_NOTUSED(stream);
     MODES_NOTUSED(meta);
-    MODES_NOTUSED(user_data);
     MODES_NOTUSED(num_samples);
 
     // record initial time for later sys timestamp calculation
@@ -328,10 +329,10 @@ static void *handle_bladerf_samples(struct bladerf *dev,
         return BLADERF_STREAM_SHUTDOWN;
     }
 
-    unsigned next_free_buffer = (Modes.first_free_buffer + 1) % MODES_MAG_BUFFERS;
-    struct mag_buf *outbuf = &Modes.mag_buffers[Modes.first_free_buffer];
-    struct mag_buf *lastbuf = &Modes.mag_buffers[(Modes.first_free_buffer + MODES_MAG_BUFFERS - 1) % MODES_MAG_BUFFERS];
-    unsigned free_bufs = (Modes.first_filled_buffer - next_free_buffer + MODES_MAG_BUFFERS) % MODES_MAG_BUFFERS;
+    unsigned next_free_buffer = (rx->first_free_buffer + 1) % MODES_MAG_BUFFERS;
+    struct mag_buf *outbuf = &rx->mag_buffers[rx->first_free_buffer];
+    struct mag_buf *lastbuf = &rx->mag_buffers[(rx->first_free_buffer + MODES_MAG_BUFFERS - 1) % MODES_MAG_BUFFERS];
+    unsigned free_bufs = (rx->first_filled_buffer - next_free_buffer + MODES_MAG_BUFFERS) % MODES_MAG_BUFFERS;
 
     if (free_bufs == 0 || (dropping && free_bufs < MODES_MAG_BUFFERS/2)) {
         // FIFO is full. Drop this block.
@@ -406,6 +407,9 @@ static void *handle_bladerf_samples(struct bladerf *dev,
             outbuf->sampleTimestamp = nextTimestamp * 12e6 / Modes.sample_rate / BladeRF.decimation;
         }
 
+        if (rx->recorder)
+            recorderWrite(rx->recorder, sample_data, samples_per_block * 4);
+
         // Convert a block of data
         double mean_level, mean_power;
         BladeRF.converter(sample_data, &outbuf->data[Modes.trailing_samples + outbuf->length], samples_per_block, BladeRF.converter_state, &mean_level, &mean_power);
@@ -434,11 +438,11 @@ static void *handle_bladerf_samples(struct bladerf *dev,
         end_cpu_timing(&thread_cpu, &Modes.reader_cpu_accumulator);
         start_cpu_timing(&thread_cpu);
 
-        Modes.mag_buffers[next_free_buffer].dropped = 0;
-        Modes.mag_buffers[next_free_buffer].length = 0;  // just in case
-        Modes.first_free_buffer = next_free_buffer;
+        rx->mag_buffers[next_free_buffer].dropped = 0;
+        rx->mag_buffers[next_free_buffer].length = 0;  // just in case
+        rx->first_free_buffer = next_free_buffer;
 
-        pthread_cond_signal(&Modes.data_cond);
+        pthread_cond_broadcast(&Modes.data_cond);
         pthread_mutex_unlock(&Modes.data_mutex);
     }
 
@@ -446,7 +450,7 @@ static void *handle_bladerf_samples(struct bladerf *dev,
 }
 
 
-void bladeRFRun()
+void bladeRFRun(struct receiver *rx)
 {
     if (!BladeRF.device) {
         return;
@@ -466,7 +470,7 @@ void bladeRFRun()
                                       BLADERF_FORMAT_SC16_Q11_META,
                                       /* samples_per_buffer */ MODES_MAG_BUF_SAMPLES,
                                       /* num_transfers */ transfers,
-                                      /* user_data */ NULL)) < 0) {
+                                      /* user_data */ rx)) < 0) {
         fprintf(stderr, "bladerf_init_stream() failed: %s\n", bladerf_strerror(status));
         goto out;
     }
@@ -506,8 +510,10 @@ void bladeRFRun()
     }
 }
 
-void bladeRFClose()
+void bladeRFClose(struct receiver *rx)
 {
+    MODES_NOTUSED(rx);
+
     if (BladeRF.converter) {
         cleanup_converter(BladeRF.converter_state);
         BladeRF.converter = NULL;
@@ -25,8 +25,8 @@
 void bladeRFInitConfig();
 void bladeRFShowHelp();
 bool bladeRFHandleOption(int argc, char **argv, int *jptr);
-bool bladeRFOpen();
-void bladeRFRun();
-void bladeRFClose();
+bool bladeRFOpen(struct receiver *rx);
+void bladeRFRun(struct receiver *rx);
+void bladeRFClose(struct receiver *rx);
 
 #endif
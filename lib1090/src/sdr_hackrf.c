@@ -43,7 +43,7 @@ void hackRFInitConfig()
     HackRF.enable_amp = 0;
     HackRF.lna_gain = 32;
     HackRF.vga_gain = 50;
-    HackRF.rate = 2400000;
+    HackRF.rate = 0;
     HackRF.ppm = 0;
     HackRF.converter = NULL;
     HackRF.converter_state = NULL;
@@ -81,7 +81,7 @@ bool hackRFHandleOption(int argc, char **argv, int *jptr)
     } else if (!strcmp(argv[j], "--ppm") && more) {
         HackRF.ppm = atoi(argv[++j]);
     } else if (!strcmp(argv[j], "--samplerate") && more) {
-        HackRF.rate = atoi(argv[++j]);
+        Modes.sample_rate = atoi(argv[++j]);
     } else if (!strcmp(argv[j], "--enable-amp") && more) {
         HackRF.enable_amp = 1;
     } else {
@@ -100,7 +100,7 @@ void hackRFShowHelp()
     printf("--enable-amp             enable amplifier)\n");
     printf("--lna-gain               set LNA gain (Range 0-40 in 8dB steps))\n");
     printf("--vga-gain               set VGA gain (Range 0-62 in 2dB steps))\n");
-    printf("--samplerate             set sample rate)\n");
+    printf("--samplerate             set sample rate, same as --sample-rate)\n");
     printf("--ppm                    ppm correction)\n");
     printf("\n");
 }
@@ -114,13 +114,14 @@ static void show_config()
     printf("ppm : %d\n", HackRF.ppm);
 }
 
-bool hackRFOpen()
+bool hackRFOpen(struct receiver *rx)
 {
     if (HackRF.device) {
         return true;
     }
 
     // Calculate sample rate and frequency deviation if ppm is specified
+    HackRF.rate = (uint32_t) Modes.sample_rate;
     if (HackRF.ppm != 0) {
         HackRF.rate = (uint32_t)((double)HackRF.rate * (1000000 - HackRF.ppm)/1000000+0.5);
         HackRF.freq = HackRF.freq * (1000000 - HackRF.ppm)/1000000;
@@ -186,6 +187,7 @@ bool hackRFOpen()
 
     show_config();
 
+    rx->sample_format = INPUT_UC8;
     HackRF.converter = init_converter(INPUT_UC8,
                                       Modes.sample_rate,
                                       Modes.dc_filter,
@@ -202,6 +204,7 @@ struct timespec thread_cpu;
 
 int handle_hackrf_samples(hackrf_transfer *transfer)
 {
+    struct receiver *rx = transfer->rx_ctx;
     struct mag_buf *outbuf;
     struct mag_buf *lastbuf;
     unsigned char *buf;
@@ -221,10 +224,10 @@ int handle_hackrf_samples(hackrf_transfer *transfer)
         return -1;
     }
 
-    next_free_buffer = (Modes.first_free_buffer + 1) % MODES_MAG_BUFFERS;
-    outbuf = &Modes.mag_buffers[Modes.first_free_buffer];
-    lastbuf = &Modes.mag_buffers[(Modes.first_free_buffer + MODES_MAG_BUFFERS - 1) % MODES_MAG_BUFFERS];
-    free_bufs = (Modes.first_filled_buffer - next_free_buffer + MODES_MAG_BUFFERS) % MODES_MAG_BUFFERS;
+    next_free_buffer = (rx->first_free_buffer + 1) % MODES_MAG_BUFFERS;
+    outbuf = &rx->mag_buffers[rx->first_free_buffer];
+    lastbuf = &rx->mag_buffers[(rx->first_free_buffer + MODES_MAG_BUFFERS - 1) % MODES_MAG_BUFFERS];
+    free_bufs = (rx->first_filled_buffer - next_free_buffer + MODES_MAG_BUFFERS) % MODES_MAG_BUFFERS;
 
     buf = transfer->buffer;
     len = transfer->buffer_length;
@@ -234,6 +237,10 @@ int handle_hackrf_samples(hackrf_transfer *transfer)
         buf[i] ^= (uint8_t)0x80;
     }
 
+    // Record everything the device gives us, even blocks we drop below
+    if (rx->recorder)
+        recorderWrite(rx->recorder, buf, len);
+
     slen = len/2; // Drops any trailing odd sample, that's OK
 
     if (free_bufs == 0 || (dropping && free_bufs < MODES_MAG_BUFFERS/2)) {
@@ -270,22 +277,22 @@ int handle_hackrf_samples(hackrf_transfer *transfer)
     // Push the new data to the demodulation thread
     pthread_mutex_lock(&Modes.data_mutex);
 
-    Modes.mag_buffers[next_free_buffer].dropped = 0;
-    Modes.mag_buffers[next_free_buffer].length = 0;  // just in case
-    Modes.first_free_buffer = next_free_buffer;
+    rx->mag_buffers[next_free_buffer].dropped = 0;
+    rx->mag_buffers[next_free_buffer].length = 0;  // just in case
+    rx->first_free_buffer = next_free_buffer;
 
     // accumulate CPU while holding the mutex, and restart measurement
     end_cpu_timing(&thread_cpu, &Modes.reader_cpu_accumulator);
     start_cpu_timing(&thread_cpu);
 
-    pthread_cond_signal(&Modes.data_cond);
+    pthread_cond_broadcast(&Modes.data_cond);
     pthread_mutex_unlock(&Modes.data_mutex);
 
     return 0;
 }
 
 
-void hackRFRun()
+void hackRFRun(struct receiver *rx)
 {
     if (!HackRF.device) {
         printf("hackRFRun: HackRF.device = NULL\n");
@@ -294,7 +301,7 @@ void hackRFRun()
 
     start_cpu_timing(&thread_cpu);
 
-    int status = hackrf_start_rx(HackRF.device, &handle_hackrf_samples, NULL);
+    int status = hackrf_start_rx(HackRF.device, &handle_hackrf_samples, rx);
 
     if (status != 0) { 
         printf("hackrf_start_rx failed"); 
@@ -312,8 +319,10 @@ void hackRFRun()
     printf("HackRF stopped streaming %d\n", hackrf_is_streaming(HackRF.device));
 }
 
-void hackRFClose()
+void hackRFClose(struct receiver *rx)
 {
+    MODES_NOTUSED(rx);
+
     if (HackRF.device) {
         hackrf_close(HackRF.device);
         hackrf_exit();
@@ -23,9 +23,9 @@
 void hackRFInitConfig();
 void hackRFShowHelp();
 bool hackRFHandleOption(int argc, char **argv, int *jptr);
-bool hackRFOpen();
-void hackRFRun();
-void hackRFClose();
+bool hackRFOpen(struct receiver *rx);
+void hackRFRun(struct receiver *rx);
+void hackRFClose(struct receiver *rx);
 
 #endif
 
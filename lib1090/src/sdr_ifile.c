@@ -51,37 +51,70 @@
 #include "dump1090.h"
 #include "sdr_ifile.h"
 
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <zlib.h>
+
+// Settings shared by all input files
 static struct {
-    const char *filename;
     input_format_t input_format;
     bool throttle;
+    bool use_mmap;
+    int threads;
+} ifile;
+
+// Mapped input is released back to the kernel in chunks of this size (power of two)
+#define IFILE_RELEASE_CHUNK (4 * 1024 * 1024)
 
+// Per-receiver state, one per --ifile argument
+struct ifile_state {
     int fd;
+    input_format_t input_format; // --iformat, or taken from a --record header
     unsigned bytes_per_sample;
-    void *readbuf;
+    void *readbuf;               // read() path only
+
+    uint8_t peek[RECORDER_HEADER_SIZE]; // bytes read while probing for a header on a pipe
+    size_t peek_len;
+    size_t peek_pos;
+
+    bool compressed;             // replaying a --record file
+    uint8_t *zbuf;               // current compressed frame
+    size_t zbuf_alloc;
+    uint8_t *frame;              // current frame, decompressed
+    size_t frame_alloc;
+    size_t frame_len;
+    size_t frame_pos;
+    uint64_t next_sample;        // first sample we expect in the next frame
+    uint64_t skipped;            // samples missing before the current frame, not yet handed on
+
+    uint8_t *map;                // mmap path: the whole file, converted in place
+    size_t map_len;
+    size_t map_pos;              // next unconverted byte
+    size_t map_released;         // pages before this offset have been dropped
     iq_convert_fn converter;
     struct converter_state *converter_state;
-} ifile;
+};
 
 void ifileInitConfig(void)
 {
-    ifile.filename = NULL;
     ifile.input_format = INPUT_UC8;
     ifile.throttle = false;
-    ifile.fd = -1;
-    ifile.bytes_per_sample = 0;
-    ifile.readbuf = NULL;
-    ifile.converter = NULL;
-    ifile.converter_state = NULL;
+    ifile.use_mmap = true;
+    ifile.threads = 0;
 }
 
 void ifileShowHelp()
 {
     printf("      ifile-specific options (use with --ifile)\n");
     printf("\n");
-    printf("--ifile <path>           read samples from given file ('-' for stdin)\n");
+    printf("--ifile <path>           read samples from given file ('-' for stdin); may be repeated.\n");
+    printf("                         Files written by --record are detected and decompressed\n");
+    printf("                         With several inputs, Beast and raw output carry no timestamps\n");
     printf("--iformat <type>         set sample format (UC8, SC16, SC16Q11)\n");
     printf("--throttle               process samples at the original capture speed\n");
+    printf("--no-mmap                read regular files with read() rather than mapping them\n");
+    printf("--bench                  report throughput and per-stage CPU when the input ends\n");
+    printf("--ifile-threads <n>      search mapped files for messages on <n> worker threads\n");
     printf("\n");
 }
 
@@ -92,7 +125,8 @@ bool ifileHandleOption(int argc, char **argv, int *jptr)
 
     if (!strcmp(argv[j], "--ifile") && more) {
         // implies --device-type ifile
-        ifile.filename = strdup(argv[++j]);
+        if (!sdrAddReceiver(argv[++j]))
+            return false;
         Modes.sdr_type = SDR_IFILE;
     } else if (!strcmp(argv[j],"--iformat") && more) {
         ++j;
@@ -109,6 +143,12 @@ bool ifileHandleOption(int argc, char **argv, int *jptr)
         }
     } else if (!strcmp(argv[j],"--throttle")) {
         ifile.throttle = true;
+    } else if (!strcmp(argv[j],"--no-mmap")) {
+        ifile.use_mmap = false;
+    } else if (!strcmp(argv[j],"--bench")) {
+        Modes.bench = 1;
+    } else if (!strcmp(argv[j],"--ifile-threads") && more) {
+        ifile.threads = atoi(argv[++j]);
     } else {
         return false;
     }
@@ -117,65 +157,502 @@ bool ifileHandleOption(int argc, char **argv, int *jptr)
     return true;
 }
 
+// Read exactly len bytes unless we hit EOF; returns the number read, or -1 on error
+static ssize_t readFull(int fd, void *buf, size_t len)
+{
+    size_t done = 0;
+
+    while (done < len) {
+        ssize_t nread = read(fd, (uint8_t *) buf + done, len - done);
+        if (nread < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (nread == 0)
+            break;
+        done += nread;
+    }
+
+    return done;
+}
+
+// Load and decompress the next --record frame; returns 1 on success, 0 at EOF, -1 on error
+static int ifileNextFrame(struct receiver *rx)
+{
+    struct ifile_state *state = rx->sdr_state;
+    uint8_t header[RECORDER_FRAME_HEADER_SIZE];
+    struct recorder_frame frame;
+    uLongf raw_len;
+    ssize_t nread;
+
+    if ((nread = readFull(state->fd, header, sizeof(header))) <= 0)
+        return nread;
+
+    if (nread != sizeof(header) || !recorderParseFrameHeader(header, &frame)) {
+        fprintf(stderr, "ifile: %s: truncated or corrupt recording\n", rx->dev_name);
+        return -1;
+    }
+
+    if (frame.compressed_len > state->zbuf_alloc) {
+        if (!(state->zbuf = realloc(state->zbuf, frame.compressed_len))) {
+            fprintf(stderr, "ifile: out of memory\n");
+            exit(1);
+        }
+        state->zbuf_alloc = frame.compressed_len;
+    }
+    if (frame.raw_len > state->frame_alloc) {
+        if (!(state->frame = realloc(state->frame, frame.raw_len))) {
+            fprintf(stderr, "ifile: out of memory\n");
+            exit(1);
+        }
+        state->frame_alloc = frame.raw_len;
+    }
+
+    raw_len = frame.raw_len;
+    if (readFull(state->fd, state->zbuf, frame.compressed_len) != (ssize_t) frame.compressed_len ||
+        uncompress(state->frame, &raw_len, state->zbuf, frame.compressed_len) != Z_OK ||
+        raw_len != frame.raw_len) {
+        fprintf(stderr, "ifile: %s: truncated or corrupt recording\n", rx->dev_name);
+        return -1;
+    }
+
+    if (frame.first_sample != state->next_sample) {
+        fprintf(stderr, "ifile: %s: recording skips %" PRId64 " samples at sample %" PRIu64 " (the recorder fell behind)\n",
+                rx->dev_name, (int64_t) (frame.first_sample - state->next_sample), state->next_sample);
+        if (frame.first_sample > state->next_sample)
+            state->skipped = frame.first_sample - state->next_sample;
+    }
+    state->next_sample = frame.first_sample + frame.raw_len / state->bytes_per_sample;
+
+    state->frame_len = frame.raw_len;
+    state->frame_pos = 0;
+    return 1;
+}
+
+// read() replacement: hands out any bytes consumed while probing for a
+// --record header, then either reads the file directly or decompresses it.
+// Returns 0 with state->skipped set where a recording has a gap, so that
+// no block spans it; the next call carries on after the gap.
+static ssize_t ifileRead(struct receiver *rx, void *buf, size_t len)
+{
+    struct ifile_state *state = rx->sdr_state;
+    size_t n;
+
+    if (state->peek_pos < state->peek_len) {
+        n = state->peek_len - state->peek_pos;
+        if (n > len)
+            n = len;
+        memcpy(buf, state->peek + state->peek_pos, n);
+        state->peek_pos += n;
+        return n;
+    }
+
+    if (!state->compressed)
+        return read(state->fd, buf, len);
+
+    if (state->frame_pos == state->frame_len) {
+        int result = ifileNextFrame(rx);
+        if (result <= 0) {
+            if (result < 0)
+                errno = EIO;
+            return result;
+        }
+        if (state->skipped)
+            return 0;
+    }
+
+    n = state->frame_len - state->frame_pos;
+    if (n > len)
+        n = len;
+    memcpy(buf, state->frame + state->frame_pos, n);
+    state->frame_pos += n;
+    return n;
+}
+
+// Look for a --record header at the start of the input
+static bool ifileProbeRecording(struct receiver *rx)
+{
+    struct ifile_state *state = rx->sdr_state;
+    ssize_t nread;
+    double sample_rate;
+
+    if ((nread = readFull(state->fd, state->peek, sizeof(state->peek))) < 0) {
+        fprintf(stderr, "ifile: error reading %s: %s\n", rx->dev_name, strerror(errno));
+        return false;
+    }
+
+    if (nread == sizeof(state->peek) && recorderParseHeader(state->peek, &state->input_format, &sample_rate)) {
+        state->compressed = true;
+        if (sample_rate != Modes.sample_rate) {
+            fprintf(stderr, "ifile: %s was recorded at %.0f samples/s, but we are decoding at %.0f samples/s (see --sample-rate)\n",
+                    rx->dev_name, sample_rate, Modes.sample_rate);
+        }
+        return true;
+    }
+
+    // Plain samples: rewind, or replay the probed bytes if we can't
+    if (lseek(state->fd, 0, SEEK_SET) == 0)
+        nread = 0;
+    state->peek_len = nread;
+    state->peek_pos = 0;
+    return true;
+}
+
 //
 //=========================================================================
 //
 // This is used when --ifile is specified in order to read data from file
 // instead of using an RTLSDR device
 //
-bool ifileOpen(void)
+bool ifileOpen(struct receiver *rx)
 {
-    if (!ifile.filename) {
+    struct ifile_state *state;
+
+    if (!rx->dev_name) {
         fprintf(stderr, "SDR type 'ifile' requires an --ifile argument\n");
         return false;
     }
 
-    if (!strcmp(ifile.filename, "-")) {
-        ifile.fd = STDIN_FILENO;
-    } else if ((ifile.fd = open(ifile.filename, O_RDONLY)) < 0) {
+    if (!(state = calloc(1, sizeof(*state)))) {
+        fprintf(stderr, "ifile: out of memory\n");
+        return false;
+    }
+    state->fd = -1;
+    rx->sdr_state = state;
+
+    if (!strcmp(rx->dev_name, "-")) {
+        state->fd = STDIN_FILENO;
+    } else if ((state->fd = open(rx->dev_name, O_RDONLY)) < 0) {
         fprintf(stderr, "ifile: could not open %s: %s\n",
-                ifile.filename, strerror(errno));
+                rx->dev_name, strerror(errno));
+        ifileClose(rx);
         return false;
     }
 
-    switch (ifile.input_format) {
+    state->input_format = ifile.input_format;
+    if (!ifileProbeRecording(rx)) {
+        ifileClose(rx);
+        return false;
+    }
+
+    switch (state->input_format) {
     case INPUT_UC8:
-        ifile.bytes_per_sample = 2;
+        state->bytes_per_sample = 2;
         break;
     case INPUT_SC16:
     case INPUT_SC16Q11:
-        ifile.bytes_per_sample = 4;
+        state->bytes_per_sample = 4;
         break;
     default:
         fprintf(stderr, "ifile: unhandled input format\n");
-        ifileClose();
+        ifileClose(rx);
         return false;
     }
 
-    if (!(ifile.readbuf = malloc(MODES_MAG_BUF_SAMPLES * ifile.bytes_per_sample))) {
+    // Regular files are mapped and converted straight from the page cache,
+    // avoiding the copy into readbuf; pipes and stdin fall back to read().
+    struct stat st;
+    if (ifile.use_mmap && !state->compressed && state->fd != STDIN_FILENO && fstat(state->fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, state->fd, 0);
+        if (map != MAP_FAILED) {
+            state->map = map;
+            state->map_len = st.st_size;
+            madvise(state->map, state->map_len, MADV_SEQUENTIAL);
+        }
+    }
+
+    if (!state->map && !(state->readbuf = malloc(MODES_MAG_BUF_SAMPLES * state->bytes_per_sample))) {
         fprintf(stderr, "ifile: failed to allocate read buffer\n");
-        ifileClose();
+        ifileClose(rx);
         return false;
     }
 
-    ifile.converter = init_converter(ifile.input_format,
-                                     Modes.sample_rate,
-                                     Modes.dc_filter,
-                                     &ifile.converter_state);
-    if (!ifile.converter) {
+    if (ifile.threads > 0 && (!state->map || Modes.dc_filter || !Modes.demod->scan)) {
+        fprintf(stderr, "ifile: --ifile-threads needs a mapped regular file, no --dcfilter and the 2.4MHz demodulator, decoding %s on one thread\n", rx->dev_name);
+    }
+
+    rx->sample_format = state->input_format;
+    state->converter = init_converter(state->input_format,
+                                      Modes.sample_rate,
+                                      Modes.dc_filter,
+                                      &state->converter_state);
+    if (!state->converter) {
         fprintf(stderr, "ifile: can't initialize sample converter\n");
-        ifileClose();
+        ifileClose(rx);
         return false;
     }
 
     return true;
 }
 
-void ifileRun()
+//
+//=========================================================================
+//
+// Parallel offline decoding (--ifile-threads).
+//
+// The file is cut into exactly the blocks that ifileRun would deliver, each
+// starting with the same trailing_samples overlap. Worker threads convert
+// blocks and run the demodulator's scan over them; this thread hands them to
+// the main thread in file order, and demodulate2400 finishes them with the
+// usual skip-over rule, so messages in the overlaps are resolved exactly as
+// in a sequential run. Only the DC-filter-free converters are stateless, so
+// --dcfilter always takes the sequential path.
+//
+
+// Number of blocks that may be in flight per worker
+#define IFILE_SLOTS_PER_THREAD 4
+
+struct ifile_slot {
+    bool ready;                              // a worker has filled this slot
+    uint16_t *data;                          // converted samples, overlap first
+    unsigned length;
+    double mean_level;
+    double mean_power;
+    struct demod_candidates *candidates;
+};
+
+struct ifile_pool {
+    struct modes_t *modes;                   // decoder instance the workers feed
+    struct ifile_state *state;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t *threads;
+    int nthreads;
+    struct ifile_slot *slots;
+    unsigned nslots;
+    uint64_t nblocks;
+    uint64_t next_block;                     // next block for a worker to claim
+    uint64_t delivered;                      // blocks handed to the main thread so far
+    bool stop;
+};
+
+static void ifileFillSlot(struct ifile_pool *pool, struct ifile_slot *slot, uint64_t block,
+                          iq_convert_fn converter, struct converter_state *converter_state)
 {
-    if (ifile.fd < 0)
+    struct ifile_state *state = pool->state;
+    size_t total = state->map_len / state->bytes_per_sample;
+    size_t start = (size_t) block * MODES_MAG_BUF_SAMPLES;
+    unsigned slen = (total - start < MODES_MAG_BUF_SAMPLES ? total - start : MODES_MAG_BUF_SAMPLES);
+
+    // The overlap is the tail of the previous block, as ifileRun would copy it
+    if (block > 0)
+        converter(state->map + (start - Modes.trailing_samples) * state->bytes_per_sample, slot->data, Modes.trailing_samples, converter_state, NULL, NULL);
+    else
+        memset(slot->data, 0, Modes.trailing_samples * sizeof(uint16_t));
+
+    converter(state->map + start * state->bytes_per_sample, &slot->data[Modes.trailing_samples], slen, converter_state, &slot->mean_level, &slot->mean_power);
+    if (slen < MODES_MAG_BUF_SAMPLES)
+        memset(&slot->data[Modes.trailing_samples + slen], 0, (MODES_MAG_BUF_SAMPLES - slen) * sizeof(uint16_t));
+    slot->length = slen;
+
+    if (!slot->candidates && !(slot->candidates = calloc(1, sizeof(*slot->candidates)))) {
+        fprintf(stderr, "ifile: out of memory\n");
+        exit(1);
+    }
+    Modes.demod->scan(slot->data, slen, slot->candidates);
+}
+
+static void *ifileWorker(void *arg)
+{
+    struct ifile_pool *pool = arg;
+    struct converter_state *converter_state;
+    iq_convert_fn converter;
+    struct timespec thread_cpu;
+
+    modesSetCurrent(pool->modes);
+    converter = init_converter(pool->state->input_format, Modes.sample_rate, 0, &converter_state);
+
+    if (!converter) {
+        fprintf(stderr, "ifile: can't initialize sample converter\n");
+        exit(1);
+    }
+
+    start_cpu_timing(&thread_cpu);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (!pool->stop && pool->next_block < pool->nblocks) {
+        uint64_t block = pool->next_block;
+        struct ifile_slot *slot;
+
+        if (block >= pool->delivered + pool->nslots) {
+            // every slot is waiting to be delivered
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+            continue;
+        }
+
+        pool->next_block++;
+        slot = &pool->slots[block % pool->nslots];
+        pthread_mutex_unlock(&pool->mutex);
+
+        ifileFillSlot(pool, slot, block, converter, converter_state);
+
+        pthread_mutex_lock(&Modes.data_mutex);
+        end_cpu_timing(&thread_cpu, &Modes.reader_cpu_accumulator);
+        start_cpu_timing(&thread_cpu);
+        pthread_mutex_unlock(&Modes.data_mutex);
+
+        pthread_mutex_lock(&pool->mutex);
+        slot->ready = true;
+        pthread_cond_broadcast(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    cleanup_converter(converter_state);
+    return NULL;
+}
+
+static void ifileRunParallel(struct receiver *rx)
+{
+    struct ifile_state *state = rx->sdr_state;
+    struct ifile_pool pool;
+    struct timespec next_buffer_delivery;
+    uint64_t block;
+    unsigned i;
+    int t;
+
+    memset(&pool, 0, sizeof(pool));
+    pool.modes = &Modes;
+    pool.state = state;
+    pool.nthreads = ifile.threads;
+    pool.nslots = ifile.threads * IFILE_SLOTS_PER_THREAD;
+    // As in ifileRun, the last block is the short (possibly empty) one that hits EOF
+    pool.nblocks = state->map_len / state->bytes_per_sample / MODES_MAG_BUF_SAMPLES + 1;
+    pthread_mutex_init(&pool.mutex, NULL);
+    pthread_cond_init(&pool.cond, NULL);
+
+    if (!(pool.slots = calloc(pool.nslots, sizeof(*pool.slots))) ||
+        !(pool.threads = calloc(pool.nthreads, sizeof(*pool.threads)))) {
+        fprintf(stderr, "ifile: out of memory\n");
+        exit(1);
+    }
+    for (i = 0; i < pool.nslots; ++i) {
+        if (!(pool.slots[i].data = calloc(MODES_MAG_BUF_SAMPLES + Modes.trailing_samples, sizeof(uint16_t)))) {
+            fprintf(stderr, "ifile: out of memory\n");
+            exit(1);
+        }
+    }
+    for (t = 0; t < pool.nthreads; ++t) {
+        if (pthread_create(&pool.threads[t], NULL, ifileWorker, &pool)) {
+            fprintf(stderr, "ifile: failed to start worker thread\n");
+            exit(1);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &next_buffer_delivery);
+
+    for (block = 0; block < pool.nblocks; ++block) {
+        struct ifile_slot *slot = &pool.slots[block % pool.nslots];
+        struct mag_buf *outbuf;
+        struct demod_candidates *candidates;
+        uint16_t *data;
+        unsigned next_free_buffer;
+
+        pthread_mutex_lock(&pool.mutex);
+        while (!slot->ready)
+            pthread_cond_wait(&pool.cond, &pool.mutex);
+        pthread_mutex_unlock(&pool.mutex);
+
+        pthread_mutex_lock(&Modes.data_mutex);
+        next_free_buffer = (rx->first_free_buffer + 1) % MODES_MAG_BUFFERS;
+        while (!Modes.exit && next_free_buffer == rx->first_filled_buffer) {
+            // no space for output yet
+            pthread_cond_wait(&Modes.data_cond, &Modes.data_mutex);
+        }
+        pthread_mutex_unlock(&Modes.data_mutex);
+        if (Modes.exit)
+            break;
+
+        // Hand the worker's buffers over by swapping them with the free ring entry
+        outbuf = &rx->mag_buffers[rx->first_free_buffer];
+        data = outbuf->data;
+        outbuf->data = slot->data;
+        slot->data = data;
+        candidates = outbuf->candidates;
+        outbuf->candidates = slot->candidates;
+        slot->candidates = candidates;
+
+        outbuf->length = slot->length;
+        outbuf->mean_level = slot->mean_level;
+        outbuf->mean_power = slot->mean_power;
+        outbuf->sampleTimestamp = block * MODES_MAG_BUF_SAMPLES * 12e6 / Modes.sample_rate;
+        outbuf->sysTimestamp = mstime();
+
+        if (rx->recorder)
+            recorderWrite(rx->recorder, state->map + block * MODES_MAG_BUF_SAMPLES * state->bytes_per_sample, (size_t) outbuf->length * state->bytes_per_sample);
+
+        if (ifile.throttle || Modes.interactive) {
+            // Wait until we are allowed to release this buffer to the main thread
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_buffer_delivery, NULL) == EINTR)
+                ;
+
+            // compute the time we can deliver the next buffer.
+            next_buffer_delivery.tv_nsec += outbuf->length * 1e9 / Modes.sample_rate;
+            normalize_timespec(&next_buffer_delivery);
+        }
+
+        // Push the new data to the main thread
+        pthread_mutex_lock(&Modes.data_mutex);
+        rx->first_free_buffer = next_free_buffer;
+        pthread_cond_broadcast(&Modes.data_cond);
+        pthread_mutex_unlock(&Modes.data_mutex);
+
+        // Let the workers reuse the slot
+        pthread_mutex_lock(&pool.mutex);
+        slot->ready = false;
+        pool.delivered++;
+        pthread_cond_broadcast(&pool.cond);
+        pthread_mutex_unlock(&pool.mutex);
+
+        // Drop pages that no later block's overlap reaches back into
+        size_t done = ((block + 1) * MODES_MAG_BUF_SAMPLES - Modes.trailing_samples) * state->bytes_per_sample;
+        size_t release = (done & ~(size_t)(IFILE_RELEASE_CHUNK - 1));
+        if (release > state->map_len)
+            release = state->map_len & ~(size_t)(IFILE_RELEASE_CHUNK - 1);
+        if (release > state->map_released) {
+            madvise(state->map + state->map_released, release - state->map_released, MADV_DONTNEED);
+            state->map_released = release;
+        }
+    }
+
+    pthread_mutex_lock(&pool.mutex);
+    pool.stop = true;
+    pthread_cond_broadcast(&pool.cond);
+    pthread_mutex_unlock(&pool.mutex);
+    for (t = 0; t < pool.nthreads; ++t)
+        pthread_join(pool.threads[t], NULL);
+
+    // Wait for the main thread to consume all data
+    pthread_mutex_lock(&Modes.data_mutex);
+    while (!Modes.exit && rx->first_filled_buffer != rx->first_free_buffer)
+        pthread_cond_wait(&Modes.data_cond, &Modes.data_mutex);
+    pthread_mutex_unlock(&Modes.data_mutex);
+
+    for (i = 0; i < pool.nslots; ++i) {
+        free(pool.slots[i].data);
+        if (pool.slots[i].candidates) {
+            free(pool.slots[i].candidates->list);
+            free(pool.slots[i].candidates);
+        }
+    }
+    free(pool.slots);
+    free(pool.threads);
+    pthread_mutex_destroy(&pool.mutex);
+    pthread_cond_destroy(&pool.cond);
+}
+
+void ifileRun(struct receiver *rx)
+{
+    struct ifile_state *state = rx->sdr_state;
+
+    if (!state || state->fd < 0)
         return;
 
+    if (ifile.threads > 0 && state->map && !Modes.dc_filter && Modes.demod->scan) {
+        ifileRunParallel(rx);
+        return;
+    }
+
     int eof = 0;
     struct timespec next_buffer_delivery;
 
@@ -194,23 +671,27 @@ void ifileRun()
         unsigned next_free_buffer;
         unsigned slen;
 
-        next_free_buffer = (Modes.first_free_buffer + 1) % MODES_MAG_BUFFERS;
-        if (next_free_buffer == Modes.first_filled_buffer) {
+        next_free_buffer = (rx->first_free_buffer + 1) % MODES_MAG_BUFFERS;
+        if (next_free_buffer == rx->first_filled_buffer) {
             // no space for output yet
             pthread_cond_wait(&Modes.data_cond, &Modes.data_mutex);
             continue;
         }
 
-        outbuf = &Modes.mag_buffers[Modes.first_free_buffer];
-        lastbuf = &Modes.mag_buffers[(Modes.first_free_buffer + MODES_MAG_BUFFERS - 1) % MODES_MAG_BUFFERS];
+        outbuf = &rx->mag_buffers[rx->first_free_buffer];
+        lastbuf = &rx->mag_buffers[(rx->first_free_buffer + MODES_MAG_BUFFERS - 1) % MODES_MAG_BUFFERS];
         pthread_mutex_unlock(&Modes.data_mutex);
 
+        // Step the clock over any gap in a recording
+        outbuf->dropped = (state->skipped > UINT32_MAX ? UINT32_MAX : (uint32_t) state->skipped);
+        sampleCounter += state->skipped;
+        state->skipped = 0;
+
         // Compute the sample timestamp for the start of the block
         outbuf->sampleTimestamp = sampleCounter * 12e6 / Modes.sample_rate;
-        sampleCounter += MODES_MAG_BUF_SAMPLES;
 
         // Copy trailing data from last block (or reset if not valid)
-        if (lastbuf->length >= Modes.trailing_samples) {
+        if (outbuf->dropped == 0 && lastbuf->length >= Modes.trailing_samples) {
             memcpy(outbuf->data, lastbuf->data + lastbuf->length, Modes.trailing_samples * sizeof(uint16_t));
         } else {
             memset(outbuf->data, 0, Modes.trailing_samples * sizeof(uint16_t));
@@ -219,26 +700,56 @@ void ifileRun()
         // Get the system time for the start of this block
         outbuf->sysTimestamp = mstime();
 
-        toread = MODES_MAG_BUF_SAMPLES * ifile.bytes_per_sample;
-        r = ifile.readbuf;
-        while (toread) {
-            nread = read(ifile.fd, r, toread);
-            if (nread <= 0) {
-                if (nread < 0) {
-                    fprintf(stderr, "ifile: error reading input file: %s\n", strerror(errno));
-                }
-                // Done.
+        if (state->map) {
+            size_t avail = (state->map_len - state->map_pos) / state->bytes_per_sample;
+
+            slen = outbuf->length = (avail < MODES_MAG_BUF_SAMPLES ? avail : MODES_MAG_BUF_SAMPLES);
+            if (slen < MODES_MAG_BUF_SAMPLES)
                 eof = 1;
-                break;
+
+            if (rx->recorder)
+                recorderWrite(rx->recorder, state->map + state->map_pos, (size_t) slen * state->bytes_per_sample);
+
+            // Convert the new data directly from the mapping
+            state->converter(state->map + state->map_pos, &outbuf->data[Modes.trailing_samples], slen, state->converter_state, &outbuf->mean_level, &outbuf->mean_power);
+            state->map_pos += (size_t) slen * state->bytes_per_sample;
+
+            // Drop pages we have finished with so long recordings don't fill the page cache
+            size_t release = (state->map_pos & ~(size_t)(IFILE_RELEASE_CHUNK - 1));
+            if (release > state->map_released) {
+                madvise(state->map + state->map_released, release - state->map_released, MADV_DONTNEED);
+                state->map_released = release;
             }
-            r += nread;
-            toread -= nread;
-        }
+        } else {
+            toread = MODES_MAG_BUF_SAMPLES * state->bytes_per_sample;
+            r = state->readbuf;
+            while (toread) {
+                nread = ifileRead(rx, r, toread);
+                if (nread == 0 && state->skipped) {
+                    // a gap in the recording: end the block here
+                    break;
+                }
+                if (nread <= 0) {
+                    if (nread < 0) {
+                        fprintf(stderr, "ifile: error reading input file: %s\n", strerror(errno));
+                    }
+                    // Done.
+                    eof = 1;
+                    break;
+                }
+                r += nread;
+                toread -= nread;
+            }
+
+            slen = outbuf->length = MODES_MAG_BUF_SAMPLES - toread / state->bytes_per_sample;
 
-        slen = outbuf->length = MODES_MAG_BUF_SAMPLES - toread / ifile.bytes_per_sample;
+            if (rx->recorder)
+                recorderWrite(rx->recorder, state->readbuf, (size_t) slen * state->bytes_per_sample);
 
-        // Convert the new data
-        ifile.converter(ifile.readbuf, &outbuf->data[Modes.trailing_samples], slen, ifile.converter_state, &outbuf->mean_level, &outbuf->mean_power);
+            // Convert the new data
+            state->converter(state->readbuf, &outbuf->data[Modes.trailing_samples], slen, state->converter_state, &outbuf->mean_level, &outbuf->mean_power);
+        }
+        sampleCounter += slen;
 
         if (ifile.throttle || Modes.interactive) {
             // Wait until we are allowed to release this buffer to the main thread
@@ -252,35 +763,51 @@ void ifileRun()
 
         // Push the new data to the main thread
         pthread_mutex_lock(&Modes.data_mutex);
-        Modes.first_free_buffer = next_free_buffer;
+        rx->first_free_buffer = next_free_buffer;
         // accumulate CPU while holding the mutex, and restart measurement
         end_cpu_timing(&thread_cpu, &Modes.reader_cpu_accumulator);
         start_cpu_timing(&thread_cpu);
-        pthread_cond_signal(&Modes.data_cond);
+        pthread_cond_broadcast(&Modes.data_cond);
     }
 
     // Wait for the main thread to consume all data
-    while (!Modes.exit && Modes.first_filled_buffer != Modes.first_free_buffer)
+    while (!Modes.exit && rx->first_filled_buffer != rx->first_free_buffer)
         pthread_cond_wait(&Modes.data_cond, &Modes.data_mutex);
 
     pthread_mutex_unlock(&Modes.data_mutex);
 }
 
-void ifileClose()
+void ifileClose(struct receiver *rx)
 {
-    if (ifile.converter) {
-        cleanup_converter(ifile.converter_state);
-        ifile.converter = NULL;
-        ifile.converter_state = NULL;
+    struct ifile_state *state = rx->sdr_state;
+
+    if (!state)
+        return;
+
+    if (state->converter) {
+        cleanup_converter(state->converter_state);
+        state->converter = NULL;
+        state->converter_state = NULL;
     }
 
-    if (ifile.readbuf) {
-        free(ifile.readbuf);
-        ifile.readbuf = NULL;
+    if (state->readbuf) {
+        free(state->readbuf);
+        state->readbuf = NULL;
     }
 
-    if (ifile.fd >= 0 && ifile.fd != STDIN_FILENO) {
-        close(ifile.fd);
-        ifile.fd = -1;
+    free(state->zbuf);
+    free(state->frame);
+
+    if (state->map) {
+        munmap(state->map, state->map_len);
+        state->map = NULL;
     }
+
+    if (state->fd >= 0 && state->fd != STDIN_FILENO) {
+        close(state->fd);
+        state->fd = -1;
+    }
+
+    free(state);
+    rx->sdr_state = NULL;
 }
@@ -26,8 +26,8 @@
 void ifileInitConfig();
 void ifileShowHelp();
 bool ifileHandleOption(int argc, char **argv, int *jptr);
-bool ifileOpen();
-void ifileRun();
-void ifileClose();
+bool ifileOpen(struct receiver *rx);
+void ifileRun(struct receiver *rx);
+void ifileClose(struct receiver *rx);
 
 #endif
@@ -84,7 +84,7 @@ bool limesdrHandleOption(int argc, char **argv, int *jptr)
     return true;
 }
 
-bool limesdrOpen()
+bool limesdrOpen(struct receiver *rx)
 {
     LimeSDR.device_list_size = LMS_GetDeviceList(LimeSDR.device_list);
     if (LimeSDR.device != NULL) {
@@ -149,6 +149,7 @@ bool limesdrOpen()
 
     //show_config();
 
+    rx->sample_format = INPUT_SC16;
     LimeSDR.converter = init_converter(INPUT_SC16,
                                        Modes.sample_rate,
                                        Modes.dc_filter,
@@ -168,7 +169,7 @@ error:
     return false;
 }
 
-void limesdrRun()
+void limesdrRun(struct receiver *rx)
 {
     sc16_t samples[MODES_MAG_BUF_SAMPLES];
     lms_stream_meta_t meta;
@@ -226,10 +227,10 @@ void limesdrRun()
             }
         }
 
-        unsigned next_free_buffer = (Modes.first_free_buffer + 1) % MODES_MAG_BUFFERS;
-        struct mag_buf *outbuf = &Modes.mag_buffers[Modes.first_free_buffer];
-        struct mag_buf *lastbuf = &Modes.mag_buffers[(Modes.first_free_buffer + MODES_MAG_BUFFERS - 1) % MODES_MAG_BUFFERS];
-        unsigned free_bufs = (Modes.first_filled_buffer - next_free_buffer + MODES_MAG_BUFFERS) % MODES_MAG_BUFFERS;
+        unsigned next_free_buffer = (rx->first_free_buffer + 1) % MODES_MAG_BUFFERS;
+        struct mag_buf *outbuf = &rx->mag_buffers[rx->first_free_buffer];
+        struct mag_buf *lastbuf = &rx->mag_buffers[(rx->first_free_buffer + MODES_MAG_BUFFERS - 1) % MODES_MAG_BUFFERS];
+        unsigned free_bufs = (rx->first_filled_buffer - next_free_buffer + MODES_MAG_BUFFERS) % MODES_MAG_BUFFERS;
 
         if (free_bufs == 0 || (dropping && free_bufs < MODES_MAG_BUFFERS/2)) {
             // FIFO is full. Drop this block.
@@ -255,6 +256,9 @@ void limesdrRun()
         // Compute the sample timestamp for the start of the block
         outbuf->sampleTimestamp = nextTimestamp * 12e6 / Modes.sample_rate / LimeSDR.decimation;
 
+        if (rx->recorder)
+            recorderWrite(rx->recorder, samples, nSamples * 4);
+
         // Convert a block of data
         double mean_level, mean_power;
         LimeSDR.converter(samples, &outbuf->data[Modes.trailing_samples + outbuf->length], nSamples, LimeSDR.converter_state, &mean_level, &mean_power);
@@ -275,11 +279,11 @@ void limesdrRun()
         end_cpu_timing(&thread_cpu, &Modes.reader_cpu_accumulator);
         start_cpu_timing(&thread_cpu);
 
-        Modes.mag_buffers[next_free_buffer].dropped = 0;
-        Modes.mag_buffers[next_free_buffer].length = 0;  // just in case
-        Modes.first_free_buffer = next_free_buffer;
+        rx->mag_buffers[next_free_buffer].dropped = 0;
+        rx->mag_buffers[next_free_buffer].length = 0;  // just in case
+        rx->first_free_buffer = next_free_buffer;
 
-        pthread_cond_signal(&Modes.data_cond);
+        pthread_cond_broadcast(&Modes.data_cond);
     }
 
     pthread_mutex_unlock(&Modes.data_mutex);
@@ -288,8 +292,10 @@ void limesdrRun()
 
 }
 
-void limesdrClose()
+void limesdrClose(struct receiver *rx)
 {
+    MODES_NOTUSED(rx);
+
     if (LimeSDR.converter != NULL) {
         cleanup_converter(LimeSDR.converter_state);
         LimeSDR.converter = NULL;
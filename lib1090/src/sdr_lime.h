@@ -24,9 +24,9 @@
 
 void limesdrInitConfig();
 void limesdrShowHelp();
-bool limesdrOpen();
-void limesdrRun();
-void limesdrClose();
+bool limesdrOpen(struct receiver *rx);
+void limesdrRun(struct receiver *rx);
+void limesdrClose(struct receiver *rx);
 bool limesdrHandleOption(int argc, char **argv, int *jptr);
 
 #endif
@@ -53,15 +53,25 @@
 
 #include <rtl-sdr.h>
 
+// Settings shared by all rtlsdr receivers
 static struct {
-    rtlsdr_dev_t *dev;
     bool digital_agc;
     int ppm_error;
     int direct_sampling;
+} RTLSDR;
+
+// Per-receiver state, one per --device argument
+struct rtlsdr_state {
+    struct receiver *rx;
+    rtlsdr_dev_t *dev;
 
     iq_convert_fn converter;
     struct converter_state *converter_state;
-} RTLSDR;
+
+    int dropping;
+    uint64_t sampleCounter;
+    struct timespec thread_cpu;
+};
 
 //
 // =============================== RTLSDR handling ==========================
@@ -69,12 +79,9 @@ static struct {
 
 void rtlsdrInitConfig()
 {
-    RTLSDR.dev = NULL;
     RTLSDR.digital_agc = false;
     RTLSDR.ppm_error = 0;
     RTLSDR.direct_sampling = 0;
-    RTLSDR.converter = NULL;
-    RTLSDR.converter_state = NULL;
 }
 
 static void show_rtlsdr_devices()
@@ -141,7 +148,8 @@ void rtlsdrShowHelp()
 {
     printf("      rtlsdr-specific options (use with --device-type rtlsdr)\n");
     printf("\n");
-    printf("--device <index|serial>  select device by index or serial number\n");
+    printf("--device <index|serial>  select device by index or serial number; repeat to use several devices\n");
+    printf("                         (with several, Beast and raw output carry no timestamps: not for mlat)\n");
     printf("--enable-agc             enable digital AGC (not tuner AGC!)\n");
     printf("--ppm <correction>       set oscillator frequency correction in PPM\n");
     printf("--direct <0|1|2>         set direct sampling mode\n");
@@ -167,16 +175,18 @@ bool rtlsdrHandleOption(int argc, char **argv, int *jptr)
     return true;
 }
 
-bool rtlsdrOpen(void) {
+bool rtlsdrOpen(struct receiver *rx) {
+    struct rtlsdr_state *state;
+
     if (!rtlsdr_get_device_count()) {
         fprintf(stderr, "rtlsdr: no supported devices found.\n");
         return false;
     }
 
     int dev_index = 0;
-    if (Modes.dev_name) {
-        if ((dev_index = find_device_index(Modes.dev_name)) < 0) {
-            fprintf(stderr, "rtlsdr: no device matching '%s' found.\n", Modes.dev_name);
+    if (rx->dev_name) {
+        if ((dev_index = find_device_index(rx->dev_name)) < 0) {
+            fprintf(stderr, "rtlsdr: no device matching '%s' found.\n", rx->dev_name);
             show_rtlsdr_devices();
             return false;
         }
@@ -194,34 +204,44 @@ bool rtlsdrOpen(void) {
             dev_index, rtlsdr_get_device_name(dev_index),
             manufacturer, product, serial);
 
-    if (rtlsdr_open(&RTLSDR.dev, dev_index) < 0) {
+    if (!(state = calloc(1, sizeof(*state)))) {
+        fprintf(stderr, "rtlsdr: out of memory\n");
+        return false;
+    }
+    state->rx = rx;
+    rx->sdr_state = state;
+
+    if (rtlsdr_open(&state->dev, dev_index) < 0) {
         fprintf(stderr, "rtlsdr: error opening the RTLSDR device: %s\n",
             strerror(errno));
+        rtlsdrClose(rx);
         return false;
     }
 
     // Set gain, frequency, sample rate, and reset the device
     if (RTLSDR.direct_sampling) {
         fprintf(stderr, "rtlsdr: direct sampling from input %d\n", RTLSDR.direct_sampling);
-        rtlsdr_set_direct_sampling(RTLSDR.dev, RTLSDR.direct_sampling);
+        rtlsdr_set_direct_sampling(state->dev, RTLSDR.direct_sampling);
     } else {
         if (Modes.gain == MODES_AUTO_GAIN) {
             fprintf(stderr, "rtlsdr: enabling tuner AGC\n");
-            rtlsdr_set_tuner_gain_mode(RTLSDR.dev, 0);
+            rtlsdr_set_tuner_gain_mode(state->dev, 0);
         } else {
             int *gains;
             int numgains;
 
-            numgains = rtlsdr_get_tuner_gains(RTLSDR.dev, NULL);
+            numgains = rtlsdr_get_tuner_gains(state->dev, NULL);
             if (numgains <= 0) {
                 fprintf(stderr, "rtlsdr: error getting tuner gains\n");
+                rtlsdrClose(rx);
                 return false;
             }
 
             gains = malloc(numgains * sizeof(int));
-            if (rtlsdr_get_tuner_gains(RTLSDR.dev, gains) != numgains) {
+            if (rtlsdr_get_tuner_gains(state->dev, gains) != numgains) {
                 fprintf(stderr, "rtlsdr: error getting tuner gains\n");
                 free(gains);
+                rtlsdrClose(rx);
                 return false;
             }
 
@@ -233,41 +253,47 @@ bool rtlsdrOpen(void) {
                     closest = i;
             }
 
-            rtlsdr_set_tuner_gain(RTLSDR.dev, gains[closest]);
+            rtlsdr_set_tuner_gain(state->dev, gains[closest]);
             free(gains);
 
             fprintf(stderr, "rtlsdr: tuner gain set to %.1f dB\n",
-                    rtlsdr_get_tuner_gain(RTLSDR.dev)/10.0);
+                    rtlsdr_get_tuner_gain(state->dev)/10.0);
         }
     }
 
     if (RTLSDR.digital_agc) {
         fprintf(stderr, "rtlsdr: enabling digital AGC\n");
-        rtlsdr_set_agc_mode(RTLSDR.dev, 1);
+        rtlsdr_set_agc_mode(state->dev, 1);
     }
 
-    rtlsdr_set_freq_correction(RTLSDR.dev, RTLSDR.ppm_error);
-    rtlsdr_set_center_freq(RTLSDR.dev, Modes.freq);
-    rtlsdr_set_sample_rate(RTLSDR.dev, (unsigned)Modes.sample_rate);
+    rtlsdr_set_freq_correction(state->dev, RTLSDR.ppm_error);
+    rtlsdr_set_center_freq(state->dev, Modes.freq);
+    if (rtlsdr_set_sample_rate(state->dev, (unsigned)Modes.sample_rate) < 0) {
+        fprintf(stderr, "rtlsdr: can't sample at %.0f samples/s; RTL2832U dongles go up to about 3.2 MHz (see --sample-rate)\n",
+                Modes.sample_rate);
+        rtlsdrClose(rx);
+        return false;
+    }
 
-    rtlsdr_reset_buffer(RTLSDR.dev);
+    rtlsdr_reset_buffer(state->dev);
 
-    RTLSDR.converter = init_converter(INPUT_UC8,
+    rx->sample_format = INPUT_UC8;
+    state->converter = init_converter(INPUT_UC8,
                                       Modes.sample_rate,
                                       Modes.dc_filter,
-                                      &RTLSDR.converter_state);
-    if (!RTLSDR.converter) {
+                                      &state->converter_state);
+    if (!state->converter) {
         fprintf(stderr, "rtlsdr: can't initialize sample converter\n");
-        rtlsdrClose();
+        rtlsdrClose(rx);
         return false;
     }
 
     return true;
 }
 
-static struct timespec rtlsdr_thread_cpu;
-
 void rtlsdrCallback(unsigned char *buf, uint32_t len, void *ctx) {
+    struct rtlsdr_state *state = ctx;
+    struct receiver *rx = state->rx;
     struct mag_buf *outbuf;
     struct mag_buf *lastbuf;
     uint32_t slen;
@@ -275,21 +301,20 @@ void rtlsdrCallback(unsigned char *buf, uint32_t len, void *ctx) {
     unsigned free_bufs;
     unsigned block_duration;
 
-    static int dropping = 0;
-    static uint64_t sampleCounter = 0;
-
-    MODES_NOTUSED(ctx);
+    // Record everything the dongle gives us, even blocks we drop below
+    if (rx->recorder)
+        recorderWrite(rx->recorder, buf, len);
 
     // Lock the data buffer variables before accessing them
     pthread_mutex_lock(&Modes.data_mutex);
     if (Modes.exit) {
-        rtlsdr_cancel_async(RTLSDR.dev); // ask our caller to exit
+        rtlsdr_cancel_async(state->dev); // ask our caller to exit
     }
 
-    next_free_buffer = (Modes.first_free_buffer + 1) % MODES_MAG_BUFFERS;
-    outbuf = &Modes.mag_buffers[Modes.first_free_buffer];
-    lastbuf = &Modes.mag_buffers[(Modes.first_free_buffer + MODES_MAG_BUFFERS - 1) % MODES_MAG_BUFFERS];
-    free_bufs = (Modes.first_filled_buffer - next_free_buffer + MODES_MAG_BUFFERS) % MODES_MAG_BUFFERS;
+    next_free_buffer = (rx->first_free_buffer + 1) % MODES_MAG_BUFFERS;
+    outbuf = &rx->mag_buffers[rx->first_free_buffer];
+    lastbuf = &rx->mag_buffers[(rx->first_free_buffer + MODES_MAG_BUFFERS - 1) % MODES_MAG_BUFFERS];
+    free_bufs = (rx->first_filled_buffer - next_free_buffer + MODES_MAG_BUFFERS) % MODES_MAG_BUFFERS;
 
     // Paranoia! Unlikely, but let's go for belt and suspenders here
 
@@ -308,21 +333,21 @@ void rtlsdrCallback(unsigned char *buf, uint32_t len, void *ctx) {
 
     slen = len/2; // Drops any trailing odd sample, that's OK
 
-    if (free_bufs == 0 || (dropping && free_bufs < MODES_MAG_BUFFERS/2)) {
+    if (free_bufs == 0 || (state->dropping && free_bufs < MODES_MAG_BUFFERS/2)) {
         // FIFO is full. Drop this block.
-        dropping = 1;
+        state->dropping = 1;
         outbuf->dropped += slen;
-        sampleCounter += slen;
+        state->sampleCounter += slen;
         pthread_mutex_unlock(&Modes.data_mutex);
         return;
     }
 
-    dropping = 0;
+    state->dropping = 0;
     pthread_mutex_unlock(&Modes.data_mutex);
 
     // Compute the sample timestamp and system timestamp for the start of the block
-    outbuf->sampleTimestamp = sampleCounter * 12e6 / Modes.sample_rate;
-    sampleCounter += slen;
+    outbuf->sampleTimestamp = state->sampleCounter * 12e6 / Modes.sample_rate;
+    state->sampleCounter += slen;
 
     // Get the approx system time for the start of this block
     block_duration = 1e3 * slen / Modes.sample_rate;
@@ -337,32 +362,34 @@ void rtlsdrCallback(unsigned char *buf, uint32_t len, void *ctx) {
 
     // Convert the new data
     outbuf->length = slen;
-    RTLSDR.converter(buf, &outbuf->data[Modes.trailing_samples], slen, RTLSDR.converter_state, &outbuf->mean_level, &outbuf->mean_power);
+    state->converter(buf, &outbuf->data[Modes.trailing_samples], slen, state->converter_state, &outbuf->mean_level, &outbuf->mean_power);
 
     // Push the new data to the demodulation thread
     pthread_mutex_lock(&Modes.data_mutex);
 
-    Modes.mag_buffers[next_free_buffer].dropped = 0;
-    Modes.mag_buffers[next_free_buffer].length = 0;  // just in case
-    Modes.first_free_buffer = next_free_buffer;
+    rx->mag_buffers[next_free_buffer].dropped = 0;
+    rx->mag_buffers[next_free_buffer].length = 0;  // just in case
+    rx->first_free_buffer = next_free_buffer;
 
     // accumulate CPU while holding the mutex, and restart measurement
-    end_cpu_timing(&rtlsdr_thread_cpu, &Modes.reader_cpu_accumulator);
-    start_cpu_timing(&rtlsdr_thread_cpu);
+    end_cpu_timing(&state->thread_cpu, &Modes.reader_cpu_accumulator);
+    start_cpu_timing(&state->thread_cpu);
 
-    pthread_cond_signal(&Modes.data_cond);
+    pthread_cond_broadcast(&Modes.data_cond);
     pthread_mutex_unlock(&Modes.data_mutex);
 }
 
-void rtlsdrRun()
+void rtlsdrRun(struct receiver *rx)
 {
-    if (!RTLSDR.dev) {
+    struct rtlsdr_state *state = rx->sdr_state;
+
+    if (!state || !state->dev) {
         return;
     }
 
-    start_cpu_timing(&rtlsdr_thread_cpu);
+    start_cpu_timing(&state->thread_cpu);
 
-    rtlsdr_read_async(RTLSDR.dev, rtlsdrCallback, NULL,
+    rtlsdr_read_async(state->dev, rtlsdrCallback, state,
                       /* MODES_RTL_BUFFERS */ 4,
                       MODES_RTL_BUF_SIZE);
     if (!Modes.exit) {
@@ -370,16 +397,25 @@ void rtlsdrRun()
     }
 }
 
-void rtlsdrClose()
+void rtlsdrClose(struct receiver *rx)
 {
-    if (RTLSDR.dev) {
-        rtlsdr_close(RTLSDR.dev);
-        RTLSDR.dev = NULL;
+    struct rtlsdr_state *state = rx->sdr_state;
+
+    if (!state) {
+        return;
     }
 
-    if (RTLSDR.converter) {
-        cleanup_converter(RTLSDR.converter_state);
-        RTLSDR.converter = NULL;
-        RTLSDR.converter_state = NULL;
+    if (state->dev) {
+        rtlsdr_close(state->dev);
+        state->dev = NULL;
     }
+
+    if (state->converter) {
+        cleanup_converter(state->converter_state);
+        state->converter = NULL;
+        state->converter_state = NULL;
+    }
+
+    free(state);
+    rx->sdr_state = NULL;
 }
@@ -23,9 +23,9 @@
 
 void rtlsdrInitConfig();
 void rtlsdrShowHelp();
-bool rtlsdrOpen();
-void rtlsdrRun();
-void rtlsdrClose();
+bool rtlsdrOpen(struct receiver *rx);
+void rtlsdrRun(struct receiver *rx);
+void rtlsdrClose(struct receiver *rx);
 bool rtlsdrHandleOption(int argc, char **argv, int *jptr);
 
 #endif
@@ -294,7 +294,7 @@ int tune(SoapySDRDevice *dev, double freq) {
     return r; //(r < 0) ? 0 : 1;
 }
 
-bool SOAPYSDROpen(void) {
+bool SOAPYSDROpen(struct receiver *rx) {
     size_t length;
     int r;
     
@@ -361,6 +361,7 @@ bool SOAPYSDROpen(void) {
     }
     SoapySDRStrings_clear(&names,length);
 
+    rx->sample_format = INPUT_SC16;
     SOAPYSDR.converter = init_converter(INPUT_SC16,
                                       Modes.sample_rate,
                                       Modes.dc_filter,
@@ -376,7 +377,7 @@ bool SOAPYSDROpen(void) {
 
 static struct timespec SOAPYSDR_thread_cpu;
 
-void SOAPYSDRRun()
+void SOAPYSDRRun(struct receiver *rx)
 {
     sc16_t samples[MODES_MAG_BUF_SAMPLES];
     static unsigned timeouts = 0;
@@ -421,10 +422,10 @@ void SOAPYSDRRun()
             }
         }
 
-        unsigned next_free_buffer = (Modes.first_free_buffer + 1) % MODES_MAG_BUFFERS;
-        struct mag_buf *outbuf = &Modes.mag_buffers[Modes.first_free_buffer];
-        struct mag_buf *lastbuf = &Modes.mag_buffers[(Modes.first_free_buffer + MODES_MAG_BUFFERS - 1) % MODES_MAG_BUFFERS];
-        unsigned free_bufs = (Modes.first_filled_buffer - next_free_buffer + MODES_MAG_BUFFERS) % MODES_MAG_BUFFERS;
+        unsigned next_free_buffer = (rx->first_free_buffer + 1) % MODES_MAG_BUFFERS;
+        struct mag_buf *outbuf = &rx->mag_buffers[rx->first_free_buffer];
+        struct mag_buf *lastbuf = &rx->mag_buffers[(rx->first_free_buffer + MODES_MAG_BUFFERS - 1) % MODES_MAG_BUFFERS];
+        unsigned free_bufs = (rx->first_filled_buffer - next_free_buffer + MODES_MAG_BUFFERS) % MODES_MAG_BUFFERS;
 
         if (free_bufs == 0 || (dropping && free_bufs < MODES_MAG_BUFFERS/2)) {
             // FIFO is full. Drop this block.
@@ -450,6 +451,9 @@ void SOAPYSDRRun()
         // Compute the sample timestamp for the start of the block
         outbuf->sampleTimestamp = nextTimestamp * 12e6 / Modes.sample_rate / SOAPYSDR.decimation;
 
+        if (rx->recorder)
+            recorderWrite(rx->recorder, samples, nSamples * 4);
+
         // Convert a block of data
         double mean_level, mean_power;
         SOAPYSDR.converter(samples, &outbuf->data[Modes.trailing_samples + outbuf->length], nSamples, SOAPYSDR.converter_state, &mean_level, &mean_power);
@@ -470,11 +474,11 @@ void SOAPYSDRRun()
         end_cpu_timing(&thread_cpu, &Modes.reader_cpu_accumulator);
         start_cpu_timing(&thread_cpu);
 
-        Modes.mag_buffers[next_free_buffer].dropped = 0;
-        Modes.mag_buffers[next_free_buffer].length = 0;  // just in case
-        Modes.first_free_buffer = next_free_buffer;
+        rx->mag_buffers[next_free_buffer].dropped = 0;
+        rx->mag_buffers[next_free_buffer].length = 0;  // just in case
+        rx->first_free_buffer = next_free_buffer;
 
-        pthread_cond_signal(&Modes.data_cond);
+        pthread_cond_broadcast(&Modes.data_cond);
     }
 
     pthread_mutex_unlock(&Modes.data_mutex);
@@ -485,8 +489,10 @@ void SOAPYSDRRun()
     }
 }
 
-void SOAPYSDRClose()
+void SOAPYSDRClose(struct receiver *rx)
 {
+    MODES_NOTUSED(rx);
+
     if (SOAPYSDR.dev) {
         SoapySDRDevice_unmake(SOAPYSDR.dev);
         SOAPYSDR.dev = NULL;
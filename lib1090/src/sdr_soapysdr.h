@@ -27,9 +27,9 @@
 
 void SOAPYSDRInitConfig();
 void SOAPYSDRShowHelp();
-bool SOAPYSDROpen();
-void SOAPYSDRRun();
-void SOAPYSDRClose();
+bool SOAPYSDROpen(struct receiver *rx);
+void SOAPYSDRRun(struct receiver *rx);
+void SOAPYSDRClose(struct receiver *rx);
 bool SOAPYSDRHandleOption(int argc, char **argv, int *jptr);
 bool set_gain(SoapySDRDevice *dev, float gain);
 int set_freq_correction(SoapySDRDevice *dev, int ppm);
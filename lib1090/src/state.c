@@ -0,0 +1,328 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// state.c: tracker state snapshots (--write-state)
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "dump1090.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#define STATE_MODEAC_SIZE (4 * 4096 * sizeof(uint32_t))
+
+// Records are used in place from the mapped file, and are laid out back
+// to back after the header
+_Static_assert(sizeof(struct aircraft) % 8 == 0, "struct aircraft must stay a multiple of 8 bytes for state snapshots");
+_Static_assert(sizeof(struct state_header) % 8 == 0, "struct state_header must stay a multiple of 8 bytes");
+
+// Every member of struct aircraft and data_validity; bit-fields can't be
+// named here, but any change to them moves their neighbours. A snapshot is
+// only restored if the offsets, sizes and kinds of all of these match the
+// running build (see stateLayout).
+#define STATE_AIRCRAFT_FIELDS(F) \
+    F(addr) F(addrtype) F(seen) F(messages) F(reliable) F(reliableDF11) \
+    F(reliableDF17) F(discarded) F(signalLevel) F(signalNext) \
+    F(callsign_valid) F(callsign) F(altitude_baro_valid) F(altitude_baro) \
+    F(altitude_geom_valid) F(altitude_geom) F(geom_delta_valid) \
+    F(geom_delta) F(gs_valid) F(gs) F(ias_valid) F(ias) F(tas_valid) \
+    F(tas) F(mach_valid) F(mach) F(track_valid) F(track) \
+    F(track_rate_valid) F(track_rate) F(roll_valid) F(roll) \
+    F(mag_heading_valid) F(mag_heading) F(true_heading_valid) \
+    F(true_heading) F(baro_rate_valid) F(baro_rate) F(geom_rate_valid) \
+    F(geom_rate) F(squawk_valid) F(squawk) F(emergency_valid) F(emergency) \
+    F(category) F(airground_valid) F(airground) F(nav_qnh_valid) \
+    F(nav_qnh) F(nav_altitude_mcp_valid) F(nav_altitude_mcp) \
+    F(nav_altitude_fms_valid) F(nav_altitude_fms) \
+    F(nav_altitude_src_valid) F(nav_altitude_src) F(nav_heading_valid) \
+    F(nav_heading) F(nav_modes_valid) F(nav_modes) F(cpr_odd_valid) \
+    F(cpr_odd_type) F(cpr_odd_lat) F(cpr_odd_lon) F(cpr_odd_nic) \
+    F(cpr_odd_rc) F(cpr_even_valid) F(cpr_even_type) F(cpr_even_lat) \
+    F(cpr_even_lon) F(cpr_even_nic) F(cpr_even_rc) F(position_valid) \
+    F(lat) F(lon) F(pos_nic) F(pos_rc) F(adsb_version) F(adsr_version) \
+    F(tisb_version) F(adsb_hrd) F(adsb_tah) F(nic_a_valid) F(nic_c_valid) \
+    F(nic_baro_valid) F(nac_p_valid) F(nac_v_valid) F(sil_valid) \
+    F(gva_valid) F(sda_valid) F(sil_type) F(modeA_hit) F(modeC_hit) \
+    F(fatsv_emitted_altitude_baro) F(fatsv_emitted_altitude_geom) \
+    F(fatsv_emitted_baro_rate) F(fatsv_emitted_geom_rate) \
+    F(fatsv_emitted_track) F(fatsv_emitted_track_rate) \
+    F(fatsv_emitted_mag_heading) F(fatsv_emitted_true_heading) \
+    F(fatsv_emitted_roll) F(fatsv_emitted_gs) F(fatsv_emitted_ias) \
+    F(fatsv_emitted_tas) F(fatsv_emitted_mach) F(fatsv_emitted_airground) \
+    F(fatsv_emitted_nav_altitude_mcp) F(fatsv_emitted_nav_altitude_fms) \
+    F(fatsv_emitted_nav_altitude_src) F(fatsv_emitted_nav_heading) \
+    F(fatsv_emitted_nav_modes) F(fatsv_emitted_nav_qnh) \
+    F(fatsv_emitted_bds_10) F(fatsv_emitted_bds_30) \
+    F(fatsv_emitted_es_status) F(fatsv_emitted_es_acas_ra) \
+    F(fatsv_emitted_callsign) F(fatsv_emitted_addrtype) \
+    F(fatsv_emitted_adsb_version) F(fatsv_emitted_category) \
+    F(fatsv_emitted_squawk) F(fatsv_emitted_nac_p) F(fatsv_emitted_nac_v) \
+    F(fatsv_emitted_sil) F(fatsv_emitted_sil_type) \
+    F(fatsv_emitted_nic_baro) F(fatsv_emitted_emergency) \
+    F(fatsv_last_emitted) F(fatsv_last_force_emit) F(fatsv_changed) \
+    F(fatsv_dirty_next) F(fatsv_dirty_pprev) F(trace.segment) \
+    F(trace.time) F(trace.lat) F(trace.lon) F(trace.alt_baro) \
+    F(trace.alt_geom) F(trace.gs) F(trace.track) F(trace.baro_rate) \
+    F(trace.squawk) F(trace.callsign) F(next)
+
+#define STATE_VALIDITY_FIELDS(F) \
+    F(stale_interval) F(expire_interval) F(source) F(updated) F(stale) \
+    F(expires)
+
+// Tells apart members of the same size but a different type
+#define STATE_KIND(x) _Generic((x), \
+    float: 1, double: 2, int: 3, unsigned: 4, long: 5, unsigned long: 6, \
+    long long: 7, unsigned long long: 8, char *: 9, unsigned char *: 10, \
+    double *: 11, struct aircraft *: 12, struct aircraft **: 13, default: 0)
+
+static uint32_t layoutMix(uint32_t hash, size_t offset, size_t size, int kind)
+{
+    // FNV-1a over the three values
+    uint64_t v[3] = { offset, size, (uint64_t) kind };
+    const unsigned char *p = (const unsigned char *) v;
+
+    for (size_t i = 0; i < sizeof(v); ++i) {
+        hash ^= p[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+// Fingerprint of the record layout, stored in the snapshot header
+static uint32_t stateLayout(void)
+{
+    uint32_t hash = 2166136261U;
+
+#define STATE_MIX(type, f) hash = layoutMix(hash, offsetof(type, f), sizeof(((type *) 0)->f), STATE_KIND(((type *) 0)->f));
+#define STATE_MIX_AIRCRAFT(f) STATE_MIX(struct aircraft, f)
+#define STATE_MIX_VALIDITY(f) STATE_MIX(data_validity, f)
+    STATE_AIRCRAFT_FIELDS(STATE_MIX_AIRCRAFT)
+    STATE_VALIDITY_FIELDS(STATE_MIX_VALIDITY)
+#undef STATE_MIX_VALIDITY
+#undef STATE_MIX_AIRCRAFT
+#undef STATE_MIX
+
+    return layoutMix(hash, 0, sizeof(struct aircraft), 0);
+}
+
+struct icao_list {
+    struct state_icao_entry *entries;
+    uint32_t count;
+    uint32_t size;
+};
+
+static void collectIcao(uint32_t addr, uint32_t seen, void *udata)
+{
+    struct icao_list *list = udata;
+
+    if (list->count == list->size) {
+        list->size = list->size ? list->size * 2 : 1024;
+        if (!(list->entries = realloc(list->entries, list->size * sizeof(*list->entries)))) {
+            fprintf(stderr, "state: out of memory\n");
+            exit(1);
+        }
+    }
+
+    list->entries[list->count].addr = addr;
+    list->entries[list->count].seen = seen;
+    ++list->count;
+}
+
+bool stateWrite(const char *path)
+{
+#ifndef _WIN32
+    char tmppath[PATH_MAX];
+    struct state_header header;
+    struct icao_list icao = { NULL, 0, 0 };
+    struct aircraft *a;
+    uint32_t aircraft_count = 0;
+
+    for (a = Modes.aircrafts; a; a = a->next)
+        ++aircraft_count;
+    icaoFilterForEach(collectIcao, &icao);
+
+    // struct aircraft and struct state_icao_entry are both multiples of
+    // 8 bytes (see the asserts above), so laying the sections out back to
+    // back keeps them aligned
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, STATE_MAGIC, sizeof(header.magic));
+    header.version = STATE_VERSION;
+    header.byte_order = STATE_BYTE_ORDER;
+    header.record_size = sizeof(struct aircraft);
+    header.record_layout = stateLayout();
+    header.saved = mstime();
+    header.aircraft_count = aircraft_count;
+    header.icao_count = icao.count;
+    header.aircraft_offset = sizeof(header);
+    header.icao_offset = header.aircraft_offset + (uint64_t) aircraft_count * sizeof(struct aircraft);
+    header.modeac_offset = header.icao_offset + (uint64_t) icao.count * sizeof(struct state_icao_entry);
+
+    snprintf(tmppath, PATH_MAX, "%s.XXXXXX", path);
+    tmppath[PATH_MAX-1] = 0;
+    int fd = mkstemp(tmppath);
+    if (fd < 0) {
+        fprintf(stderr, "state: %s: %s\n", tmppath, strerror(errno));
+        free(icao.entries);
+        return false;
+    }
+
+    FILE *out = fdopen(fd, "wb");
+    if (!out) {
+        fprintf(stderr, "state: %s: %s\n", tmppath, strerror(errno));
+        close(fd);
+        unlink(tmppath);
+        free(icao.entries);
+        return false;
+    }
+
+    bool ok = (fwrite(&header, sizeof(header), 1, out) == 1);
+
+    for (a = Modes.aircrafts; a && ok; a = a->next) {
+        struct aircraft record = *a;
+        record.next = NULL;
+        record.fatsv_dirty_next = NULL;
+        record.fatsv_dirty_pprev = NULL;
+        ok = (fwrite(&record, sizeof(record), 1, out) == 1);
+    }
+
+    if (ok && icao.count)
+        ok = (fwrite(icao.entries, sizeof(*icao.entries), icao.count, out) == icao.count);
+
+    ok = ok &&
+        fwrite(Modes.modeAC_count, sizeof(Modes.modeAC_count), 1, out) == 1 &&
+        fwrite(Modes.modeAC_lastcount, sizeof(Modes.modeAC_lastcount), 1, out) == 1 &&
+        fwrite(Modes.modeAC_match, sizeof(Modes.modeAC_match), 1, out) == 1 &&
+        fwrite(Modes.modeAC_age, sizeof(Modes.modeAC_age), 1, out) == 1;
+
+    if (fclose(out) != 0)
+        ok = false;
+    free(icao.entries);
+
+    if (!ok || rename(tmppath, path) < 0) {
+        fprintf(stderr, "state: failed to write %s: %s\n", path, strerror(errno));
+        unlink(tmppath);
+        return false;
+    }
+
+    return true;
+#else
+    MODES_NOTUSED(path);
+    return false;
+#endif
+}
+
+// Returns NULL if the snapshot starting with 'h' (of 'len' bytes) can be used,
+// otherwise why not
+static const char *checkHeader(const struct state_header *h, size_t len)
+{
+    if (len < sizeof(*h) || memcmp(h->magic, STATE_MAGIC, sizeof(h->magic)))
+        return "not a state snapshot";
+    if (h->version != STATE_VERSION)
+        return "unsupported snapshot version";
+    if (h->byte_order != STATE_BYTE_ORDER || h->record_size != sizeof(struct aircraft) || h->record_layout != stateLayout())
+        return "snapshot written by a different build";
+    if ((h->aircraft_offset | h->icao_offset | h->modeac_offset) & 7)
+        return "misaligned snapshot";
+    if (h->aircraft_offset > len || h->aircraft_count > (len - h->aircraft_offset) / h->record_size ||
+        h->icao_offset > len || h->icao_count > (len - h->icao_offset) / sizeof(struct state_icao_entry) ||
+        h->modeac_offset > len || len - h->modeac_offset < STATE_MODEAC_SIZE)
+        return "truncated snapshot";
+    return NULL;
+}
+
+void stateRead(const char *path)
+{
+#ifndef _WIN32
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT)
+            fprintf(stderr, "state: %s: %s\n", path, strerror(errno));
+        return;
+    }
+
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        close(fd);
+        return;
+    }
+
+    size_t len = st.st_size;
+    void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "state: %s: %s\n", path, strerror(errno));
+        return;
+    }
+
+    const uint8_t *base = map;
+    const struct state_header *h = map;
+    const char *problem = checkHeader(h, len);
+    if (problem) {
+        fprintf(stderr, "state: %s: %s, not restoring tracker state\n", path, problem);
+        munmap(map, len);
+        return;
+    }
+
+    // Keep the saved order
+    uint64_t now = mstime();
+    struct aircraft **tail = &Modes.aircrafts;
+    while (*tail)
+        tail = &(*tail)->next;
+
+    unsigned restored = 0;
+    for (uint32_t i = 0; i < h->aircraft_count; ++i) {
+        const struct aircraft *saved = (const struct aircraft *) (base + h->aircraft_offset + (uint64_t) i * h->record_size);
+
+        // Drop what trackRemoveStaleAircraft() would have removed while we
+        // were down, and anything from the future (the clock went backwards)
+        if (saved->seen > now)
+            continue;
+        if ((now - saved->seen) > TRACK_AIRCRAFT_TTL || (!saved->reliable && (now - saved->seen) > TRACK_AIRCRAFT_UNRELIABLE_TTL))
+            continue;
+
+        struct aircraft *a = malloc(sizeof(*a));
+        if (!a) {
+            fprintf(stderr, "state: out of memory\n");
+            exit(1);
+        }
+
+        *a = *saved;
+        a->next = NULL;
+        a->fatsv_dirty_next = NULL;
+        a->fatsv_dirty_pprev = NULL;
+
+        *tail = a;
+        tail = &a->next;
+        ++restored;
+    }
+
+    const struct state_icao_entry *entries = (const struct state_icao_entry *) (base + h->icao_offset);
+    for (uint32_t i = 0; i < h->icao_count; ++i)
+        icaoFilterAddSeen(entries[i].addr, entries[i].seen);
+
+    const uint32_t *modeac = (const uint32_t *) (base + h->modeac_offset);
+    memcpy(Modes.modeAC_count, modeac, sizeof(Modes.modeAC_count));
+    memcpy(Modes.modeAC_lastcount, modeac + 4096, sizeof(Modes.modeAC_lastcount));
+    memcpy(Modes.modeAC_match, modeac + 2 * 4096, sizeof(Modes.modeAC_match));
+    memcpy(Modes.modeAC_age, modeac + 3 * 4096, sizeof(Modes.modeAC_age));
+
+    log_with_timestamp("Restored %u of %u aircraft from %s (saved %.0fs ago)",
+                       restored, h->aircraft_count, path, (now > h->saved ? now - h->saved : 0) / 1000.0);
+
+    munmap(map, len);
+#else
+    MODES_NOTUSED(path);
+#endif
+}
@@ -0,0 +1,71 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// state.h: tracker state snapshots (--write-state) and their file format
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DUMP1090_STATE_H
+#define DUMP1090_STATE_H
+
+// File layout, in native byte order and struct layout; a snapshot is only
+// meant to be read back by the same build on the same machine, and the
+// header carries enough to notice when that isn't so:
+//
+//   header:    struct state_header
+//   aircraft:  aircraft_count records of record_size bytes each
+//              (struct aircraft with its list pointers cleared)
+//   icao:      icao_count struct state_icao_entry
+//   mode A/C:  modeAC_count, modeAC_lastcount, modeAC_match, modeAC_age
+//              (4 x 4096 uint32_t)
+//
+// Each section starts at the offset given in the header, aligned to 8
+// bytes, so the file can be mapped and its records used in place.
+//
+// All timestamps in the tracker are wall-clock, so restored data simply
+// ages by however long we were down.
+
+#define STATE_MAGIC "D1090TRK"
+// Bump on any change to the file layout. Changes to struct aircraft are
+// caught by record_layout, but bumping for those too does no harm.
+#define STATE_VERSION 2
+#define STATE_BYTE_ORDER 0x01020304
+
+struct state_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t byte_order;        // STATE_BYTE_ORDER as the writer saw it
+    uint32_t record_size;       // sizeof(struct aircraft)
+    uint32_t record_layout;     // fingerprint of the offsets, sizes and types of its members
+    uint64_t saved;             // mstime() when the snapshot was taken
+    uint32_t aircraft_count;
+    uint32_t icao_count;
+    uint64_t aircraft_offset;
+    uint64_t icao_offset;
+    uint64_t modeac_offset;
+};
+
+struct state_icao_entry {
+    uint32_t addr;
+    uint32_t seen;              // icao_filter epoch (seconds)
+};
+
+// Write the current instance's tracker state to 'path', replacing it atomically
+bool stateWrite(const char *path);
+
+// Restore tracker state from 'path' into the current instance. Call after
+// icaoFilterInit() and before any messages are tracked. A missing, stale or
+// incompatible snapshot is not an error; there is just nothing to restore.
+void stateRead(const char *path);
+
+#endif
@@ -88,6 +88,8 @@ void display_stats(struct stats *st) {
         printf("    %u accepted with correct CRC\n",                st->demod_accepted[0]);
         for (j = 1; j <= Modes.nfix_crc; ++j)
             printf("    %u accepted with %d-bit error repaired\n", st->demod_accepted[j], j);
+        printf("  %u Mode-S phase candidates scored\n",              st->demod_phases_scored);
+        printf("  %u Mode-S phase candidates abandoned by DF\n",     st->demod_phases_abandoned);
 
         if (st->noise_power_sum > 0 && st->noise_power_count > 0) {
             printf("  %.1f dBFS noise power\n",
@@ -121,6 +123,30 @@ void display_stats(struct stats *st) {
 
     printf("%u total usable messages\n",
            st->messages_total);
+    if (Modes.net) {
+        printf("Messages handed to output formats:\n");
+        for (j = 0; j < NET_OUTPUT_FORMATS; ++j)
+            printf("  %u %s\n", st->net_output_calls[j], netOutputFormatName(j));
+        if (st->net_udp_sent || st->net_udp_dropped)
+            printf("%u UDP output datagrams sent, %u dropped\n", st->net_udp_sent, st->net_udp_dropped);
+        if (st->net_compress_in)
+            printf("%llu bytes of compressed Beast output sent as %llu (%.1f:1)\n",
+                   (unsigned long long) st->net_compress_in, (unsigned long long) st->net_compress_out,
+                   st->net_compress_out ? (double) st->net_compress_in / st->net_compress_out : 0.0);
+        if (st->net_decompress_in)
+            printf("%llu bytes of compressed Beast input received as %llu (%.1f:1)\n",
+                   (unsigned long long) st->net_decompress_in, (unsigned long long) st->net_decompress_out,
+                   (double) st->net_decompress_out / st->net_decompress_in);
+    }
+    if (Modes.dedup_window)
+        printf("%u duplicate messages from other inputs dropped\n", st->dedup_dropped);
+
+    printf("%u Comm-B replies identified as repeats\n"
+           "%u Comm-B replies identified by prediction\n"
+           "%u Comm-B replies that needed a full decoder sweep\n",
+           st->commb_repeated,
+           st->commb_predicted,
+           st->commb_sweeps);
 
     printf("%u surface position messages received\n"
            "%u airborne position messages received\n"
@@ -177,6 +203,33 @@ void display_stats(struct stats *st) {
     fflush(stdout);
 }
 
+// Summary printed at the end of a --bench run; elapsed is wall-clock seconds
+void display_bench_stats(const struct stats *st, double elapsed)
+{
+    uint64_t demod_cpu_millis = (uint64_t)st->demod_cpu.tv_sec*1000UL + st->demod_cpu.tv_nsec/1000000UL;
+    uint64_t reader_cpu_millis = (uint64_t)st->reader_cpu.tv_sec*1000UL + st->reader_cpu.tv_nsec/1000000UL;
+    uint64_t background_cpu_millis = (uint64_t)st->background_cpu.tv_sec*1000UL + st->background_cpu.tv_nsec/1000000UL;
+    uint64_t total_cpu_millis = demod_cpu_millis + reader_cpu_millis + background_cpu_millis;
+
+    if (elapsed <= 0)
+        elapsed = 1e-3;
+
+    printf("\nBenchmark:\n");
+    printf("  %.3f s elapsed\n", elapsed);
+    printf("  %llu samples, %.2f Msamples/s (%.1fx realtime)\n",
+           (unsigned long long) st->samples_processed,
+           st->samples_processed / elapsed / 1e6,
+           st->samples_processed / elapsed / Modes.sample_rate);
+    printf("  %u messages, %.0f messages/s\n",
+           st->messages_total, st->messages_total / elapsed);
+    printf("  CPU: %llu ms demodulation (%.1f%%), %llu ms reading and conversion (%.1f%%), %llu ms background (%.1f%%)\n",
+           (unsigned long long) demod_cpu_millis, 100.0 * demod_cpu_millis / (total_cpu_millis + 1),
+           (unsigned long long) reader_cpu_millis, 100.0 * reader_cpu_millis / (total_cpu_millis + 1),
+           (unsigned long long) background_cpu_millis, 100.0 * background_cpu_millis / (total_cpu_millis + 1));
+
+    fflush(stdout);
+}
+
 static void display_range_histogram(struct stats *st)
 {
     uint32_t peak;
@@ -268,6 +321,8 @@ void add_stats(const struct stats *st1, const struct stats *st2, struct stats *t
     target->demod_rejected_unknown_icao = st1->demod_rejected_unknown_icao + st2->demod_rejected_unknown_icao;
     for (i = 0; i < MODES_MAX_BITERRORS+1; ++i)
         target->demod_accepted[i]  = st1->demod_accepted[i] + st2->demod_accepted[i];
+    target->demod_phases_scored = st1->demod_phases_scored + st2->demod_phases_scored;
+    target->demod_phases_abandoned = st1->demod_phases_abandoned + st2->demod_phases_abandoned;
     target->demod_modeac = st1->demod_modeac + st2->demod_modeac;
 
     target->samples_processed = st1->samples_processed + st2->samples_processed;
@@ -304,6 +359,21 @@ void add_stats(const struct stats *st1, const struct stats *st2, struct stats *t
 
     // total messages:
     target->messages_total = st1->messages_total + st2->messages_total;
+    target->dedup_dropped = st1->dedup_dropped + st2->dedup_dropped;
+
+    // Comm-B:
+    target->commb_repeated = st1->commb_repeated + st2->commb_repeated;
+    target->commb_predicted = st1->commb_predicted + st2->commb_predicted;
+    target->commb_sweeps = st1->commb_sweeps + st2->commb_sweeps;
+
+    for (i = 0; i < NET_OUTPUT_FORMATS; ++i)
+        target->net_output_calls[i] = st1->net_output_calls[i] + st2->net_output_calls[i];
+    target->net_udp_sent = st1->net_udp_sent + st2->net_udp_sent;
+    target->net_udp_dropped = st1->net_udp_dropped + st2->net_udp_dropped;
+    target->net_compress_in = st1->net_compress_in + st2->net_compress_in;
+    target->net_compress_out = st1->net_compress_out + st2->net_compress_out;
+    target->net_decompress_in = st1->net_decompress_in + st2->net_decompress_in;
+    target->net_decompress_out = st1->net_decompress_out + st2->net_decompress_out;
 
     // CPR decoding:
     target->cpr_surface = st1->cpr_surface + st2->cpr_surface;
@@ -59,6 +59,8 @@ struct stats {
     uint32_t demod_rejected_bad;
     uint32_t demod_rejected_unknown_icao;
     uint32_t demod_accepted[MODES_MAX_BITERRORS+1];
+    uint32_t demod_phases_scored;     // phases sliced in full and scored
+    uint32_t demod_phases_abandoned;     // phases whose DF could not beat the best score
 
     // Mode A/C demodulator counts:
     uint32_t demod_modeac;
@@ -95,6 +97,29 @@ struct stats {
     // total messages:
     uint32_t messages_total;
 
+    // messages handed to each output format
+    uint32_t net_output_calls[NET_OUTPUT_FORMATS];
+
+    // UDP output datagrams sent, and lost because the send failed
+    uint32_t net_udp_sent;
+    uint32_t net_udp_dropped;
+
+    // compressed Beast connections: bytes before and after deflate on
+    // output, and before and after inflate on input
+    uint64_t net_compress_in;
+    uint64_t net_compress_out;
+    uint64_t net_decompress_in;
+    uint64_t net_decompress_out;
+
+    // messages dropped as duplicates of another input's copy
+    uint32_t dedup_dropped;
+
+    // Comm-B replies identified by repeating the last reply's result,
+    // by the aircraft's recent registers, or by trying every decoder
+    uint32_t commb_repeated;
+    uint32_t commb_predicted;
+    uint32_t commb_sweeps;
+
     // CPR decoding:
     unsigned int cpr_surface;
     unsigned int cpr_airborne;
@@ -130,6 +155,7 @@ struct stats {
 
 void add_stats(const struct stats *st1, const struct stats *st2, struct stats *target);
 void display_stats(struct stats *st);
+void display_bench_stats(const struct stats *st, double elapsed);
 void reset_stats(struct stats *st);
 
 void add_timespecs(const struct timespec *x, const struct timespec *y, struct timespec *z);
@@ -0,0 +1,466 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// trace.c: append-only binary aircraft trace archive (--write-trace)
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "dump1090.h"
+
+// Records are collected here and written with a single write(), so a
+// crash can only lose whole buffers rather than leave half a record behind
+#define TRACE_BUFFER_SIZE 65536
+
+// Upper bound on the encoded size of one record
+#define TRACE_MAX_RECORD 96
+
+// Millis between writes of a partly filled buffer
+#define TRACE_FLUSH_INTERVAL 1000
+
+// Millis before trying again after the file could not be opened or written
+#define TRACE_RETRY_INTERVAL 10000
+
+#define TRACE_MS_PER_DAY 86400000ULL
+
+static uint8_t *putVarint(uint8_t *p, uint64_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (uint8_t) (v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t) v;
+    return p;
+}
+
+static uint8_t *putZigzag(uint8_t *p, int64_t v)
+{
+    return putVarint(p, ((uint64_t) v << 1) ^ (uint64_t) (v >> 63));
+}
+
+//
+// Writer
+//
+
+static void writeBuffer(void)
+{
+    const uint8_t *p = Modes.trace_buf;
+    size_t left = Modes.trace_buf_used;
+
+    while (left > 0 && Modes.trace_fd >= 0) {
+        ssize_t n = write(Modes.trace_fd, p, left);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            // drop this buffer and start a new segment a little later
+            fprintf(stderr, "trace: write failed: %s\n", strerror(errno));
+            close(Modes.trace_fd);
+            Modes.trace_fd = -1;
+            Modes.next_trace_retry = messageNow() + TRACE_RETRY_INTERVAL;
+            break;
+        }
+        p += n;
+        left -= n;
+    }
+
+    Modes.trace_buf_used = 0;
+}
+
+static void closeFile(void)
+{
+    if (Modes.trace_fd >= 0) {
+        writeBuffer();
+        if (Modes.trace_fd >= 0)
+            close(Modes.trace_fd);
+    }
+    Modes.trace_fd = -1;
+    Modes.trace_buf_used = 0;
+}
+
+// Open (or reopen) the file for the day containing 'now' and start a segment
+static void openFile(uint64_t now)
+{
+    char path[PATH_MAX];
+    time_t t = now / 1000;
+    struct tm tm;
+
+    closeFile();
+    Modes.trace_day = now / TRACE_MS_PER_DAY;
+
+    gmtime_r(&t, &tm);
+    snprintf(path, sizeof(path), "%s/trace-%04d%02d%02d.bin", Modes.trace_dir, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+    path[PATH_MAX-1] = 0;
+
+    if ((Modes.trace_fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644)) < 0) {
+        fprintf(stderr, "trace: %s: %s\n", path, strerror(errno));
+        Modes.next_trace_retry = now + TRACE_RETRY_INTERVAL;
+        return;
+    }
+
+    if (!Modes.trace_buf && !(Modes.trace_buf = malloc(TRACE_BUFFER_SIZE))) {
+        fprintf(stderr, "trace: out of memory\n");
+        exit(1);
+    }
+
+    // every aircraft starts again with a keyframe
+    uint8_t *p = Modes.trace_buf;
+    *p++ = 0;
+    memcpy(p, TRACE_MAGIC, 8);
+    p += 8;
+    *p++ = TRACE_VERSION;
+    for (int i = 0; i < 8; ++i)
+        *p++ = (uint8_t) (now >> (8 * i));
+    Modes.trace_buf_used = p - Modes.trace_buf;
+    Modes.trace_base = now;
+    Modes.next_trace_flush = now + TRACE_FLUSH_INTERVAL;
+}
+
+// Append a record for whatever this message changed. Called for every
+// message from a reliable aircraft once it has been applied.
+void traceUpdate(struct aircraft *a)
+{
+    uint64_t now = messageNow();
+
+    // files only move forwards, even if message times don't; after a
+    // failure, the file is retried every TRACE_RETRY_INTERVAL
+    if (now / TRACE_MS_PER_DAY > Modes.trace_day || (Modes.trace_fd < 0 && now >= Modes.next_trace_retry))
+        openFile(now);
+    if (Modes.trace_fd < 0)
+        return;
+
+    int keyframe = (a->trace.segment != Modes.trace_base);
+    struct trace_state next;
+    unsigned fields = 0;
+
+    if (keyframe) {
+        memset(&next, 0, sizeof(next));
+        next.segment = next.time = Modes.trace_base;
+        fields |= TRACE_KEYFRAME;
+    } else {
+        next = a->trace;
+    }
+
+    // In a keyframe, everything that's valid; otherwise only what this
+    // message updated and that changed at the resolution we store
+#define TRACE_FRESH(_f) (trackDataValid(&a->_f##_valid) && (keyframe || a->_f##_valid.updated == now))
+    if (TRACE_FRESH(position)) {
+        int32_t lat = (int32_t) lround(a->lat * 1e5);
+        int32_t lon = (int32_t) lround(a->lon * 1e5);
+        if (keyframe || lat != next.lat || lon != next.lon) {
+            fields |= TRACE_POSITION;
+            next.lat = lat;
+            next.lon = lon;
+        }
+    }
+    if (TRACE_FRESH(altitude_baro) && (keyframe || a->altitude_baro != next.alt_baro)) {
+        fields |= TRACE_ALT_BARO;
+        next.alt_baro = a->altitude_baro;
+    }
+    if (TRACE_FRESH(altitude_geom) && (keyframe || a->altitude_geom != next.alt_geom)) {
+        fields |= TRACE_ALT_GEOM;
+        next.alt_geom = a->altitude_geom;
+    }
+    if (TRACE_FRESH(gs)) {
+        int32_t gs = (int32_t) lroundf(a->gs * 10);
+        if (keyframe || gs != next.gs) {
+            fields |= TRACE_GS;
+            next.gs = gs;
+        }
+    }
+    if (TRACE_FRESH(track)) {
+        int32_t track = (int32_t) lroundf(a->track * 10);
+        if (keyframe || track != next.track) {
+            fields |= TRACE_TRACK;
+            next.track = track;
+        }
+    }
+    if (TRACE_FRESH(baro_rate) && (keyframe || a->baro_rate != next.baro_rate)) {
+        fields |= TRACE_BARO_RATE;
+        next.baro_rate = a->baro_rate;
+    }
+    if (TRACE_FRESH(squawk) && (keyframe || a->squawk != next.squawk)) {
+        fields |= TRACE_SQUAWK;
+        next.squawk = a->squawk;
+    }
+    if (TRACE_FRESH(callsign) && (keyframe || memcmp(a->callsign, next.callsign, 8))) {
+        fields |= TRACE_CALLSIGN;
+        memcpy(next.callsign, a->callsign, 8);
+    }
+#undef TRACE_FRESH
+
+    if (!(fields & TRACE_ALL_FIELDS))
+        return;
+
+    if (Modes.trace_buf_used + TRACE_MAX_RECORD > TRACE_BUFFER_SIZE)
+        writeBuffer();
+
+    uint64_t when = (now > next.time ? now : next.time);
+    uint8_t *p = Modes.trace_buf + Modes.trace_buf_used;
+    p = putVarint(p, fields);
+    p = putVarint(p, a->addr);
+    p = putVarint(p, when - next.time);
+    next.time = when;
+
+    const struct trace_state *prev = keyframe ? NULL : &a->trace;
+#define TRACE_DELTA(_f) putZigzag(p, (int64_t) next._f - (prev ? prev->_f : 0))
+    if (fields & TRACE_POSITION) {
+        p = TRACE_DELTA(lat);
+        p = TRACE_DELTA(lon);
+    }
+    if (fields & TRACE_ALT_BARO)
+        p = TRACE_DELTA(alt_baro);
+    if (fields & TRACE_ALT_GEOM)
+        p = TRACE_DELTA(alt_geom);
+    if (fields & TRACE_GS)
+        p = TRACE_DELTA(gs);
+    if (fields & TRACE_TRACK)
+        p = TRACE_DELTA(track);
+    if (fields & TRACE_BARO_RATE)
+        p = TRACE_DELTA(baro_rate);
+#undef TRACE_DELTA
+    if (fields & TRACE_SQUAWK)
+        p = putVarint(p, next.squawk);
+    if (fields & TRACE_CALLSIGN) {
+        memcpy(p, next.callsign, 8);
+        p += 8;
+    }
+
+    Modes.trace_buf_used = p - Modes.trace_buf;
+    a->trace = next;
+}
+
+// Write out buffered records now and then, so the archive is never far behind
+void traceFlush(uint64_t now)
+{
+    if (Modes.trace_fd >= 0 && Modes.trace_buf_used && now >= Modes.next_trace_flush) {
+        writeBuffer();
+        Modes.next_trace_flush = now + TRACE_FLUSH_INTERVAL;
+    }
+}
+
+void traceClose(void)
+{
+    closeFile();
+    free(Modes.trace_buf);
+    Modes.trace_buf = NULL;
+}
+
+//
+// Reader
+//
+
+struct trace_entry {
+    uint32_t addr;              // 0 if unused
+    struct trace_state state;
+};
+
+struct trace_reader {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint64_t base;              // base time of the current segment; 0 before the first one
+    unsigned damaged;           // stretches of damaged data skipped
+
+    // per-aircraft state in the current segment, open-addressed
+    struct trace_entry *entries;
+    uint32_t size;
+    uint32_t used;
+};
+
+struct trace_reader *traceReaderNew(const uint8_t *data, size_t len)
+{
+    struct trace_reader *r = calloc(1, sizeof(*r));
+    if (!r) {
+        fprintf(stderr, "trace: out of memory\n");
+        exit(1);
+    }
+    r->p = data;
+    r->end = data + len;
+    return r;
+}
+
+void traceReaderFree(struct trace_reader *r)
+{
+    if (!r)
+        return;
+    free(r->entries);
+    free(r);
+}
+
+static inline uint32_t entryHash(uint32_t addr)
+{
+    return addr * 2654435761U;
+}
+
+static struct trace_entry *findEntry(struct trace_reader *r, uint32_t addr, int create)
+{
+    if (create && (r->used + 1) * 2 > r->size) {
+        struct trace_entry *old = r->entries;
+        uint32_t old_size = r->size;
+
+        r->size = old_size ? old_size * 2 : 1024;
+        if (!(r->entries = calloc(r->size, sizeof(*r->entries)))) {
+            fprintf(stderr, "trace: out of memory\n");
+            exit(1);
+        }
+        r->used = 0;
+        for (uint32_t i = 0; i < old_size; ++i) {
+            if (old[i].addr) {
+                struct trace_entry *e = findEntry(r, old[i].addr, 1);
+                e->state = old[i].state;
+            }
+        }
+        free(old);
+    }
+
+    if (!r->size)
+        return NULL;
+
+    for (uint32_t i = entryHash(addr) & (r->size - 1); ; i = (i + 1) & (r->size - 1)) {
+        struct trace_entry *e = &r->entries[i];
+        if (e->addr == addr)
+            return e;
+        if (!e->addr) {
+            if (!create)
+                return NULL;
+            e->addr = addr;
+            ++r->used;
+            return e;
+        }
+    }
+}
+
+static int getVarint(struct trace_reader *r, uint64_t *v)
+{
+    uint64_t x = 0;
+    for (unsigned shift = 0; shift < 64 && r->p < r->end; shift += 7) {
+        uint8_t b = *r->p++;
+        x |= (uint64_t) (b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = x;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int getDelta(struct trace_reader *r, int32_t *value)
+{
+    uint64_t u;
+    if (!getVarint(r, &u))
+        return 0;
+    *value = (int32_t) (*value + ((int64_t) (u >> 1) ^ -(int64_t) (u & 1)));
+    return 1;
+}
+
+static int isSegmentHeader(const uint8_t *p, const uint8_t *end)
+{
+    return end - p >= TRACE_SEGMENT_SIZE && p[0] == 0 && !memcmp(p + 1, TRACE_MAGIC, 8) && p[9] == TRACE_VERSION;
+}
+
+static void readSegmentHeader(struct trace_reader *r)
+{
+    r->base = 0;
+    for (int i = 0; i < 8; ++i)
+        r->base |= (uint64_t) r->p[10 + i] << (8 * i);
+    r->p += TRACE_SEGMENT_SIZE;
+
+    if (r->entries)
+        memset(r->entries, 0, r->size * sizeof(*r->entries));
+    r->used = 0;
+}
+
+// Decode the record at r->p; returns 0 if it is damaged
+static int readRecord(struct trace_reader *r, struct trace_point *p)
+{
+    uint64_t fields, addr, dt, squawk;
+    if (!getVarint(r, &fields) || !getVarint(r, &addr) || !getVarint(r, &dt))
+        return 0;
+    if (!(fields & TRACE_ALL_FIELDS) || (fields & ~(uint64_t) (TRACE_ALL_FIELDS | TRACE_KEYFRAME)) || !addr || addr > 0xffffffff)
+        return 0;
+
+    struct trace_entry *e = findEntry(r, (uint32_t) addr, fields & TRACE_KEYFRAME);
+    if (!e)
+        return 0;      // no keyframe for this aircraft
+
+    struct trace_state *st = &e->state;
+    if (fields & TRACE_KEYFRAME) {
+        memset(st, 0, sizeof(*st));
+        st->segment = st->time = r->base;
+    }
+    st->time += dt;
+
+    if ((fields & TRACE_POSITION) && (!getDelta(r, &st->lat) || !getDelta(r, &st->lon)))
+        return 0;
+    if ((fields & TRACE_ALT_BARO) && !getDelta(r, &st->alt_baro))
+        return 0;
+    if ((fields & TRACE_ALT_GEOM) && !getDelta(r, &st->alt_geom))
+        return 0;
+    if ((fields & TRACE_GS) && !getDelta(r, &st->gs))
+        return 0;
+    if ((fields & TRACE_TRACK) && !getDelta(r, &st->track))
+        return 0;
+    if ((fields & TRACE_BARO_RATE) && !getDelta(r, &st->baro_rate))
+        return 0;
+    if (fields & TRACE_SQUAWK) {
+        if (!getVarint(r, &squawk) || squawk > 0xffff)
+            return 0;
+        st->squawk = (uint32_t) squawk;
+    }
+    if (fields & TRACE_CALLSIGN) {
+        if (r->end - r->p < 8)
+            return 0;
+        memcpy(st->callsign, r->p, 8);
+        st->callsign[8] = 0;
+        r->p += 8;
+    }
+
+    p->time = st->time;
+    p->addr = (uint32_t) addr;
+    p->fields = (unsigned) fields;
+    p->lat = st->lat / 1e5;
+    p->lon = st->lon / 1e5;
+    p->alt_baro = st->alt_baro;
+    p->alt_geom = st->alt_geom;
+    p->gs = st->gs / 10.0;
+    p->track = st->track / 10.0;
+    p->baro_rate = st->baro_rate;
+    p->squawk = st->squawk;
+    memcpy(p->callsign, st->callsign, sizeof(p->callsign));
+    return 1;
+}
+
+int traceReaderNext(struct trace_reader *r, struct trace_point *p)
+{
+    while (r->p < r->end) {
+        const uint8_t *start = r->p;
+
+        if (isSegmentHeader(r->p, r->end)) {
+            readSegmentHeader(r);
+            continue;
+        }
+        if (r->base && readRecord(r, p))
+            return 1;
+
+        // Records are deltas against earlier ones, so nothing can be
+        // trusted again before the next segment header
+        ++r->damaged;
+        for (r->p = start + 1; r->p < r->end && !isSegmentHeader(r->p, r->end); ++r->p)
+            ;
+    }
+
+    return 0;
+}
+
+unsigned traceReaderDamaged(const struct trace_reader *r)
+{
+    return r->damaged;
+}
@@ -0,0 +1,102 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// trace.h: append-only binary aircraft trace archive (--write-trace)
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DUMP1090_TRACE_H
+#define DUMP1090_TRACE_H
+
+// One file per UTC day, <dir>/trace-YYYYMMDD.bin, only ever appended to.
+// A file is a series of segments; each time the file is opened a new
+// segment starts:
+//
+//   segment:  u8 0, "D1090TRC", u8 version, u64 base time (ms, little-endian)
+//   record:   varint fields   TRACE_* bits, never 0
+//             varint addr
+//             varint dt       ms since this aircraft's previous record in the
+//                             segment, or since the base time for a keyframe
+//             then, for each bit set in fields, in bit order:
+//               position      zigzag varint lat, lon (1e-5 degrees)
+//               alt_baro      zigzag varint (ft)
+//               alt_geom      zigzag varint (ft)
+//               gs            zigzag varint (0.1 kt)
+//               track         zigzag varint (0.1 degrees)
+//               baro_rate     zigzag varint (ft/min)
+//               squawk        varint (the hex digits as a 16-bit value)
+//               callsign      8 bytes
+//
+// Numeric fields are deltas from the value in the aircraft's previous
+// record in the segment (from 0 in a keyframe, the first record for an
+// aircraft in the segment). A record only carries fields that changed.
+
+#define TRACE_MAGIC "D1090TRC"
+#define TRACE_VERSION 1
+#define TRACE_SEGMENT_SIZE 18
+
+#define TRACE_KEYFRAME   (1 << 0)
+#define TRACE_POSITION   (1 << 1)
+#define TRACE_ALT_BARO   (1 << 2)
+#define TRACE_ALT_GEOM   (1 << 3)
+#define TRACE_GS         (1 << 4)
+#define TRACE_TRACK      (1 << 5)
+#define TRACE_BARO_RATE  (1 << 6)
+#define TRACE_SQUAWK     (1 << 7)
+#define TRACE_CALLSIGN   (1 << 8)
+#define TRACE_ALL_FIELDS 0x1fe
+
+// Last values written for one aircraft, in trace units
+struct trace_state {
+    uint64_t segment;           // base time of the segment they were written to; 0 = none
+    uint64_t time;
+    int32_t  lat, lon;
+    int32_t  alt_baro, alt_geom;
+    int32_t  gs, track;
+    int32_t  baro_rate;
+    uint32_t squawk;
+    char     callsign[9];
+};
+
+// One decoded record, with the aircraft's values as of that record;
+// 'fields' says which of them the record itself carried
+struct trace_point {
+    uint64_t time;
+    uint32_t addr;
+    unsigned fields;
+    double   lat, lon;
+    int      alt_baro, alt_geom;
+    double   gs, track;
+    int      baro_rate;
+    unsigned squawk;
+    char     callsign[9];
+};
+
+struct aircraft;
+struct trace_reader;
+
+// Writer, for the current instance (Modes.trace_dir)
+void traceUpdate(struct aircraft *a);
+void traceFlush(uint64_t now);
+void traceClose(void);
+
+// Reader over a whole file held in memory
+struct trace_reader *traceReaderNew(const uint8_t *data, size_t len);
+// Returns 1 and fills in 'p', or 0 at the end of the data. Damaged data
+// is skipped up to the next segment header
+int traceReaderNext(struct trace_reader *r, struct trace_point *p);
+// How many times damaged data was skipped so far
+unsigned traceReaderDamaged(const struct trace_reader *r);
+void traceReaderFree(struct trace_reader *r);
+
+#endif
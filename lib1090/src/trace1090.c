@@ -0,0 +1,205 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// trace1090.c: convert --write-trace archives to JSON or CSV
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "dump1090.h"
+
+static void showHelp(void) {
+    printf(
+            "-----------------------------------------------------------------------------\n"
+            "| trace1090 trace archive reader     %40s |\n"
+            "-----------------------------------------------------------------------------\n"
+            "Usage: trace1090 [options] <trace file>...\n"
+            "\n"
+            "--json                   One JSON object per record (default)\n"
+            "--csv                    CSV with a header line\n"
+            "--icao <hex>             Only show this aircraft\n"
+            "--help                   Show this help\n"
+            "\n"
+            "Each record carries only the fields that changed; the others are left out.\n"
+            "\n",
+            MODES_DUMP1090_VARIANT " " MODES_DUMP1090_VERSION
+    );
+}
+
+// Read a whole file; returns NULL (after complaining) if we can't
+static uint8_t *readFile(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    size_t size = 0, alloc = 1 << 20;
+    uint8_t *data = malloc(alloc);
+    for (;;) {
+        if (!data) {
+            fprintf(stderr, "trace1090: out of memory\n");
+            exit(1);
+        }
+        size += fread(data + size, 1, alloc - size, f);
+        if (size < alloc)
+            break;
+        alloc *= 2;
+        data = realloc(data, alloc);
+    }
+
+    if (ferror(f)) {
+        fprintf(stderr, "%s: read error\n", path);
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+
+    *len = size;
+    return data;
+}
+
+static void printJson(const struct trace_point *p)
+{
+    printf("{\"time\":%.3f,\"hex\":\"%s%06x\"", p->time / 1000.0, (p->addr & MODES_NON_ICAO_ADDRESS) ? "~" : "", p->addr & 0xFFFFFF);
+    if (p->fields & TRACE_POSITION)
+        printf(",\"lat\":%.5f,\"lon\":%.5f", p->lat, p->lon);
+    if (p->fields & TRACE_ALT_BARO)
+        printf(",\"alt_baro\":%d", p->alt_baro);
+    if (p->fields & TRACE_ALT_GEOM)
+        printf(",\"alt_geom\":%d", p->alt_geom);
+    if (p->fields & TRACE_GS)
+        printf(",\"gs\":%.1f", p->gs);
+    if (p->fields & TRACE_TRACK)
+        printf(",\"track\":%.1f", p->track);
+    if (p->fields & TRACE_BARO_RATE)
+        printf(",\"baro_rate\":%d", p->baro_rate);
+    if (p->fields & TRACE_SQUAWK)
+        printf(",\"squawk\":\"%04x\"", p->squawk);
+    if (p->fields & TRACE_CALLSIGN) {
+        printf(",\"flight\":\"");
+        for (const char *c = p->callsign; *c; ++c) {
+            if (*c == '"' || *c == '\\' || (unsigned char) *c < 32)
+                printf("\\u%04x", (unsigned char) *c);
+            else
+                putchar(*c);
+        }
+        putchar('"');
+    }
+    printf("}\n");
+}
+
+static void printCsv(const struct trace_point *p)
+{
+    printf("%.3f,%s%06x,", p->time / 1000.0, (p->addr & MODES_NON_ICAO_ADDRESS) ? "~" : "", p->addr & 0xFFFFFF);
+    if (p->fields & TRACE_POSITION)
+        printf("%.5f,%.5f,", p->lat, p->lon);
+    else
+        printf(",,");
+    if (p->fields & TRACE_ALT_BARO)
+        printf("%d", p->alt_baro);
+    putchar(',');
+    if (p->fields & TRACE_ALT_GEOM)
+        printf("%d", p->alt_geom);
+    putchar(',');
+    if (p->fields & TRACE_GS)
+        printf("%.1f", p->gs);
+    putchar(',');
+    if (p->fields & TRACE_TRACK)
+        printf("%.1f", p->track);
+    putchar(',');
+    if (p->fields & TRACE_BARO_RATE)
+        printf("%d", p->baro_rate);
+    putchar(',');
+    if (p->fields & TRACE_SQUAWK)
+        printf("%04x", p->squawk);
+    putchar(',');
+    if (p->fields & TRACE_CALLSIGN) {
+        // callsigns are A-Z, 0-9 and spaces; drop anything else
+        for (const char *c = p->callsign; *c; ++c) {
+            if (*c != ',' && *c != '"' && (unsigned char) *c >= 32)
+                putchar(*c);
+        }
+    }
+    putchar('\n');
+}
+
+int trace1090main(int argc, char **argv) {
+    int csv = 0;
+    int have_icao = 0;
+    uint32_t icao = 0;
+    int first_file = argc;
+    int failed = 0;
+
+    for (int j = 1; j < argc; j++) {
+        int more = j+1 < argc; // There are more arguments
+
+        if (!strcmp(argv[j],"--json")) {
+            csv = 0;
+        } else if (!strcmp(argv[j],"--csv")) {
+            csv = 1;
+        } else if (!strcmp(argv[j],"--icao") && more) {
+            have_icao = 1;
+            icao = (uint32_t) strtoul(argv[++j], NULL, 16);
+        } else if (!strcmp(argv[j],"--help")) {
+            showHelp();
+            exit(0);
+        } else if (argv[j][0] == '-' && argv[j][1] == '-') {
+            fprintf(stderr,
+                    "Unknown or not enough arguments for option '%s'.\n\n",
+                    argv[j]);
+            showHelp();
+            exit(1);
+        } else {
+            first_file = j;
+            break;
+        }
+    }
+
+    if (first_file == argc) {
+        showHelp();
+        exit(1);
+    }
+
+    if (csv)
+        printf("time,hex,lat,lon,alt_baro,alt_geom,gs,track,baro_rate,squawk,flight\n");
+
+    for (int j = first_file; j < argc; j++) {
+        size_t len;
+        uint8_t *data = readFile(argv[j], &len);
+        if (!data) {
+            failed = 1;
+            continue;
+        }
+
+        struct trace_reader *r = traceReaderNew(data, len);
+        struct trace_point p;
+        while (traceReaderNext(r, &p)) {
+            if (have_icao && (p.addr & 0xFFFFFF) != icao)
+                continue;
+            if (csv)
+                printCsv(&p);
+            else
+                printJson(&p);
+        }
+        if (traceReaderDamaged(r)) {
+            fprintf(stderr, "%s: damaged trace data, skipped %u stretch(es)\n", argv[j], traceReaderDamaged(r));
+            failed = 1;
+        }
+
+        traceReaderFree(r);
+        free(data);
+    }
+
+    return failed ? 1 : 0;
+}
@@ -52,11 +52,6 @@
 
 /* #define DEBUG_CPR_CHECKS */
 
-uint32_t modeAC_count[4096];
-uint32_t modeAC_lastcount[4096];
-uint32_t modeAC_match[4096];
-uint32_t modeAC_age[4096];
-
 //
 // Return a new aircraft structure for the linked list of tracked
 // aircraft
@@ -152,9 +147,34 @@ struct aircraft *trackFindAircraft(uint32_t addr) {
     return (NULL);
 }
 
+// Put an aircraft on the FATSV dirty list, so writeFATSV() looks at it
+static void trackMarkDirty(struct aircraft *a)
+{
+    if (a->fatsv_dirty_pprev)
+        return;
+
+    a->fatsv_dirty_next = Modes.fatsv_dirty;
+    if (Modes.fatsv_dirty)
+        Modes.fatsv_dirty->fatsv_dirty_pprev = &a->fatsv_dirty_next;
+    a->fatsv_dirty_pprev = &Modes.fatsv_dirty;
+    Modes.fatsv_dirty = a;
+}
+
+void trackClearDirty(struct aircraft *a)
+{
+    if (!a->fatsv_dirty_pprev)
+        return;
+
+    *a->fatsv_dirty_pprev = a->fatsv_dirty_next;
+    if (a->fatsv_dirty_next)
+        a->fatsv_dirty_next->fatsv_dirty_pprev = a->fatsv_dirty_pprev;
+    a->fatsv_dirty_next = NULL;
+    a->fatsv_dirty_pprev = NULL;
+}
+
 // Should we accept some new data from the given source?
-// If so, update the validity and return 1
-static int accept_data(data_validity *d, datasource_t source)
+// If so, update the validity, record the change for FATSV and return 1
+static int accept_data(struct aircraft *a, data_validity *d, uint64_t changed, datasource_t source)
 {
     if (messageNow() < d->updated)
         return 0;
@@ -166,6 +186,7 @@ static int accept_data(data_validity *d, datasource_t source)
     d->updated = messageNow();
     d->stale = messageNow() + (d->stale_interval ? d->stale_interval : 60000);
     d->expires = messageNow() + (d->expire_interval ? d->expire_interval : 70000);
+    a->fatsv_changed |= changed;
     return 1;
 }
 
@@ -540,7 +561,7 @@ static void updatePosition(struct aircraft *a, struct modesMessage *mm)
             // Nonfatal, try again later.
             Modes.stats_current.cpr_global_skipped++;
         } else {
-            if (accept_data(&a->position_valid, mm->source)) {
+            if (accept_data(a, &a->position_valid, CHANGED_POSITION, mm->source)) {
                 Modes.stats_current.cpr_global_ok++;
             } else {
                 Modes.stats_current.cpr_global_skipped++;
@@ -553,7 +574,7 @@ static void updatePosition(struct aircraft *a, struct modesMessage *mm)
     if (location_result == -1) {
         location_result = doLocalCPR(a, mm, &new_lat, &new_lon, &new_nic, &new_rc);
 
-        if (location_result == 0 && accept_data(&a->position_valid, mm->source)) {
+        if (location_result == 0 && accept_data(a, &a->position_valid, CHANGED_POSITION, mm->source)) {
             Modes.stats_current.cpr_local_ok++;
             mm->cpr_relative = 1;
         } else {
@@ -866,7 +887,7 @@ static int compute_v0_sil(struct modesMessage *mm)
 static void compute_nic_rc_from_message(struct modesMessage *mm, struct aircraft *a, unsigned *nic, unsigned *rc)
 {
     int nic_a = (trackDataValid(&a->nic_a_valid) && a->nic_a);
-    int nic_b = (mm->accuracy.nic_b_valid && mm->accuracy.nic_b);
+    int nic_b = ((mm->sections & MODES_SECTION_ACCURACY) && mm->accuracy.nic_b_valid && mm->accuracy.nic_b);
     int nic_c = (trackDataValid(&a->nic_c_valid) && a->nic_c);
 
     *nic = compute_nic(mm->metype, a->adsb_version, nic_a, nic_b, nic_c);
@@ -899,7 +920,7 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm)
 
     if (mm->msgtype == 32) {
         // Mode A/C, just count it (we ignore SPI)
-        modeAC_count[modeAToIndex(mm->squawk)]++;
+        Modes.modeAC_count[modeAToIndex(mm->squawk)]++;
         return NULL;
     }
 
@@ -908,7 +929,7 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm)
         return NULL;
     }
 
-    _messageNow = mm->sysTimestampMsg;
+    Modes.message_now = mm->sysTimestampMsg;
 
     // Lookup our aircraft or create a new one
     a = trackFindAircraft(mm->addr);
@@ -924,6 +945,7 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm)
     }
     a->seen      = messageNow();
     a->messages++;
+    trackMarkDirty(a);
 
     // count reliable messages we receive; use them as a metric to
     // decide when this is a real aircraft, not noise
@@ -979,7 +1001,7 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm)
 
     // operational status message
     // done early to update version / HRD / TAH
-    if (mm->opstatus.valid) {
+    if ((mm->sections & MODES_SECTION_OPSTATUS) && mm->opstatus.valid) {
         *message_version = mm->opstatus.version;
 
         if (mm->opstatus.hrd != HEADING_INVALID) {
@@ -991,23 +1013,25 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm)
     }
 
     // fill in ADS-B v0 NACp, SIL from position message type
-    if (*message_version == 0 && !mm->accuracy.nac_p_valid) {
+    if (*message_version == 0) {
         int computed_nacp = compute_v0_nacp(mm);
-        if (computed_nacp != -1) {
+        int computed_sil = compute_v0_sil(mm);
+
+        if (computed_nacp != -1 || computed_sil != -1)
+            modesUseSections(mm, MODES_SECTION_ACCURACY);
+
+        if (computed_nacp != -1 && !mm->accuracy.nac_p_valid) {
             mm->accuracy.nac_p_valid = 1;
             mm->accuracy.nac_p = computed_nacp;
         }
-    }
 
-    if (*message_version == 0 && mm->accuracy.sil_type == SIL_INVALID) {
-        int computed_sil = compute_v0_sil(mm);
-        if (computed_sil != -1) {
+        if (computed_sil != -1 && mm->accuracy.sil_type == SIL_INVALID) {
             mm->accuracy.sil_type = SIL_UNKNOWN;
             mm->accuracy.sil = computed_sil;
         }
     }
 
-    if (mm->altitude_baro_valid && accept_data(&a->altitude_baro_valid, mm->source)) {
+    if (mm->altitude_baro_valid && accept_data(a, &a->altitude_baro_valid, CHANGED_ALTITUDE_BARO, mm->source)) {
         int alt = altitude_to_feet(mm->altitude_baro, mm->altitude_baro_unit);
         if (a->modeC_hit) {
             int new_modeC = (a->altitude_baro + 49) / 100;
@@ -1020,7 +1044,7 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm)
         a->altitude_baro = alt;
     }
 
-    if (mm->squawk_valid && accept_data(&a->squawk_valid, mm->source)) {
+    if (mm->squawk_valid && accept_data(a, &a->squawk_valid, CHANGED_SQUAWK, mm->source)) {
         if (mm->squawk != a->squawk) {
             a->modeA_hit = 0;
         }
@@ -1045,22 +1069,22 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm)
                 break;
             }
 
-            if (squawk_emergency != EMERGENCY_NONE && accept_data(&a->emergency_valid, mm->source)) {
+            if (squawk_emergency != EMERGENCY_NONE && accept_data(a, &a->emergency_valid, CHANGED_EMERGENCY, mm->source)) {
                 a->emergency = squawk_emergency;
             }
         }
 #endif
     }
 
-    if (mm->emergency_valid && accept_data(&a->emergency_valid, mm->source)) {
+    if (mm->emergency_valid && accept_data(a, &a->emergency_valid, CHANGED_EMERGENCY, mm->source)) {
         a->emergency = mm->emergency;
     }
 
-    if (mm->altitude_geom_valid && accept_data(&a->altitude_geom_valid, mm->source)) {
+    if (mm->altitude_geom_valid && accept_data(a, &a->altitude_geom_valid, CHANGED_ALTITUDE_GEOM, mm->source)) {
         a->altitude_geom = altitude_to_feet(mm->altitude_geom, mm->altitude_geom_unit);
     }
 
-    if (mm->geom_delta_valid && accept_data(&a->geom_delta_valid, mm->source)) {
+    if (mm->geom_delta_valid && accept_data(a, &a->geom_delta_valid, CHANGED_GEOM_DELTA, mm->source)) {
         a->geom_delta = mm->geom_delta;
     }
 
@@ -1072,47 +1096,47 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm)
             htype = a->adsb_tah;
         }
 
-        if (htype == HEADING_GROUND_TRACK && accept_data(&a->track_valid, mm->source)) {
+        if (htype == HEADING_GROUND_TRACK && accept_data(a, &a->track_valid, CHANGED_TRACK, mm->source)) {
             a->track = mm->heading;
-        } else if (htype == HEADING_MAGNETIC && accept_data(&a->mag_heading_valid, mm->source)) {
+        } else if (htype == HEADING_MAGNETIC && accept_data(a, &a->mag_heading_valid, CHANGED_MAG_HEADING, mm->source)) {
             a->mag_heading = mm->heading;
-        } else if (htype == HEADING_TRUE && accept_data(&a->true_heading_valid, mm->source)) {
+        } else if (htype == HEADING_TRUE && accept_data(a, &a->true_heading_valid, CHANGED_TRUE_HEADING, mm->source)) {
             a->true_heading = mm->heading;
         }
     }
 
-    if (mm->track_rate_valid && accept_data(&a->track_rate_valid, mm->source)) {
+    if (mm->track_rate_valid && accept_data(a, &a->track_rate_valid, CHANGED_TRACK_RATE, mm->source)) {
         a->track_rate = mm->track_rate;
     }
 
-    if (mm->roll_valid && accept_data(&a->roll_valid, mm->source)) {
+    if (mm->roll_valid && accept_data(a, &a->roll_valid, CHANGED_ROLL, mm->source)) {
         a->roll = mm->roll;
     }
 
     if (mm->gs_valid) {
         mm->gs.selected = (*message_version == 2 ? mm->gs.v2 : mm->gs.v0);
-        if (accept_data(&a->gs_valid, mm->source)) {
+        if (accept_data(a, &a->gs_valid, CHANGED_GS, mm->source)) {
             a->gs = mm->gs.selected;
         }
     }
 
-    if (mm->ias_valid && accept_data(&a->ias_valid, mm->source)) {
+    if (mm->ias_valid && accept_data(a, &a->ias_valid, CHANGED_IAS, mm->source)) {
         a->ias = mm->ias;
     }
 
-    if (mm->tas_valid && accept_data(&a->tas_valid, mm->source)) {
+    if (mm->tas_valid && accept_data(a, &a->tas_valid, CHANGED_TAS, mm->source)) {
         a->tas = mm->tas;
     }
 
-    if (mm->mach_valid && accept_data(&a->mach_valid, mm->source)) {
+    if (mm->mach_valid && accept_data(a, &a->mach_valid, CHANGED_MACH, mm->source)) {
         a->mach = mm->mach;
     }
 
-    if (mm->baro_rate_valid && accept_data(&a->baro_rate_valid, mm->source)) {
+    if (mm->baro_rate_valid && accept_data(a, &a->baro_rate_valid, CHANGED_BARO_RATE, mm->source)) {
         a->baro_rate = mm->baro_rate;
     }
 
-    if (mm->geom_rate_valid && accept_data(&a->geom_rate_valid, mm->source)) {
+    if (mm->geom_rate_valid && accept_data(a, &a->geom_rate_valid, CHANGED_GEOM_RATE, mm->source)) {
         a->geom_rate = mm->geom_rate;
     }
 
@@ -1121,42 +1145,44 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm)
         // If our current state is certain but new data is not, only accept the uncertain state if the certain data has gone stale
         if (mm->airground != AG_UNCERTAIN ||
             (mm->airground == AG_UNCERTAIN && !trackDataFresh(&a->airground_valid))) {
-            if (accept_data(&a->airground_valid, mm->source)) {
+            if (accept_data(a, &a->airground_valid, CHANGED_AIRGROUND, mm->source)) {
                 a->airground = mm->airground;
             }
         }
     }
 
-    if (mm->callsign_valid && accept_data(&a->callsign_valid, mm->source)) {
+    if (mm->callsign_valid && accept_data(a, &a->callsign_valid, CHANGED_CALLSIGN, mm->source)) {
         memcpy(a->callsign, mm->callsign, sizeof(a->callsign));
     }
 
-    if (mm->nav.mcp_altitude_valid && accept_data(&a->nav_altitude_mcp_valid, mm->source)) {
-        a->nav_altitude_mcp = mm->nav.mcp_altitude;
-    }
+    if (mm->sections & MODES_SECTION_NAV) {
+        if (mm->nav.mcp_altitude_valid && accept_data(a, &a->nav_altitude_mcp_valid, CHANGED_NAV_ALTITUDE_MCP, mm->source)) {
+            a->nav_altitude_mcp = mm->nav.mcp_altitude;
+        }
 
-    if (mm->nav.fms_altitude_valid && accept_data(&a->nav_altitude_fms_valid, mm->source)) {
-        a->nav_altitude_fms = mm->nav.fms_altitude;
-    }
+        if (mm->nav.fms_altitude_valid && accept_data(a, &a->nav_altitude_fms_valid, CHANGED_NAV_ALTITUDE_FMS, mm->source)) {
+            a->nav_altitude_fms = mm->nav.fms_altitude;
+        }
 
-    if (mm->nav.altitude_source != NAV_ALT_INVALID && accept_data(&a->nav_altitude_src_valid, mm->source)) {
-        a->nav_altitude_src = mm->nav.altitude_source;
-    }
+        if (mm->nav.altitude_source != NAV_ALT_INVALID && accept_data(a, &a->nav_altitude_src_valid, CHANGED_NAV_ALTITUDE_SRC, mm->source)) {
+            a->nav_altitude_src = mm->nav.altitude_source;
+        }
 
-    if (mm->nav.heading_valid && accept_data(&a->nav_heading_valid, mm->source)) {
-        a->nav_heading = mm->nav.heading;
-    }
+        if (mm->nav.heading_valid && accept_data(a, &a->nav_heading_valid, CHANGED_NAV_HEADING, mm->source)) {
+            a->nav_heading = mm->nav.heading;
+        }
 
-    if (mm->nav.modes_valid && accept_data(&a->nav_modes_valid, mm->source)) {
-        a->nav_modes = mm->nav.modes;
-    }
+        if (mm->nav.modes_valid && accept_data(a, &a->nav_modes_valid, CHANGED_NAV_MODES, mm->source)) {
+            a->nav_modes = mm->nav.modes;
+        }
 
-    if (mm->nav.qnh_valid && accept_data(&a->nav_qnh_valid, mm->source)) {
-        a->nav_qnh = mm->nav.qnh;
+        if (mm->nav.qnh_valid && accept_data(a, &a->nav_qnh_valid, CHANGED_NAV_QNH, mm->source)) {
+            a->nav_qnh = mm->nav.qnh;
+        }
     }
 
     // CPR, even
-    if (mm->cpr_valid && !mm->cpr_odd && accept_data(&a->cpr_even_valid, mm->source)) {
+    if (mm->cpr_valid && !mm->cpr_odd && accept_data(a, &a->cpr_even_valid, CHANGED_CPR_EVEN, mm->source)) {
         a->cpr_even_type = mm->cpr_type;
         a->cpr_even_lat = mm->cpr_lat;
         a->cpr_even_lon = mm->cpr_lon;
@@ -1165,7 +1191,7 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm)
     }
 
     // CPR, odd
-    if (mm->cpr_valid && mm->cpr_odd && accept_data(&a->cpr_odd_valid, mm->source)) {
+    if (mm->cpr_valid && mm->cpr_odd && accept_data(a, &a->cpr_odd_valid, CHANGED_CPR_ODD, mm->source)) {
         a->cpr_odd_type = mm->cpr_type;
         a->cpr_odd_lat = mm->cpr_lat;
         a->cpr_odd_lon = mm->cpr_lon;
@@ -1173,43 +1199,45 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm)
         cpr_new = 1;
     }
 
-    if (mm->accuracy.sda_valid && accept_data(&a->sda_valid, mm->source)) {
-        a->sda = mm->accuracy.sda;
-    }
+    if (mm->sections & MODES_SECTION_ACCURACY) {
+        if (mm->accuracy.sda_valid && accept_data(a, &a->sda_valid, CHANGED_SDA, mm->source)) {
+            a->sda = mm->accuracy.sda;
+        }
 
-    if (mm->accuracy.nic_a_valid && accept_data(&a->nic_a_valid, mm->source)) {
-        a->nic_a = mm->accuracy.nic_a;
-    }
+        if (mm->accuracy.nic_a_valid && accept_data(a, &a->nic_a_valid, CHANGED_NIC_A, mm->source)) {
+            a->nic_a = mm->accuracy.nic_a;
+        }
 
-    if (mm->accuracy.nic_c_valid && accept_data(&a->nic_c_valid, mm->source)) {
-        a->nic_c = mm->accuracy.nic_c;
-    }
+        if (mm->accuracy.nic_c_valid && accept_data(a, &a->nic_c_valid, CHANGED_NIC_C, mm->source)) {
+            a->nic_c = mm->accuracy.nic_c;
+        }
 
-    if (mm->accuracy.nic_baro_valid && accept_data(&a->nic_baro_valid, mm->source)) {
-        a->nic_baro = mm->accuracy.nic_baro;
-    }
+        if (mm->accuracy.nic_baro_valid && accept_data(a, &a->nic_baro_valid, CHANGED_NIC_BARO, mm->source)) {
+            a->nic_baro = mm->accuracy.nic_baro;
+        }
 
-    if (mm->accuracy.nac_p_valid && accept_data(&a->nac_p_valid, mm->source)) {
-        a->nac_p = mm->accuracy.nac_p;
-    }
+        if (mm->accuracy.nac_p_valid && accept_data(a, &a->nac_p_valid, CHANGED_NAC_P, mm->source)) {
+            a->nac_p = mm->accuracy.nac_p;
+        }
 
-    if (mm->accuracy.nac_v_valid && accept_data(&a->nac_v_valid, mm->source)) {
-        a->nac_v = mm->accuracy.nac_v;
-    }
+        if (mm->accuracy.nac_v_valid && accept_data(a, &a->nac_v_valid, CHANGED_NAC_V, mm->source)) {
+            a->nac_v = mm->accuracy.nac_v;
+        }
 
-    if (mm->accuracy.sil_type != SIL_INVALID && accept_data(&a->sil_valid, mm->source)) {
-        a->sil = mm->accuracy.sil;
-        if (a->sil_type == SIL_INVALID || mm->accuracy.sil_type != SIL_UNKNOWN) {
-            a->sil_type = mm->accuracy.sil_type;
+        if (mm->accuracy.sil_type != SIL_INVALID && accept_data(a, &a->sil_valid, CHANGED_SIL, mm->source)) {
+            a->sil = mm->accuracy.sil;
+            if (a->sil_type == SIL_INVALID || mm->accuracy.sil_type != SIL_UNKNOWN) {
+                a->sil_type = mm->accuracy.sil_type;
+            }
         }
-    }
 
-    if (mm->accuracy.gva_valid && accept_data(&a->gva_valid, mm->source)) {
-        a->gva = mm->accuracy.gva;
-    }
+        if (mm->accuracy.gva_valid && accept_data(a, &a->gva_valid, CHANGED_GVA, mm->source)) {
+            a->gva = mm->accuracy.gva;
+        }
 
-    if (mm->accuracy.sda_valid && accept_data(&a->sda_valid, mm->source)) {
-        a->sda = mm->accuracy.sda;
+        if (mm->accuracy.sda_valid && accept_data(a, &a->sda_valid, CHANGED_SDA, mm->source)) {
+            a->sda = mm->accuracy.sda;
+        }
     }
 
     // Now handle derived data
@@ -1220,6 +1248,7 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm)
         // Baro and delta are both more recent than geometric, derive geometric from baro + delta
         a->altitude_geom = a->altitude_baro + a->geom_delta;
         combine_validity(&a->altitude_geom_valid, &a->altitude_baro_valid, &a->geom_delta_valid);
+        a->fatsv_changed |= CHANGED_ALTITUDE_GEOM;
     }
 
     // If we've got a new cpr_odd or cpr_even
@@ -1227,6 +1256,10 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm)
         updatePosition(a, mm);
     }
 
+    if (Modes.trace_dir && a->reliable) {
+        traceUpdate(a);
+    }
+
     return (a);
 }
 
@@ -1239,7 +1272,7 @@ static void trackMatchAC(uint64_t now)
 {
     // clear match flags
     for (unsigned i = 0; i < 4096; ++i) {
-        modeAC_match[i] = 0;
+        Modes.modeAC_match[i] = 0;
     }
 
     // scan aircraft list, look for matches
@@ -1251,9 +1284,9 @@ static void trackMatchAC(uint64_t now)
         // match on Mode A
         if (trackDataValid(&a->squawk_valid)) {
             unsigned i = modeAToIndex(a->squawk);
-            if ((modeAC_count[i] - modeAC_lastcount[i]) >= TRACK_MODEAC_MIN_MESSAGES) {
+            if ((Modes.modeAC_count[i] - Modes.modeAC_lastcount[i]) >= TRACK_MODEAC_MIN_MESSAGES) {
                 a->modeA_hit = 1;
-                modeAC_match[i] = (modeAC_match[i] ? 0xFFFFFFFF : a->addr);
+                Modes.modeAC_match[i] = (Modes.modeAC_match[i] ? 0xFFFFFFFF : a->addr);
             }
         }
 
@@ -1263,50 +1296,50 @@ static void trackMatchAC(uint64_t now)
 
             unsigned modeA = modeCToModeA(modeC);
             unsigned i = modeAToIndex(modeA);
-            if (modeA && (modeAC_count[i] - modeAC_lastcount[i]) >= TRACK_MODEAC_MIN_MESSAGES) {
+            if (modeA && (Modes.modeAC_count[i] - Modes.modeAC_lastcount[i]) >= TRACK_MODEAC_MIN_MESSAGES) {
                 a->modeC_hit = 1;
-                modeAC_match[i] = (modeAC_match[i] ? 0xFFFFFFFF : a->addr);
+                Modes.modeAC_match[i] = (Modes.modeAC_match[i] ? 0xFFFFFFFF : a->addr);
             }
 
             modeA = modeCToModeA(modeC + 1);
             i = modeAToIndex(modeA);
-            if (modeA && (modeAC_count[i] - modeAC_lastcount[i]) >= TRACK_MODEAC_MIN_MESSAGES) {
+            if (modeA && (Modes.modeAC_count[i] - Modes.modeAC_lastcount[i]) >= TRACK_MODEAC_MIN_MESSAGES) {
                 a->modeC_hit = 1;
-                modeAC_match[i] = (modeAC_match[i] ? 0xFFFFFFFF : a->addr);
+                Modes.modeAC_match[i] = (Modes.modeAC_match[i] ? 0xFFFFFFFF : a->addr);
             }
 
             modeA = modeCToModeA(modeC - 1);
             i = modeAToIndex(modeA);
-            if (modeA && (modeAC_count[i] - modeAC_lastcount[i]) >= TRACK_MODEAC_MIN_MESSAGES) {
+            if (modeA && (Modes.modeAC_count[i] - Modes.modeAC_lastcount[i]) >= TRACK_MODEAC_MIN_MESSAGES) {
                 a->modeC_hit = 1;
-                modeAC_match[i] = (modeAC_match[i] ? 0xFFFFFFFF : a->addr);
+                Modes.modeAC_match[i] = (Modes.modeAC_match[i] ? 0xFFFFFFFF : a->addr);
             }
         }
     }
 
     // reset counts for next time
     for (unsigned i = 0; i < 4096; ++i) {
-        if (!modeAC_count[i])
+        if (!Modes.modeAC_count[i])
             continue;
 
-        if ((modeAC_count[i] - modeAC_lastcount[i]) < TRACK_MODEAC_MIN_MESSAGES) {
-            if (++modeAC_age[i] > 15) {
+        if ((Modes.modeAC_count[i] - Modes.modeAC_lastcount[i]) < TRACK_MODEAC_MIN_MESSAGES) {
+            if (++Modes.modeAC_age[i] > 15) {
                 // not heard from for a while, clear it out
-                modeAC_lastcount[i] = modeAC_count[i] = modeAC_age[i] = 0;
+                Modes.modeAC_lastcount[i] = Modes.modeAC_count[i] = Modes.modeAC_age[i] = 0;
             }
         } else {
             // this one is live
             // set a high initial age for matches, so they age out rapidly
             // and don't show up on the interactive display when the matching
             // mode S data goes away or changes
-            if (modeAC_match[i]) {
-                modeAC_age[i] = 10;
+            if (Modes.modeAC_match[i]) {
+                Modes.modeAC_age[i] = 10;
             } else {
-                modeAC_age[i] = 0;
+                Modes.modeAC_age[i] = 0;
             }
         }
 
-        modeAC_lastcount[i] = modeAC_count[i];
+        Modes.modeAC_lastcount[i] = Modes.modeAC_count[i];
     }
 }
 
@@ -1330,6 +1363,8 @@ static void trackRemoveStaleAircraft(uint64_t now)
             if (!a->reliable)
                 Modes.stats_current.unreliable_aircraft++;
 
+            trackClearDirty(a);
+
             // Remove the element from the linked list, with care
             // if we are removing the first element
             if (!prev) {
@@ -1386,12 +1421,11 @@ static void trackRemoveStaleAircraft(uint64_t now)
 
 void trackPeriodicUpdate()
 {
-    static uint64_t next_update;
     uint64_t now = mstime();
 
     // Only do updates once per second
-    if (now >= next_update) {
-        next_update = now + 1000;
+    if (now >= Modes.next_track_update) {
+        Modes.next_track_update = now + 1000;
         trackRemoveStaleAircraft(now);
         trackMatchAC(now);
     }
@@ -90,7 +90,47 @@ typedef struct {
     uint64_t expires;        /* when it expires */
 } data_validity;
 
-/* Structure used to describe the state of one tracked aircraft */
+// Bits of aircraft.fatsv_changed: which data_validity-tracked fields have
+// been written since the aircraft was last emitted as FATSV
+#define CHANGED_CALLSIGN          (UINT64_C(1) << 0)
+#define CHANGED_ALTITUDE_BARO     (UINT64_C(1) << 1)
+#define CHANGED_ALTITUDE_GEOM     (UINT64_C(1) << 2)
+#define CHANGED_GEOM_DELTA        (UINT64_C(1) << 3)
+#define CHANGED_GS                (UINT64_C(1) << 4)
+#define CHANGED_IAS               (UINT64_C(1) << 5)
+#define CHANGED_TAS               (UINT64_C(1) << 6)
+#define CHANGED_MACH              (UINT64_C(1) << 7)
+#define CHANGED_TRACK             (UINT64_C(1) << 8)
+#define CHANGED_TRACK_RATE        (UINT64_C(1) << 9)
+#define CHANGED_ROLL              (UINT64_C(1) << 10)
+#define CHANGED_MAG_HEADING       (UINT64_C(1) << 11)
+#define CHANGED_TRUE_HEADING      (UINT64_C(1) << 12)
+#define CHANGED_BARO_RATE         (UINT64_C(1) << 13)
+#define CHANGED_GEOM_RATE         (UINT64_C(1) << 14)
+#define CHANGED_SQUAWK            (UINT64_C(1) << 15)
+#define CHANGED_EMERGENCY         (UINT64_C(1) << 16)
+#define CHANGED_AIRGROUND         (UINT64_C(1) << 17)
+#define CHANGED_NAV_QNH           (UINT64_C(1) << 18)
+#define CHANGED_NAV_ALTITUDE_MCP  (UINT64_C(1) << 19)
+#define CHANGED_NAV_ALTITUDE_FMS  (UINT64_C(1) << 20)
+#define CHANGED_NAV_ALTITUDE_SRC  (UINT64_C(1) << 21)
+#define CHANGED_NAV_HEADING       (UINT64_C(1) << 22)
+#define CHANGED_NAV_MODES         (UINT64_C(1) << 23)
+#define CHANGED_CPR_ODD           (UINT64_C(1) << 24)
+#define CHANGED_CPR_EVEN          (UINT64_C(1) << 25)
+#define CHANGED_POSITION          (UINT64_C(1) << 26)
+#define CHANGED_NIC_A             (UINT64_C(1) << 27)
+#define CHANGED_NIC_C             (UINT64_C(1) << 28)
+#define CHANGED_NIC_BARO          (UINT64_C(1) << 29)
+#define CHANGED_NAC_P             (UINT64_C(1) << 30)
+#define CHANGED_NAC_V             (UINT64_C(1) << 31)
+#define CHANGED_SIL               (UINT64_C(1) << 32)
+#define CHANGED_GVA               (UINT64_C(1) << 33)
+#define CHANGED_SDA               (UINT64_C(1) << 34)
+
+/* Structure used to describe the state of one tracked aircraft.
+ * It is saved raw in state snapshots (state.c): list any new member in
+ * STATE_AIRCRAFT_FIELDS there, and keep the size a multiple of 8 bytes. */
 struct aircraft {
     uint32_t      addr;           // ICAO address
     addrtype_t    addrtype;       // highest priority address type seen for this aircraft
@@ -266,17 +306,20 @@ struct aircraft {
 
     uint64_t      fatsv_last_emitted;             // time (millis) aircraft was last FA emitted
     uint64_t      fatsv_last_force_emit;          // time (millis) we last emitted only-on-change data
+    uint64_t      fatsv_changed;                  // CHANGED_* fields written since the last FA emission
+    struct aircraft *fatsv_dirty_next;            // next aircraft on Modes.fatsv_dirty
+    struct aircraft **fatsv_dirty_pprev;          // link that points at us on Modes.fatsv_dirty; NULL if not queued
+
+    struct trace_state trace;     // values last written to the trace archive (--write-trace)
 
     struct aircraft *next;        // Next aircraft in our linked list
 };
 
 /* Mode A/C tracking is done separately, not via the aircraft list,
- * and via a flat array rather than a list since there are only 4k possible values
+ * and via flat arrays in Modes (modeAC_count, modeAC_match, modeAC_age)
+ * rather than a list since there are only 4k possible values
  * (nb: we ignore the ident/SPI bit when tracking)
  */
-extern uint32_t modeAC_count[4096];
-extern uint32_t modeAC_match[4096];
-extern uint32_t modeAC_age[4096];
 
 /* is this bit of data valid? */
 static inline int trackDataValid(const data_validity *v)
@@ -306,6 +349,12 @@ static inline uint64_t trackDataAge(const data_validity *v)
 struct modesMessage;
 struct aircraft *trackUpdateFromMessage(struct modesMessage *mm);
 
+/* Return the aircraft with this address, or NULL */
+struct aircraft *trackFindAircraft(uint32_t addr);
+
+/* Take an aircraft off the FATSV dirty list, if it is on it */
+void trackClearDirty(struct aircraft *a);
+
 /* Call periodically */
 void trackPeriodicUpdate();
 
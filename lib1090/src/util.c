@@ -52,8 +52,6 @@
 #include <stdlib.h>
 #include <sys/time.h>
 
-uint64_t _messageNow = 0;
-
 uint64_t mstime(void)
 {
     struct timeval tv;
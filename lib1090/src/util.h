@@ -25,12 +25,6 @@
 /* Returns system time in milliseconds */
 uint64_t mstime(void);
 
-/* Returns the time for the current message we're dealing with */
-extern uint64_t _messageNow;
-static inline uint64_t messageNow() {
-    return _messageNow;
-}
-
 /* Returns the time elapsed, in nanoseconds, from t1 to t2,
  * where t1 and t2 are 12MHz counters.
  */
@@ -116,6 +116,7 @@ static void showHelp(void) {
   "--modeac                 Enable decoding of SSR modes 3/A & 3/C\n"
   "--net-bo-ipaddr <IPv4>   TCP Beast output listen IPv4 (default: 127.0.0.1)\n"
   "--net-bo-port <port>     TCP Beast output listen port (default: 30005)\n"
+  "--net-bo-compress        Ask for the Beast data to be compressed\n"
   "--lat <latitude>         Reference/receiver latitide for surface posn (opt)\n"
   "--lon <longitude>        Reference/receiver longitude for surface posn (opt)\n"
   "--max-range <distance>   Absolute maximum range for position decoding (in nm, default: 300)\n"
@@ -139,6 +140,7 @@ int view1090main(int argc, char **argv) {
     struct net_service *s;
     char *bo_connect_ipaddr = "127.0.0.1";
     int bo_connect_port = 30005;
+    int bo_compress = 0;
 
     // Set sane defaults
 
@@ -153,6 +155,8 @@ int view1090main(int argc, char **argv) {
             bo_connect_port = atoi(argv[++j]);
         } else if (!strcmp(argv[j],"--net-bo-ipaddr") && more) {
             bo_connect_ipaddr = argv[++j];
+        } else if (!strcmp(argv[j],"--net-bo-compress")) {
+            bo_compress = 1;
         } else if (!strcmp(argv[j],"--modeac")) {
             Modes.mode_ac = 1;
         } else if (!strcmp(argv[j],"--no-interactive")) {
@@ -209,6 +213,8 @@ int view1090main(int argc, char **argv) {
     sendBeastSettings(c, "Cd"); // Beast binary format, no filters
     sendBeastSettings(c, Modes.mode_ac ? "J" : "j");  // Mode A/C on or off
     sendBeastSettings(c, Modes.check_crc ? "f" : "F");  // CRC checks on or off
+    if (bo_compress)
+        requestBeastCompression(c);
 
     // Keep going till the user does something that stops us
     while (!Modes.exit) {
@@ -223,6 +229,8 @@ int view1090main(int argc, char **argv) {
             // lost input connection, try to reconnect
             usleep(1000000);
             c = serviceConnect(s, bo_connect_ipaddr, bo_connect_port);
+            if (c && bo_compress)
+                requestBeastCompression(c);
             continue;
         }
 
@@ -0,0 +1,301 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// avrtests.c - tests for the AVR / raw hex line parser
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+// Checks avrDecodeLine against fixed lines, and against the parser it
+// replaced for a large number of randomly damaged lines. With --bench,
+// instead reports how many lines/s each of them parses from a receive
+// buffer of typical input.
+//
+// usage: avrtests [--bench] [count]
+
+#include "testutil.h"
+
+static int hexDigitVal(int c) {
+    c = tolower(c);
+    if (c >= '0' && c <= '9') return c-'0';
+    else if (c >= 'a' && c <= 'f') return c-'a'+10;
+    else return -1;
+}
+
+//
+// The parser avrDecodeLine replaced, as it was in decodeHexMessage, except
+// that a '<' line with a bad signal level digit is rejected rather than
+// given a nonsense level.
+//
+static int refDecodeLine(char *hex, struct avr_frame *frame)
+{
+    int l = strlen(hex), j;
+
+    frame->signalLevel = 0;
+
+    while(l && isspace(hex[l-1])) {
+        hex[l-1] = '\0'; l--;
+    }
+    while(isspace(*hex)) {
+        hex++; l--;
+    }
+
+    if (l < 1 || hex[l-1] != ';') {return (0);}
+
+    switch(hex[0]) {
+        case '<': {
+            if (l < 16 || hexDigitVal(hex[13]) < 0 || hexDigitVal(hex[14]) < 0) return 0;
+            frame->signalLevel = ((hexDigitVal(hex[13])<<4) | hexDigitVal(hex[14])) / 255.0;
+            frame->signalLevel = frame->signalLevel * frame->signalLevel;
+            hex += 15; l -= 16;
+            break;}
+
+        case '@':
+        case '%': {
+            hex += 13; l -= 14;
+            break;}
+
+        case '*':
+        case ':': {
+            hex++; l-=2;
+            break;}
+
+        default: {
+            return (0);
+            break;}
+    }
+
+    if ( (l != (MODEAC_MSG_BYTES      * 2))
+         && (l != (MODES_SHORT_MSG_BYTES * 2))
+         && (l != (MODES_LONG_MSG_BYTES  * 2)) )
+    {return (0);}
+
+    for (j = 0; j < l; j += 2) {
+        int high = hexDigitVal(hex[j]);
+        int low  = hexDigitVal(hex[j+1]);
+
+        if (high == -1 || low == -1) return 0;
+        frame->msg[j/2] = (high << 4) | low;
+    }
+
+    frame->len = l / 2;
+    return 1;
+}
+
+static int failures;
+
+static void compare(const char *line)
+{
+    char copy[256];
+    struct avr_frame got, expected;
+
+    snprintf(copy, sizeof(copy), "%s", line);
+    int r1 = avrDecodeLine(line, line + strlen(line), &got);
+    int r2 = refDecodeLine(copy, &expected);
+
+    if (r1 != r2 ||
+        (r1 && (got.len != expected.len ||
+                memcmp(got.msg, expected.msg, got.len) ||
+                got.signalLevel != expected.signalLevel))) {
+        if (++failures <= 20)
+            fprintf(stderr, "FAIL: \"%s\": got %d, expected %d\n", line, r1, r2);
+    }
+}
+
+static void testGolden(void)
+{
+    static const struct {
+        const char *line;
+        int len;
+        const char *msg;
+        double signal;
+    } golden[] = {
+        { "*8D4840D6202CC371C32CE0576098;",                 14, "\x8d\x48\x40\xd6\x20\x2c\xc3\x71\xc3\x2c\xe0\x57\x60\x98", 0 },
+        { ":8d4840d6202cc371c32ce0576098;\r",               14, "\x8d\x48\x40\xd6\x20\x2c\xc3\x71\xc3\x2c\xe0\x57\x60\x98", 0 },
+        { "@0123456789AB5D4840D6E5A1C2;",                   7,  "\x5d\x48\x40\xd6\xe5\xa1\xc2", 0 },
+        { "  %0123456789AB0421;  ",                         2,  "\x04\x21", 0 },
+        { "<0123456789ABFF8D4840D6202CC371C32CE0576098;",   14, "\x8d\x48\x40\xd6\x20\x2c\xc3\x71\xc3\x2c\xe0\x57\x60\x98", 1.0 },
+        { "*8D4840D6202CC371C32CE05760;",                   0,  NULL, 0 },
+        { "*8D4840D6202CC371C32CE057609G;",                 0,  NULL, 0 },
+        { "*8D4840D6202CC371C32CE0576098",                  0,  NULL, 0 },
+        { "#8D4840D6202CC371C32CE0576098;",                 0,  NULL, 0 },
+        { "<0123456789ABZZ8D4840D6202CC371C32CE0576098;",   0,  NULL, 0 },
+        { "",                                               0,  NULL, 0 },
+        { ";",                                              0,  NULL, 0 },
+    };
+
+    for (size_t i = 0; i < sizeof(golden) / sizeof(golden[0]); ++i) {
+        const char *line = golden[i].line;
+        struct avr_frame frame;
+        int ok = avrDecodeLine(line, line + strlen(line), &frame);
+
+        if (ok != (golden[i].len != 0) ||
+            (ok && (frame.len != golden[i].len ||
+                    memcmp(frame.msg, golden[i].msg, frame.len) ||
+                    frame.signalLevel != golden[i].signal))) {
+            ++failures;
+            fprintf(stderr, "FAIL: golden line \"%s\"\n", line);
+        }
+
+        compare(line);
+    }
+}
+
+static void testRandom(unsigned n)
+{
+    static const char prefixes[] = "*:@%<";
+    static const char noise[] = "0123456789abcdefABCDEFgG;*@<%: \t\r";
+
+    for (unsigned i = 0; i < n; ++i) {
+        char line[128], *p = line;
+        int bytes = (random() % 3 == 0 ? MODES_SHORT_MSG_BYTES : random() % 8 == 0 ? MODEAC_MSG_BYTES : MODES_LONG_MSG_BYTES);
+        char prefix = prefixes[random() % 5];
+
+        if (random() % 4 == 0)
+            *p++ = ' ';
+        *p++ = prefix;
+        if (prefix == '<' || prefix == '@' || prefix == '%')
+            p += sprintf(p, "%06lX%06lX", random() & 0xFFFFFF, random() & 0xFFFFFF);
+        if (prefix == '<')
+            p += sprintf(p, "%02lx", random() & 0xFF);
+        for (int j = 0; j < bytes; ++j)
+            p += sprintf(p, random() & 1 ? "%02X" : "%02x", (unsigned) (random() & 0xFF));
+        *p++ = ';';
+        if (random() % 4 == 0)
+            *p++ = '\r';
+        *p = 0;
+
+        // damage some of them: change, drop or add a character
+        int len = p - line;
+        switch (random() % 4) {
+        case 0:
+            line[random() % len] = noise[random() % (sizeof(noise) - 1)];
+            break;
+        case 1: {
+            int k = random() % len;
+            memmove(line + k, line + k + 1, len - k);
+            break;
+        }
+        case 2: {
+            int k = random() % (len + 1);
+            memmove(line + k + 1, line + k, len - k + 1);
+            line[k] = noise[random() % (sizeof(noise) - 1)];
+            break;
+        }
+        default:
+            break;
+        }
+
+        compare(line);
+    }
+}
+
+// Parse a buffer of lines the way the old read loop did: strstr() for the
+// separator, NUL-terminate, then the old parser
+static unsigned benchOld(char *buf, char *eod)
+{
+    struct avr_frame frame;
+    unsigned accepted = 0;
+    char *som = buf, *p;
+
+    *eod = 0;
+    while (som < eod && (p = strstr(som, "\n")) != NULL) {
+        *p = 0;
+        accepted += refDecodeLine(som, &frame);
+        *p = '\n';
+        som = p + 1;
+    }
+    return accepted;
+}
+
+// The same with the READ_MODE_AVR loop and avrDecodeLine
+static unsigned benchNew(char *buf, char *eod)
+{
+    struct avr_frame frame;
+    unsigned accepted = 0;
+    char *som = buf, *p;
+
+    while (som < eod && (p = memchr(som, '\n', eod - som)) != NULL) {
+        accepted += avrDecodeLine(som, p, &frame);
+        som = p + 1;
+    }
+    return accepted;
+}
+
+static void bench(unsigned iterations)
+{
+    // one receive buffer's worth of a mix of AVR forms
+    static const char *lines[] = {
+        "*8D4840D6202CC371C32CE0576098;\r\n",
+        "@0123456789AB5D4840D6E5A1C2;\r\n",
+        "<0123456789AB4C8D40621D58C382D690C8AC2863A7;\r\n",
+        "*02E19CB8A3F2E4;\r\n",
+        "%0123456789AB8D485020994409940838175B284F;\r\n",
+    };
+    char buf[MODES_CLIENT_BUF_SIZE + 1];
+    char *p = buf, *end = buf + MODES_CLIENT_BUF_SIZE;
+    unsigned nlines = 0;
+
+    for (size_t i = 0; p + strlen(lines[i]) <= end; i = (i + 1) % (sizeof(lines) / sizeof(lines[0]))) {
+        memcpy(p, lines[i], strlen(lines[i]));
+        p += strlen(lines[i]);
+        ++nlines;
+    }
+
+    static const struct {
+        const char *name;
+        unsigned (*fn)(char *, char *);
+    } parsers[] = {
+        { "old", benchOld },
+        { "table", benchNew },
+    };
+
+    for (size_t k = 0; k < sizeof(parsers) / sizeof(parsers[0]); ++k) {
+        // each pass gets a fresh copy, as the old parser trims in place
+        char work[sizeof(buf)];
+        unsigned accepted = 0;
+        double start = now_seconds();
+        for (unsigned i = 0; i < iterations; ++i) {
+            memcpy(work, buf, p - buf);
+            accepted += parsers[k].fn(work, work + (p - buf));
+        }
+        double elapsed = now_seconds() - start;
+
+        printf("%-6s %12.0f lines/s  (%u of %u accepted, %.3fs)\n",
+               parsers[k].name, (double) nlines * iterations / elapsed,
+               accepted, nlines * iterations, elapsed);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && !strcmp(argv[1], "--bench")) {
+        bench(argc > 2 ? strtoul(argv[2], NULL, 10) : 100000);
+        return 0;
+    }
+
+    unsigned n = (argc > 1 ? strtoul(argv[1], NULL, 10) : 200000);
+
+    srandom(1);
+
+    testGolden();
+    testRandom(n);
+
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+
+    fprintf(stderr, "all tests passed\n");
+    return 0;
+}
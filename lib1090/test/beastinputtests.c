@@ -0,0 +1,205 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// beastinputtests.c - tests for Beast input that switches to a
+// compressed stream part way through
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "testutil.h"
+
+#include <sys/socket.h>
+#include <zlib.h>
+
+struct frame {
+    const char *hex;
+    uint64_t timestamp;
+};
+
+// The first PLAIN frames are sent before <esc> "Z", the rest compressed.
+// Some timestamps need escaping, and one looks like the marker once
+// escaped (1a 1a 5a).
+static const struct frame frames[] = {
+    { "8D4840D6202CC371C32CE0576098", 0x000000001000ULL },
+    { "5D4840D6A1B2C3",               0x00001a5a0000ULL },
+    { "8D40621D58C382D690C8AC2863A7", 0x1a0000002000ULL },
+    { "8D40621D58C386435CC412692AD6", 0x000000003000ULL },
+    { "02E197B00179C3",               0x0000001a1a1aULL },
+    { "8D485020994409940838175B284F", 0x000000004000ULL },
+};
+#define NUM_FRAMES (sizeof(frames) / sizeof(frames[0]))
+#define PLAIN 2
+
+static struct client *client;
+static unsigned received;
+static unsigned received_plain;     // of those, how many arrived before the switch
+
+// Append one byte, escaped
+static uint8_t *put(uint8_t *p, uint8_t b)
+{
+    *p++ = b;
+    if (b == 0x1a)
+        *p++ = b;
+    return p;
+}
+
+// Append frame 'i' in Beast format
+static uint8_t *beastFrame(uint8_t *p, unsigned i)
+{
+    unsigned char msg[MODES_LONG_MSG_BYTES];
+    int len = strlen(frames[i].hex) / 2;
+
+    fromHex(frames[i].hex, msg);
+    *p++ = 0x1a;
+    *p++ = (len == MODES_LONG_MSG_BYTES ? '3' : '2');
+    for (int j = 5; j >= 0; --j)
+        p = put(p, (uint8_t) (frames[i].timestamp >> (8 * j)));
+    p = put(p, 0x80);
+    for (int j = 0; j < len; ++j)
+        p = put(p, msg[j]);
+    return p;
+}
+
+// Read handler: check each frame against the next one expected, and
+// that frames from before the marker were read before inflating started
+static int checkFrame(struct client *c, char *p)
+{
+    unsigned char msg[MODES_LONG_MSG_BYTES];
+    unsigned char got[MODES_LONG_MSG_BYTES];
+    uint64_t timestamp = 0;
+
+    if (received >= NUM_FRAMES) {
+        fail("more frames than were sent");
+        return 0;
+    }
+
+    const struct frame *f = &frames[received];
+    int len = strlen(f->hex) / 2;
+    fromHex(f->hex, msg);
+
+    if (*p++ != (len == MODES_LONG_MSG_BYTES ? '3' : '2'))
+        fail("frame %u: wrong type", received);
+    for (int j = 0; j < 6; ++j) {
+        timestamp = timestamp << 8 | (uint8_t) *p;
+        p += (*p == 0x1a ? 2 : 1);
+    }
+    p += (*p == 0x1a ? 2 : 1);  // signal level
+    for (int j = 0; j < len; ++j) {
+        got[j] = (uint8_t) *p;
+        p += (*p == 0x1a ? 2 : 1);
+    }
+
+    if (timestamp != f->timestamp)
+        fail("frame %u: timestamp %012llx, expected %012llx", received,
+             (unsigned long long) timestamp, (unsigned long long) f->timestamp);
+    if (memcmp(got, msg, len))
+        fail("frame %u: wrong data", received);
+    if ((received < PLAIN) != !c->zin)
+        fail("frame %u: read %s the stream was inflated", received, c->zin ? "after" : "before");
+
+    if (!c->zin)
+        ++received_plain;
+    ++received;
+    return 0;
+}
+
+// Read whatever the client has waiting, until it stops producing frames
+static void readAll(void)
+{
+    unsigned before;
+
+    do {
+        before = received;
+        modesNetPeriodicWork();
+    } while (received != before);
+}
+
+int main(int argc, char **argv)
+{
+    MODES_NOTUSED(argc);
+    MODES_NOTUSED(argv);
+
+    modesInitConfig();
+    Modes.quiet = 1;
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        perror("socketpair");
+        return 1;
+    }
+
+    struct net_service *s = serviceInit("Beast TCP input", NULL, NULL, READ_MODE_BEAST, NULL, checkFrame);
+    client = createGenericClient(s, sv[0]);
+    requestBeastCompression(client);
+
+    char request[3];
+    if (read(sv[1], request, sizeof(request)) != 3 || memcmp(request, "\x1a" "1Z", 3))
+        fail("compression was not requested");
+
+    // The plain frames, the marker, then the rest deflated
+    static uint8_t stream[NUM_FRAMES * 64 + 1024], raw[NUM_FRAMES * 64];
+    uint8_t *p = stream;
+    for (unsigned i = 0; i < PLAIN; ++i)
+        p = beastFrame(p, i);
+    *p++ = 0x1a;
+    *p++ = 'Z';
+    size_t plain_len = p - stream;
+
+    uint8_t *r = raw;
+    for (unsigned i = PLAIN; i < NUM_FRAMES; ++i)
+        r = beastFrame(r, i);
+
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    deflateInit(&z, Z_DEFAULT_COMPRESSION);
+    z.next_in = raw;
+    z.avail_in = r - raw;
+    z.next_out = p;
+    z.avail_out = sizeof(stream) - plain_len;
+    deflate(&z, Z_SYNC_FLUSH);
+    size_t stream_len = z.next_out - stream;
+    size_t compressed_len = stream_len - plain_len;
+    deflateEnd(&z);
+
+    // Everything but the last few bytes in one read, so the switch happens
+    // inside the read buffer; then the rest
+    size_t first = stream_len - 4;
+    if (write(sv[1], stream, first) != (ssize_t) first)
+        fail("write failed");
+    readAll();
+    if (received_plain != PLAIN)
+        fail("%u frames read before the marker, expected %u", received_plain, PLAIN);
+    if (!client->zin)
+        fail("the marker did not start decompression");
+
+    if (write(sv[1], stream + first, stream_len - first) != (ssize_t) (stream_len - first))
+        fail("write failed");
+    readAll();
+    if (received != NUM_FRAMES)
+        fail("%u frames read, expected %u", received, (unsigned) NUM_FRAMES);
+
+    if (Modes.stats_current.net_decompress_in != compressed_len)
+        fail("%llu compressed bytes counted, expected %zu",
+             (unsigned long long) Modes.stats_current.net_decompress_in, compressed_len);
+    if (Modes.stats_current.net_decompress_out != (uint64_t) (r - raw))
+        fail("%llu inflated bytes counted, expected %zu",
+             (unsigned long long) Modes.stats_current.net_decompress_out, (size_t) (r - raw));
+
+    // the end of the connection closes the client and its inflate stream
+    close(sv[1]);
+    modesNetPeriodicWork();
+    if (Modes.clients)
+        fail("client not closed at the end of the stream");
+
+    return testsFinished();
+}
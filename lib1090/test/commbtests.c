@@ -0,0 +1,128 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// commbtests.c - tests for the Comm-B prediction cache
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "testutil.h"
+#include "ais_charset.h"
+
+#define START 1709337540000ULL
+
+enum { SWEPT, REPEATED, PREDICTED };
+static const char *paths[] = { "a full sweep", "a repeat", "a prediction" };
+
+// BDS2,0 with the given 8 character callsign
+static void ident(unsigned char *mb, const char *callsign)
+{
+    uint64_t bits = 0;
+
+    for (int i = 0; i < 8; ++i)
+        bits = (bits << 6) | (uint64_t) ((char *) memchr(ais_charset, callsign[i], 64) - ais_charset);
+    mb[0] = 0x20;
+    for (int i = 1; i < 7; ++i)
+        mb[i] = (unsigned char) (bits >> (8 * (6 - i)));
+}
+
+// Decode one Comm-B reply from 'addr' at START + 'at' ms; returns how the
+// cache handled it, and checks it decoded as 'format'
+static int reply(uint32_t addr, const unsigned char *mb, uint64_t at, commb_format_t format)
+{
+    struct modesMessage mm;
+    struct stats before = Modes.stats_current;
+
+    modesInitMessage(&mm);
+    modesClearFields(&mm);
+    mm.msgtype = 20;
+    mm.addr = addr;
+    mm.sysTimestampMsg = START + at;
+    memcpy(mm.MB, mb, sizeof(mm.MB));
+    decodeCommB(&mm);
+
+    if (mm.commb_format != format)
+        fail("reply from %06x at +%llums decoded as format %d, expected %d", addr, (unsigned long long) at, mm.commb_format, format);
+
+    if (Modes.stats_current.commb_repeated != before.commb_repeated)
+        return REPEATED;
+    if (Modes.stats_current.commb_predicted != before.commb_predicted)
+        return PREDICTED;
+    if (Modes.stats_current.commb_sweeps != before.commb_sweeps)
+        return SWEPT;
+    fail("reply from %06x at +%llums not counted", addr, (unsigned long long) at);
+    return -1;
+}
+
+static void expect(int path, int expected, const char *what)
+{
+    if (path != expected)
+        fail("%s: took %s, expected %s", what, path >= 0 ? paths[path] : "nothing", paths[expected]);
+}
+
+// Another address that lands on the same cache entry as 'addr'
+static uint32_t sameSlot(uint32_t addr)
+{
+    uint32_t h = addr ^ (addr >> 10) ^ (addr >> 20);
+    for (uint32_t other = 1; other < 0x1000000; ++other) {
+        if (other != addr && !(((other ^ (other >> 10) ^ (other >> 20)) ^ h) & 1023))
+            return other;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    MODES_NOTUSED(argc);
+    MODES_NOTUSED(argv);
+
+    modesInitConfig();
+
+    unsigned char klm[7], abc[7], xyz[7];
+    static const unsigned char caps[7] = { 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    ident(klm, "KLM1023 ");
+    ident(abc, "ABC123  ");
+    ident(xyz, "XYZ789  ");
+
+    // miss, then hits: the same content again, and the same register
+    // with new content
+    expect(reply(0x4840D6, klm, 0, COMMB_AIRCRAFT_IDENT), SWEPT, "first reply");
+    expect(reply(0x4840D6, klm, 1000, COMMB_AIRCRAFT_IDENT), REPEATED, "same reply again");
+    expect(reply(0x4840D6, abc, 2000, COMMB_AIRCRAFT_IDENT), PREDICTED, "same register again");
+    expect(reply(0x4840D6, caps, 3000, COMMB_DATALINK_CAPS), SWEPT, "register not seen yet");
+    expect(reply(0x4840D6, xyz, 4000, COMMB_AIRCRAFT_IDENT), PREDICTED, "register seen before another");
+
+    // another aircraft on the same entry starts from nothing
+    uint32_t other = sameSlot(0x4840D6);
+    if (!other) {
+        fail("no address shares a cache entry with 4840D6");
+        return testsFinished();
+    }
+    expect(reply(other, xyz, 5000, COMMB_AIRCRAFT_IDENT), SWEPT, "address change, same content");
+    expect(reply(other, klm, 6000, COMMB_AIRCRAFT_IDENT), PREDICTED, "address change, then the same register");
+    expect(reply(0x4840D6, abc, 7000, COMMB_AIRCRAFT_IDENT), SWEPT, "address change back");
+
+    // the entry is forgotten after COMMB_CACHE_TTL without replies
+    uint64_t t = 7000 + COMMB_CACHE_TTL + 1;
+    expect(reply(0x4840D6, abc, t, COMMB_AIRCRAFT_IDENT), SWEPT, "same reply after the entry TTL");
+    expect(reply(0x4840D6, klm, t + 1000, COMMB_AIRCRAFT_IDENT), PREDICTED, "same register after the entry TTL");
+
+    // a register stops being predicted COMMB_HIT_TTL after its last reply,
+    // even while the entry is kept alive by other registers
+    for (uint64_t at = t + 2000; at < t + COMMB_HIT_TTL + 4000; at += 1000)
+        reply(0x4840D6, caps, at, COMMB_DATALINK_CAPS);
+    expect(reply(0x4840D6, xyz, t + COMMB_HIT_TTL + 4000, COMMB_AIRCRAFT_IDENT), SWEPT, "register after its hit TTL");
+    expect(reply(0x4840D6, abc, t + COMMB_HIT_TTL + 5000, COMMB_AIRCRAFT_IDENT), PREDICTED, "register seen again after its hit TTL");
+
+    commBFree();
+    return testsFinished();
+}
@@ -0,0 +1,107 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// decodebench.c - message decoding throughput benchmark
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Decodes a fixed mix of frames over and over and reports messages per
+// second for:
+//
+//   zeroed    - the whole struct modesMessage cleared, full decode
+//               (how every message used to be handled)
+//   header    - only the header initialized, full decode
+//   lazy      - only the header initialized, decodeModesHeader only
+//               (a relay with nothing but Beast verbatim clients)
+//
+// usage: decodebench [iterations]
+
+#include "testutil.h"
+
+// Extended squitters, as hex
+static const char *frames_hex[] = {
+    "8D4840D6202CC371C32CE0576098",  // DF17 identification
+    "8D40621D58C382D690C8AC2863A7",  // DF17 airborne position
+    "8D485020994409940838175B284F",  // DF17 airborne velocity
+    "8DA05F219B06B6AF189400CBC33F",  // DF17 airborne velocity (airspeed)
+};
+
+#define NUM_ES (sizeof(frames_hex) / sizeof(frames_hex[0]))
+#define NUM_FRAMES (NUM_ES + 3)
+
+static unsigned char frames[NUM_FRAMES][MODES_LONG_MSG_BYTES];
+
+typedef int (*bench_fn)(struct modesMessage *mm, unsigned char *msg);
+
+static int benchZeroed(struct modesMessage *mm, unsigned char *msg)
+{
+    memset(mm, 0, sizeof(*mm));
+    return decodeModesMessage(mm, msg);
+}
+
+static int benchHeader(struct modesMessage *mm, unsigned char *msg)
+{
+    modesInitMessage(mm);
+    return decodeModesMessage(mm, msg);
+}
+
+static int benchLazy(struct modesMessage *mm, unsigned char *msg)
+{
+    modesInitMessage(mm);
+    return decodeModesHeader(mm, msg);
+}
+
+static void run(const char *name, bench_fn fn, unsigned iterations)
+{
+    struct modesMessage mm;
+    unsigned accepted = 0;
+
+    double start = now_seconds();
+    for (unsigned i = 0; i < iterations; ++i) {
+        for (unsigned f = 0; f < NUM_FRAMES; ++f) {
+            if (fn(&mm, frames[f]) == 0)
+                ++accepted;
+        }
+    }
+    double elapsed = now_seconds() - start;
+
+    unsigned total = iterations * NUM_FRAMES;
+    printf("%-8s %10.0f msg/s  (%u of %u accepted, %.3fs)\n",
+           name, total / elapsed, accepted, total, elapsed);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned iterations = (argc > 1 ? strtoul(argv[1], NULL, 10) : 200000);
+
+    modesInitConfig();
+    Modes.quiet = 1;
+    modesInit();
+
+    for (unsigned f = 0; f < NUM_ES; ++f)
+        fromHex(frames_hex[f], frames[f]);
+
+    // seed the ICAO filter so the Address/Parity frames are accepted
+    icaoFilterAdd(0x4840D6);
+    makeAddressParity(frames[NUM_ES], 4, 0x4840D6);
+    makeAddressParity(frames[NUM_ES + 1], 20, 0x4840D6);
+    makeAllCall(frames[NUM_ES + 2], 0x4840D6);
+
+    printf("struct modesMessage: %zu bytes, header %zu bytes\n",
+           sizeof(struct modesMessage), offsetof(struct modesMessage, AC));
+
+    run("zeroed", benchZeroed, iterations);
+    run("header", benchHeader, iterations);
+    run("lazy", benchLazy, iterations);
+    return 0;
+}
@@ -0,0 +1,149 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// deduptests.c - tests for cross-receiver duplicate suppression
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "testutil.h"
+
+#include <fcntl.h>
+
+#define WINDOW 100
+#define START  1709337540000ULL
+
+// Feed one copy of 'hex' (or a Mode A reply, if hex is NULL) heard by
+// 'receiver' through useModesMessage, read at START + 'at' ms and with
+// its sample clock at 'sample_at' ms; returns 1 if it was dropped as a
+// duplicate
+static int deliverAt(const char *hex, int receiver, uint64_t at, uint64_t sample_at)
+{
+    struct modesMessage mm;
+    unsigned dropped = Modes.stats_current.dedup_dropped;
+
+    modesInitMessage(&mm);
+    if (hex) {
+        fromHex(hex, mm.msg);
+        memcpy(mm.verbatim, mm.msg, sizeof(mm.verbatim));
+        mm.msgbits = strlen(hex) * 4;
+        mm.msgtype = mm.msg[0] >> 3;
+    } else {
+        decodeModeAMessage(&mm, 0x1200);
+    }
+    mm.sysTimestampMsg = START + at;
+    mm.timestampMsg = sample_at * 12000;
+    mm.receiverId = receiver;
+
+    useModesMessage(&mm);
+    return Modes.stats_current.dedup_dropped != dropped;
+}
+
+static int deliver(const char *hex, int receiver, uint64_t at)
+{
+    return deliverAt(hex, receiver, at, at);
+}
+
+static void testDuplicates(void)
+{
+    static const char *ident = "8D4840D6202CC371C32CE0576098";
+    static const char *velocity = "8D485020994409940838175B284F";
+
+    dedupInit();
+
+    if (deliver(ident, 0, 0))
+        fail("first copy dropped");
+    if (!deliver(ident, 1, 10))
+        fail("copy from a second receiver within the window not dropped");
+    if (!deliver(ident, MODES_MAX_RECEIVERS + 3, 20))
+        fail("copy from a network client within the window not dropped");
+    if (deliver(velocity, 1, 30))
+        fail("different message from a second receiver dropped");
+
+    // a retransmission heard by the same receiver is genuine, and
+    // restarts the window
+    if (deliver(ident, 0, 80))
+        fail("retransmission from the same receiver dropped");
+    if (!deliver(ident, 1, 80 + WINDOW))
+        fail("copy within the window of a retransmission not dropped");
+
+    // once the window has passed, another receiver's copy is new
+    if (deliver(ident, 1, 80 + 2 * WINDOW + 1))
+        fail("copy after the window dropped");
+    if (deliver(velocity, 0, 30 + WINDOW + 1))
+        fail("copy just after the window dropped");
+
+    // Mode A/C replies carry no address, so identical ones from different
+    // aircraft are common; they are never deduplicated
+    if (deliver(NULL, 0, 500) || deliver(NULL, 1, 500) || deliver(NULL, 1, 501))
+        fail("Mode A/C reply dropped");
+}
+
+// File replays compare sample times: reading order and speed don't matter
+static void testSampleClock(void)
+{
+    static const char *ident = "8D4840D6202CC371C32CE0576098";
+
+    dedupInit();
+    Modes.dedup_sample_clock = 1;
+
+    // the second file is read well after the first, but heard it together
+    if (deliverAt(ident, 0, 0, 1000))
+        fail("first copy dropped");
+    if (!deliverAt(ident, 1, 5000, 1010))
+        fail("copy heard within the window, but read later, not dropped");
+
+    // read together, but heard a long way apart
+    if (deliverAt(ident, 1, 5001, 2000))
+        fail("copy heard after the window, but read together, dropped");
+
+    Modes.dedup_sample_clock = 0;
+}
+
+// Network clients get an identity of their own, even when the OS hands
+// out the same fd again after an earlier client closed
+static void testClientIds(void)
+{
+    struct net_service *s = serviceInit("Beast TCP input", NULL, NULL, READ_MODE_BEAST, NULL, NULL);
+
+    int fd = open("/dev/null", O_RDONLY);
+    struct client *first = createGenericClient(s, fd);
+    close(fd);
+    fd = open("/dev/null", O_RDONLY);
+    struct client *second = createGenericClient(s, fd);
+
+    if (first->fd != second->fd)
+        fprintf(stderr, "(fd was not reused, the test is weaker)\n");
+    if (first->receiverId < MODES_MAX_RECEIVERS || second->receiverId < MODES_MAX_RECEIVERS)
+        fail("network client shares an id with a local receiver");
+    if (first->receiverId == second->receiverId)
+        fail("new client inherited the id of a closed one");
+
+    close(fd);
+}
+
+int main(int argc, char **argv)
+{
+    MODES_NOTUSED(argc);
+    MODES_NOTUSED(argv);
+
+    modesInitConfig();
+    Modes.quiet = 1;
+    Modes.dedup_window = WINDOW;
+
+    testDuplicates();
+    testSampleClock();
+    testClientIds();
+
+    dedupFree();
+    return testsFinished();
+}
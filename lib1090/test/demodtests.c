@@ -0,0 +1,186 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// demodtests.c - synthetic sample tests for the demodulators
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Each supported sample rate gets the same input: frames at random levels
+// and sub-sample offsets over a little noise, spread across several
+// magnitude buffers. Every frame must come out once, uncorrected, with a
+// timestamp within a sample of where it was put. Noise on its own must
+// produce nothing.
+//
+// The exception is 2MHz: with one sample per chip, a frame that starts
+// half a sample off spreads every chip evenly over two samples, and some
+// of those are lost or come out with bits wrong. Up to 'max_lost' per
+// thousand frames may go that way.
+
+#include "testutil.h"
+
+#define NUM_BLOCKS    4
+#define MAX_PLACED    1024
+#define NOISE         300.0
+
+static const char *es_hex[] = {
+    "8D4840D6202CC371C32CE0576098",
+    "8D40621D58C382D690C8AC2863A7",
+    "8D40621D58C386435CC412692AD6",
+    "8D485020994409940838175B284F",
+    "8DA05F219B06B6AF189400CBC33F",
+};
+#define NUM_ES (sizeof(es_hex) / sizeof(es_hex[0]))
+#define NUM_FRAMES (NUM_ES + 3)
+
+struct placed {
+    unsigned char msg[MODES_LONG_MSG_BYTES];
+    uint64_t timestamp;     // 12MHz clock at the end of bit 56
+    int seen;
+};
+
+static struct placed placed[MAX_PLACED];
+static unsigned placed_count;
+static unsigned received, unexpected;
+static int max_error;
+
+static void checkMessage(struct modesMessage *mm, struct aircraft *a, void *udata)
+{
+    MODES_NOTUSED(a);
+    MODES_NOTUSED(udata);
+
+    ++received;
+    for (unsigned i = 0; i < placed_count; ++i) {
+        struct placed *p = &placed[i];
+        int64_t error = (int64_t) mm->timestampMsg - (int64_t) p->timestamp;
+
+        if (memcmp(p->msg, mm->verbatim, mm->msgbits / 8) != 0 || llabs(error) > 100)
+            continue;
+
+        if (p->seen++)
+            fail("%s: frame %u decoded twice", Modes.demod->name, i);
+        if (mm->correctedbits)
+            fail("%s: frame %u needed %d bits corrected", Modes.demod->name, i, mm->correctedbits);
+        if (llabs(error) > max_error)
+            max_error = llabs(error);
+        return;
+    }
+
+    ++unexpected;
+}
+
+// Turn the envelope into magnitude, with noise, and hand it to the
+// demodulator a buffer at a time as the reader thread would
+static void demodulateEnvelope(float *envelope, uint32_t samples)
+{
+    uint16_t *mag = calloc(samples + Modes.trailing_samples, sizeof(uint16_t));
+
+    for (uint32_t n = 0; n < samples; ++n)
+        mag[n] = (uint16_t) fmin(65535.0, fmax(0.0, envelope[n] + NOISE * rngUnit()));
+
+    uint64_t sys = mstime();
+    for (uint32_t start = 0; start < samples; start += MODES_MAG_BUF_SAMPLES) {
+        struct mag_buf buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.data = mag + start;
+        buf.length = samples - start;
+        if (buf.length > MODES_MAG_BUF_SAMPLES)
+            buf.length = MODES_MAG_BUF_SAMPLES;
+        buf.sampleTimestamp = start * 12e6 / Modes.sample_rate;
+        buf.sysTimestamp = sys + start * 1000.0 / Modes.sample_rate;
+        buf.mean_power = 1e-4;
+        Modes.demod->demodulate(&buf);
+    }
+
+    free(mag);
+}
+
+static void testRate(double rate, unsigned max_lost)
+{
+    struct modes_t *instance = modesNewInstance();
+    struct modes_t *previous = modesSetCurrent(instance);
+
+    modesInitConfig();
+    Modes.quiet = 1;
+    Modes.sample_rate = rate;
+    modesInit();
+    modesSetMessageSink(checkMessage, NULL);
+
+    unsigned char frames[NUM_FRAMES][MODES_LONG_MSG_BYTES];
+    for (unsigned f = 0; f < NUM_ES; ++f)
+        fromHex(es_hex[f], frames[f]);
+    makeAllCall(frames[NUM_ES], 0x4840D6);
+    makeAllCall(frames[NUM_ES + 1], 0x40621D);
+    makeAddressParity(frames[NUM_ES + 2], 20, 0x40621D);
+
+    uint32_t samples = NUM_BLOCKS * MODES_MAG_BUF_SAMPLES;
+    float *envelope = calloc(samples, sizeof(float));
+
+    // noise alone
+    rng_state = 0x1090;
+    received = 0;
+    demodulateEnvelope(envelope, samples);
+    if (received)
+        fail("%s: %u messages decoded from noise", Modes.demod->name, received);
+
+    // Frames 150-350us apart, so that some straddle buffer boundaries.
+    // The all-calls come first, so the address/parity frame is accepted
+    placed_count = received = unexpected = 0;
+    max_error = 0;
+    double end = samples / (rate / 1e6) - 130.0;
+    for (double t = 10.0; t < end && placed_count < MAX_PLACED; t += 150.0 + 200.0 * rngUnit()) {
+        struct placed *p = &placed[placed_count];
+        unsigned f = placed_count < 2 ? NUM_ES + placed_count : rng() % NUM_FRAMES;
+        int bits = modesMessageLenByType(frames[f][0] >> 3);
+
+        t += rngUnit();   // sub-sample offsets
+        memcpy(p->msg, frames[f], sizeof(p->msg));
+        p->timestamp = (uint64_t) ((t + MODES_PREAMBLE_US + 56) * 12.0 + 0.5);
+        p->seen = 0;
+        addFrame(envelope, samples, t, p->msg, bits, 2000.0f + 30000.0f * (float) rngUnit());
+        ++placed_count;
+    }
+
+    demodulateEnvelope(envelope, samples);
+
+    unsigned missed = 0;
+    for (unsigned i = 0; i < placed_count; ++i)
+        missed += !placed[i].seen;
+    if (missed * 1000 > max_lost * placed_count)
+        fail("%s: %u of %u frames not decoded", Modes.demod->name, missed, placed_count);
+    if (unexpected > (max_lost ? missed : 0))
+        fail("%s: %u unexpected messages", Modes.demod->name, unexpected);
+
+    // one sample, in 12MHz ticks
+    int tolerance = (int) ceil(12e6 / rate);
+    if (max_error > tolerance)
+        fail("%s: timestamps up to %d ticks out, expected at most %d", Modes.demod->name, max_error, tolerance);
+
+    fprintf(stderr, "%s: %u frames, %u lost, timestamps within %d ticks\n", Modes.demod->name, placed_count, missed, max_error);
+
+    free(envelope);
+    modesSetCurrent(previous);
+    modesFreeInstance(instance);
+}
+
+int main(int argc, char **argv)
+{
+    MODES_NOTUSED(argc);
+    MODES_NOTUSED(argv);
+
+    testRate(2000000, 50);
+    testRate(2400000, 0);
+    testRate(6000000, 0);
+    testRate(8000000, 0);
+
+    return testsFinished();
+}
@@ -0,0 +1,207 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// icaofiltertests.c - tests for the ICAO address filter tables
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "testutil.h"
+
+#define TTL_SECONDS (MODES_ICAO_FILTER_TTL / 1000)
+
+// Distinct addresses with distinct low 16 bits, for n < 65536
+static uint32_t address(uint32_t n, uint32_t top)
+{
+    return (top << 16) | ((n * 7919) & 0xffff) | (n == 0 ? 0x10000 : 0);
+}
+
+static void forceSweep(void)
+{
+    Modes.next_icao_filter_sweep = 0;
+    icaoFilterExpire();
+}
+
+// Far more addresses than fit in the minimum size, all live
+static void testGrowth(void)
+{
+    const uint32_t count = ICAO_FILTER_MIN_SIZE * 2;
+
+    icaoFilterInit();
+    for (uint32_t n = 0; n < count; ++n)
+        icaoFilterAdd(address(n, 0x48));
+
+    if (Modes.icao_filter_exact.size <= ICAO_FILTER_MIN_SIZE)
+        fail("exact table did not grow: %u slots for %u addresses", Modes.icao_filter_exact.size, count);
+    if (Modes.icao_filter_partial.size <= ICAO_FILTER_MIN_SIZE)
+        fail("partial table did not grow: %u slots for %u addresses", Modes.icao_filter_partial.size, count);
+    if (Modes.icao_filter_exact.used > Modes.icao_filter_exact.size / 4 * 3)
+        fail("exact table more than 3/4 full: %u of %u", Modes.icao_filter_exact.used, Modes.icao_filter_exact.size);
+
+    unsigned missing = 0, fuzzy = 0;
+    for (uint32_t n = 0; n < count; ++n) {
+        missing += !icaoFilterTest(address(n, 0x48));
+        fuzzy += icaoFilterTestFuzzy(address(n, 0xff)) != address(n, 0x48);
+    }
+    if (missing)
+        fail("%u of %u addresses lost while growing", missing, count);
+    if (fuzzy)
+        fail("%u of %u partial lookups wrong after growing", fuzzy, count);
+    if (icaoFilterTest(address(count, 0x48)))
+        fail("address never added found");
+}
+
+// Entries expire on their own, and their slots are reused
+static void testExpiry(void)
+{
+    const uint32_t count = ICAO_FILTER_MIN_SIZE / 2;
+
+    icaoFilterInit();
+    uint32_t now = Modes.icao_filter_epoch;
+
+    icaoFilterAddSeen(0x4840D6, now - TTL_SECONDS + 1);
+    icaoFilterAddSeen(0x40621D, now);
+    icaoFilterAddSeen(0x485020, now - TTL_SECONDS - 1);
+    if (!icaoFilterTest(0x4840D6) || !icaoFilterTest(0x40621D))
+        fail("live addresses not found");
+    if (icaoFilterTest(0x485020))
+        fail("address added already expired was found");
+
+    Modes.icao_filter_epoch = now + 2;
+    if (icaoFilterTest(0x4840D6) || icaoFilterTestFuzzy(0x4840D6))
+        fail("address found after its TTL");
+    if (!icaoFilterTest(0x40621D))
+        fail("address expired before its TTL");
+    icaoFilterAdd(0x4840D6);
+    if (!icaoFilterTest(0x4840D6))
+        fail("expired address not found once seen again");
+
+    // fill with addresses that then expire; new ones should take over many
+    // of their slots rather than use empty ones (without reuse every one
+    // would, and the table would be rebuilt once 3/4 full)
+    icaoFilterInit();
+    now = Modes.icao_filter_epoch;
+    for (uint32_t n = 0; n < count; ++n)
+        icaoFilterAddSeen(address(n, 0x11), now - TTL_SECONDS);
+
+    const uint32_t *slots = Modes.icao_filter_exact.addr;
+    uint32_t used = Modes.icao_filter_exact.used;
+    Modes.icao_filter_epoch = now + 1;
+    for (uint32_t n = 0; n < count; ++n)
+        icaoFilterAdd(address(n, 0x22));
+
+    if (Modes.icao_filter_exact.addr != slots)
+        fail("table rebuilt although expired slots were free");
+    if (Modes.icao_filter_exact.used - used > count / 2)
+        fail("expired slots not reused: %u more slots used for %u addresses", Modes.icao_filter_exact.used - used, count);
+
+    unsigned missing = 0, stale = 0;
+    for (uint32_t n = 0; n < count; ++n) {
+        missing += !icaoFilterTest(address(n, 0x22));
+        stale += icaoFilterTest(address(n, 0x11));
+    }
+    if (missing || stale)
+        fail("after reuse: %u new addresses missing, %u expired ones found", missing, stale);
+}
+
+// The sweep drops expired entries and shrinks the tables back
+static void testSweep(void)
+{
+    const uint32_t count = ICAO_FILTER_MIN_SIZE * 2;
+
+    icaoFilterInit();
+    uint32_t now = Modes.icao_filter_epoch;
+
+    // pretend the tables filled up an hour ago
+    Modes.icao_filter_epoch = now - 3600;
+    for (uint32_t n = 0; n < count; ++n)
+        icaoFilterAdd(address(n, 0x33));
+    icaoFilterAddSeen(0x4840D6, now);
+    if (Modes.icao_filter_exact.size <= ICAO_FILTER_MIN_SIZE)
+        fail("sweep test: tables did not grow");
+
+    forceSweep();
+    if (Modes.icao_filter_exact.size != ICAO_FILTER_MIN_SIZE || Modes.icao_filter_partial.size != ICAO_FILTER_MIN_SIZE)
+        fail("sweep did not shrink the tables: %u / %u slots", Modes.icao_filter_exact.size, Modes.icao_filter_partial.size);
+    if (Modes.icao_filter_exact.used != 1 || Modes.icao_filter_partial.used != 1)
+        fail("sweep kept %u / %u entries, expected 1", Modes.icao_filter_exact.used, Modes.icao_filter_partial.used);
+    if (!icaoFilterTest(0x4840D6) || icaoFilterTestFuzzy(0x0040D6) != 0x4840D6)
+        fail("sweep dropped a live address");
+    if (icaoFilterTest(address(0, 0x33)))
+        fail("sweep kept an expired address");
+}
+
+static void testFuzzy(void)
+{
+    icaoFilterInit();
+
+    icaoFilterAdd(0x4840D6);
+    if (icaoFilterTestFuzzy(0x0040D6) != 0x4840D6 || icaoFilterTestFuzzy(0xAB40D6) != 0x4840D6)
+        fail("partial match not found");
+    if (icaoFilterTestFuzzy(0x0040D7) || icaoFilterTestFuzzy(0x4841D6))
+        fail("partial match found for other low 16 bits");
+    if (icaoFilterTest(0x0040D6))
+        fail("exact match found for a partial address");
+
+    // one address per low 16 bits: the latest one added
+    icaoFilterAdd(0x1240D6);
+    if (icaoFilterTestFuzzy(0x0040D6) != 0x1240D6)
+        fail("partial match is not the most recent address");
+    if (!icaoFilterTest(0x4840D6) || !icaoFilterTest(0x1240D6))
+        fail("exact matches lost by a partial replacement");
+
+    Modes.icao_filter_epoch += TTL_SECONDS + 1;
+    if (icaoFilterTestFuzzy(0x0040D6))
+        fail("partial match found after its TTL");
+}
+
+// The vector groupMatch (if any) against the scalar one
+static void testGroupMatch(void)
+{
+    static const uint32_t masks[] = { 0xffffffff, 0x00ffff };
+    static const uint32_t values[] = { 0, 0x4840D6, 0x1240D6, 0x40621D, 0x80000000, 0xffffffff };
+    uint32_t slots[ICAO_FILTER_GROUP];
+
+    rng_state = 0x1090;
+    for (unsigned n = 0; n < 100000; ++n) {
+        for (unsigned i = 0; i < ICAO_FILTER_GROUP; ++i)
+            slots[i] = (rng() & 1) ? values[rng() % 6] : rng();
+        uint32_t mask = masks[n & 1];
+        uint32_t key = ((rng() & 3) ? slots[rng() % ICAO_FILTER_GROUP] : rng()) & mask;
+
+        unsigned empty, scalar_empty;
+        unsigned match = icaoGroupMatch(slots, key, mask, &empty);
+        unsigned scalar_match = icaoGroupMatchScalar(slots, key, mask, &scalar_empty);
+        if (match != scalar_match || empty != scalar_empty) {
+            fail("groupMatch(%08x %08x %08x %08x, key %08x, mask %08x) = %x/%x, scalar %x/%x",
+                 slots[0], slots[1], slots[2], slots[3], key, mask, match, empty, scalar_match, scalar_empty);
+            return;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    MODES_NOTUSED(argc);
+    MODES_NOTUSED(argv);
+
+    modesInitConfig();
+
+    testGrowth();
+    testExpiry();
+    testSweep();
+    testFuzzy();
+    testGroupMatch();
+
+    icaoFilterFree();
+    return testsFinished();
+}
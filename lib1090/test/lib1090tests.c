@@ -0,0 +1,170 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// lib1090tests.c - tests for the lib1090 context API
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Everything below goes through lib1090.h, as an embedder would, except
+// for one look at the decoder's own view of what lib1090 configured.
+
+#include "testutil.h"
+#include "lib1090.h"
+
+static const char *frames_hex[] = {
+    "8D4840D6202CC371C32CE0576098",     // 4840D6 ident KLM1023
+    "8D40621D58C382D690C8AC2863A7",     // 40621D airborne position, even
+    "8D40621D58C386435CC412692AD6",     // 40621D airborne position, odd: 52.2658,3.9389
+    "8D485020994409940838175B284F",     // 485020 airborne velocity
+};
+#define NUM_FRAMES (sizeof(frames_hex) / sizeof(frames_hex[0]))
+
+static unsigned callbacks;
+static bool saw_callsign;
+
+static void onMessage(struct modesMessage *mm, struct aircraft *a, void *udata)
+{
+    struct lib1090Aircraft info;
+
+    ++callbacks;
+    if (udata != &callbacks)
+        fail("callback got the wrong udata");
+    if (!a) {
+        fail("callback for %06x without an aircraft", mm->addr);
+        return;
+    }
+    lib1090AircraftInfo(a, &info);
+    if (info.addr != mm->addr)
+        fail("callback aircraft %06x for a message from %06x", info.addr, mm->addr);
+    if (info.addr == 0x4840D6 && info.callsign_valid && !strcmp(info.callsign, "KLM1023 "))
+        saw_callsign = true;
+}
+
+// Decode the test frames in one batch, 1s apart; returns what
+// lib1090CtxHandleFrames returned
+static ssize_t decodeAll(struct lib1090Context *ctx, int *status, bool writeToPipe)
+{
+    unsigned char msgs[NUM_FRAMES][MODES_LONG_MSG_BYTES];
+    struct lib1090Frame frames[NUM_FRAMES];
+    struct modesMessage mms[NUM_FRAMES];
+
+    for (unsigned i = 0; i < NUM_FRAMES; ++i) {
+        fromHex(frames_hex[i], msgs[i]);
+        frames[i].frame = msgs[i];
+        frames[i].timestamp = 1000 * (i + 1);
+        frames[i].signalLevel = 0.25;
+    }
+
+    return lib1090CtxHandleFrames(ctx, mms, frames, NUM_FRAMES, status, writeToPipe);
+}
+
+int main(int argc, char **argv)
+{
+    MODES_NOTUSED(argc);
+    MODES_NOTUSED(argv);
+
+    struct lib1090Config_t config;
+    memset(&config, 0, sizeof(config));
+    config.quiet = 1;
+
+    struct lib1090Context *ctx = lib1090CreateContext(&config);
+    struct lib1090Context *other = lib1090CreateContext(&config);
+    if (!ctx || !other) {
+        fail("lib1090CreateContext failed");
+        return testsFinished();
+    }
+
+    // lib1090.c and the decoder must agree on the instance layout
+    struct lib1090Context *previous = lib1090BindContext(ctx);
+    if (Modes.mode_ac != 1 || Modes.mode_ac_auto != 0 || Modes.dc_filter != 1 || Modes.json_dir || !Modes.check_crc)
+        fail("decoder sees mode_ac=%d mode_ac_auto=%d dc_filter=%d json_dir=%s check_crc=%d",
+             Modes.mode_ac, Modes.mode_ac_auto, Modes.dc_filter, Modes.json_dir ? Modes.json_dir : "NULL", Modes.check_crc);
+    lib1090BindContext(previous);
+
+    lib1090SetMessageCallback(ctx, onMessage, &callbacks);
+
+    int status[NUM_FRAMES];
+    ssize_t produced = decodeAll(ctx, status, false);
+    if (produced != (ssize_t) NUM_FRAMES)
+        fail("lib1090CtxHandleFrames accepted %zd messages, expected %u", produced, (unsigned) NUM_FRAMES);
+    for (unsigned i = 0; i < NUM_FRAMES; ++i) {
+        if (status[i] != 0)
+            fail("frame %u: status %d", i, status[i]);
+    }
+
+    // one frame that can't be repaired
+    unsigned char bad[MODES_LONG_MSG_BYTES];
+    struct modesMessage mm;
+    fromHex(frames_hex[0], bad);
+    bad[5] ^= 0x5a;
+    bad[9] ^= 0xa5;
+    if (lib1090CtxDecodeFrame(ctx, &mm, bad, 5000, 0.25) != -2)
+        fail("damaged frame accepted");
+
+    struct lib1090Aircraft a;
+    if (!lib1090GetAircraft(ctx, 0x4840D6, &a))
+        fail("4840D6 not tracked");
+    else if (!a.callsign_valid || strcmp(a.callsign, "KLM1023 ") || a.messages != 1)
+        fail("4840D6: callsign '%s' (valid %d), %ld messages", a.callsign, a.callsign_valid, a.messages);
+
+    if (!lib1090GetAircraft(ctx, 0x40621D, &a))
+        fail("40621D not tracked");
+    else if (!a.position_valid || fabs(a.lat - 52.2658) > 1e-4 || fabs(a.lon - 3.9389) > 1e-4 ||
+             !a.altitude_baro_valid || a.altitude_baro != 38000)
+        fail("40621D: position %.4f,%.4f (valid %d), altitude %d (valid %d)",
+             a.lat, a.lon, a.position_valid, a.altitude_baro, a.altitude_baro_valid);
+
+    if (!lib1090GetAircraft(ctx, 0x485020, &a))
+        fail("485020 not tracked");
+    else if (!a.gs_valid || fabs(a.gs - 159.2) > 0.1 || !a.track_valid || fabs(a.track - 182.9) > 0.1)
+        fail("485020: gs %.1f (valid %d), track %.1f (valid %d)", a.gs, a.gs_valid, a.track, a.track_valid);
+
+    struct lib1090Stats st;
+    lib1090GetStats(ctx, &st);
+    if (st.messages != NUM_FRAMES || st.accepted != NUM_FRAMES || st.rejected_bad != 1 || st.aircraft != 3)
+        fail("stats: %llu messages, %llu accepted, %llu bad, %u aircraft",
+             (unsigned long long) st.messages, (unsigned long long) st.accepted,
+             (unsigned long long) st.rejected_bad, st.aircraft);
+
+    if (callbacks != NUM_FRAMES || !saw_callsign)
+        fail("%u callbacks, callsign seen %d", callbacks, saw_callsign);
+
+    // contexts are independent
+    lib1090GetStats(other, &st);
+    if (st.messages || st.aircraft || lib1090GetAircraft(other, 0x4840D6, &a))
+        fail("other context saw the first one's messages");
+
+    // asking for Beast output without a pipe fails before decoding anything
+    if (decodeAll(other, status, true) != -1)
+        fail("writing to a context without a pipe did not fail");
+    lib1090GetStats(other, &st);
+    if (st.messages)
+        fail("frames decoded although there was no pipe to write them to");
+
+    decodeAll(other, status, false);
+    lib1090GetStats(other, &st);
+    if (st.messages != NUM_FRAMES || st.aircraft != 3)
+        fail("other context: %llu messages, %u aircraft", (unsigned long long) st.messages, st.aircraft);
+    if (callbacks != NUM_FRAMES)
+        fail("first context's callback ran for the other context");
+
+    // periodic work rolls the statistics over without losing the totals
+    lib1090CtxPeriodicWork(ctx);
+    lib1090GetStats(ctx, &st);
+    if (st.messages != NUM_FRAMES)
+        fail("stats after periodic work: %llu messages", (unsigned long long) st.messages);
+
+    lib1090FreeContext(other);
+    lib1090FreeContext(ctx);
+    return testsFinished();
+}
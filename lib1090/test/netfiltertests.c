@@ -0,0 +1,124 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// netfiltertests.c - tests for the per-connection output filters
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "testutil.h"
+
+// Specs that must be rejected outright
+static void testMalformed(void)
+{
+    static const char *specs[] = {
+        "icao", "icao=", "icao=zz", "icao=4840D6,", "icao=,4840D6",
+        "icao=1000000", "icao=-1", "df=32", "df=1.5", "df=17;18",
+        "bbox=1,2,3", "bbox=1,2,3,4,5", "bbox=91,0,0,0", "bbox=0,181,0,0",
+        "signal=3", "signal=nan", "signal=-20dB", "squawk=7700",
+        "df=17 bogus",
+    };
+
+    for (size_t i = 0; i < sizeof(specs) / sizeof(specs[0]); ++i) {
+        int error;
+        struct net_filter *f = netFilterParse(specs[i], &error);
+        if (f || !error)
+            fail("\"%s\": accepted", specs[i]);
+        netFilterFree(f);
+    }
+
+    // these match everything, so there is no filter at all
+    static const char *empty[] = { "", "   ", "\t" };
+    for (size_t i = 0; i < sizeof(empty) / sizeof(empty[0]); ++i) {
+        int error;
+        struct net_filter *f = netFilterParse(empty[i], &error);
+        if (f || error)
+            fail("\"%s\": not an empty filter", empty[i]);
+        netFilterFree(f);
+    }
+}
+
+struct match_case {
+    const char *spec;
+    int df;
+    uint32_t addr;
+    double signal;
+    int have_pos;       // 1 = in the message, 2 = only on the aircraft
+    double lat, lon;
+    int expected;
+};
+
+static void testMatch(void)
+{
+    static const struct match_case cases[] = {
+        { "icao=4840D6",                     17, 0x4840D6, 0.1, 0, 0, 0, 1 },
+        { "icao=4840d6,40621D,A05F21",       17, 0x40621D, 0.1, 0, 0, 0, 1 },
+        { "icao=4840D6,40621D",              17, 0x485020, 0.1, 0, 0, 0, 0 },
+        { "icao=4840D6",                     17, 0x4840D6 | MODES_NON_ICAO_ADDRESS, 0.1, 0, 0, 0, 0 },
+        { "df=17,18",                        18, 0x4840D6, 0.1, 0, 0, 0, 1 },
+        { "df=17,18",                        11, 0x4840D6, 0.1, 0, 0, 0, 0 },
+        { "df=0",                            32, 0x4840D6, 0.1, 0, 0, 0, 0 },
+        { "signal=-20",                      17, 0x4840D6, 0.011, 0, 0, 0, 1 },
+        { "signal=-20",                      17, 0x4840D6, 0.009, 0, 0, 0, 0 },
+        { "bbox=52,3,53,5",                  17, 0x4840D6, 0.1, 1, 52.5, 4, 1 },
+        { "bbox=53,3,52,5",                  17, 0x4840D6, 0.1, 2, 52.5, 4, 1 },
+        { "bbox=52,3,53,5",                  17, 0x4840D6, 0.1, 1, 51.9, 4, 0 },
+        { "bbox=52,3,53,5",                  17, 0x4840D6, 0.1, 0, 0, 0, 0 },
+        { "bbox=-10,170,10,-170",            17, 0x4840D6, 0.1, 1, 0, 179, 1 },
+        { "bbox=-10,170,10,-170",            17, 0x4840D6, 0.1, 1, 0, -175, 1 },
+        { "bbox=-10,170,10,-170",            17, 0x4840D6, 0.1, 1, 0, 0, 0 },
+        { "icao=4840D6 df=17 signal=-20",    17, 0x4840D6, 0.1, 0, 0, 0, 1 },
+        { "icao=4840D6 df=17 signal=-20",    17, 0x4840D6, 0.001, 0, 0, 0, 0 },
+        { "  icao=4840D6   df=11 ",          17, 0x4840D6, 0.1, 0, 0, 0, 0 },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        const struct match_case *t = &cases[i];
+        static struct modesMessage mm;
+        static struct aircraft a;
+        int error;
+
+        memset(&mm, 0, sizeof(mm));
+        memset(&a, 0, sizeof(a));
+        mm.msgtype = t->df;
+        mm.addr = t->addr;
+        mm.signalLevel = t->signal;
+        if (t->have_pos == 1) {
+            mm.cpr_decoded = 1;
+            mm.decoded_lat = t->lat;
+            mm.decoded_lon = t->lon;
+        } else if (t->have_pos == 2) {
+            a.position_valid.source = SOURCE_ADSB;
+            a.position_valid.expires = UINT64_MAX;
+            a.lat = t->lat;
+            a.lon = t->lon;
+        }
+
+        struct net_filter *f = netFilterParse(t->spec, &error);
+        if (!f) {
+            fail("\"%s\": rejected", t->spec);
+            continue;
+        }
+        if (netFilterMatch(f, &mm, &a) != t->expected) {
+            fail("\"%s\": case %zu: expected %s", t->spec, i, t->expected ? "a match" : "no match");
+        }
+        netFilterFree(f);
+    }
+}
+
+int main(void)
+{
+    testMalformed();
+    testMatch();
+
+    return testsFinished();
+}
@@ -0,0 +1,548 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// pipelinebench.c - per-stage throughput of the receive pipeline
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Feeds synthetic IQ (fixed seed, so the same on every run) and any UC8
+// sample files given on the command line through each stage of the
+// pipeline in turn. Files at another rate (--input-rate) are resampled
+// to 2.4MHz first, outside the timings. The stages are:
+//
+//   convert                 UC8 IQ to magnitude, one block at a time
+//   demodulate2400          preamble search, slicing, scoring and
+//                           decodeModesHeader; nothing downstream
+//   decodeModesMessage      full decode of the frames demod accepted
+//   trackUpdateFromMessage  the decoded messages, as if the input was
+//                           played in a loop
+//   output_<format>         each per-message network output format on
+//                           its own, writing to a /dev/null client
+//   aircraft_json           generateAircraftJson over the tracked
+//                           aircraft (a "message" is one aircraft here)
+//
+// Each stage is repeated until it has used --min-time seconds of CPU.
+// Progress goes to stderr; the results go to stdout (or --output) as one
+// JSON object with, per input and stage, ns/sample (of input), ns/message
+// and messages/s.
+//
+// usage: pipelinebench [--min-time <seconds>] [--input-rate <Hz>] [--output <file>] [--no-synthetic] [file.bin ...]
+
+#include "testutil.h"
+
+#include <fcntl.h>
+
+#define SYNTHETIC_SAMPLES (10 * MODES_MAG_BUF_SAMPLES)
+#define SYNTHETIC_SEED    0x1090
+
+// Extended squitters in the synthetic input, as hex; DF11, DF4 and DF20
+// frames for two of the same aircraft are built at startup
+static const char *es_hex[] = {
+    "8D4840D6202CC371C32CE0576098",  // DF17 identification
+    "8D40621D58C382D690C8AC2863A7",  // DF17 airborne position, even
+    "8D40621D58C386435CC412692AD6",  // DF17 airborne position, odd
+    "8D485020994409940838175B284F",  // DF17 airborne velocity
+    "8DA05F219B06B6AF189400CBC33F",  // DF17 airborne velocity (airspeed)
+};
+
+#define NUM_ES (sizeof(es_hex) / sizeof(es_hex[0]))
+#define NUM_FRAMES (NUM_ES + 4)
+
+// Captured from the demodulator, before decoding
+struct frame {
+    unsigned char msg[MODES_LONG_MSG_BYTES];
+    uint64_t timestampMsg;
+    uint64_t sysTimestampMsg;
+    double signalLevel;
+    int score;
+};
+
+struct bench_input {
+    const char *name;
+    uint8_t *iq;                    // UC8 samples
+    uint32_t samples;
+    uint16_t *mag;                  // trailing_samples of overlap, samples, trailing_samples of padding
+    uint64_t duration;              // ms
+
+    struct frame *frames;           // accepted by demodulate2400
+    unsigned frame_count, frame_alloc;
+
+    struct modesMessage *decoded;   // frames that decodeModesMessage accepted
+    struct modesMessage *tracked;   // the same after tracking (last pass)
+    struct aircraft **aircraft;     // what each of them updated (last pass)
+    unsigned decoded_count;
+    unsigned loop;                  // times the input has been fed to the tracker
+
+    enum net_output_format format;  // for the output_<format> stages
+};
+
+struct result {
+    const char *input;
+    char stage[32];
+    unsigned passes;
+    uint32_t samples;
+    unsigned messages;
+    double seconds;
+};
+
+static struct result *results;
+static unsigned result_count, result_alloc;
+static double min_time = 1.0;
+
+static void *xrealloc(void *p, size_t size)
+{
+    if (!(p = realloc(p, size ? size : 1))) {
+        fprintf(stderr, "pipelinebench: out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+//
+// Inputs
+//
+
+// Noise plus a mix of extended squitters, all-call and surveillance
+// replies at random levels and sub-sample offsets
+static void makeSynthetic(struct bench_input *in)
+{
+    unsigned char frames[NUM_FRAMES][MODES_LONG_MSG_BYTES];
+
+    for (unsigned f = 0; f < NUM_ES; ++f)
+        fromHex(es_hex[f], frames[f]);
+    makeAllCall(frames[NUM_ES], 0x4840D6);
+    makeAllCall(frames[NUM_ES + 1], 0x40621D);
+    makeAddressParity(frames[NUM_ES + 2], 4, 0x4840D6);
+    makeAddressParity(frames[NUM_ES + 3], 20, 0x40621D);
+
+    in->name = "synthetic";
+    in->samples = SYNTHETIC_SAMPLES;
+    in->iq = xrealloc(NULL, in->samples * 2);
+
+    float *envelope = xrealloc(NULL, in->samples * sizeof(float));
+    memset(envelope, 0, in->samples * sizeof(float));
+
+    rng_state = SYNTHETIC_SEED;
+    double t = 10.0;    // us
+    double end = in->samples / (Modes.sample_rate / 1e6) - 130.0;
+    while (t < end) {
+        const unsigned char *msg = frames[rng() % NUM_FRAMES];
+        int bits = modesMessageLenByType(msg[0] >> 3);
+        float amplitude = 15.0f + 100.0f * (float) rngUnit();
+
+        addFrame(envelope, in->samples, t, msg, bits, amplitude);
+
+        // about 2000 messages/s, with the odd overlap
+        t += 150.0 + 700.0 * rngUnit();
+    }
+
+    for (uint32_t n = 0; n < in->samples; ++n) {
+        double I = 127.5 + envelope[n] * 0.8 + 6.0 * (rngUnit() - 0.5);
+        double Q = 127.5 + envelope[n] * 0.6 + 6.0 * (rngUnit() - 0.5);
+        in->iq[n*2] = (uint8_t) fmin(255.0, fmax(0.0, I));
+        in->iq[n*2+1] = (uint8_t) fmin(255.0, fmax(0.0, Q));
+    }
+
+    free(envelope);
+}
+
+// Linear interpolation is crude, but good enough to turn a 2MHz capture
+// (such as testfiles/modes1.bin) into something demodulate2400 decodes
+static void resample(struct bench_input *in, double from_rate)
+{
+    double step = from_rate / Modes.sample_rate;
+    uint32_t samples = (uint32_t) ((in->samples - 1) / step);
+    uint8_t *iq = xrealloc(NULL, (size_t) samples * 2);
+
+    for (uint32_t n = 0; n < samples; ++n) {
+        double t = n * step;
+        uint32_t i = (uint32_t) t;
+        double f = t - i;
+        for (int c = 0; c < 2; ++c)
+            iq[n*2+c] = (uint8_t) (in->iq[i*2+c] * (1 - f) + in->iq[(i+1)*2+c] * f + 0.5);
+    }
+
+    free(in->iq);
+    in->iq = iq;
+    in->samples = samples;
+}
+
+static int readInput(struct bench_input *in, const char *path, double rate)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 0;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f) & ~1L;
+    fseek(f, 0, SEEK_SET);
+
+    in->name = path;
+    in->samples = len / 2;
+    in->iq = xrealloc(NULL, len);
+    if (in->samples < 2 || fread(in->iq, 1, len, f) != (size_t) len) {
+        fprintf(stderr, "%s: short read\n", path);
+        fclose(f);
+        return 0;
+    }
+    fclose(f);
+
+    if (rate != Modes.sample_rate)
+        resample(in, rate);
+    return 1;
+}
+
+static void prepareInput(struct bench_input *in)
+{
+    size_t len = (size_t) in->samples + 2 * Modes.trailing_samples;
+    in->mag = xrealloc(NULL, len * sizeof(uint16_t));
+    memset(in->mag, 0, len * sizeof(uint16_t));
+    in->duration = (uint64_t) (in->samples * 1000.0 / Modes.sample_rate) + 1;
+}
+
+// Fresh tracker, so each input is measured on its own aircraft
+static void resetTracker(void)
+{
+    while (Modes.aircrafts) {
+        struct aircraft *next = Modes.aircrafts->next;
+        free(Modes.aircrafts);
+        Modes.aircrafts = next;
+    }
+    Modes.fatsv_dirty = NULL;
+    icaoFilterInit();
+}
+
+//
+// Stages; each does one pass over the input and returns the number of
+// messages it handled
+//
+
+typedef unsigned (*stage_fn)(struct bench_input *in);
+
+static unsigned stageConvert(struct bench_input *in)
+{
+    struct converter_state *state;
+    iq_convert_fn converter = init_converter(INPUT_UC8, Modes.sample_rate, Modes.dc_filter, &state);
+    if (!converter) {
+        fprintf(stderr, "pipelinebench: can't initialize converter\n");
+        exit(1);
+    }
+
+    for (uint32_t start = 0; start < in->samples; start += MODES_MAG_BUF_SAMPLES) {
+        uint32_t len = in->samples - start;
+        double mean_level, mean_power;
+        if (len > MODES_MAG_BUF_SAMPLES)
+            len = MODES_MAG_BUF_SAMPLES;
+        converter(in->iq + start * 2, in->mag + Modes.trailing_samples + start, len, state, &mean_level, &mean_power);
+    }
+
+    cleanup_converter(state);
+    return 0;
+}
+
+// Feed the magnitude data to demodulate2400 a block at a time, as the
+// reader thread would
+static unsigned demodulateAll(struct bench_input *in)
+{
+    unsigned before = Modes.stats_current.messages_total;
+    uint64_t sys = mstime();
+
+    for (uint32_t start = 0; start < in->samples; start += MODES_MAG_BUF_SAMPLES) {
+        struct mag_buf mag;
+        memset(&mag, 0, sizeof(mag));
+        mag.data = in->mag + start;
+        mag.length = in->samples - start;
+        if (mag.length > MODES_MAG_BUF_SAMPLES)
+            mag.length = MODES_MAG_BUF_SAMPLES;
+        mag.sampleTimestamp = start * 12e6 / Modes.sample_rate;
+        mag.sysTimestamp = sys + start * 1000.0 / Modes.sample_rate;
+        mag.mean_power = 1e-4;
+        demodulate2400(&mag);
+    }
+
+    return Modes.stats_current.messages_total - before;
+}
+
+static unsigned stageDemodulate(struct bench_input *in)
+{
+    return demodulateAll(in);
+}
+
+static void captureFrame(struct modesMessage *mm, struct aircraft *a, void *udata)
+{
+    struct bench_input *in = udata;
+    MODES_NOTUSED(a);
+
+    if (in->frame_count == in->frame_alloc) {
+        in->frame_alloc = in->frame_alloc ? in->frame_alloc * 2 : 1024;
+        in->frames = xrealloc(in->frames, in->frame_alloc * sizeof(*in->frames));
+    }
+
+    struct frame *f = &in->frames[in->frame_count++];
+    memcpy(f->msg, mm->verbatim, sizeof(f->msg));
+    f->timestampMsg = mm->timestampMsg;
+    f->sysTimestampMsg = mm->sysTimestampMsg;
+    f->signalLevel = mm->signalLevel;
+    f->score = mm->score;
+}
+
+static unsigned stageDecode(struct bench_input *in)
+{
+    unsigned n = 0;
+
+    for (unsigned i = 0; i < in->frame_count; ++i) {
+        struct frame *f = &in->frames[i];
+        struct modesMessage *mm = &in->decoded[n];
+
+        modesInitMessage(mm);
+        mm->timestampMsg = f->timestampMsg;
+        mm->sysTimestampMsg = f->sysTimestampMsg;
+        mm->signalLevel = f->signalLevel;
+        mm->score = f->score;
+        if (decodeModesMessage(mm, f->msg) >= 0)
+            ++n;
+    }
+
+    in->decoded_count = n;
+    return n;
+}
+
+static unsigned stageTrack(struct bench_input *in)
+{
+    uint64_t shift = ++in->loop * in->duration;
+
+    for (unsigned i = 0; i < in->decoded_count; ++i) {
+        struct modesMessage *mm = &in->tracked[i];
+        *mm = in->decoded[i];
+        mm->sysTimestampMsg += shift;
+        mm->timestampMsg += shift * 12000;
+        in->aircraft[i] = trackUpdateFromMessage(mm);
+    }
+
+    return in->decoded_count;
+}
+
+static unsigned stageOutput(struct bench_input *in)
+{
+    Modes.net_output_dispatch[0] = in->format;
+    Modes.net_output_dispatch_count = 1;
+
+    for (unsigned i = 0; i < in->decoded_count; ++i)
+        modesQueueOutput(&in->tracked[i], in->aircraft[i]);
+
+    return in->decoded_count;
+}
+
+static unsigned stageAircraftJson(struct bench_input *in)
+{
+    unsigned count = 0;
+    int len;
+    MODES_NOTUSED(in);
+
+    free(generateAircraftJson(NULL, &len));
+    for (struct aircraft *a = Modes.aircrafts; a; a = a->next) {
+        if (a->reliable)
+            ++count;
+    }
+    return count;
+}
+
+// One untimed pass, then passes until min_time of CPU has been used
+static void runStage(struct bench_input *in, const char *stage, stage_fn fn)
+{
+    struct timespec total = { 0, 0 };
+    unsigned passes = 0, messages;
+
+    fprintf(stderr, "%s: %s ", in->name, stage);
+    messages = fn(in);
+
+    do {
+        struct timespec start;
+        start_cpu_timing(&start);
+        messages = fn(in);
+        end_cpu_timing(&start, &total);
+        ++passes;
+    } while (total.tv_sec + total.tv_nsec / 1e9 < min_time);
+
+    if (result_count == result_alloc) {
+        result_alloc = result_alloc ? result_alloc * 2 : 32;
+        results = xrealloc(results, result_alloc * sizeof(*results));
+    }
+    struct result *r = &results[result_count++];
+    r->input = in->name;
+    snprintf(r->stage, sizeof(r->stage), "%s", stage);
+    r->passes = passes;
+    r->samples = in->samples;
+    r->messages = messages;
+    r->seconds = total.tv_sec + total.tv_nsec / 1e9;
+
+    fprintf(stderr, "%u passes, %.0f messages/s\n", passes, messages ? messages * passes / r->seconds : 0.0);
+}
+
+// Output clients for every per-message format, writing to /dev/null
+static void openOutputs(void)
+{
+    struct {
+        const char *descr;
+        struct net_writer *writer;
+    } outputs[] = {
+        { "Basestation benchmark output", &Modes.sbs_out },
+        { "Raw benchmark output", &Modes.raw_out },
+        { "Beast benchmark output (verbatim mode)", &Modes.beast_verbatim_out },
+        { "Beast benchmark output (cooked mode)", &Modes.beast_cooked_out },
+        { "FATSV benchmark output", &Modes.fatsv_out },
+    };
+
+    for (size_t i = 0; i < sizeof(outputs) / sizeof(outputs[0]); ++i) {
+        struct net_service *s = serviceInit(outputs[i].descr, outputs[i].writer, NULL, READ_MODE_IGNORE, NULL, NULL);
+        int fd = open("/dev/null", O_WRONLY);
+        if (fd < 0) {
+            perror("/dev/null");
+            exit(1);
+        }
+        createGenericClient(s, fd);
+    }
+}
+
+static void benchInput(struct bench_input *in)
+{
+    resetTracker();
+    prepareInput(in);
+
+    runStage(in, "convert", stageConvert);
+    runStage(in, "demodulate2400", stageDemodulate);
+
+    // Keep what the demodulator accepted, for the later stages
+    modesSetMessageSink(captureFrame, in);
+    demodulateAll(in);
+    modesSetMessageSink(NULL, NULL);
+
+    if (!in->frame_count) {
+        fprintf(stderr, "%s: nothing decoded, skipping the later stages\n", in->name);
+        goto done;
+    }
+
+    in->decoded = xrealloc(NULL, in->frame_count * sizeof(*in->decoded));
+    in->tracked = xrealloc(NULL, in->frame_count * sizeof(*in->tracked));
+    in->aircraft = xrealloc(NULL, in->frame_count * sizeof(*in->aircraft));
+
+    runStage(in, "decodeModesMessage", stageDecode);
+    runStage(in, "trackUpdateFromMessage", stageTrack);
+
+    for (int f = 0; f < NET_OUTPUT_FORMATS; ++f) {
+        char stage[32];
+        snprintf(stage, sizeof(stage), "output_%s", netOutputFormatName(f));
+        in->format = f;
+        runStage(in, stage, stageOutput);
+    }
+
+    runStage(in, "aircraft_json", stageAircraftJson);
+
+ done:
+    free(in->iq);
+    free(in->mag);
+    free(in->frames);
+    free(in->decoded);
+    free(in->tracked);
+    free(in->aircraft);
+}
+
+static void printResults(FILE *out)
+{
+    fprintf(out, "{\n  \"version\": \"%s\",\n  \"min_time\": %.3f,\n  \"results\": [",
+            MODES_DUMP1090_VARIANT " " MODES_DUMP1090_VERSION, min_time);
+
+    for (unsigned i = 0; i < result_count; ++i) {
+        struct result *r = &results[i];
+        double ns = r->seconds * 1e9 / r->passes;
+
+        fprintf(out, "%s\n    {\"input\": \"", i ? "," : "");
+        for (const char *c = r->input; *c; ++c) {
+            if (*c == '"' || *c == '\\' || (unsigned char) *c < 32)
+                fprintf(out, "\\u%04x", (unsigned char) *c);
+            else
+                fputc(*c, out);
+        }
+        fprintf(out, "\", \"stage\": \"%s\", \"passes\": %u, \"seconds\": %.6f, \"samples\": %u, \"messages\": %u, \"ns_per_sample\": %.4f",
+                r->stage, r->passes, r->seconds, r->samples, r->messages, ns / r->samples);
+        if (r->messages)
+            fprintf(out, ", \"ns_per_message\": %.2f, \"messages_per_second\": %.0f", ns / r->messages, r->messages * 1e9 / ns);
+        else
+            fprintf(out, ", \"ns_per_message\": null, \"messages_per_second\": null");
+        fprintf(out, "}");
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+}
+
+int main(int argc, char **argv)
+{
+    int synthetic = 1;
+    double input_rate = 0;
+    const char *output = NULL;
+    int j;
+
+    for (j = 1; j < argc; ++j) {
+        if (!strcmp(argv[j], "--min-time") && j + 1 < argc) {
+            min_time = atof(argv[++j]);
+        } else if (!strcmp(argv[j], "--input-rate") && j + 1 < argc) {
+            input_rate = atof(argv[++j]);
+        } else if (!strcmp(argv[j], "--output") && j + 1 < argc) {
+            output = argv[++j];
+        } else if (!strcmp(argv[j], "--no-synthetic")) {
+            synthetic = 0;
+        } else if (argv[j][0] == '-' && argv[j][1] == '-') {
+            fprintf(stderr, "usage: pipelinebench [--min-time <seconds>] [--input-rate <Hz>] [--output <file>] [--no-synthetic] [file.bin ...]\n");
+            return 1;
+        } else {
+            break;
+        }
+    }
+
+    modesInitConfig();
+    Modes.quiet = 1;
+    modesInit();
+    openOutputs();
+    if (input_rate <= 0)
+        input_rate = Modes.sample_rate;
+
+    if (synthetic) {
+        struct bench_input in;
+        memset(&in, 0, sizeof(in));
+        makeSynthetic(&in);
+        benchInput(&in);
+    }
+
+    for (; j < argc; ++j) {
+        struct bench_input in;
+        memset(&in, 0, sizeof(in));
+        if (!readInput(&in, argv[j], input_rate))
+            return 1;
+        benchInput(&in);
+    }
+
+    if (output) {
+        FILE *out = fopen(output, "w");
+        if (!out) {
+            fprintf(stderr, "%s: %s\n", output, strerror(errno));
+            return 1;
+        }
+        printResults(out);
+        fclose(out);
+    } else {
+        printResults(stdout);
+    }
+    return 0;
+}
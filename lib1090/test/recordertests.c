@@ -0,0 +1,230 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// recordertests.c - tests for --record files and their replay by --ifile
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "testutil.h"
+#include "sdr_ifile.h"
+
+#include <zlib.h>
+
+// A little over three blocks of UC8 samples
+#define SAMPLES (3 * MODES_MAG_BUF_SAMPLES + 1234)
+#define CHUNK_BYTES 65536
+
+// A recording made in two frames, with this many samples lost between them
+#define GAP_AT (MODES_MAG_BUF_SAMPLES + 5000)
+#define GAP 7777
+
+static uint8_t iq[SAMPLES * 2];
+static uint16_t mag[SAMPLES];       // what the converter makes of iq
+
+struct replay {
+    struct receiver *rx;
+    int done;                       // ifileRun has returned
+};
+
+static void *replayThread(void *arg)
+{
+    struct replay *replay = arg;
+
+    modesSetCurrent(replay->rx->modes);
+    ifileRun(replay->rx);
+
+    pthread_mutex_lock(&Modes.data_mutex);
+    replay->done = 1;
+    pthread_cond_broadcast(&Modes.data_cond);
+    pthread_mutex_unlock(&Modes.data_mutex);
+    return NULL;
+}
+
+// Replay 'path' and check every block against mag[]: the samples, the
+// sample clock, and the overlap copied from the block before. Samples
+// from 'gap_at' on are expected 'gap' samples later. Returns the number
+// of samples replayed.
+static uint64_t replay(const char *path, uint64_t gap_at, uint64_t gap)
+{
+    struct receiver *rx = &Modes.receivers[0];
+    struct replay r = { rx, 0 };
+    pthread_t thread;
+    uint64_t pos = 0, replayed = 0, dropped = 0;
+
+    Modes.num_receivers = 0;
+    sdrAddReceiver(path);
+    if (!ifileOpen(rx)) {
+        fail("ifileOpen(%s) failed", path);
+        return 0;
+    }
+    for (int i = 0; i < MODES_MAG_BUFFERS; ++i) {
+        rx->mag_buffers[i].data = calloc(MODES_MAG_BUF_SAMPLES + Modes.trailing_samples, sizeof(uint16_t));
+        rx->mag_buffers[i].length = 0;
+        rx->mag_buffers[i].dropped = 0;
+    }
+    rx->first_free_buffer = rx->first_filled_buffer = 0;
+
+    pthread_create(&thread, NULL, replayThread, &r);
+
+    pthread_mutex_lock(&Modes.data_mutex);
+    for (;;) {
+        if (rx->first_filled_buffer == rx->first_free_buffer) {
+            if (r.done)
+                break;
+            pthread_cond_wait(&Modes.data_cond, &Modes.data_mutex);
+            continue;
+        }
+
+        struct mag_buf *buf = &rx->mag_buffers[rx->first_filled_buffer];
+        pthread_mutex_unlock(&Modes.data_mutex);
+
+        pos += buf->dropped;
+        dropped += buf->dropped;
+        if (buf->sampleTimestamp != (uint64_t) (pos * 12e6 / Modes.sample_rate))
+            fail("block at sample %llu has timestamp %llu", (unsigned long long) pos, (unsigned long long) buf->sampleTimestamp);
+
+        // the overlap must be the samples just before, or zero after a gap
+        uint64_t recorded = (pos >= gap_at + gap ? pos - gap : pos);
+        for (unsigned i = 0; i < Modes.trailing_samples; ++i) {
+            uint16_t expected = 0;
+            if (!buf->dropped && replayed > 0)
+                expected = mag[recorded - Modes.trailing_samples + i];
+            if (buf->data[i] != expected) {
+                fail("block at sample %llu: wrong overlap", (unsigned long long) pos);
+                break;
+            }
+        }
+
+        for (unsigned i = 0; i < buf->length; ++i) {
+            if (recorded + i >= SAMPLES || buf->data[Modes.trailing_samples + i] != mag[recorded + i]) {
+                fail("block at sample %llu: wrong sample %u", (unsigned long long) pos, i);
+                break;
+            }
+        }
+        if (gap && recorded < gap_at && recorded + buf->length > gap_at)
+            fail("block at sample %llu spans the gap", (unsigned long long) pos);
+
+        pos += buf->length;
+        replayed += buf->length;
+
+        pthread_mutex_lock(&Modes.data_mutex);
+        rx->first_filled_buffer = (rx->first_filled_buffer + 1) % MODES_MAG_BUFFERS;
+        pthread_cond_broadcast(&Modes.data_cond);
+    }
+    pthread_mutex_unlock(&Modes.data_mutex);
+    pthread_join(thread, NULL);
+
+    if (dropped != gap)
+        fail("%s: %llu samples dropped, expected %llu", path, (unsigned long long) dropped, (unsigned long long) gap);
+
+    ifileClose(rx);
+    for (int i = 0; i < MODES_MAG_BUFFERS; ++i) {
+        free(rx->mag_buffers[i].data);
+        rx->mag_buffers[i].data = NULL;
+    }
+    free(rx->dev_name);
+    rx->dev_name = NULL;
+    return replayed;
+}
+
+// Write one frame of samples [first, first + count) of iq[] as 'first_sample'
+static void writeFrame(FILE *f, uint64_t first, uint64_t count, uint64_t first_sample)
+{
+    uLongf zlen = compressBound(count * 2);
+    uint8_t *z = malloc(zlen);
+    uint8_t header[RECORDER_FRAME_HEADER_SIZE];
+    struct recorder_frame frame;
+
+    compress2(z, &zlen, iq + first * 2, count * 2, Z_BEST_SPEED);
+    memcpy(header, RECORDER_FRAME_MAGIC, 4);
+    for (int i = 0; i < 4; ++i) {
+        header[4 + i] = (uint8_t) (zlen >> (8 * i));
+        header[8 + i] = (uint8_t) ((count * 2) >> (8 * i));
+    }
+    for (int i = 0; i < 8; ++i)
+        header[12 + i] = (uint8_t) (first_sample >> (8 * i));
+    if (!recorderParseFrameHeader(header, &frame) || frame.first_sample != first_sample)
+        fail("frame header does not parse");
+
+    fwrite(header, sizeof(header), 1, f);
+    fwrite(z, zlen, 1, f);
+    free(z);
+}
+
+int main(int argc, char **argv)
+{
+    MODES_NOTUSED(argc);
+    MODES_NOTUSED(argv);
+
+    char path[] = "/tmp/recordertests.XXXXXX";
+    char gap_path[] = "/tmp/recordertests.XXXXXX";
+    int fd = mkstemp(path), gap_fd = mkstemp(gap_path);
+    if (fd < 0 || gap_fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+
+    modesInitConfig();
+    Modes.quiet = 1;
+    Modes.sdr_type = SDR_IFILE;
+    Modes.trailing_samples = (MODES_PREAMBLE_US + MODES_LONG_MSG_BITS + 16) * 1e-6 * Modes.sample_rate;
+    pthread_mutex_init(&Modes.data_mutex, NULL);
+    pthread_cond_init(&Modes.data_cond, NULL);
+
+    rng_state = 0x1090;
+    for (size_t i = 0; i < sizeof(iq); ++i)
+        iq[i] = (uint8_t) rng();
+
+    struct converter_state *converter_state;
+    iq_convert_fn converter = init_converter(INPUT_UC8, Modes.sample_rate, 0, &converter_state);
+    double level, power;
+    converter(iq, mag, SAMPLES, converter_state, &level, &power);
+    cleanup_converter(converter_state);
+
+    // Record in chunks that don't line up with the replay blocks, then
+    // replay: the same samples with the same timestamps
+    struct receiver recording;
+    memset(&recording, 0, sizeof(recording));
+    if (!recorderOpen(&recording, path, INPUT_UC8, Modes.sample_rate)) {
+        fail("recorderOpen failed");
+        return testsFinished();
+    }
+    for (size_t at = 0; at < sizeof(iq); at += CHUNK_BYTES)
+        recorderWrite(recording.recorder, iq + at, (at + CHUNK_BYTES <= sizeof(iq) ? CHUNK_BYTES : sizeof(iq) - at));
+    recorderClose(&recording);
+
+    if (replay(path, SAMPLES, 0) != SAMPLES)
+        fail("round trip: wrong number of samples replayed");
+
+    // A recording that lost GAP samples after GAP_AT: the clock skips
+    // them, and nothing is spliced across
+    FILE *f = fdopen(gap_fd, "wb");
+    uint8_t header[RECORDER_HEADER_SIZE];
+    FILE *in = fopen(path, "rb");
+    if (!in || fread(header, sizeof(header), 1, in) != 1)
+        fail("could not read the recording header back");
+    if (in)
+        fclose(in);
+    fwrite(header, sizeof(header), 1, f);
+    writeFrame(f, 0, GAP_AT, 0);
+    writeFrame(f, GAP_AT, SAMPLES - GAP_AT, GAP_AT + GAP);
+    fclose(f);
+
+    if (replay(gap_path, GAP_AT, GAP) != SAMPLES)
+        fail("gap: wrong number of samples replayed");
+
+    unlink(path);
+    unlink(gap_path);
+    return testsFinished();
+}
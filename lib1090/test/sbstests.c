@@ -0,0 +1,363 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// sbstests.c - BaseStation output formatting tests
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Checks sbsFormatMessage against fixed golden lines, and against the
+// printf-based formatter it replaced for a large number of random messages.
+
+#include "dump1090.h"
+
+//
+// The formatter sbsFormatMessage replaced, as it was in modesSendSBSOutput
+//
+static char *refFormatMessage(char *p, int msgType, const struct modesMessage *mm,
+                              const struct aircraft *a, const struct timespec *now)
+{
+    struct tm stTime_receive, stTime_now;
+
+    p += sprintf(p, "MSG,%d,1,1,%06X,1,", msgType, mm->addr);
+
+    localtime_r(&now->tv_sec, &stTime_now);
+    time_t received = (time_t) (mm->sysTimestampMsg / 1000);
+    localtime_r(&received, &stTime_receive);
+
+    p += sprintf(p, "%04d/%02d/%02d,", (stTime_receive.tm_year+1900),(stTime_receive.tm_mon+1), stTime_receive.tm_mday);
+    p += sprintf(p, "%02d:%02d:%02d.%03u,", stTime_receive.tm_hour, stTime_receive.tm_min, stTime_receive.tm_sec, (unsigned) (mm->sysTimestampMsg % 1000));
+    p += sprintf(p, "%04d/%02d/%02d,", (stTime_now.tm_year+1900),(stTime_now.tm_mon+1), stTime_now.tm_mday);
+    p += sprintf(p, "%02d:%02d:%02d.%03u", stTime_now.tm_hour, stTime_now.tm_min, stTime_now.tm_sec, (unsigned) (now->tv_nsec / 1000000U));
+
+    if (mm->callsign_valid) {p += sprintf(p, ",%s", mm->callsign);}
+    else                    {p += sprintf(p, ",");}
+
+    if (Modes.use_gnss) {
+        if (mm->altitude_geom_valid) {
+            p += sprintf(p, ",%dH", mm->altitude_geom);
+        } else if (mm->altitude_baro_valid && trackDataValid(&a->geom_delta_valid)) {
+            p += sprintf(p, ",%dH", mm->altitude_baro + a->geom_delta);
+        } else if (mm->altitude_baro_valid) {
+            p += sprintf(p, ",%d", mm->altitude_baro);
+        } else {
+            p += sprintf(p, ",");
+        }
+    } else {
+        if (mm->altitude_baro_valid) {
+            p += sprintf(p, ",%d", mm->altitude_baro);
+        } else if (mm->altitude_geom_valid && trackDataValid(&a->geom_delta_valid)) {
+            p += sprintf(p, ",%d", mm->altitude_geom - a->geom_delta);
+        } else {
+            p += sprintf(p, ",");
+        }
+    }
+
+    if (mm->gs_valid) {
+        p += sprintf(p, ",%.0f", mm->gs.selected);
+    } else {
+        p += sprintf(p, ",");
+    }
+
+    if (mm->heading_valid && mm->heading_type == HEADING_GROUND_TRACK) {
+        p += sprintf(p, ",%.0f", mm->heading);
+    } else {
+        p += sprintf(p, ",");
+    }
+
+    if (mm->cpr_decoded) {
+        p += sprintf(p, ",%1.5f,%1.5f", mm->decoded_lat, mm->decoded_lon);
+    } else {
+        p += sprintf(p, ",,");
+    }
+
+    if (Modes.use_gnss) {
+        if (mm->geom_rate_valid) {
+            p += sprintf(p, ",%dH", mm->geom_rate);
+        } else if (mm->baro_rate_valid) {
+            p += sprintf(p, ",%d", mm->baro_rate);
+        } else {
+            p += sprintf(p, ",");
+        }
+    } else {
+        if (mm->baro_rate_valid) {
+            p += sprintf(p, ",%d", mm->baro_rate);
+        } else if (mm->geom_rate_valid) {
+            p += sprintf(p, ",%d", mm->geom_rate);
+        } else {
+            p += sprintf(p, ",");
+        }
+    }
+
+    if (mm->squawk_valid) {
+        p += sprintf(p, ",%04x", mm->squawk);
+    } else {
+        p += sprintf(p, ",");
+    }
+
+    if (mm->alert_valid) {
+        p += sprintf(p, mm->alert ? ",-1" : ",0");
+    } else {
+        p += sprintf(p, ",");
+    }
+
+    if (mm->squawk_valid) {
+        if ((mm->squawk == 0x7500) || (mm->squawk == 0x7600) || (mm->squawk == 0x7700)) {
+            p += sprintf(p, ",-1");
+        } else {
+            p += sprintf(p, ",0");
+        }
+    } else {
+        p += sprintf(p, ",");
+    }
+
+    if (mm->spi_valid) {
+        p += sprintf(p, mm->spi ? ",-1" : ",0");
+    } else {
+        p += sprintf(p, ",");
+    }
+
+    switch (mm->airground) {
+        case AG_GROUND:
+            p += sprintf(p, ",-1");
+            break;
+        case AG_AIRBORNE:
+            p += sprintf(p, ",0");
+            break;
+        default:
+            p += sprintf(p, ",");
+            break;
+    }
+
+    p += sprintf(p, "\r\n");
+    return p;
+}
+
+static int failures;
+
+static void check(const char *what, const char *got, const char *expected)
+{
+    if (strcmp(got, expected)) {
+        if (++failures <= 20)
+            fprintf(stderr, "FAIL: %s:\n  got      %s  expected %s", what, got, expected);
+    }
+}
+
+//
+// Golden lines, with TZ=UTC
+//
+static void testGolden(void)
+{
+    static struct aircraft a;
+    struct modesMessage mm;
+    struct timespec now = { 1700000000, 123456789 };   // 2023-11-14 22:13:20.123 UTC
+    char buf[SBS_MAX_LINE];
+
+    a.reliable = 1;
+
+    // DF17 identification
+    memset(&mm, 0, sizeof(mm));
+    mm.msgtype = 17; mm.metype = 4; mm.addr = 0x4840D6; mm.reliable = 1;
+    mm.sysTimestampMsg = 1699999999987ULL;
+    mm.callsign_valid = 1; strcpy(mm.callsign, "KLM1023 ");
+    mm.airground = AG_AIRBORNE;
+    *sbsFormatMessage(buf, sbsMessageType(&mm, &a), &mm, &a, &now) = 0;
+    check("identification", buf,
+          "MSG,1,1,1,4840D6,1,2023/11/14,22:13:19.987,2023/11/14,22:13:20.123,KLM1023 ,,,,,,,,,,,0\r\n");
+
+    // DF17 airborne position
+    memset(&mm, 0, sizeof(mm));
+    mm.msgtype = 17; mm.metype = 11; mm.addr = 0x40621D; mm.reliable = 1;
+    mm.sysTimestampMsg = 1700000000001ULL;
+    mm.altitude_baro_valid = 1; mm.altitude_baro = 38000;
+    mm.cpr_decoded = 1; mm.decoded_lat = 52.2572021484375; mm.decoded_lon = 3.9193725585937;
+    mm.airground = AG_AIRBORNE;
+    *sbsFormatMessage(buf, sbsMessageType(&mm, &a), &mm, &a, &now) = 0;
+    check("position", buf,
+          "MSG,3,1,1,40621D,1,2023/11/14,22:13:20.001,2023/11/14,22:13:20.123,,38000,,,52.25720,3.91937,,,,,,0\r\n");
+
+    // DF17 airborne velocity, negative rate, speed and track that round
+    memset(&mm, 0, sizeof(mm));
+    mm.msgtype = 17; mm.metype = 19; mm.addr = 0x485020; mm.reliable = 1;
+    mm.sysTimestampMsg = 1700000000120ULL;
+    mm.gs_valid = 1; mm.gs.selected = 159.5f;
+    mm.heading_valid = 1; mm.heading_type = HEADING_GROUND_TRACK; mm.heading = 182.5f;
+    mm.baro_rate_valid = 1; mm.baro_rate = -832;
+    *sbsFormatMessage(buf, sbsMessageType(&mm, &a), &mm, &a, &now) = 0;
+    check("velocity", buf,
+          "MSG,4,1,1,485020,1,2023/11/14,22:13:20.120,2023/11/14,22:13:20.123,,,160,182,,,-832,,,,,\r\n");
+
+    // DF5 identity reply, emergency squawk, SPI, alert, on the ground,
+    // southern/western hemisphere
+    memset(&mm, 0, sizeof(mm));
+    mm.msgtype = 5; mm.addr = 0x00A1B2; mm.reliable = 1;
+    mm.sysTimestampMsg = 1700000000000ULL;
+    mm.squawk_valid = 1; mm.squawk = 0x7700;
+    mm.alert_valid = 1; mm.alert = 1;
+    mm.spi_valid = 1; mm.spi = 0;
+    mm.cpr_decoded = 1; mm.decoded_lat = -33.9399185180664; mm.decoded_lon = -0.000001;
+    mm.airground = AG_GROUND;
+    *sbsFormatMessage(buf, sbsMessageType(&mm, &a), &mm, &a, &now) = 0;
+    check("identity", buf,
+          "MSG,6,1,1,00A1B2,1,2023/11/14,22:13:20.000,2023/11/14,22:13:20.123,,,,,-33.93992,-0.00000,,7700,-1,-1,0,-1\r\n");
+
+    // GNSS altitudes and rates
+    Modes.use_gnss = 1;
+    memset(&mm, 0, sizeof(mm));
+    mm.msgtype = 0; mm.addr = 0xABCDEF; mm.reliable = 1;
+    mm.sysTimestampMsg = 1700000000999ULL;
+    mm.altitude_geom_valid = 1; mm.altitude_geom = -75;
+    mm.geom_rate_valid = 1; mm.geom_rate = 64;
+    mm.squawk_valid = 1; mm.squawk = 0x1200;
+    *sbsFormatMessage(buf, sbsMessageType(&mm, &a), &mm, &a, &now) = 0;
+    check("gnss", buf,
+          "MSG,7,1,1,ABCDEF,1,2023/11/14,22:13:20.999,2023/11/14,22:13:20.123,,-75H,,,,,64H,1200,,0,,\r\n");
+    Modes.use_gnss = 0;
+
+    // Messages that are never sent as SBS
+    memset(&mm, 0, sizeof(mm));
+    mm.msgtype = 17; mm.metype = 0; mm.reliable = 1;
+    if (sbsMessageType(&mm, &a) != 0)
+        check("ES type 0", "sent\n", "not sent\n");
+    mm.metype = 11; mm.correctedbits = 2;
+    if (sbsMessageType(&mm, &a) != 0)
+        check("2-bit corrected", "sent\n", "not sent\n");
+    mm.correctedbits = 0; mm.addr = MODES_NON_ICAO_ADDRESS | 0x123456;
+    if (sbsMessageType(&mm, &a) != 0)
+        check("non-ICAO", "sent\n", "not sent\n");
+    mm.addr = 0x123456;
+    if (sbsMessageType(&mm, NULL) != 0)
+        check("untracked", "sent\n", "not sent\n");
+}
+
+static double randomDouble(double lo, double hi)
+{
+    return lo + (hi - lo) * (random() / (double) RAND_MAX);
+}
+
+// Values that land exactly on (or right next to) a rounding tie, as well
+// as arbitrary ones
+static double randomCoordinate(double range)
+{
+    switch (random() % 4) {
+    case 0:
+        return (random() % (long) (range * 200000) - range * 100000) / 100000.0 + 0.000005;
+    case 1:
+        return (random() % (long) (range * 2 * 131072) - range * 131072) / 131072.0;
+    case 2:
+        return nextafter(randomDouble(-range, range), 0);
+    default:
+        return randomDouble(-range, range);
+    }
+}
+
+static float randomSpeed(void)
+{
+    switch (random() % 3) {
+    case 0:
+        return (random() % 2000) / 2.0f;   // halves: ties to even
+    case 1:
+        return (random() % 8000) / 8.0f;
+    default:
+        return (float) randomDouble(0, 1000);
+    }
+}
+
+//
+// Random messages, compared with the printf formatter
+//
+static void testRandom(unsigned n)
+{
+    static struct aircraft a;
+    struct modesMessage mm;
+    char got[SBS_MAX_LINE], expected[SBS_MAX_LINE];
+    static const int types[] = { 0, 4, 5, 11, 16, 17, 18, 20, 21 };
+
+    a.reliable = 1;
+    Modes.message_now = 1700000000000ULL;
+
+    for (unsigned i = 0; i < n; ++i) {
+        struct timespec now;
+        int msgType;
+
+        memset(&mm, 0, sizeof(mm));
+        mm.msgtype = types[random() % (sizeof(types) / sizeof(types[0]))];
+        mm.metype = random() % 32;
+        mm.addr = random() & 0xFFFFFF;
+        mm.reliable = 1;
+        // a spread of times, with runs inside the same second
+        mm.sysTimestampMsg = 1600000000000ULL + (random() % 4 ? i * 37ULL : (uint64_t) random() * 1000ULL + random() % 1000);
+        now.tv_sec = mm.sysTimestampMsg / 1000 + random() % 2;
+        now.tv_nsec = random() % 1000000000;
+
+        if ((mm.callsign_valid = random() & 1))
+            snprintf(mm.callsign, sizeof(mm.callsign), "%c%c%c%04ld", 'A' + (int) (random() % 26), 'A' + (int) (random() % 26), 'A' + (int) (random() % 26), random() % 10000);
+        mm.altitude_baro_valid = random() & 1;
+        mm.altitude_baro = random() % 60000 - 2000;
+        mm.altitude_geom_valid = random() & 1;
+        mm.altitude_geom = random() % 60000 - 2000;
+        a.geom_delta = random() % 1000 - 500;
+        a.geom_delta_valid.source = (random() & 1) ? SOURCE_ADSB : SOURCE_INVALID;
+        a.geom_delta_valid.expires = Modes.message_now + 1000;
+        mm.gs_valid = random() & 1;
+        mm.gs.selected = randomSpeed();
+        mm.heading_valid = random() & 1;
+        mm.heading_type = (random() & 1) ? HEADING_GROUND_TRACK : HEADING_MAGNETIC;
+        mm.heading = randomSpeed();
+        mm.cpr_decoded = random() & 1;
+        mm.decoded_lat = randomCoordinate(90);
+        mm.decoded_lon = randomCoordinate(180);
+        mm.baro_rate_valid = random() & 1;
+        mm.baro_rate = random() % 12000 - 6000;
+        mm.geom_rate_valid = random() & 1;
+        mm.geom_rate = random() % 12000 - 6000;
+        mm.squawk_valid = random() & 1;
+        mm.squawk = (random() % 8) << 12 | (random() % 8) << 8 | (random() % 8) << 4 | (random() % 8);
+        mm.alert_valid = random() & 1;
+        mm.alert = random() & 1;
+        mm.spi_valid = random() & 1;
+        mm.spi = random() & 1;
+        mm.airground = random() % 4;
+        Modes.use_gnss = random() & 1;
+
+        if (!(msgType = sbsMessageType(&mm, &a)))
+            continue;
+
+        *sbsFormatMessage(got, msgType, &mm, &a, &now) = 0;
+        *refFormatMessage(expected, msgType, &mm, &a, &now) = 0;
+        check("random message", got, expected);
+    }
+
+    Modes.use_gnss = 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned n = (argc > 1 ? strtoul(argv[1], NULL, 10) : 200000);
+
+    setenv("TZ", "UTC", 1);
+    tzset();
+    srandom(1);
+
+    modesInitConfig();
+
+    testGolden();
+    testRandom(n);
+
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+
+    fprintf(stderr, "all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,203 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// statetests.c - tests for tracker state snapshots
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "testutil.h"
+
+// Fresh tracker state on the current instance
+static void resetTracker(void)
+{
+    while (Modes.aircrafts) {
+        struct aircraft *next = Modes.aircrafts->next;
+        free(Modes.aircrafts);
+        Modes.aircrafts = next;
+    }
+    Modes.fatsv_dirty = NULL;
+    memset(Modes.modeAC_count, 0, sizeof(Modes.modeAC_count));
+    memset(Modes.modeAC_age, 0, sizeof(Modes.modeAC_age));
+    icaoFilterInit();
+}
+
+static struct aircraft *addAircraft(uint32_t addr, uint64_t seen, int reliable)
+{
+    struct aircraft *a = calloc(1, sizeof(*a));
+    a->addr = addr;
+    a->seen = seen;
+    a->reliable = reliable;
+    a->lat = 51.5;
+    a->lon = -0.25;
+    a->position_valid.source = SOURCE_ADSB;
+    a->position_valid.updated = seen;
+    a->position_valid.expires = seen + 60000;
+    a->cpr_even_lat = 12345;
+    a->cpr_even_valid.source = SOURCE_ADSB;
+    a->cpr_even_valid.updated = seen;
+    strcpy(a->callsign, "TEST1234");
+
+    struct aircraft **tail = &Modes.aircrafts;
+    while (*tail)
+        tail = &(*tail)->next;
+    *tail = a;
+    return a;
+}
+
+static void testRoundTrip(const char *path)
+{
+    uint64_t now = mstime();
+
+    resetTracker();
+    addAircraft(0x4840D6, now - 1000, 1);
+    addAircraft(0xA05F21, now - 5000, 1);
+    addAircraft(0x000123, now - TRACK_AIRCRAFT_TTL - 1000, 1);               // too old
+    addAircraft(0x000456, now - TRACK_AIRCRAFT_UNRELIABLE_TTL - 1000, 0);    // unreliable and old
+    icaoFilterAdd(0x4840D6);
+    icaoFilterAdd(0xA05F21);
+    Modes.modeAC_count[1234] = 7;
+    Modes.modeAC_age[42] = 3;
+
+    if (!stateWrite(path)) {
+        fail("stateWrite failed");
+        return;
+    }
+
+    resetTracker();
+    stateRead(path);
+
+    struct aircraft *a = Modes.aircrafts;
+    if (!a || a->addr != 0x4840D6 || !a->next || a->next->addr != 0xA05F21 || a->next->next) {
+        fail("wrong aircraft restored");
+        return;
+    }
+    if (a->seen != now - 1000 || a->lat != 51.5 || a->lon != -0.25 || strcmp(a->callsign, "TEST1234"))
+        fail("aircraft fields not restored");
+    if (a->cpr_even_lat != 12345 || a->cpr_even_valid.updated != now - 1000 || a->position_valid.expires != now + 59000)
+        fail("CPR state / validity not restored");
+    if (a->fatsv_dirty_pprev || a->fatsv_dirty_next)
+        fail("list pointers restored");
+    if (!icaoFilterTest(0x4840D6) || !icaoFilterTest(0xA05F21) || icaoFilterTest(0x000123))
+        fail("icao filter not restored");
+    if (icaoFilterTestFuzzy(0x0040D6) != 0x4840D6)
+        fail("partial icao filter not restored");
+    if (Modes.modeAC_count[1234] != 7 || Modes.modeAC_age[42] != 3)
+        fail("mode A/C state not restored");
+}
+
+// Damaged or foreign snapshots restore nothing
+static void testRejected(const char *path)
+{
+    uint64_t now = mstime();
+
+    resetTracker();
+    addAircraft(0x4840D6, now - 1000, 1);
+    if (!stateWrite(path)) {
+        fail("stateWrite failed");
+        return;
+    }
+
+    FILE *f = fopen(path, "rb");
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *good = malloc(len);
+    if (fread(good, 1, len, f) != (size_t) len)
+        fail("short read");
+    fclose(f);
+
+    struct {
+        const char *what;
+        size_t offset;
+        uint8_t value;
+        long len;
+    } cases[] = {
+        { "bad magic", 0, 'X', len },
+        { "other version", offsetof(struct state_header, version), 99, len },
+        { "other record size", offsetof(struct state_header, record_size), 1, len },
+        { "other record layout", offsetof(struct state_header, record_layout), 0x5a, len },
+        { "truncated", 0, 'D', len - 1 },
+        { "header only", 0, 'D', sizeof(struct state_header) },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        uint8_t *damaged = malloc(len);
+        memcpy(damaged, good, len);
+        damaged[cases[i].offset] = cases[i].value;
+
+        f = fopen(path, "wb");
+        fwrite(damaged, 1, cases[i].len, f);
+        fclose(f);
+        free(damaged);
+
+        resetTracker();
+        stateRead(path);
+        if (Modes.aircrafts)
+            fail("%s snapshot was restored", cases[i].what);
+    }
+
+    free(good);
+}
+
+// With --quiet and nothing else consuming messages, aircraft must still be
+// tracked so that there is something to snapshot
+static void testQuietTracking(const char *path)
+{
+    struct modesMessage mm;
+    unsigned char msg[MODES_LONG_MSG_BYTES];
+
+    resetTracker();
+    Modes.quiet = 1;
+    Modes.net = 0;
+    Modes.state_path = (char *) path;
+    modesChecksumInit(0);
+
+    modesInitMessage(&mm);
+    fromHex("8D4840D6202CC371C32CE0576098", msg);
+    if (decodeModesHeader(&mm, msg) < 0) {
+        fail("ident frame rejected");
+        return;
+    }
+    mm.sysTimestampMsg = mstime();
+    useModesMessage(&mm);
+
+    if (!Modes.aircrafts || Modes.aircrafts->addr != 0x4840D6 || strcmp(Modes.aircrafts->callsign, "KLM1023 "))
+        fail("quiet decoding with --write-state tracked nothing");
+    Modes.state_path = NULL;
+}
+
+int main(int argc, char **argv)
+{
+    MODES_NOTUSED(argc);
+    MODES_NOTUSED(argv);
+
+    char path[] = "/tmp/statetests.XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+
+    modesInitConfig();
+
+    testRoundTrip(path);
+    testRejected(path);
+    testQuietTracking(path);
+
+    resetTracker();
+    icaoFilterFree();
+    unlink(path);
+
+    return testsFinished();
+}
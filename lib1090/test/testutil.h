@@ -0,0 +1,148 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// testutil.h - helpers shared by the lib1090 tests and benchmarks
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DUMP1090_TESTUTIL_H
+#define DUMP1090_TESTUTIL_H
+
+#include "dump1090.h"
+
+#include <math.h>
+#include <stdarg.h>
+
+// Tests report each failure with fail() as they go, and main returns
+// testsFinished()
+
+static int test_failures __attribute__((unused));
+
+static inline void __attribute__((format(printf, 1, 2))) fail(const char *format, ...)
+{
+    va_list ap;
+
+    ++test_failures;
+    fprintf(stderr, "FAIL: ");
+    va_start(ap, format);
+    vfprintf(stderr, format, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+}
+
+static inline int testsFinished(void)
+{
+    if (test_failures) {
+        fprintf(stderr, "%d failures\n", test_failures);
+        return 1;
+    }
+
+    fprintf(stderr, "all tests passed\n");
+    return 0;
+}
+
+// Frames for tests and benchmarks
+
+static inline void fromHex(const char *hex, unsigned char *out)
+{
+    for (size_t i = 0; hex[i] && hex[i+1]; i += 2) {
+        unsigned v;
+        sscanf(hex + i, "%2x", &v);
+        out[i/2] = v;
+    }
+}
+
+// Build a DF11 all-call reply with II = 0
+static inline void makeAllCall(unsigned char *msg, uint32_t addr)
+{
+    memset(msg, 0, MODES_LONG_MSG_BYTES);
+    msg[0] = (11 << 3) | 5;
+    msg[1] = addr >> 16;
+    msg[2] = addr >> 8;
+    msg[3] = addr;
+    uint32_t crc = modesChecksum(msg, MODES_SHORT_MSG_BITS);
+    msg[4] = crc >> 16;
+    msg[5] = crc >> 8;
+    msg[6] = crc;
+}
+
+// Build an Address/Parity frame (DF4 / DF20) from the given aircraft
+static inline void makeAddressParity(unsigned char *msg, int df, uint32_t addr)
+{
+    int bits = modesMessageLenByType(df);
+    memset(msg, 0, MODES_LONG_MSG_BYTES);
+    msg[0] = df << 3;
+    msg[2] = 0x1e;                        // some altitude
+    msg[3] = 0x38;
+    if (bits == MODES_LONG_MSG_BITS)
+        memcpy(msg + 4, "\x20\x2c\xc3\x71\xc3\x2c\xe0", 7);  // BDS2,0 callsign
+    uint32_t crc = modesChecksum(msg, bits) ^ addr;
+    msg[bits/8 - 3] = crc >> 16;
+    msg[bits/8 - 2] = crc >> 8;
+    msg[bits/8 - 1] = crc;
+}
+
+// Synthetic signals, at Modes.sample_rate
+
+// xorshift32, so synthetic input doesn't depend on the C library
+static uint32_t rng_state __attribute__((unused));
+
+static inline uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static inline double rngUnit(void)
+{
+    return rng() / 4294967296.0;
+}
+
+// Add a pulse of 'amplitude' over [start, end) us to the envelope
+static inline void addPulse(float *envelope, uint32_t len, double start, double end, float amplitude)
+{
+    double rate = Modes.sample_rate / 1e6;
+    uint32_t first = (uint32_t) (start * rate);
+    uint32_t last = (uint32_t) (end * rate);
+
+    for (uint32_t n = first; n <= last && n < len; ++n) {
+        double from = fmax(start, n / rate);
+        double to = fmin(end, (n + 1) / rate);
+        if (to > from)
+            envelope[n] += (float) ((to - from) * rate * amplitude);
+    }
+}
+
+// Add the preamble and the first 'bits' bits of 'msg', starting at 't' us
+static inline void addFrame(float *envelope, uint32_t len, double t, const unsigned char *msg, int bits, float amplitude)
+{
+    addPulse(envelope, len, t + 0.0, t + 0.5, amplitude);
+    addPulse(envelope, len, t + 1.0, t + 1.5, amplitude);
+    addPulse(envelope, len, t + 3.5, t + 4.0, amplitude);
+    addPulse(envelope, len, t + 4.5, t + 5.0, amplitude);
+    for (int i = 0; i < bits; ++i) {
+        double bit = t + 8.0 + i + ((msg[i/8] & (0x80 >> (i % 8))) ? 0.0 : 0.5);
+        addPulse(envelope, len, bit, bit + 0.5, amplitude);
+    }
+}
+
+static inline double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#endif
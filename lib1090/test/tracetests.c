@@ -0,0 +1,305 @@
+// Part of dump1090, a Mode S message decoder for RTLSDR devices.
+//
+// tracetests.c - tests for the binary trace archive
+//
+// This file is free software: you may copy, redistribute and/or modify it
+// under the terms of the GNU General Public License as published by the
+// Free Software Foundation, either version 2 of the License, or (at your
+// option) any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "testutil.h"
+
+// 2024-03-01 23:59:00 UTC
+#define START 1709337540000ULL
+
+#define STEPS 200
+
+static void setValid(data_validity *v, uint64_t now)
+{
+    v->source = SOURCE_ADSB;
+    v->updated = now;
+    v->expires = now + 60000;
+}
+
+// What the aircraft looked like at step i
+static void fly(struct aircraft *a, int i, uint64_t now)
+{
+    Modes.message_now = now;
+
+    if (i % 2 == 0) {
+        a->lat = 51.5 + i * 0.0013;
+        a->lon = -0.25 - i * 0.0021;
+        setValid(&a->position_valid, now);
+        a->altitude_baro = 3000 + (i / 4) * 25;
+        setValid(&a->altitude_baro_valid, now);
+    } else {
+        a->gs = 250.0f + (i % 7) * 0.5f;
+        a->track = (float) ((i * 3) % 360);
+        a->baro_rate = (i % 3) * 64;
+        setValid(&a->gs_valid, now);
+        setValid(&a->track_valid, now);
+        setValid(&a->baro_rate_valid, now);
+    }
+    if (i % 50 == 1) {
+        a->squawk = (i < 100) ? 0x1200 : 0x7700;
+        setValid(&a->squawk_valid, now);
+        strcpy(a->callsign, (i < 100) ? "ABC123  " : "XYZ789  ");
+        setValid(&a->callsign_valid, now);
+    }
+}
+
+static uint8_t *readAll(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(*len ? *len : 1);
+    if (fread(data, 1, *len, f) != *len)
+        fail("short read");
+    fclose(f);
+    return data;
+}
+
+// Number of records in 'data', and how often the reader skipped damage
+static int countRecords(const uint8_t *data, size_t len, unsigned *damaged)
+{
+    struct trace_reader *r = traceReaderNew(data, len);
+    struct trace_point p;
+    int records = 0;
+
+    while (traceReaderNext(r, &p))
+        ++records;
+    *damaged = traceReaderDamaged(r);
+    traceReaderFree(r);
+    return records;
+}
+
+// Replays the trace in 'data' against a second run of fly(), returning
+// the number of records read
+static int checkTrace(const uint8_t *data, size_t len, struct aircraft *expected, int *step)
+{
+    struct trace_reader *r = traceReaderNew(data, len);
+    struct trace_point p;
+    int records = 0;
+
+    while (traceReaderNext(r, &p)) {
+        ++records;
+        if (p.addr != expected->addr) {
+            fail("wrong address");
+            break;
+        }
+
+        // records are only written when something changed, so catch up
+        // to the step that produced this one
+        while (*step < STEPS && START + *step * 700ULL < p.time)
+            ++*step;
+        if (*step >= STEPS || START + *step * 700ULL != p.time) {
+            fail("record time does not match any step");
+            break;
+        }
+        fly(expected, *step, p.time);
+
+        if ((p.fields & TRACE_POSITION) && (fabs(p.lat - expected->lat) > 0.6e-5 || fabs(p.lon - expected->lon) > 0.6e-5))
+            fail("position");
+        if ((p.fields & TRACE_ALT_BARO) && p.alt_baro != expected->altitude_baro)
+            fail("altitude");
+        if ((p.fields & TRACE_GS) && fabs(p.gs - expected->gs) > 0.051)
+            fail("groundspeed");
+        if ((p.fields & TRACE_TRACK) && fabs(p.track - expected->track) > 0.051)
+            fail("track");
+        if ((p.fields & TRACE_BARO_RATE) && p.baro_rate != expected->baro_rate)
+            fail("vertical rate");
+        if ((p.fields & TRACE_SQUAWK) && p.squawk != expected->squawk)
+            fail("squawk");
+        if ((p.fields & TRACE_CALLSIGN) && strcmp(p.callsign, expected->callsign))
+            fail("callsign");
+        ++*step;
+    }
+
+    if (traceReaderDamaged(r))
+        fail("trace reported as damaged");
+    traceReaderFree(r);
+    return records;
+}
+
+// With --quiet and nothing else consuming messages, messages that only had
+// their header decoded must still be tracked and reach the trace
+static void testQuietTrace(const char *dir)
+{
+    static const char *position[] = {
+        "8D40621D58C382D690C8AC2863A7",
+        "8D40621D58C386435CC412692AD6",
+    };
+    char path[PATH_MAX + 32];
+
+    Modes.quiet = 1;
+    Modes.net = 0;
+    Modes.trace_dir = (char *) dir;
+    Modes.trace_day = 0;
+    Modes.next_trace_retry = 0;
+    modesChecksumInit(0);
+
+    for (int i = 0; i < 20; ++i) {
+        struct modesMessage mm;
+        unsigned char msg[MODES_LONG_MSG_BYTES];
+
+        modesInitMessage(&mm);
+        fromHex(position[i % 2], msg);
+        if (decodeModesHeader(&mm, msg) < 0) {
+            fail("position frame rejected");
+            return;
+        }
+        mm.sysTimestampMsg = START + i * 1000ULL;
+        useModesMessage(&mm);
+    }
+    traceClose();
+
+    snprintf(path, sizeof(path), "%s/trace-20240301.bin", dir);
+    size_t len = 0;
+    uint8_t *data = readAll(path, &len);
+    unsigned damaged;
+    if (!data || countRecords(data, len, &damaged) == 0)
+        fail("quiet decoding wrote no trace");
+    unlink(path);
+    free(data);
+}
+
+int main(int argc, char **argv)
+{
+    MODES_NOTUSED(argc);
+    MODES_NOTUSED(argv);
+
+    char dir[] = "/tmp/tracetests.XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    modesInitConfig();
+    Modes.trace_dir = dir;
+
+    // One aircraft across midnight, with a restart (new segment) half way
+    // through the first day
+    struct aircraft *a = calloc(1, sizeof(*a));
+    a->addr = 0x4840D6;
+    a->reliable = 1;
+    for (int i = 0; i < STEPS; ++i) {
+        uint64_t now = START + i * 700ULL;
+        fly(a, i, now);
+        traceUpdate(a);
+        if (i == 40) {
+            traceClose();
+            Modes.trace_day = 0;
+        }
+    }
+    traceClose();
+
+    char path1[PATH_MAX], path2[PATH_MAX];
+    snprintf(path1, sizeof(path1), "%s/trace-20240301.bin", dir);
+    snprintf(path2, sizeof(path2), "%s/trace-20240302.bin", dir);
+
+    size_t len1 = 0, len2 = 0;
+    uint8_t *day1 = readAll(path1, &len1);
+    uint8_t *day2 = readAll(path2, &len2);
+    if (!day1 || !day2) {
+        fail("daily files not written");
+        return 1;
+    }
+
+    struct aircraft *expected = calloc(1, sizeof(*expected));
+    expected->addr = a->addr;
+    int step = 0;
+    int records = checkTrace(day1, len1, expected, &step);
+    records += checkTrace(day2, len2, expected, &step);
+    if (records < STEPS / 2)
+        fail("too few records");
+    if (step != STEPS)
+        fail("did not reach the last step");
+
+    // Keyframes restart each file and segment: the second day's file
+    // must read on its own, and both segments of the first
+    int segments = 0;
+    size_t second = 0;
+    for (size_t i = 0; i + 9 <= len1; ++i) {
+        if (day1[i] == 0 && !memcmp(day1 + i + 1, TRACE_MAGIC, 8)) {
+            ++segments;
+            second = i;
+        }
+    }
+    if (segments != 2)
+        fail("expected two segments in the first file");
+
+    // Damage is skipped up to the next segment header, and reading goes
+    // on from there: a truncated last record, records before any segment
+    // header, and a bad record early in the first segment
+    unsigned damaged;
+    int all = countRecords(day1, len1, &damaged);
+    int in_second = countRecords(day1 + second, len1 - second, &damaged);
+    if (in_second <= 0 || in_second >= all)
+        fail("second segment has %d of %d records", in_second, all);
+
+    if (countRecords(day1, len1 - 1, &damaged) != all - 1 || damaged != 1)
+        fail("truncated trace: expected %d records and one damaged stretch", all - 1);
+    if (countRecords(day1 + TRACE_SEGMENT_SIZE, len1 - TRACE_SEGMENT_SIZE, &damaged) != in_second || damaged != 1)
+        fail("records without a segment: expected the %d of the next segment and one damaged stretch", in_second);
+
+    uint8_t *corrupt = malloc(len1);
+    memcpy(corrupt, day1, len1);
+    corrupt[TRACE_SEGMENT_SIZE] = TRACE_KEYFRAME;   // a record with no fields
+    if (countRecords(corrupt, len1, &damaged) != in_second || damaged != 1)
+        fail("bad record: expected the %d records of the next segment and one damaged stretch", in_second);
+    free(corrupt);
+
+    // A file that can't be opened is retried a little later, rather than
+    // only once the day changes
+    char later[PATH_MAX], path3[PATH_MAX];
+    snprintf(later, sizeof(later), "%s/later", dir);
+    snprintf(path3, sizeof(path3), "%s/later/trace-20240302.bin", dir);
+    Modes.trace_dir = later;
+
+    uint64_t now = START + STEPS * 700ULL;
+    fly(a, 0, now);
+    traceUpdate(a);
+    if (Modes.trace_fd >= 0)
+        fail("trace file opened in a missing directory");
+    mkdir(later, 0755);
+    fly(a, 0, now + 1000);
+    traceUpdate(a);
+    if (Modes.trace_fd >= 0)
+        fail("failed trace file retried straight away");
+    fly(a, 0, now + 60000);
+    traceUpdate(a);
+    if (Modes.trace_fd < 0)
+        fail("failed trace file not retried");
+    traceClose();
+
+    char quiet[PATH_MAX];
+    snprintf(quiet, sizeof(quiet), "%s/quiet", dir);
+    mkdir(quiet, 0755);
+    testQuietTrace(quiet);
+
+    unlink(path1);
+    unlink(path2);
+    unlink(path3);
+    rmdir(later);
+    rmdir(quiet);
+    rmdir(dir);
+    free(day1);
+    free(day2);
+    free(a);
+    free(expected);
+
+    fprintf(stderr, "%d records, %zu + %zu bytes\n", records, len1, len2);
+    return testsFinished();
+}